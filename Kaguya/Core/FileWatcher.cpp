@@ -0,0 +1,324 @@
+#include "pch.h"
+#include "FileWatcher.h"
+
+// WaitForMultipleObjects takes at most MAXIMUM_WAIT_OBJECTS handles, one of them is the wake event
+static constexpr size_t MaxDirectories = MAXIMUM_WAIT_OBJECTS - 1;
+
+static constexpr DWORD NotifyFilter = FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_SIZE;
+
+struct FileWatcher::Directory
+{
+	std::filesystem::path Path;
+	std::wstring Key;
+	wil::unique_hfile Handle;
+	wil::unique_event Event;
+	OVERLAPPED Overlapped = {};
+	alignas(DWORD) BYTE Buffer[16_KiB];
+};
+
+FileWatcher::FileWatcher(Backend Backend, TCallback Callback)
+	: WatchBackend(Backend),
+	Callback(std::move(Callback))
+{
+	WakeEvent.create(wil::EventOptions::None);
+	Thread.reset(::CreateThread(nullptr, 0, &ThreadProc, this, 0, nullptr));
+}
+
+FileWatcher::~FileWatcher()
+{
+	Shutdown = true;
+	WakeEvent.SetEvent();
+
+	::WaitForSingleObject(Thread.get(), INFINITE);
+}
+
+void FileWatcher::Watch(const std::filesystem::path& Path)
+{
+	std::error_code ec;
+	File file =
+	{
+		.Path = Path,
+		.LastWriteTime = std::filesystem::last_write_time(Path, ec),
+		.Polled = WatchBackend == Backend::Polling
+	};
+
+	ScopedCriticalSection SCS(CriticalSection);
+	if (Files.try_emplace(GetKey(Path), std::move(file)).second)
+	{
+		FilesChanged = true;
+		WakeEvent.SetEvent();
+	}
+}
+
+void FileWatcher::Unwatch(const std::filesystem::path& Path)
+{
+	const auto key = GetKey(Path);
+
+	ScopedCriticalSection SCS(CriticalSection);
+	if (Files.erase(key) > 0)
+	{
+		Changes.erase(key);
+		FilesChanged = true;
+		WakeEvent.SetEvent();
+	}
+}
+
+std::wstring FileWatcher::GetKey(const std::filesystem::path& Path)
+{
+	std::wstring key = Path.lexically_normal().native();
+	std::transform(key.begin(), key.end(), key.begin(), ::towlower);
+	return key;
+}
+
+// Opens a directory for every folder holding a watched file and closes the ones that are no longer needed,
+// files whose folder couldn't be opened are polled
+void FileWatcher::UpdateDirectories()
+{
+	ScopedCriticalSection SCS(CriticalSection);
+	if (!FilesChanged)
+	{
+		return;
+	}
+	FilesChanged = false;
+
+	if (WatchBackend == Backend::Polling)
+	{
+		return;
+	}
+
+	std::unordered_map<std::wstring, std::filesystem::path> folders;
+	for (const auto& [key, file] : Files)
+	{
+		folders.try_emplace(GetKey(file.Path.parent_path()), file.Path.parent_path());
+	}
+
+	std::erase_if(Directories, [&](const auto& Directory)
+	{
+		if (folders.erase(Directory->Key) > 0)
+		{
+			return false;
+		}
+		::CancelIoEx(Directory->Handle.get(), &Directory->Overlapped);
+		DWORD bytes;
+		::GetOverlappedResult(Directory->Handle.get(), &Directory->Overlapped, &bytes, TRUE);
+		return true;
+	});
+
+	for (auto& [key, path] : folders)
+	{
+		if (Directories.size() == MaxDirectories)
+		{
+			break;
+		}
+
+		auto directory = std::make_unique<Directory>();
+		directory->Path = path;
+		directory->Key = key;
+		directory->Handle.reset(::CreateFileW(path.c_str(),
+			FILE_LIST_DIRECTORY,
+			FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+			nullptr,
+			OPEN_EXISTING,
+			FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED,
+			nullptr));
+		if (!directory->Handle)
+		{
+			continue;
+		}
+
+		directory->Event.create(wil::EventOptions::ManualReset);
+		directory->Overlapped.hEvent = directory->Event.get();
+		if (!::ReadDirectoryChangesW(directory->Handle.get(), directory->Buffer, sizeof(directory->Buffer), FALSE, NotifyFilter, nullptr, &directory->Overlapped, nullptr))
+		{
+			LOG_WARN("Failed to watch {}, polling its files (error={})", path.string(), ::GetLastError());
+			continue;
+		}
+
+		Directories.push_back(std::move(directory));
+	}
+
+	// Everything outside of the watched directories falls back to polling
+	for (auto& [key, file] : Files)
+	{
+		const auto folder = GetKey(file.Path.parent_path());
+		file.Polled = std::none_of(Directories.begin(), Directories.end(), [&](const auto& Directory)
+		{
+			return Directory->Key == folder;
+		});
+	}
+}
+
+// Returns false once the directory can't be watched anymore, its files are polled from then on
+bool FileWatcher::ReadDirectoryChanges(Directory& Directory)
+{
+	DWORD bytes = 0;
+	const bool succeeded = ::GetOverlappedResult(Directory.Handle.get(), &Directory.Overlapped, &bytes, FALSE);
+	Directory.Event.ResetEvent();
+
+	{
+		ScopedCriticalSection SCS(CriticalSection);
+		if (succeeded && bytes > 0)
+		{
+			const BYTE* pData = Directory.Buffer;
+			while (true)
+			{
+				const auto pInfo = reinterpret_cast<const FILE_NOTIFY_INFORMATION*>(pData);
+				if (pInfo->Action != FILE_ACTION_REMOVED && pInfo->Action != FILE_ACTION_RENAMED_OLD_NAME)
+				{
+					MarkChanged(GetKey(Directory.Path / std::wstring_view(pInfo->FileName, pInfo->FileNameLength / sizeof(WCHAR))));
+				}
+
+				if (pInfo->NextEntryOffset == 0)
+				{
+					break;
+				}
+				pData += pInfo->NextEntryOffset;
+			}
+		}
+		else
+		{
+			// The buffer overflowed, find out what changed from the last write times
+			const auto folder = Directory.Key;
+			for (auto& [key, file] : Files)
+			{
+				std::error_code ec;
+				const auto lastWriteTime = std::filesystem::last_write_time(file.Path, ec);
+				if (!ec && lastWriteTime != file.LastWriteTime && GetKey(file.Path.parent_path()) == folder)
+				{
+					MarkChanged(key);
+				}
+			}
+		}
+	}
+
+	if (::ReadDirectoryChangesW(Directory.Handle.get(), Directory.Buffer, sizeof(Directory.Buffer), FALSE, NotifyFilter, nullptr, &Directory.Overlapped, nullptr))
+	{
+		return true;
+	}
+
+	LOG_WARN("Failed to watch {}, polling its files (error={})", Directory.Path.string(), ::GetLastError());
+
+	ScopedCriticalSection SCS(CriticalSection);
+	for (auto& [key, file] : Files)
+	{
+		if (GetKey(file.Path.parent_path()) == Directory.Key)
+		{
+			file.Polled = true;
+		}
+	}
+	return false;
+}
+
+void FileWatcher::PollFiles(bool PolledOnly)
+{
+	ScopedCriticalSection SCS(CriticalSection);
+	for (auto& [key, file] : Files)
+	{
+		if (PolledOnly && !file.Polled)
+		{
+			continue;
+		}
+
+		std::error_code ec;
+		const auto lastWriteTime = std::filesystem::last_write_time(file.Path, ec);
+		if (!ec && lastWriteTime != file.LastWriteTime)
+		{
+			MarkChanged(key);
+		}
+	}
+}
+
+// Expects CriticalSection to be held
+void FileWatcher::MarkChanged(const std::wstring& Key)
+{
+	if (auto iter = Files.find(Key);
+		iter != Files.end())
+	{
+		std::error_code ec;
+		iter->second.LastWriteTime = std::filesystem::last_write_time(iter->second.Path, ec);
+
+		Changes[Key] = std::chrono::steady_clock::now();
+	}
+}
+
+void FileWatcher::FlushChanges()
+{
+	std::vector<std::filesystem::path> changedFiles;
+	{
+		ScopedCriticalSection SCS(CriticalSection);
+
+		const auto now = std::chrono::steady_clock::now();
+		std::erase_if(Changes, [&](const auto& Change)
+		{
+			const auto& [key, time] = Change;
+			if (now - time < DebounceTime)
+			{
+				return false;
+			}
+
+			if (auto iter = Files.find(key);
+				iter != Files.end())
+			{
+				changedFiles.push_back(iter->second.Path);
+			}
+			return true;
+		});
+	}
+
+	// Outside of the lock, callbacks may watch or unwatch files
+	for (const auto& path : changedFiles)
+	{
+		Callback(path);
+	}
+}
+
+DWORD WINAPI FileWatcher::ThreadProc(_In_ PVOID pParameter)
+{
+	auto pFileWatcher = static_cast<FileWatcher*>(pParameter);
+
+	while (!pFileWatcher->Shutdown)
+	{
+		pFileWatcher->UpdateDirectories();
+
+		std::vector<HANDLE> events = { pFileWatcher->WakeEvent.get() };
+		for (const auto& directory : pFileWatcher->Directories)
+		{
+			events.push_back(directory->Event.get());
+		}
+
+		// Wake up often enough to report debounced changes and to poll
+		const DWORD result = ::WaitForMultipleObjects(static_cast<DWORD>(events.size()), events.data(), FALSE, static_cast<DWORD>(DebounceTime.count() / 2));
+		if (pFileWatcher->Shutdown)
+		{
+			break;
+		}
+
+		if (result > WAIT_OBJECT_0 && result < WAIT_OBJECT_0 + events.size())
+		{
+			const size_t index = result - WAIT_OBJECT_0 - 1;
+			if (!pFileWatcher->ReadDirectoryChanges(*pFileWatcher->Directories[index]))
+			{
+				pFileWatcher->Directories.erase(pFileWatcher->Directories.begin() + index);
+			}
+		}
+
+		const auto now = std::chrono::steady_clock::now();
+		if (now - pFileWatcher->LastPoll >= PollInterval)
+		{
+			pFileWatcher->PollFiles(pFileWatcher->WatchBackend == Backend::Native);
+			pFileWatcher->LastPoll = now;
+		}
+
+		pFileWatcher->FlushChanges();
+	}
+
+	for (auto& directory : pFileWatcher->Directories)
+	{
+		::CancelIoEx(directory->Handle.get(), &directory->Overlapped);
+		DWORD bytes;
+		::GetOverlappedResult(directory->Handle.get(), &directory->Overlapped, &bytes, TRUE);
+	}
+	pFileWatcher->Directories.clear();
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <unordered_map>
+
+#include <wil/resource.h>
+
+#include "Synchronization/CriticalSection.h"
+
+/*
+* Watches individual files and reports every file once it stopped changing for DebounceTime, exporters usually
+* write a file in several steps or through a temporary file that is renamed over it.
+* The native backend waits on ReadDirectoryChangesW for the folders of the watched files, files in folders it can't
+* watch (too many folders, file systems that don't report changes) are polled. The polling backend only compares
+* last write times. Callbacks are made on the watcher thread.
+*/
+class FileWatcher
+{
+public:
+	enum class Backend
+	{
+		Native,
+		Polling
+	};
+
+	using TCallback = std::function<void(const std::filesystem::path&)>;
+
+	static constexpr std::chrono::milliseconds DebounceTime{ 250 };
+	static constexpr std::chrono::milliseconds PollInterval{ 500 };
+
+	FileWatcher(Backend Backend, TCallback Callback);
+	FileWatcher(const FileWatcher&) = delete;
+	FileWatcher& operator=(const FileWatcher&) = delete;
+	~FileWatcher();
+
+	void Watch(const std::filesystem::path& Path);
+	void Unwatch(const std::filesystem::path& Path);
+private:
+	struct File
+	{
+		std::filesystem::path Path; // As passed to Watch, this is what the callback gets
+		std::filesystem::file_time_type LastWriteTime;
+		bool Polled;
+	};
+
+	struct Directory;
+
+	// Case insensitive like the file system, ReadDirectoryChangesW does not preserve the case Watch was called with
+	static std::wstring GetKey(const std::filesystem::path& Path);
+
+	void UpdateDirectories();
+	bool ReadDirectoryChanges(Directory& Directory);
+	void PollFiles(bool PolledOnly);
+	void MarkChanged(const std::wstring& Key);
+	void FlushChanges();
+
+	static DWORD WINAPI ThreadProc(_In_ PVOID pParameter);
+private:
+	Backend WatchBackend;
+	TCallback Callback;
+
+	CriticalSection CriticalSection;
+	std::unordered_map<std::wstring, File> Files;
+	std::unordered_map<std::wstring, std::chrono::steady_clock::time_point> Changes; // Time of the last change
+	bool FilesChanged = false;
+
+	// Only touched by the watcher thread
+	std::vector<std::unique_ptr<Directory>> Directories;
+	std::chrono::steady_clock::time_point LastPoll;
+
+	wil::unique_event WakeEvent;
+	wil::unique_handle Thread;
+	std::atomic<bool> Shutdown = false;
+};
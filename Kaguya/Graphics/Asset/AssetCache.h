@@ -93,6 +93,14 @@ public:
 		}
 	}
 
+	// Swaps in a new version of the asset, handles loaded before keep the previous version alive until they are reloaded
+	void Replace(UINT64 Key, std::shared_ptr<T> Resource)
+	{
+		ScopedWriteLock SWL(RWLock);
+
+		Cache[Key] = std::move(Resource);
+	}
+
 	void Discard(UINT64 Key)
 	{
 		ScopedWriteLock SWL(RWLock);
@@ -1,2 +1,242 @@
 #include "pch.h"
 #include "AssetStream.h"
+
+AssetStreamWriter::AssetStreamWriter(uint32_t Version, uint64_t SectionAlignment)
+	: Version(Version),
+	SectionAlignment(SectionAlignment)
+{
+	assert(SectionAlignment >= DefaultSectionAlignment && (SectionAlignment & (SectionAlignment - 1)) == 0);
+}
+
+uint32_t AssetStreamWriter::AddSection(uint32_t Id, const void* pData, size_t SizeInBytes)
+{
+	std::vector<BYTE> Data(SizeInBytes);
+	if (SizeInBytes > 0)
+	{
+		memcpy(Data.data(), pData, SizeInBytes);
+	}
+	return AddSection(Id, std::move(Data));
+}
+
+uint32_t AssetStreamWriter::AddSection(uint32_t Id, std::vector<BYTE>&& Data)
+{
+	Sections.emplace_back(Id, std::move(Data));
+	return static_cast<uint32_t>(Sections.size() - 1);
+}
+
+std::vector<AssetStreamSection> AssetStreamWriter::GetSectionTable() const
+{
+	std::vector<AssetStreamSection> Table(Sections.size());
+
+	uint64_t Offset = AlignUp<uint64_t>(sizeof(AssetStreamHeader) + sizeof(AssetStreamSection) * Table.size(), SectionAlignment);
+	for (size_t i = 0; i < Sections.size(); ++i)
+	{
+		Table[i] =
+		{
+			.Id = Sections[i].first,
+			.Reserved = 0,
+			.Offset = Offset,
+			.Size = Sections[i].second.size()
+		};
+		Offset = AlignUp<uint64_t>(Offset + Table[i].Size, SectionAlignment);
+	}
+
+	return Table;
+}
+
+std::vector<BYTE> AssetStreamWriter::Serialize() const
+{
+	AssetStreamHeader Header =
+	{
+		.Signature = AssetStreamHeader::Magic,
+		.Version = Version,
+		.NumSections = static_cast<uint32_t>(Sections.size()),
+		.Reserved = 0
+	};
+
+	const auto Table = GetSectionTable();
+	const uint64_t StreamSize = Table.empty() ?
+		AlignUp<uint64_t>(sizeof(AssetStreamHeader), SectionAlignment) :
+		AlignUp<uint64_t>(Table.back().Offset + Table.back().Size, SectionAlignment);
+
+	std::vector<BYTE> Stream(StreamSize, 0);
+	memcpy(Stream.data(), &Header, sizeof(Header));
+	memcpy(Stream.data() + sizeof(Header), Table.data(), sizeof(AssetStreamSection) * Table.size());
+	for (size_t i = 0; i < Sections.size(); ++i)
+	{
+		if (Table[i].Size > 0)
+		{
+			memcpy(Stream.data() + Table[i].Offset, Sections[i].second.data(), Table[i].Size);
+		}
+	}
+
+	return Stream;
+}
+
+bool AssetStreamWriter::Write(const std::filesystem::path& Path) const
+{
+	std::error_code ec;
+	std::filesystem::create_directories(Path.parent_path(), ec);
+
+	wil::unique_hfile File(::CreateFileW(Path.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr));
+	if (!File)
+	{
+		return false;
+	}
+
+	uint64_t Position = 0;
+	auto WriteBytes = [&](const void* pData, uint64_t SizeInBytes)
+	{
+		// WriteFile takes a 32-bit size, large sections are written in chunks
+		const BYTE* pBytes = static_cast<const BYTE*>(pData);
+		while (SizeInBytes > 0)
+		{
+			const DWORD ChunkSize = static_cast<DWORD>(std::min<uint64_t>(SizeInBytes, 1_GiB));
+			DWORD NumBytesWritten = 0;
+			if (!::WriteFile(File.get(), pBytes, ChunkSize, &NumBytesWritten, nullptr) || NumBytesWritten != ChunkSize)
+			{
+				return false;
+			}
+			pBytes += ChunkSize;
+			SizeInBytes -= ChunkSize;
+			Position += ChunkSize;
+		}
+		return true;
+	};
+
+	const std::vector<BYTE> Padding(SectionAlignment, 0);
+	auto PadTo = [&](uint64_t Offset)
+	{
+		return WriteBytes(Padding.data(), Offset - Position);
+	};
+
+	AssetStreamHeader Header =
+	{
+		.Signature = AssetStreamHeader::Magic,
+		.Version = Version,
+		.NumSections = static_cast<uint32_t>(Sections.size()),
+		.Reserved = 0
+	};
+
+	const auto Table = GetSectionTable();
+	if (!WriteBytes(&Header, sizeof(Header)) ||
+		!WriteBytes(Table.data(), sizeof(AssetStreamSection) * Table.size()))
+	{
+		return false;
+	}
+
+	for (size_t i = 0; i < Sections.size(); ++i)
+	{
+		if (!PadTo(Table[i].Offset) ||
+			!WriteBytes(Sections[i].second.data(), Table[i].Size))
+		{
+			return false;
+		}
+	}
+
+	return PadTo(AlignUp<uint64_t>(Position, SectionAlignment));
+}
+
+bool AssetStreamReader::Open(const std::filesystem::path& Path, uint32_t Version)
+{
+	File.reset(::CreateFileW(Path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr));
+	if (!File)
+	{
+		return false;
+	}
+
+	LARGE_INTEGER FileSize = {};
+	if (!::GetFileSizeEx(File.get(), &FileSize) || FileSize.QuadPart < static_cast<LONGLONG>(sizeof(AssetStreamHeader)))
+	{
+		return false;
+	}
+
+	Mapping.reset(::CreateFileMappingW(File.get(), nullptr, PAGE_READONLY, 0, 0, nullptr));
+	if (!Mapping)
+	{
+		return false;
+	}
+
+	View.reset(static_cast<BYTE*>(::MapViewOfFile(Mapping.get(), FILE_MAP_READ, 0, 0, 0)));
+	if (!View)
+	{
+		return false;
+	}
+
+	return Open(View.get(), static_cast<size_t>(FileSize.QuadPart), Version);
+}
+
+bool AssetStreamReader::Open(const BYTE* pData, size_t SizeInBytes, uint32_t Version)
+{
+	if (SizeInBytes < sizeof(AssetStreamHeader))
+	{
+		return false;
+	}
+
+	const auto pHeader = reinterpret_cast<const AssetStreamHeader*>(pData);
+	if (pHeader->Signature != AssetStreamHeader::Magic ||
+		pHeader->Version != Version ||
+		sizeof(AssetStreamHeader) + sizeof(AssetStreamSection) * pHeader->NumSections > SizeInBytes)
+	{
+		return false;
+	}
+
+	const auto pSections = reinterpret_cast<const AssetStreamSection*>(pData + sizeof(AssetStreamHeader));
+	for (uint32_t i = 0; i < pHeader->NumSections; ++i)
+	{
+		if (pSections[i].Offset + pSections[i].Size > SizeInBytes)
+		{
+			return false;
+		}
+	}
+
+	this->pData = pData;
+	this->SizeInBytes = SizeInBytes;
+	Sections = { pSections, pHeader->NumSections };
+	return true;
+}
+
+bool AssetStreamReader::HasSection(uint32_t Id) const
+{
+	return std::any_of(Sections.begin(), Sections.end(), [Id](const AssetStreamSection& Section)
+	{
+		return Section.Id == Id;
+	});
+}
+
+std::span<const BYTE> AssetStreamReader::GetSection(uint32_t Id) const
+{
+	for (const auto& Section : Sections)
+	{
+		if (Section.Id == Id)
+		{
+			return { pData + Section.Offset, static_cast<size_t>(Section.Size) };
+		}
+	}
+	return {};
+}
+
+std::span<const BYTE> AssetStreamReader::GetSectionAt(uint32_t Index) const
+{
+	if (Index >= Sections.size())
+	{
+		return {};
+	}
+	return { pData + Sections[Index].Offset, static_cast<size_t>(Sections[Index].Size) };
+}
+
+std::filesystem::path GetCookedAssetPath(const std::filesystem::path& Path, std::string_view Folder, std::string_view Extension)
+{
+	entt::id_type hs = entt::hashed_string(Path.string().data());
+	return Application::ExecutableFolderPath / "Cache" / Folder / (std::to_string(hs) + std::string(Extension));
+}
+
+bool IsCookedAssetUpToDate(const std::filesystem::path& Path, const std::filesystem::path& CookedPath)
+{
+	std::error_code ec;
+	if (!std::filesystem::exists(CookedPath, ec))
+	{
+		return false;
+	}
+	return std::filesystem::last_write_time(CookedPath, ec) >= std::filesystem::last_write_time(Path, ec);
+}
@@ -1,5 +1,116 @@
 #pragma once
+#include <filesystem>
+#include <span>
+#include <string_view>
+#include <vector>
+#include <wil/resource.h>
 
-class AssetStream
+/*
+* Binary container used for cooked assets. A stream is a header followed by a table of sections,
+* every section is identified by a FourCC and starts on a 16 byte boundary so it can be used in place
+* from a memory mapped view. Readers check the version and discard the stream on mismatch, so bump the
+* version of an asset type whenever the layout of one of its sections changes.
+*/
+struct AssetStreamHeader
 {
-};
\ No newline at end of file
+	static constexpr uint32_t Magic = MAKEFOURCC('K', 'A', 'S', 'T');
+
+	uint32_t Signature;
+	uint32_t Version;
+	uint32_t NumSections;
+	uint32_t Reserved;
+};
+
+struct AssetStreamSection
+{
+	uint32_t Id;
+	uint32_t Reserved;
+	uint64_t Offset; // Relative to the start of the stream
+	uint64_t Size;
+};
+
+class AssetStreamWriter
+{
+public:
+	static constexpr uint64_t DefaultSectionAlignment = 16;
+
+	// SectionAlignment must be a power of two and at least DefaultSectionAlignment
+	explicit AssetStreamWriter(uint32_t Version, uint64_t SectionAlignment = DefaultSectionAlignment);
+
+	// The data is copied, the caller does not need to keep it alive. Returns the index of the section
+	uint32_t AddSection(uint32_t Id, const void* pData, size_t SizeInBytes);
+
+	uint32_t AddSection(uint32_t Id, std::vector<BYTE>&& Data);
+
+	template<typename T>
+	uint32_t AddSection(uint32_t Id, const std::vector<T>& Data)
+	{
+		static_assert(std::is_trivially_copyable_v<T>);
+		return AddSection(Id, Data.data(), Data.size() * sizeof(T));
+	}
+
+	// Serializes the stream into memory
+	[[nodiscard]] std::vector<BYTE> Serialize() const;
+
+	// Writes the sections to the file one after another without serializing the stream into memory first
+	bool Write(const std::filesystem::path& Path) const;
+private:
+	[[nodiscard]] std::vector<AssetStreamSection> GetSectionTable() const;
+private:
+	uint32_t Version;
+	uint64_t SectionAlignment;
+	std::vector<std::pair<uint32_t, std::vector<BYTE>>> Sections;
+};
+
+class AssetStreamReader
+{
+public:
+	// Memory maps the file
+	bool Open(const std::filesystem::path& Path, uint32_t Version);
+
+	// Reads from memory owned by the caller, which must outlive the reader
+	bool Open(const BYTE* pData, size_t SizeInBytes, uint32_t Version);
+
+	[[nodiscard]] bool HasSection(uint32_t Id) const;
+
+	[[nodiscard]] std::span<const BYTE> GetSection(uint32_t Id) const;
+
+	[[nodiscard]] uint32_t GetNumSections() const { return static_cast<uint32_t>(Sections.size()); }
+
+	// Returns the section by the index AddSection returned, used when several sections share an Id
+	[[nodiscard]] std::span<const BYTE> GetSectionAt(uint32_t Index) const;
+
+	template<typename T>
+	[[nodiscard]] std::span<const T> GetSection(uint32_t Id) const
+	{
+		static_assert(std::is_trivially_copyable_v<T>);
+		auto Section = GetSection(Id);
+		return { reinterpret_cast<const T*>(Section.data()), Section.size() / sizeof(T) };
+	}
+
+	template<typename T>
+	bool ReadSection(uint32_t Id, std::vector<T>& Data) const
+	{
+		if (!HasSection(Id))
+		{
+			return false;
+		}
+		auto Section = GetSection<T>(Id);
+		Data.assign(Section.begin(), Section.end());
+		return true;
+	}
+private:
+	wil::unique_hfile File;
+	wil::unique_handle Mapping;
+	wil::unique_mapview_ptr<BYTE> View;
+
+	const BYTE* pData = nullptr;
+	size_t SizeInBytes = 0;
+	std::span<const AssetStreamSection> Sections;
+};
+
+// Returns the path of the cooked asset for the source file: Cache/<Folder>/<hash><Extension>
+std::filesystem::path GetCookedAssetPath(const std::filesystem::path& Path, std::string_view Folder, std::string_view Extension);
+
+// Returns true if the cooked asset exists and is newer than the source file
+bool IsCookedAssetUpToDate(const std::filesystem::path& Path, const std::filesystem::path& CookedPath);
@@ -1,5 +1,17 @@
 #include "pch.h"
 #include "AsyncLoader.h"
+#include "MeshStream.h"
+#include "MeshOptimizer.h"
+#include "IndexPacking.h"
+#include "MeshSimplifier.h"
+#include "MeshClusterizer.h"
+#include "VertexQuantization.h"
+#include "SceneBundle.h"
+#include "ImportWorker.h"
+#include "ImageDecoder.h"
+#include "../CPU/BVH.h"
+
+#include <random>
 
 #include <DDSTextureLoader.h>
 #include <WICTextureLoader.h>
@@ -13,6 +25,10 @@ using namespace DirectX;
 
 static Assimp::Importer s_Importer;
 
+// Loads run concurrently, importing in process is only done when there are no import workers and is serialized
+// as the importers are not thread safe (s_Importer is shared)
+static CriticalSection s_ImportCriticalSection;
+
 static constexpr uint32_t s_ImporterFlags =
 aiProcess_ConvertToLeftHanded |
 aiProcess_JoinIdenticalVertices |
@@ -23,38 +39,120 @@ aiProcess_GenUVCoords |
 aiProcess_OptimizeMeshes |
 aiProcess_ValidateDataStructure;
 
-AsyncImageLoader::TResourcePtr AsyncImageLoader::AsyncLoad(const TMetadata& Metadata)
+// Only loads the mip tail, the rest of the mips are streamed in by the upload thread
+static void ReadMipTail(std::unique_ptr<ImageStream> Stream, Asset::Image& Image, ScratchImage& Mips)
 {
-	const auto start = std::chrono::high_resolution_clock::now();
+	const size_t mipTailStart = Stream->GetMipTailStart();
+	Stream->ReadMips(mipTailStart, Stream->GetMetadata().mipLevels - mipTailStart, Mips);
+
+	Image.MostDetailedMip = static_cast<UINT>(mipTailStart);
+	if (mipTailStart > 0)
+	{
+		Image.Stream = std::move(Stream);
+	}
+}
 
+void CookImage(const Asset::ImageMetadata& Metadata, ScratchImage& Image)
+{
 	const auto& path = Metadata.Path;
 	const auto extension = path.extension().string();
+	const auto cookedPath = ImageStream::GetCookedPath(path);
 
-	ScratchImage image;
 	if (extension == ".dds")
 	{
-		ThrowIfFailed(LoadFromDDSFile(path.c_str(), DDS_FLAGS::DDS_FLAGS_FORCE_RGB, nullptr, image));
+		ThrowIfFailed(LoadFromDDSFile(path.c_str(), DDS_FLAGS::DDS_FLAGS_FORCE_RGB, nullptr, Image));
 	}
 	else if (extension == ".tga")
 	{
 		ScratchImage baseImage;
-		ThrowIfFailed(LoadFromTGAFile(path.c_str(), nullptr, baseImage));
-		ThrowIfFailed(GenerateMipMaps(*baseImage.GetImage(0, 0, 0), TEX_FILTER_DEFAULT, 0, image, false));
+		if (!DecodeTGA(path, baseImage))
+		{
+			ThrowIfFailed(LoadFromTGAFile(path.c_str(), nullptr, baseImage));
+		}
+		ThrowIfFailed(GenerateMipMaps(*baseImage.GetImage(0, 0, 0), TEX_FILTER_DEFAULT, 0, Image, false));
 	}
 	else if (extension == ".hdr")
 	{
 		ScratchImage baseImage;
-		ThrowIfFailed(LoadFromHDRFile(path.c_str(), nullptr, baseImage));
-		ThrowIfFailed(GenerateMipMaps(*baseImage.GetImage(0, 0, 0), TEX_FILTER_DEFAULT, 0, image, false));
+		if (!DecodeHDR(path, baseImage))
+		{
+			ThrowIfFailed(LoadFromHDRFile(path.c_str(), nullptr, baseImage));
+		}
+		ThrowIfFailed(GenerateMipMaps(*baseImage.GetImage(0, 0, 0), TEX_FILTER_DEFAULT, 0, Image, false));
 	}
 	else
 	{
 		ScratchImage baseImage;
 		ThrowIfFailed(LoadFromWICFile(path.c_str(), WIC_FLAGS::WIC_FLAGS_FORCE_RGB, nullptr, baseImage));
-		ThrowIfFailed(GenerateMipMaps(*baseImage.GetImage(0, 0, 0), TEX_FILTER_DEFAULT, 0, image, false));
+		ThrowIfFailed(GenerateMipMaps(*baseImage.GetImage(0, 0, 0), TEX_FILTER_DEFAULT, 0, Image, false));
+	}
+
+	// Cook the decoded image so subsequent loads can stream it mip by mip
+	std::error_code ec;
+	std::filesystem::create_directories(cookedPath.parent_path(), ec);
+	if (FAILED(SaveToDDSFile(Image.GetImages(), Image.GetImageCount(), Image.GetMetadata(), DDS_FLAGS_FORCE_DX10_EXT, cookedPath.c_str())))
+	{
+		LOG_WARN("Failed to cook {}", path.string());
 	}
+}
+
+AsyncImageLoader::TResourcePtr AsyncImageLoader::AsyncLoad(const TMetadata& Metadata)
+{
+	const auto start = std::chrono::high_resolution_clock::now();
+
+	const auto& path = Metadata.Path;
+	const auto cookedPath = ImageStream::GetCookedPath(path);
 
 	auto assetImage = std::make_shared<Asset::Image>();
+
+	ScratchImage image;
+	if (Metadata.Bundle)
+	{
+		const auto data = Metadata.Bundle->Find(SceneBundle::AssetType::Image, path);
+
+		auto stream = std::make_unique<ImageStream>();
+		if (!stream->Open(data.data(), data.size(), Metadata.Bundle))
+		{
+			throw std::exception("Invalid image in scene bundle");
+		}
+		ReadMipTail(std::move(stream), *assetImage, image);
+	}
+	else
+	{
+		bool cooked = ImageStream::IsCookedUpToDate(path, cookedPath);
+		if (!cooked)
+		{
+			switch (ImportWorkerPool::Instance().Import(Metadata))
+			{
+			case ImportWorkerPool::Result::Succeeded:
+				cooked = true;
+				break;
+			case ImportWorkerPool::Result::Failed:
+				return {};
+			case ImportWorkerPool::Result::Unavailable:
+			{
+				// Decoded in process, the first load has already paid for decoding every mip so the whole chain is uploaded at once
+				ScopedCriticalSection SCS(s_ImportCriticalSection);
+				CookImage(Metadata, image);
+				break;
+			}
+			}
+		}
+
+		if (cooked)
+		{
+			auto stream = std::make_unique<ImageStream>();
+			if (stream->Open(cookedPath))
+			{
+				ReadMipTail(std::move(stream), *assetImage, image);
+			}
+			else
+			{
+				ThrowIfFailed(LoadFromDDSFile(cookedPath.c_str(), DDS_FLAGS::DDS_FLAGS_NONE, nullptr, image));
+			}
+		}
+	}
+
 	assetImage->Metadata = Metadata;
 	assetImage->Name = path.filename().string();
 	assetImage->Image = std::move(image);
@@ -66,10 +164,9 @@ AsyncImageLoader::TResourcePtr AsyncImageLoader::AsyncLoad(const TMetadata& Meta
 	return assetImage;
 }
 
-AsyncMeshLoader::TResourcePtr AsyncMeshLoader::AsyncLoad(const TMetadata& Metadata)
+// Imports the source mesh with Assimp
+static bool ImportMesh(const Asset::MeshMetadata& Metadata, Asset::Mesh& Mesh)
 {
-	const auto start = std::chrono::high_resolution_clock::now();
-
 	const auto path = Metadata.Path.string();
 
 	const aiScene* paiScene = s_Importer.ReadFile(path.data(), s_ImporterFlags);
@@ -77,13 +174,10 @@ AsyncMeshLoader::TResourcePtr AsyncMeshLoader::AsyncLoad(const TMetadata& Metada
 	if (!paiScene || !paiScene->HasMeshes())
 	{
 		LOG_ERROR("Assimp::Importer error: {}", s_Importer.GetErrorString());
-		return {};
+		return false;
 	}
 
-	auto assetMesh = std::make_shared<Asset::Mesh>();
-	assetMesh->Metadata = Metadata;
-	assetMesh->Name = Metadata.Path.filename().string();
-	assetMesh->Submeshes.reserve(paiScene->mNumMeshes);
+	Mesh.Submeshes.reserve(paiScene->mNumMeshes);
 
 	uint32_t numVertices = 0;
 	uint32_t numIndices = 0;
@@ -128,22 +222,249 @@ AsyncMeshLoader::TResourcePtr AsyncMeshLoader::AsyncLoad(const TMetadata& Metada
 		}
 
 		// Parse submesh indices
-		Asset::Submesh& assetSubmesh = assetMesh->Submeshes.emplace_back();
+		Asset::Submesh& assetSubmesh = Mesh.Submeshes.emplace_back();
 		assetSubmesh.IndexCount = indices.size();
 		assetSubmesh.StartIndexLocation = numIndices;
 		assetSubmesh.VertexCount = vertices.size();
 		assetSubmesh.BaseVertexLocation = numVertices;
 
-		assetMesh->Vertices.insert(assetMesh->Vertices.end(), std::make_move_iterator(vertices.begin()), std::make_move_iterator(vertices.end()));
-		assetMesh->Indices.insert(assetMesh->Indices.end(), std::make_move_iterator(indices.begin()), std::make_move_iterator(indices.end()));
+		Mesh.Vertices.insert(Mesh.Vertices.end(), std::make_move_iterator(vertices.begin()), std::make_move_iterator(vertices.end()));
+		Mesh.Indices.insert(Mesh.Indices.end(), std::make_move_iterator(indices.begin()), std::make_move_iterator(indices.end()));
 
 		numIndices += indices.size();
 		numVertices += vertices.size();
 	}
 
+	return true;
+}
+
+struct MeshLocalityStatistics
+{
+	CPU::BVHStatistics BVH;
+	float TraversalTime; // Milliseconds
+};
+
+// Builds a CPU BVH over the mesh and traces a fixed set of rays through it, the rays only depend on the bounds
+// of the mesh so the numbers before and after optimization are comparable
+static MeshLocalityStatistics AnalyzeMeshLocality(const Asset::Mesh& Mesh)
+{
+	constexpr size_t NumRays = 65536;
+
+	CPU::BVH BVH;
+	BVH.Build(Mesh);
+	if (BVH.IsEmpty())
+	{
+		return {};
+	}
+
+	const auto& Root = BVH.GetNodes()[0];
+	BoundingBox Bounds;
+	BoundingBox::CreateFromPoints(Bounds, XMLoadFloat3(&Root.Min), XMLoadFloat3(&Root.Max));
+	BoundingSphere Sphere;
+	BoundingSphere::CreateFromBoundingBox(Sphere, Bounds);
+
+	std::mt19937 Generator(0);
+	std::uniform_real_distribution<float> Distribution(-1.0f, 1.0f);
+
+	std::vector<CPU::Ray> Rays(NumRays);
+	for (auto& Ray : Rays)
+	{
+		// From a point on the bounding sphere towards a point inside the bounding box
+		XMVECTOR Origin = XMVector3Normalize(XMVectorSet(Distribution(Generator), Distribution(Generator), Distribution(Generator), 0.0f));
+		Origin = XMVectorMultiplyAdd(Origin, XMVectorReplicate(Sphere.Radius), XMLoadFloat3(&Sphere.Center));
+		XMVECTOR Target = XMVectorMultiplyAdd(
+			XMVectorSet(Distribution(Generator), Distribution(Generator), Distribution(Generator), 0.0f),
+			XMLoadFloat3(&Bounds.Extents),
+			XMLoadFloat3(&Bounds.Center));
+
+		XMStoreFloat3(&Ray.Origin, Origin);
+		XMStoreFloat3(&Ray.Direction, XMVector3Normalize(Target - Origin));
+		Ray.TMin = 0.0f;
+		Ray.TMax = FLT_MAX;
+	}
+
+	const auto start = std::chrono::high_resolution_clock::now();
+	for (const auto& Ray : Rays)
+	{
+		CPU::RayHit Hit;
+		BVH.Intersect(Ray, &Hit);
+	}
+	const auto stop = std::chrono::high_resolution_clock::now();
+
+	return { BVH.GetStatistics(), std::chrono::duration<float, std::milli>(stop - start).count() };
+}
+
+static void LogMeshLocality(const std::string& Name, const char* Label, const MeshLocalityStatistics& Statistics)
+{
+	LOG_INFO("{} {}: BVH built in {}(ms), {} nodes, SAH cost: {}, cache lines per leaf: {}, traversal: {}(ms)",
+		Name, Label, Statistics.BVH.BuildTime, Statistics.BVH.NumNodes, Statistics.BVH.SAHCost, Statistics.BVH.CacheLinesPerLeaf, Statistics.TraversalTime);
+}
+
+static bool ReadBundledMesh(const Asset::MeshMetadata& Metadata, Asset::Mesh& Mesh)
+{
+	const auto data = Metadata.Bundle->Find(SceneBundle::AssetType::Mesh, Metadata.Path);
+
+	AssetStreamReader reader;
+	if (!reader.Open(data.data(), data.size(), MeshStream::Version) ||
+		!MeshStream::Read(reader, Metadata, Mesh))
+	{
+		return false;
+	}
+
+	auto bvh = std::make_shared<CPU::BVH>();
+	if (bvh->Read(reader))
+	{
+		Mesh.BVH = std::move(bvh);
+	}
+	return true;
+}
+
+void BenchmarkMeshLocality(const std::filesystem::path& Path)
+{
+	const Asset::MeshMetadata metadata = { .Path = Path };
+	const std::string name = Path.string();
+
+	Asset::Mesh mesh;
+	{
+		ScopedCriticalSection SCS(s_ImportCriticalSection);
+		if (!ImportMesh(metadata, mesh))
+		{
+			return;
+		}
+	}
+
+	LogMeshLocality(name, "before optimization", AnalyzeMeshLocality(mesh));
+	OptimizeMesh(mesh);
+	LogMeshLocality(name, "after optimization", AnalyzeMeshLocality(mesh));
+}
+
+bool CookMesh(const Asset::MeshMetadata& Metadata, Asset::Mesh& Mesh)
+{
+	if (!ImportMesh(Metadata, Mesh))
+	{
+		return false;
+	}
+
+	if (Metadata.OptimizeMesh)
+	{
+		const auto before = AnalyzeVertexCache(Mesh);
+
+		OptimizeMesh(Mesh);
+
+		const auto after = AnalyzeVertexCache(Mesh);
+		LOG_INFO("{} optimized, ACMR: {} -> {}, ATVR: {} -> {}",
+			Metadata.Path.string(), before.ACMR(), after.ACMR(), before.ATVR(), after.ATVR());
+	}
+
+	ComputeSubmeshBounds(Mesh);
+
+	if (Metadata.GenerateLODs)
+	{
+		const auto lodStart = std::chrono::high_resolution_clock::now();
+		GenerateLODs(Mesh);
+		const auto lodStop = std::chrono::high_resolution_clock::now();
+
+		size_t numTriangles = 0, numLODTriangles = 0;
+		for (const auto& submesh : Mesh.Submeshes)
+		{
+			numTriangles += submesh.IndexCount / 3;
+		}
+		for (const auto& lod : Mesh.LODs)
+		{
+			numLODTriangles += lod.IndexCount / 3;
+		}
+		LOG_INFO("{} generated {} LODs in {}(ms), {} triangles in the base mesh, {} triangles across LODs",
+			Metadata.Path.string(), Mesh.LODs.size(), std::chrono::duration_cast<std::chrono::milliseconds>(lodStop - lodStart).count(), numTriangles, numLODTriangles);
+	}
+
+	const auto meshlets = BuildMeshlets(Mesh);
+	LOG_INFO("{} split into {} meshlets, {} vertices and {} triangles on average, {} with a usable normal cone",
+		Metadata.Path.string(), meshlets.NumMeshlets, meshlets.AverageVertices, meshlets.AverageTriangles, meshlets.NumCullableMeshlets);
+#if defined(_DEBUG)
+	{
+		CPU::BVH bvh;
+		bvh.BuildFromMeshlets(Mesh);
+		const auto& statistics = bvh.GetStatistics();
+		LOG_INFO("{} meshlet BVH: {} nodes, {} leaves, SAH cost: {}, {}(ms)",
+			Metadata.Path.string(), statistics.NumNodes, statistics.NumLeaves, statistics.SAHCost, statistics.BuildTime);
+	}
+#endif
+
+	if (Metadata.QuantizeVertices)
+	{
+		const auto error = QuantizeVertices(Mesh);
+		LOG_INFO("{} quantized, position error max: {} rms: {}, uv error max: {}, normal error max: {}(deg)",
+			Metadata.Path.string(), error.MaxPositionError, error.RMSPositionError, error.MaxTextureError, error.MaxNormalError);
+	}
+
+	const auto packing = PackIndices(Mesh);
+	LOG_INFO("{} indices packed, {} of {} submeshes use 16-bit indices, {}(KiB) -> {}(KiB)",
+		Metadata.Path.string(), packing.Num16BitSubmeshes, Mesh.Submeshes.size(), ToKiB(packing.UnpackedSizeInBytes), ToKiB(packing.PackedSizeInBytes));
+
+	if (!MeshStream::Write(MeshStream::GetCookedPath(Metadata.Path), Mesh))
+	{
+		LOG_WARN("Failed to cook {}", Metadata.Path.string());
+	}
+	return true;
+}
+
+bool LoadMesh(const Asset::MeshMetadata& Metadata, Asset::Mesh& Mesh)
+{
+	const auto cookedPath = MeshStream::GetCookedPath(Metadata.Path);
+	if (IsCookedAssetUpToDate(Metadata.Path, cookedPath) && MeshStream::Read(cookedPath, Metadata, Mesh))
+	{
+		return true;
+	}
+
+	// Discard anything read from a stale cooked mesh
+	Mesh.Submeshes.clear();
+	Mesh.Vertices.clear();
+	Mesh.CompactVertices.clear();
+	Mesh.Indices.clear();
+	Mesh.CompactIndices.clear();
+	Mesh.LODs.clear();
+	Mesh.Meshlets.clear();
+	Mesh.MeshletVertices.clear();
+	Mesh.MeshletTriangles.clear();
+
+	switch (ImportWorkerPool::Instance().Import(Metadata))
+	{
+	case ImportWorkerPool::Result::Succeeded:
+		if (!MeshStream::Read(cookedPath, Metadata, Mesh))
+		{
+			LOG_ERROR("Failed to read {} imported by an import worker", Metadata.Path.string());
+			return false;
+		}
+		return true;
+	case ImportWorkerPool::Result::Failed:
+		return false;
+	case ImportWorkerPool::Result::Unavailable:
+	{
+		ScopedCriticalSection SCS(s_ImportCriticalSection);
+		return CookMesh(Metadata, Mesh);
+	}
+	}
+	return false;
+}
+
+AsyncMeshLoader::TResourcePtr AsyncMeshLoader::AsyncLoad(const TMetadata& Metadata)
+{
+	const auto start = std::chrono::high_resolution_clock::now();
+
+	auto assetMesh = std::make_shared<Asset::Mesh>();
+	assetMesh->Metadata = Metadata;
+	assetMesh->Name = Metadata.Path.filename().string();
+
+	// Meshes are baked with the import options of the scene, a mesh requested with other options is read from disk
+	const bool bundled = Metadata.Bundle && ReadBundledMesh(Metadata, *assetMesh);
+	if (!bundled && !LoadMesh(Metadata, *assetMesh))
+	{
+		return {};
+	}
+
 	const auto stop = std::chrono::high_resolution_clock::now();
 	const auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(stop - start);
 	LOG_INFO("{} loaded in {}(ms)", Metadata.Path.string(), duration.count());
 
 	return assetMesh;
-}
\ No newline at end of file
+}
@@ -1,4 +1,5 @@
 #pragma once
+#include <thread>
 #include <wil/resource.h>
 
 #include "Image.h"
@@ -26,7 +27,11 @@ public:
 
 	~AsyncLoader()
 	{
-		Shutdown = true;
+		{
+			// Set under the lock so the thread cannot miss the wake between checking and sleeping
+			ScopedCriticalSection SCS(CriticalSection);
+			Shutdown = true;
+		}
 		ConditionVariable.WakeAll();
 
 		::WaitForSingleObject(Thread.get(), INFINITE);
@@ -35,37 +40,63 @@ public:
 	void RequestAsyncLoad(UINT NumMetadata, Metadata* pMetadata, TDelegate Delegate)
 	{
 		ScopedCriticalSection SCS(CriticalSection);
-		this->Delegate = std::move(Delegate);
 		for (UINT i = 0; i < NumMetadata; i++)
 		{
-			MetadataQueue.Enqueue(pMetadata[i]);
+			Requests.push_back({ .Metadata = pMetadata[i], .Delegate = Delegate });
 		}
 		ConditionVariable.Wake();
 	}
 private:
+	struct Request
+	{
+		TMetadata Metadata;
+		TDelegate Delegate;
+	};
+
 	static DWORD WINAPI AsyncThreadProc(_In_ PVOID pParameter)
 	{
 		auto pAsyncLoader = static_cast<AsyncLoader<T, Metadata, Loader>*>(pParameter);
 
 		while (true)
 		{
-			// Sleep until the condition variable becomes notified
-			ScopedCriticalSection SCS(pAsyncLoader->CriticalSection);
-			pAsyncLoader->ConditionVariable.Wait(pAsyncLoader->CriticalSection, INFINITE);
-
-			if (pAsyncLoader->Shutdown)
+			// Only the queue is guarded, requests made while a batch loads are picked up by the next batch
+			std::vector<Request> Items;
 			{
-				break;
+				ScopedCriticalSection SCS(pAsyncLoader->CriticalSection);
+				while (pAsyncLoader->Requests.empty() && !pAsyncLoader->Shutdown)
+				{
+					pAsyncLoader->ConditionVariable.Wait(pAsyncLoader->CriticalSection, INFINITE);
+				}
+
+				if (pAsyncLoader->Shutdown)
+				{
+					break;
+				}
+
+				Items.swap(pAsyncLoader->Requests);
 			}
 
-			// Start loading stuff async :D
-			TMetadata Item = {};
-			while (pAsyncLoader->MetadataQueue.Dequeue(Item, 0))
+			// Loads run concurrently, imports are handed to the import workers so they scale with the number of cores
+			const size_t MaxConcurrentLoads = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+			for (size_t i = 0; i < Items.size(); i += MaxConcurrentLoads)
 			{
-				auto pResource = static_cast<Loader*>(pAsyncLoader)->AsyncLoad(Item);
-				if (pResource && pAsyncLoader->Delegate)
+				std::vector<std::future<TResourcePtr>> Loads;
+				for (size_t j = i; j < std::min(i + MaxConcurrentLoads, Items.size()); ++j)
 				{
-					pAsyncLoader->Delegate(pResource);
+					Loads.push_back(std::async(std::launch::async, [pAsyncLoader, &Item = Items[j]]()
+					{
+						return static_cast<Loader*>(pAsyncLoader)->AsyncLoad(Item.Metadata);
+					}));
+				}
+
+				for (size_t j = 0; j < Loads.size(); ++j)
+				{
+					auto pResource = Loads[j].get();
+					if (const auto& Delegate = Items[i + j].Delegate;
+						pResource && Delegate)
+					{
+						Delegate(pResource);
+					}
 				}
 			}
 		}
@@ -75,8 +106,7 @@ private:
 private:
 	CriticalSection CriticalSection;
 	ConditionVariable ConditionVariable;
-	ThreadSafeQueue<Metadata> MetadataQueue;
-	TDelegate Delegate = nullptr;
+	std::vector<Request> Requests; // Guarded by CriticalSection
 
 	wil::unique_handle Thread;
 	std::atomic<bool> Shutdown = false;
@@ -92,4 +122,17 @@ class AsyncMeshLoader : public AsyncLoader<Asset::Mesh, Asset::MeshMetadata, Asy
 {
 public:
 	TResourcePtr AsyncLoad(const TMetadata& Metadata);
-};
\ No newline at end of file
+};
+
+// Decodes the source image, generates its mips and writes the cooked image, see ImageStream::GetCookedPath
+void CookImage(const Asset::ImageMetadata& Metadata, DirectX::ScratchImage& Image);
+
+// Imports and processes the source mesh and writes the cooked mesh, see MeshStream::GetCookedPath
+bool CookMesh(const Asset::MeshMetadata& Metadata, Asset::Mesh& Mesh);
+
+// Reads the cooked mesh, the mesh is cooked first if the cooked mesh is missing or older than the source
+bool LoadMesh(const Asset::MeshMetadata& Metadata, Asset::Mesh& Mesh);
+
+// Imports the source mesh and logs the BVH statistics and the time to trace a fixed set of rays through it
+// before and after OptimizeMesh
+void BenchmarkMeshLocality(const std::filesystem::path& Path);
@@ -1,7 +1,16 @@
 #pragma once
+#include <atomic>
 #include <string>
 #include <DirectXTex.h>
 #include "../RenderDevice.h"
+#include "ImageStream.h"
+
+class SceneBundle;
+
+namespace CPU
+{
+	class EnvironmentMap;
+}
 
 namespace Asset
 {
@@ -11,6 +20,8 @@ namespace Asset
 	{
 		std::filesystem::path Path;
 		bool sRGB;
+
+		std::shared_ptr<SceneBundle> Bundle; // Mounted scene bundle the image is read from, null if it is read from disk
 	};
 
 	struct Image
@@ -22,5 +33,17 @@ namespace Asset
 
 		std::shared_ptr<Resource> Resource;
 		Descriptor SRV;
+
+		// Progressive streaming, Image only holds the mips that are pending upload. The resource
+		// is created with the full mip chain and MostDetailedMip is lowered as finer mips become resident,
+		// once every mip is resident the Stream is released. Stream is only touched by the upload thread after the image
+		// is published, MostDetailedMip is read by the main thread while the upload thread lowers it
+		std::unique_ptr<ImageStream> Stream;
+		std::atomic<UINT> MostDetailedMip = 0;
+
+		// Distribution for environment lights, built the first time an environment light references the image,
+		// see CPU::GetOrBuildEnvironmentMap. EnvironmentFailed keeps an image that cannot be read from being retried
+		std::shared_ptr<const CPU::EnvironmentMap> Environment;
+		bool EnvironmentFailed = false;
 	};
 }
\ No newline at end of file
@@ -0,0 +1,719 @@
+#include "pch.h"
+#include "ImageDecoder.h"
+
+#include <thread>
+
+#include <DirectXPackedVector.h>
+
+using namespace DirectX;
+
+namespace
+{
+	struct MappedFile
+	{
+		bool Open(const std::filesystem::path& Path)
+		{
+			File.reset(::CreateFileW(Path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr));
+			if (!File)
+			{
+				return false;
+			}
+
+			LARGE_INTEGER FileSize = {};
+			if (!::GetFileSizeEx(File.get(), &FileSize) || FileSize.QuadPart == 0)
+			{
+				return false;
+			}
+
+			Mapping.reset(::CreateFileMappingW(File.get(), nullptr, PAGE_READONLY, 0, 0, nullptr));
+			if (!Mapping)
+			{
+				return false;
+			}
+
+			View.reset(static_cast<BYTE*>(::MapViewOfFile(Mapping.get(), FILE_MAP_READ, 0, 0, 0)));
+			if (!View)
+			{
+				return false;
+			}
+
+			pData = View.get();
+			SizeInBytes = static_cast<size_t>(FileSize.QuadPart);
+			return true;
+		}
+
+		wil::unique_hfile File;
+		wil::unique_handle Mapping;
+		wil::unique_mapview_ptr<BYTE> View;
+
+		const BYTE* pData = nullptr;
+		size_t SizeInBytes = 0;
+	};
+
+	// Images with fewer rows than this per thread are decoded with fewer threads
+	constexpr size_t MinRowsPerBlock = 64;
+
+	size_t GetRowsPerBlock(size_t NumRows)
+	{
+		const size_t numThreads = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+		return std::max((NumRows + numThreads - 1) / numThreads, MinRowsPerBlock);
+	}
+
+	size_t GetNumBlocks(size_t NumRows, size_t RowsPerBlock)
+	{
+		return (NumRows + RowsPerBlock - 1) / RowsPerBlock;
+	}
+
+	// Runs Function(Block, FirstRow, LastRow) for every block of rows concurrently, the first block on the calling thread
+	template<typename TFunction>
+	void ParallelForBlocks(size_t NumRows, size_t RowsPerBlock, TFunction Function)
+	{
+		std::vector<std::future<void>> blocks;
+		for (size_t block = 1; block * RowsPerBlock < NumRows; ++block)
+		{
+			const size_t firstRow = block * RowsPerBlock;
+			const size_t lastRow = std::min(firstRow + RowsPerBlock, NumRows);
+			blocks.push_back(std::async(std::launch::async, [&Function, block, firstRow, lastRow]()
+			{
+				Function(block, firstRow, lastRow);
+			}));
+		}
+
+		Function(0, 0, std::min(RowsPerBlock, NumRows));
+
+		for (auto& block : blocks)
+		{
+			block.get();
+		}
+	}
+
+#pragma pack(push, 1)
+	struct TGAHeader
+	{
+		uint8_t IDLength;
+		uint8_t ColorMapType;
+		uint8_t ImageType;
+		uint16_t ColorMapFirst;
+		uint16_t ColorMapLength;
+		uint8_t ColorMapEntrySize;
+		uint16_t XOrigin;
+		uint16_t YOrigin;
+		uint16_t Width;
+		uint16_t Height;
+		uint8_t BitsPerPixel;
+		uint8_t Descriptor;
+	};
+#pragma pack(pop)
+	static_assert(sizeof(TGAHeader) == 18);
+
+	enum TGAImageType : uint8_t
+	{
+		TGAColorMapped = 1,
+		TGATrueColor = 2,
+		TGAGrayscale = 3,
+		TGARLE = 8 // Combined with one of the above
+	};
+
+	enum TGADescriptor : uint8_t
+	{
+		TGAAlphaBits = 0x0F,
+		TGARightToLeft = 0x10,
+		TGATopToBottom = 0x20
+	};
+
+	// Converters from a TGA pixel to a destination texel, TGA stores color as BGR(A)
+	struct TGAConvertBGR24
+	{
+		static constexpr size_t SourceSize = 3;
+		static constexpr size_t DestinationSize = 4;
+		static constexpr bool HasAlpha = false;
+
+		void operator()(const BYTE* pSource, BYTE* pDestination) const
+		{
+			pDestination[0] = pSource[2];
+			pDestination[1] = pSource[1];
+			pDestination[2] = pSource[0];
+			pDestination[3] = 0xFF;
+		}
+	};
+
+	struct TGAConvertBGRA32
+	{
+		static constexpr size_t SourceSize = 4;
+		static constexpr size_t DestinationSize = 4;
+		static constexpr bool HasAlpha = true;
+
+		void operator()(const BYTE* pSource, BYTE* pDestination) const
+		{
+			pDestination[0] = pSource[2];
+			pDestination[1] = pSource[1];
+			pDestination[2] = pSource[0];
+			pDestination[3] = pSource[3];
+		}
+	};
+
+	struct TGAConvertBGR5A1
+	{
+		static constexpr size_t SourceSize = 2;
+		static constexpr size_t DestinationSize = 4;
+		static constexpr bool HasAlpha = true;
+
+		bool Alpha; // 15-bit images have no alpha
+
+		void operator()(const BYTE* pSource, BYTE* pDestination) const
+		{
+			const uint16_t texel = static_cast<uint16_t>(pSource[0] | (pSource[1] << 8));
+			const auto Expand = [](uint32_t Value) { return static_cast<BYTE>((Value << 3) | (Value >> 2)); };
+			pDestination[0] = Expand((texel >> 10) & 0x1F);
+			pDestination[1] = Expand((texel >> 5) & 0x1F);
+			pDestination[2] = Expand(texel & 0x1F);
+			pDestination[3] = !Alpha || (texel & 0x8000) ? 0xFF : 0x00;
+		}
+	};
+
+	struct TGAConvertGray8
+	{
+		static constexpr size_t SourceSize = 1;
+		static constexpr size_t DestinationSize = 1;
+		static constexpr bool HasAlpha = false;
+
+		void operator()(const BYTE* pSource, BYTE* pDestination) const
+		{
+			pDestination[0] = pSource[0];
+		}
+	};
+
+	struct TGAConvertColorMapped8
+	{
+		static constexpr size_t SourceSize = 1;
+		static constexpr size_t DestinationSize = 4;
+		static constexpr bool HasAlpha = true;
+
+		const std::array<uint32_t, 256>* pColorMap; // Already converted to RGBA, indexed by the pixel value
+
+		void operator()(const BYTE* pSource, BYTE* pDestination) const
+		{
+			std::memcpy(pDestination, &(*pColorMap)[pSource[0]], sizeof(uint32_t));
+		}
+	};
+
+	// Where decoding resumes at the start of a block, Remaining is the number of pixels left in the current packet
+	struct TGARLEState
+	{
+		size_t Offset;
+		size_t Remaining;
+		bool Run;
+	};
+
+	// Walks the packet headers and validates that every packet fits in the file, returns the state at the start of every block
+	std::vector<TGARLEState> IndexTGARLE(const BYTE* pPixels, size_t SizeInBytes, size_t SourceSize, size_t NumPixels, size_t PixelsPerBlock)
+	{
+		std::vector<TGARLEState> states(GetNumBlocks(NumPixels, PixelsPerBlock));
+
+		size_t offset = 0;
+		size_t pixel = 0;
+		size_t block = 0;
+		while (pixel < NumPixels)
+		{
+			if (offset >= SizeInBytes)
+			{
+				throw std::exception("Truncated TGA file");
+			}
+
+			const BYTE header = pPixels[offset++];
+			const size_t count = (header & 0x7F) + 1;
+			const bool run = (header & 0x80) != 0;
+			const size_t packetSize = run ? SourceSize : count * SourceSize;
+			if (packetSize > SizeInBytes - offset)
+			{
+				throw std::exception("Truncated TGA file");
+			}
+
+			// Blocks that start inside of this packet resume in the middle of it
+			for (; block < states.size() && block * PixelsPerBlock < pixel + count; ++block)
+			{
+				const size_t skipped = block * PixelsPerBlock - pixel;
+				states[block] =
+				{
+					.Offset = run ? offset : offset + skipped * SourceSize,
+					.Remaining = count - skipped,
+					.Run = run
+				};
+			}
+
+			offset += packetSize;
+			pixel += count;
+		}
+
+		return states;
+	}
+
+	struct TGALayout
+	{
+		const BYTE* pPixels;
+		size_t Width;
+		size_t Height;
+		bool TopToBottom;
+		bool RightToLeft;
+		const Image* pImage;
+
+		BYTE* GetRow(size_t Row, size_t DestinationSize) const
+		{
+			BYTE* pRow = pImage->pixels + (TopToBottom ? Row : Height - 1 - Row) * pImage->rowPitch;
+			return RightToLeft ? pRow + (Width - 1) * DestinationSize : pRow;
+		}
+	};
+
+	template<typename TConvert>
+	void DecodeTGARows(const TGALayout& Layout, const TConvert& Convert, size_t FirstRow, size_t LastRow)
+	{
+		const ptrdiff_t step = Layout.RightToLeft ? -ptrdiff_t(TConvert::DestinationSize) : ptrdiff_t(TConvert::DestinationSize);
+		for (size_t row = FirstRow; row < LastRow; ++row)
+		{
+			const BYTE* pSource = Layout.pPixels + row * Layout.Width * TConvert::SourceSize;
+			BYTE* pDestination = Layout.GetRow(row, TConvert::DestinationSize);
+			for (size_t x = 0; x < Layout.Width; ++x)
+			{
+				Convert(pSource, pDestination);
+				pSource += TConvert::SourceSize;
+				pDestination += step;
+			}
+		}
+	}
+
+	template<typename TConvert>
+	void DecodeTGARLERows(const TGALayout& Layout, const TConvert& Convert, size_t FirstRow, size_t LastRow, TGARLEState State)
+	{
+		const ptrdiff_t step = Layout.RightToLeft ? -ptrdiff_t(TConvert::DestinationSize) : ptrdiff_t(TConvert::DestinationSize);
+		for (size_t row = FirstRow; row < LastRow; ++row)
+		{
+			BYTE* pDestination = Layout.GetRow(row, TConvert::DestinationSize);
+			for (size_t x = 0; x < Layout.Width; ++x)
+			{
+				if (State.Remaining == 0)
+				{
+					const BYTE header = Layout.pPixels[State.Offset++];
+					State.Remaining = (header & 0x7F) + 1;
+					State.Run = (header & 0x80) != 0;
+				}
+
+				Convert(Layout.pPixels + State.Offset, pDestination);
+				pDestination += step;
+
+				if (!State.Run || State.Remaining == 1)
+				{
+					State.Offset += TConvert::SourceSize;
+				}
+				--State.Remaining;
+			}
+		}
+	}
+
+	template<typename TConvert>
+	void DecodeTGAPixels(const TGAHeader& Header, const BYTE* pPixels, size_t SizeInBytes, const TConvert& Convert, const Image* pImage)
+	{
+		const TGALayout layout =
+		{
+			.pPixels = pPixels,
+			.Width = Header.Width,
+			.Height = Header.Height,
+			.TopToBottom = (Header.Descriptor & TGATopToBottom) != 0,
+			.RightToLeft = (Header.Descriptor & TGARightToLeft) != 0,
+			.pImage = pImage
+		};
+
+		const size_t rowsPerBlock = GetRowsPerBlock(layout.Height);
+		if (Header.ImageType & TGARLE)
+		{
+			const auto states = IndexTGARLE(pPixels, SizeInBytes, TConvert::SourceSize, layout.Width * layout.Height, layout.Width * rowsPerBlock);
+			ParallelForBlocks(layout.Height, rowsPerBlock, [&](size_t Block, size_t FirstRow, size_t LastRow)
+			{
+				DecodeTGARLERows(layout, Convert, FirstRow, LastRow, states[Block]);
+			});
+		}
+		else
+		{
+			if (layout.Width * layout.Height * TConvert::SourceSize > SizeInBytes)
+			{
+				throw std::exception("Truncated TGA file");
+			}
+
+			ParallelForBlocks(layout.Height, rowsPerBlock, [&](size_t Block, size_t FirstRow, size_t LastRow)
+			{
+				DecodeTGARows(layout, Convert, FirstRow, LastRow);
+			});
+		}
+
+		if constexpr (TConvert::HasAlpha)
+		{
+			// Like DirectXTex, images whose alpha is zero everywhere were written without alpha and are made opaque
+			std::atomic<bool> hasAlpha = false;
+			ParallelForBlocks(layout.Height, rowsPerBlock, [&](size_t Block, size_t FirstRow, size_t LastRow)
+			{
+				for (size_t row = FirstRow; row < LastRow && !hasAlpha; ++row)
+				{
+					const BYTE* pRow = pImage->pixels + row * pImage->rowPitch;
+					for (size_t x = 0; x < layout.Width; ++x)
+					{
+						if (pRow[x * 4 + 3] != 0)
+						{
+							hasAlpha = true;
+							break;
+						}
+					}
+				}
+			});
+
+			if (!hasAlpha)
+			{
+				ParallelForBlocks(layout.Height, rowsPerBlock, [&](size_t Block, size_t FirstRow, size_t LastRow)
+				{
+					for (size_t row = FirstRow; row < LastRow; ++row)
+					{
+						BYTE* pRow = pImage->pixels + row * pImage->rowPitch;
+						for (size_t x = 0; x < layout.Width; ++x)
+						{
+							pRow[x * 4 + 3] = 0xFF;
+						}
+					}
+				});
+			}
+		}
+	}
+
+	// Scale of an RGBE texel for every exponent, the mantissa is not biased by half a unit to match DirectXTex
+	const std::array<float, 256> RGBEScales = []()
+	{
+		std::array<float, 256> scales = {};
+		for (int e = 1; e < 256; ++e)
+		{
+			scales[e] = std::ldexp(1.0f, e - (128 + 8));
+		}
+		return scales;
+	}();
+
+	void ConvertRGBE(const BYTE* pSource, XMFLOAT4* pDestination, size_t Width)
+	{
+		for (size_t x = 0; x < Width; ++x, pSource += 4)
+		{
+			const XMVECTOR rgbe = PackedVector::XMLoadUByte4(reinterpret_cast<const PackedVector::XMUBYTE4*>(pSource));
+			const XMVECTOR rgb = XMVectorMultiply(rgbe, XMVectorReplicate(RGBEScales[pSource[3]]));
+			XMStoreFloat4(&pDestination[x], XMVectorSelect(g_XMOne, rgb, g_XMSelect1110));
+		}
+	}
+
+	// Decodes one channel of an RLE scanline into every fourth byte of pDestination
+	size_t DecodeRGBEChannel(const BYTE* pData, size_t Offset, BYTE* pDestination, size_t Width)
+	{
+		for (size_t x = 0; x < Width;)
+		{
+			const size_t code = pData[Offset++];
+			if (code > 128)
+			{
+				const BYTE value = pData[Offset++];
+				for (size_t end = x + code - 128; x < end; ++x)
+				{
+					pDestination[x * 4] = value;
+				}
+			}
+			else
+			{
+				for (size_t end = x + code; x < end; ++x)
+				{
+					pDestination[x * 4] = pData[Offset++];
+				}
+			}
+		}
+		return Offset;
+	}
+}
+
+bool DecodeTGA(const std::filesystem::path& Path, ScratchImage& Image)
+{
+	MappedFile file;
+	if (!file.Open(Path) || file.SizeInBytes < sizeof(TGAHeader))
+	{
+		return false;
+	}
+
+	TGAHeader header;
+	std::memcpy(&header, file.pData, sizeof(TGAHeader));
+	if (header.Width == 0 || header.Height == 0)
+	{
+		throw std::exception("Invalid TGA file");
+	}
+
+	const size_t colorMapOffset = sizeof(TGAHeader) + header.IDLength;
+	const size_t colorMapSize = header.ColorMapType == 1 ? header.ColorMapLength * ((header.ColorMapEntrySize + 7) / 8) : 0;
+	const size_t pixelsOffset = colorMapOffset + colorMapSize;
+	if (pixelsOffset > file.SizeInBytes)
+	{
+		throw std::exception("Truncated TGA file");
+	}
+
+	const BYTE* pPixels = file.pData + pixelsOffset;
+	const size_t pixelsSize = file.SizeInBytes - pixelsOffset;
+
+	const bool grayscale = (header.ImageType & ~TGARLE) == TGAGrayscale;
+	ThrowIfFailed(Image.Initialize2D(grayscale ? DXGI_FORMAT_R8_UNORM : DXGI_FORMAT_R8G8B8A8_UNORM, header.Width, header.Height, 1, 1));
+	const auto pImage = Image.GetImage(0, 0, 0);
+
+	switch (header.ImageType & ~TGARLE)
+	{
+	case TGATrueColor:
+		switch (header.BitsPerPixel)
+		{
+		case 15:
+		case 16:
+			DecodeTGAPixels(header, pPixels, pixelsSize, TGAConvertBGR5A1{ .Alpha = header.BitsPerPixel == 16 && (header.Descriptor & TGAAlphaBits) != 0 }, pImage);
+			return true;
+		case 24:
+			DecodeTGAPixels(header, pPixels, pixelsSize, TGAConvertBGR24{}, pImage);
+			return true;
+		case 32:
+			DecodeTGAPixels(header, pPixels, pixelsSize, TGAConvertBGRA32{}, pImage);
+			return true;
+		}
+		break;
+
+	case TGAGrayscale:
+		if (header.BitsPerPixel == 8)
+		{
+			DecodeTGAPixels(header, pPixels, pixelsSize, TGAConvertGray8{}, pImage);
+			return true;
+		}
+		break;
+
+	case TGAColorMapped:
+	{
+		if (header.ColorMapType != 1 || header.BitsPerPixel != 8)
+		{
+			break;
+		}
+
+		// Entries are converted like pixels, indices outside of the color map are black
+		std::array<uint32_t, 256> colorMap = {};
+		const BYTE* pEntries = file.pData + colorMapOffset;
+		const auto ConvertColorMap = [&](const auto& Convert)
+		{
+			for (size_t i = 0; i < header.ColorMapLength && header.ColorMapFirst + i < colorMap.size(); ++i)
+			{
+				Convert(pEntries + i * Convert.SourceSize, reinterpret_cast<BYTE*>(&colorMap[header.ColorMapFirst + i]));
+			}
+		};
+
+		switch (header.ColorMapEntrySize)
+		{
+		case 15:
+		case 16:
+			ConvertColorMap(TGAConvertBGR5A1{ .Alpha = header.ColorMapEntrySize == 16 && (header.Descriptor & TGAAlphaBits) != 0 });
+			break;
+		case 24:
+			ConvertColorMap(TGAConvertBGR24{});
+			break;
+		case 32:
+			ConvertColorMap(TGAConvertBGRA32{});
+			break;
+		default:
+			return false;
+		}
+
+		DecodeTGAPixels(header, pPixels, pixelsSize, TGAConvertColorMapped8{ .pColorMap = &colorMap }, pImage);
+		return true;
+	}
+	}
+
+	Image.Release();
+	return false;
+}
+
+bool DecodeHDR(const std::filesystem::path& Path, ScratchImage& Image)
+{
+	MappedFile file;
+	if (!file.Open(Path))
+	{
+		return false;
+	}
+
+	const std::string_view text(reinterpret_cast<const char*>(file.pData), file.SizeInBytes);
+	if (!text.starts_with("#?"))
+	{
+		return false;
+	}
+
+	// The header is a list of variables terminated by an empty line, followed by the resolution. Lines may end with
+	// CRLF, headers this doesn't recognize are left to DirectXTex
+	size_t position = 0;
+	auto ReadLine = [&]() -> std::optional<std::string_view>
+	{
+		const size_t end = text.find('\n', position);
+		if (end == std::string_view::npos)
+		{
+			return std::nullopt;
+		}
+
+		auto line = text.substr(position, end - position);
+		if (line.ends_with('\r'))
+		{
+			line.remove_suffix(1);
+		}
+		position = end + 1;
+		return line;
+	};
+
+	while (true)
+	{
+		const auto line = ReadLine();
+		if (!line || (line->starts_with("FORMAT=") && *line != "FORMAT=32-bit_rle_rgbe"))
+		{
+			return false;
+		}
+
+		if (line->empty())
+		{
+			break;
+		}
+	}
+
+	// Only the standard orientation and its vertical flip, other orientations are transposed
+	const auto resolutionLine = ReadLine();
+	if (!resolutionLine)
+	{
+		return false;
+	}
+
+	const std::string resolution(*resolutionLine);
+	char ySign, xSign;
+	int numRows, numColumns;
+	if (sscanf_s(resolution.data(), "%cY %d %cX %d", &ySign, 1, &numRows, &xSign, 1, &numColumns) != 4 ||
+		(ySign != '-' && ySign != '+') || xSign != '+' || numRows <= 0 || numColumns <= 0)
+	{
+		return false;
+	}
+
+	const size_t width = static_cast<size_t>(numColumns);
+	const size_t height = static_cast<size_t>(numRows);
+
+	// Flat and old style RLE scanlines are left to DirectXTex, they can only be used outside of this range
+	if (width < 8 || width > 0x7FFF)
+	{
+		return false;
+	}
+
+	const bool topToBottom = ySign == '-';
+	const size_t rowsPerBlock = GetRowsPerBlock(height);
+
+	// Scanlines are variable length, find where every block starts and validate every run along the way
+	std::vector<size_t> blockOffsets(GetNumBlocks(height, rowsPerBlock));
+	size_t offset = position;
+	for (size_t row = 0; row < height; ++row)
+	{
+		if (row % rowsPerBlock == 0)
+		{
+			blockOffsets[row / rowsPerBlock] = offset;
+		}
+
+		if (file.SizeInBytes - offset < 4)
+		{
+			throw std::exception("Truncated HDR file");
+		}
+
+		const BYTE* pScanline = file.pData + offset;
+		if (pScanline[0] != 2 || pScanline[1] != 2 || static_cast<size_t>((pScanline[2] << 8) | pScanline[3]) != width)
+		{
+			return false;
+		}
+		offset += 4;
+
+		for (size_t channel = 0; channel < 4; ++channel)
+		{
+			for (size_t x = 0; x < width;)
+			{
+				if (offset >= file.SizeInBytes)
+				{
+					throw std::exception("Truncated HDR file");
+				}
+
+				const size_t code = file.pData[offset++];
+				const size_t count = code > 128 ? code - 128 : code;
+				const size_t size = code > 128 ? 1 : code;
+				if (count == 0 || count > width - x || size > file.SizeInBytes - offset)
+				{
+					throw std::exception("Invalid HDR file");
+				}
+
+				offset += size;
+				x += count;
+			}
+		}
+	}
+
+	ThrowIfFailed(Image.Initialize2D(DXGI_FORMAT_R32G32B32A32_FLOAT, width, height, 1, 1));
+	const auto pImage = Image.GetImage(0, 0, 0);
+
+	ParallelForBlocks(height, rowsPerBlock, [&](size_t Block, size_t FirstRow, size_t LastRow)
+	{
+		std::vector<BYTE> rgbe(width * 4);
+
+		size_t blockOffset = blockOffsets[Block];
+		for (size_t row = FirstRow; row < LastRow; ++row)
+		{
+			blockOffset += 4;
+			for (size_t channel = 0; channel < 4; ++channel)
+			{
+				blockOffset = DecodeRGBEChannel(file.pData, blockOffset, rgbe.data() + channel, width);
+			}
+
+			BYTE* pRow = pImage->pixels + (topToBottom ? row : height - 1 - row) * pImage->rowPitch;
+			ConvertRGBE(rgbe.data(), reinterpret_cast<XMFLOAT4*>(pRow), width);
+		}
+	});
+
+	return true;
+}
+
+#if defined(_DEBUG)
+void BenchmarkImageDecoders(const std::filesystem::path& Path, size_t Iterations)
+{
+	const bool tga = Path.extension() == ".tga";
+
+	auto DecodeNative = [&](ScratchImage& Image)
+	{
+		return tga ? DecodeTGA(Path, Image) : DecodeHDR(Path, Image);
+	};
+
+	auto DecodeDirectXTex = [&](ScratchImage& Image)
+	{
+		ThrowIfFailed(tga ? LoadFromTGAFile(Path.c_str(), nullptr, Image) : LoadFromHDRFile(Path.c_str(), nullptr, Image));
+	};
+
+	auto Measure = [Iterations](auto Function)
+	{
+		const auto start = std::chrono::high_resolution_clock::now();
+		for (size_t i = 0; i < Iterations; ++i)
+		{
+			Function();
+		}
+		const auto stop = std::chrono::high_resolution_clock::now();
+		return std::chrono::duration<double, std::milli>(stop - start).count() / static_cast<double>(Iterations);
+	};
+
+	ScratchImage native, reference;
+	if (!DecodeNative(native))
+	{
+		LOG_WARN("{} is not supported by the native decoders", Path.string());
+		return;
+	}
+	DecodeDirectXTex(reference);
+
+	float mse = 0.0f;
+	ThrowIfFailed(ComputeMSE(*native.GetImage(0, 0, 0), *reference.GetImage(0, 0, 0), mse, nullptr));
+
+	const auto nativeTime = Measure([&] { ScratchImage image; DecodeNative(image); });
+	const auto directXTexTime = Measure([&] { ScratchImage image; DecodeDirectXTex(image); });
+
+	const auto& metadata = native.GetMetadata();
+	LOG_INFO("{} ({}x{}): native decoded in {:.2f}(ms), DirectXTex decoded in {:.2f}(ms), MSE: {}",
+		Path.filename().string(), metadata.width, metadata.height, nativeTime, directXTexTime, mse);
+}
+#endif
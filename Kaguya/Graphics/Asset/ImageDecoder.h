@@ -0,0 +1,24 @@
+#pragma once
+#include <filesystem>
+#include <DirectXTex.h>
+
+/*
+* Decoders for the source image formats the editor imports the most, they replace LoadFromTGAFile and
+* LoadFromHDRFile. The file is memory mapped and decoded straight into the pixel format the image is cooked in,
+* blocks of rows are decoded concurrently. RLE packets can span rows, a first pass only walks the packet headers
+* to find where every block starts.
+* Both return false for variants they don't handle so the caller can fall back to DirectXTex, malformed files throw.
+*/
+
+// Truecolor, grayscale and 8-bit color mapped images, uncompressed or RLE. Decodes into DXGI_FORMAT_R8G8B8A8_UNORM,
+// grayscale into DXGI_FORMAT_R8_UNORM
+bool DecodeTGA(const std::filesystem::path& Path, DirectX::ScratchImage& Image);
+
+// RGBE images with RLE scanlines. Decodes into DXGI_FORMAT_R32G32B32A32_FLOAT
+bool DecodeHDR(const std::filesystem::path& Path, DirectX::ScratchImage& Image);
+
+#if defined(_DEBUG)
+// Decodes the image Iterations times with the native decoder and with DirectXTex, logs how long both take and
+// how much the results differ
+void BenchmarkImageDecoders(const std::filesystem::path& Path, size_t Iterations);
+#endif
@@ -0,0 +1,196 @@
+#include "pch.h"
+#include "ImageStream.h"
+#include "AssetStream.h"
+
+using namespace DirectX;
+
+// See DDS.h in DirectXTex, the magic number is followed by DDS_HEADER and an optional DDS_HEADER_DXT10
+static constexpr UINT64 DDSMagicSize = sizeof(uint32_t);
+static constexpr UINT64 DDSHeaderSize = 124;
+static constexpr UINT64 DDSHeaderDXT10Size = 20;
+static constexpr UINT64 DDSPixelFormatFourCCOffset = DDSMagicSize + 72 + 8;
+
+// Legacy DDS files may require format conversion on load, only streams cooked
+// files which are always written with the DX10 extension header
+static bool IsStreamable(const BYTE* pHeader)
+{
+	return
+		*reinterpret_cast<const uint32_t*>(pHeader) == MAKEFOURCC('D', 'D', 'S', ' ') &&
+		*reinterpret_cast<const uint32_t*>(pHeader + DDSPixelFormatFourCCOffset) == MAKEFOURCC('D', 'X', '1', '0');
+}
+
+bool ImageStream::Open(const std::filesystem::path& Path)
+{
+	File.reset(::CreateFileW(Path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr));
+	if (!File)
+	{
+		return false;
+	}
+
+	BYTE Header[DDSMagicSize + DDSHeaderSize] = {};
+	DWORD NumBytesRead = 0;
+	if (!::ReadFile(File.get(), Header, sizeof(Header), &NumBytesRead, nullptr) || NumBytesRead != sizeof(Header))
+	{
+		return false;
+	}
+
+	if (!IsStreamable(Header))
+	{
+		return false;
+	}
+
+	if (FAILED(GetMetadataFromDDSFile(Path.c_str(), DDS_FLAGS_NONE, Metadata)) ||
+		Metadata.dimension != TEX_DIMENSION_TEXTURE2D)
+	{
+		return false;
+	}
+
+	ComputeLayout();
+	return true;
+}
+
+bool ImageStream::Open(const BYTE* pData, size_t SizeInBytes, std::shared_ptr<const void> Owner)
+{
+	if (SizeInBytes < DDSMagicSize + DDSHeaderSize || !IsStreamable(pData))
+	{
+		return false;
+	}
+
+	if (FAILED(GetMetadataFromDDSMemory(pData, SizeInBytes, DDS_FLAGS_NONE, Metadata)) ||
+		Metadata.dimension != TEX_DIMENSION_TEXTURE2D)
+	{
+		return false;
+	}
+
+	ComputeLayout();
+	if (Offsets.back() + Sizes.back() > SizeInBytes)
+	{
+		return false;
+	}
+
+	this->pData = pData;
+	this->SizeInBytes = SizeInBytes;
+	this->Owner = std::move(Owner);
+	return true;
+}
+
+void ImageStream::ComputeLayout()
+{
+	Offsets.resize(Metadata.arraySize * Metadata.mipLevels);
+	Sizes.resize(Metadata.arraySize * Metadata.mipLevels);
+	RowPitches.resize(Metadata.arraySize * Metadata.mipLevels);
+
+	UINT64 Offset = DDSMagicSize + DDSHeaderSize + DDSHeaderDXT10Size;
+	for (size_t item = 0; item < Metadata.arraySize; ++item)
+	{
+		size_t width = Metadata.width;
+		size_t height = Metadata.height;
+		for (size_t mip = 0; mip < Metadata.mipLevels; ++mip)
+		{
+			size_t rowPitch, slicePitch;
+			ThrowIfFailed(ComputePitch(Metadata.format, width, height, rowPitch, slicePitch));
+
+			Offsets[item * Metadata.mipLevels + mip] = Offset;
+			Sizes[item * Metadata.mipLevels + mip] = slicePitch;
+			RowPitches[item * Metadata.mipLevels + mip] = rowPitch;
+			Offset += slicePitch;
+
+			width = std::max<size_t>(1, width / 2);
+			height = std::max<size_t>(1, height / 2);
+		}
+	}
+}
+
+void ImageStream::Read(UINT64 Offset, void* pDestination, size_t SizeInBytes) const
+{
+	if (pData)
+	{
+		assert(Offset + SizeInBytes <= this->SizeInBytes);
+		memcpy(pDestination, pData + Offset, SizeInBytes);
+		return;
+	}
+
+	LARGE_INTEGER FileOffset = {};
+	FileOffset.QuadPart = static_cast<LONGLONG>(Offset);
+	DWORD NumBytesRead = 0;
+	if (!::SetFilePointerEx(File.get(), FileOffset, nullptr, FILE_BEGIN) ||
+		!::ReadFile(File.get(), pDestination, static_cast<DWORD>(SizeInBytes), &NumBytesRead, nullptr) ||
+		NumBytesRead != SizeInBytes)
+	{
+		throw std::exception("Failed to read from image stream");
+	}
+}
+
+size_t ImageStream::GetMipTailStart() const
+{
+	size_t mip = 0;
+	while (mip + 1 < Metadata.mipLevels &&
+		std::max(Metadata.width >> mip, Metadata.height >> mip) > MipTailDimension)
+	{
+		mip++;
+	}
+	return mip;
+}
+
+void ImageStream::ReadMips(size_t MostDetailedMip, size_t MipLevels, ScratchImage& Image) const
+{
+	assert(MostDetailedMip + MipLevels <= Metadata.mipLevels);
+
+	const size_t width = std::max<size_t>(1, Metadata.width >> MostDetailedMip);
+	const size_t height = std::max<size_t>(1, Metadata.height >> MostDetailedMip);
+	if (Metadata.IsCubemap())
+	{
+		ThrowIfFailed(Image.InitializeCube(Metadata.format, width, height, Metadata.arraySize / 6, MipLevels));
+	}
+	else
+	{
+		ThrowIfFailed(Image.Initialize2D(Metadata.format, width, height, Metadata.arraySize, MipLevels));
+	}
+
+	for (size_t item = 0; item < Metadata.arraySize; ++item)
+	{
+		for (size_t mip = 0; mip < MipLevels; ++mip)
+		{
+			const size_t subresource = item * Metadata.mipLevels + MostDetailedMip + mip;
+			const DirectX::Image* pImage = Image.GetImage(mip, item, 0);
+			assert(pImage->slicePitch == Sizes[subresource]);
+
+			Read(Offsets[subresource], pImage->pixels, Sizes[subresource]);
+		}
+	}
+}
+
+void ImageStream::ReadRegion(size_t Mip, size_t Item, size_t X, size_t Y, size_t Width, size_t Height, BYTE* pDestination, size_t DestinationRowPitch) const
+{
+	const size_t subresource = Item * Metadata.mipLevels + Mip;
+	const size_t mipWidth = std::max<size_t>(1, Metadata.width >> Mip);
+	const size_t mipHeight = std::max<size_t>(1, Metadata.height >> Mip);
+	const size_t blockDimension = IsCompressed(Metadata.format) ? 4 : 1;
+	assert(X % blockDimension == 0 && Y % blockDimension == 0);
+
+	Width = std::min(Width, mipWidth - X);
+	Height = std::min(Height, mipHeight - Y);
+
+	const size_t numBlocksWide = (mipWidth + blockDimension - 1) / blockDimension;
+	const size_t bytesPerBlock = RowPitches[subresource] / numBlocksWide;
+	const size_t numBlockRows = (Height + blockDimension - 1) / blockDimension;
+	const size_t numBytesPerRow = ((Width + blockDimension - 1) / blockDimension) * bytesPerBlock;
+
+	for (size_t row = 0; row < numBlockRows; ++row)
+	{
+		const UINT64 Offset = Offsets[subresource] +
+			(Y / blockDimension + row) * RowPitches[subresource] +
+			(X / blockDimension) * bytesPerBlock;
+		Read(Offset, pDestination + row * DestinationRowPitch, numBytesPerRow);
+	}
+}
+
+std::filesystem::path ImageStream::GetCookedPath(const std::filesystem::path& Path)
+{
+	return GetCookedAssetPath(Path, "Textures", ".dds");
+}
+
+bool ImageStream::IsCookedUpToDate(const std::filesystem::path& Path, const std::filesystem::path& CookedPath)
+{
+	return IsCookedAssetUpToDate(Path, CookedPath);
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include <filesystem>
+#include <DirectXTex.h>
+#include <wil/resource.h>
+
+/*
+* Reads individual mip levels out of a DDS file, this allows textures to be brought in
+* coarsest mip first and refined incrementally instead of being decoded as a whole.
+* Only 2D textures (including arrays and cube maps) are supported, the DDS layout stores
+* every array slice with its full mip chain one after another.
+*/
+class ImageStream
+{
+public:
+	// Any mip whose largest dimension is less than or equal to this is considered part of the mip tail
+	static constexpr size_t MipTailDimension = 256;
+
+	bool Open(const std::filesystem::path& Path);
+
+	// Reads from a cooked DDS file in memory, Owner keeps the memory alive for the lifetime of the stream.
+	// Used for images inside a memory mapped scene bundle, mips are paged in as they are read
+	bool Open(const BYTE* pData, size_t SizeInBytes, std::shared_ptr<const void> Owner);
+
+	[[nodiscard]] const DirectX::TexMetadata& GetMetadata() const { return Metadata; }
+
+	// Returns the first mip of the mip tail, this is the most detailed mip that gets loaded
+	// when the texture is first requested
+	[[nodiscard]] size_t GetMipTailStart() const;
+
+	// Reads mips [MostDetailedMip, MostDetailedMip + MipLevels) of every array slice into Image,
+	// mip 0 of Image corresponds to MostDetailedMip
+	void ReadMips(size_t MostDetailedMip, size_t MipLevels, DirectX::ScratchImage& Image) const;
+
+	// Reads a rectangular region of a single mip into pDestination, the region is in texels and must be
+	// aligned to the block size of the format. The region is clipped against the dimension of the mip
+	void ReadRegion(size_t Mip, size_t Item, size_t X, size_t Y, size_t Width, size_t Height, BYTE* pDestination, size_t DestinationRowPitch) const;
+
+	// Returns the path of the cooked DDS file for the source image
+	static std::filesystem::path GetCookedPath(const std::filesystem::path& Path);
+
+	// Returns true if the cooked DDS file exists and is newer than the source image
+	static bool IsCookedUpToDate(const std::filesystem::path& Path, const std::filesystem::path& CookedPath);
+private:
+	// Computes the location of every subresource from Metadata
+	void ComputeLayout();
+
+	void Read(UINT64 Offset, void* pDestination, size_t SizeInBytes) const;
+private:
+	wil::unique_hfile File;
+
+	const BYTE* pData = nullptr;
+	size_t SizeInBytes = 0;
+	std::shared_ptr<const void> Owner;
+
+	DirectX::TexMetadata Metadata = {};
+	std::vector<UINT64> Offsets; // Byte offset of every (array slice, mip) subresource within the file
+	std::vector<UINT64> Sizes;
+	std::vector<UINT64> RowPitches;
+};
@@ -0,0 +1,354 @@
+#include "pch.h"
+#include "ImportWorker.h"
+#include "AsyncLoader.h"
+#include "MeshStream.h"
+
+#include <thread>
+
+static ImportWorkerPool* pImportWorkerPool = nullptr;
+
+static bool ReadExact(HANDLE File, void* pData, size_t SizeInBytes)
+{
+	auto pBytes = static_cast<BYTE*>(pData);
+	while (SizeInBytes > 0)
+	{
+		DWORD read = 0;
+		if (!::ReadFile(File, pBytes, static_cast<DWORD>(SizeInBytes), &read, nullptr) || read == 0)
+		{
+			return false;
+		}
+		pBytes += read;
+		SizeInBytes -= read;
+	}
+	return true;
+}
+
+static bool WriteExact(HANDLE File, const void* pData, size_t SizeInBytes)
+{
+	auto pBytes = static_cast<const BYTE*>(pData);
+	while (SizeInBytes > 0)
+	{
+		DWORD written = 0;
+		if (!::WriteFile(File, pBytes, static_cast<DWORD>(SizeInBytes), &written, nullptr) || written == 0)
+		{
+			return false;
+		}
+		pBytes += written;
+		SizeInBytes -= written;
+	}
+	return true;
+}
+
+static std::filesystem::path GetExecutablePath()
+{
+	std::wstring path(MAX_PATH, L'\0');
+	while (true)
+	{
+		const DWORD length = ::GetModuleFileNameW(nullptr, path.data(), static_cast<DWORD>(path.size()));
+		if (length < path.size())
+		{
+			path.resize(length);
+			return path;
+		}
+		path.resize(path.size() * 2);
+	}
+}
+
+void ImportWorkerPool::Initialize()
+{
+	if (!pImportWorkerPool)
+	{
+		pImportWorkerPool = new ImportWorkerPool();
+	}
+}
+
+void ImportWorkerPool::Shutdown()
+{
+	if (pImportWorkerPool)
+	{
+		delete pImportWorkerPool;
+	}
+}
+
+ImportWorkerPool& ImportWorkerPool::Instance()
+{
+	assert(pImportWorkerPool);
+	return *pImportWorkerPool;
+}
+
+ImportWorkerPool::ImportWorkerPool()
+	// One core is left to the editor
+	: Workers(std::max<size_t>(std::thread::hardware_concurrency(), 2) - 1)
+{
+	IdleWorkers.resize(Workers.size());
+	std::iota(IdleWorkers.begin(), IdleWorkers.end(), 0);
+
+	Job.reset(::CreateJobObjectW(nullptr, nullptr));
+	if (Job)
+	{
+		JOBOBJECT_EXTENDED_LIMIT_INFORMATION Limits = {};
+		Limits.BasicLimitInformation.LimitFlags = JOB_OBJECT_LIMIT_KILL_ON_JOB_CLOSE;
+		::SetInformationJobObject(Job.get(), JobObjectExtendedLimitInformation, &Limits, sizeof(Limits));
+	}
+}
+
+ImportWorkerPool::~ImportWorkerPool()
+{
+	// Workers exit once their request pipe is closed
+	for (auto& Worker : Workers)
+	{
+		Worker.Requests.reset();
+		Worker.Responses.reset();
+		if (Worker.Process.hProcess)
+		{
+			::WaitForSingleObject(Worker.Process.hProcess, INFINITE);
+		}
+	}
+}
+
+int ImportWorkerPool::RunWorker(int argc, char* argv[])
+{
+	if (argc < 4)
+	{
+		return EXIT_FAILURE;
+	}
+
+	Log::Create();
+
+	// WIC decoders are COM objects
+	ThrowIfFailed(CoInitializeEx(nullptr, tagCOINIT::COINIT_MULTITHREADED));
+
+	Application::ExecutableFolderPath = GetExecutablePath().parent_path();
+
+	const auto requests = reinterpret_cast<HANDLE>(static_cast<uintptr_t>(std::stoull(argv[2])));
+	const auto responses = reinterpret_cast<HANDLE>(static_cast<uintptr_t>(std::stoull(argv[3])));
+
+	Request request = {};
+	while (ReadExact(requests, &request, sizeof(request)))
+	{
+		std::wstring path(request.PathLength, L'\0');
+		if (!ReadExact(requests, path.data(), path.size() * sizeof(wchar_t)))
+		{
+			break;
+		}
+
+		Response response = { .Status = ImportFailed };
+		try
+		{
+			if (request.Type == ImageRequest)
+			{
+				Asset::ImageMetadata metadata =
+				{
+					.Path = path,
+					.sRGB = (request.Options & RequestOptions::sRGB) != 0
+				};
+
+				DirectX::ScratchImage image;
+				CookImage(metadata, image);
+				response.Status = IsCooked(request.Type, metadata.Path) ? Cooked : WriteFailed;
+			}
+			else if (request.Type == MeshRequest)
+			{
+				Asset::Mesh mesh;
+				mesh.Metadata =
+				{
+					.Path = path,
+					.KeepGeometryInRAM = (request.Options & RequestOptions::KeepGeometryInRAM) != 0,
+					.QuantizeVertices = (request.Options & RequestOptions::QuantizeVertices) != 0,
+					.GenerateLODs = (request.Options & RequestOptions::GenerateLODs) != 0,
+					.OptimizeMesh = (request.Options & RequestOptions::OptimizeMesh) != 0
+				};
+				mesh.Name = mesh.Metadata.Path.filename().string();
+
+				if (CookMesh(mesh.Metadata, mesh))
+				{
+					response.Status = IsCooked(request.Type, mesh.Metadata.Path) ? Cooked : WriteFailed;
+				}
+			}
+		}
+		catch (std::exception& e)
+		{
+			LOG_ERROR("Failed to import {}: {}", std::filesystem::path(path).string(), e.what());
+		}
+
+		if (!WriteExact(responses, &response, sizeof(response)))
+		{
+			break;
+		}
+	}
+
+	CoUninitialize();
+	return EXIT_SUCCESS;
+}
+
+ImportWorkerPool::Result ImportWorkerPool::Import(const Asset::ImageMetadata& Metadata)
+{
+	Request request =
+	{
+		.Type = ImageRequest,
+		.Options = Metadata.sRGB ? RequestOptions::sRGB : 0u
+	};
+	return Import(request, Metadata.Path);
+}
+
+ImportWorkerPool::Result ImportWorkerPool::Import(const Asset::MeshMetadata& Metadata)
+{
+	Request request =
+	{
+		.Type = MeshRequest,
+		.Options =
+			(Metadata.KeepGeometryInRAM ? RequestOptions::KeepGeometryInRAM : 0u) |
+			(Metadata.QuantizeVertices ? RequestOptions::QuantizeVertices : 0u) |
+			(Metadata.GenerateLODs ? RequestOptions::GenerateLODs : 0u) |
+			(Metadata.OptimizeMesh ? RequestOptions::OptimizeMesh : 0u)
+	};
+	return Import(request, Metadata.Path);
+}
+
+bool ImportWorkerPool::IsCooked(RequestType Type, const std::filesystem::path& Path)
+{
+	return Type == ImageRequest ? ImageStream::IsCookedUpToDate(Path, ImageStream::GetCookedPath(Path))
+								: IsCookedAssetUpToDate(Path, MeshStream::GetCookedPath(Path));
+}
+
+bool ImportWorkerPool::Start(Worker& Worker)
+{
+	SECURITY_ATTRIBUTES securityAttributes = { .nLength = sizeof(SECURITY_ATTRIBUTES), .bInheritHandle = TRUE };
+
+	wil::unique_hfile requestRead, requestWrite, responseRead, responseWrite;
+	if (!::CreatePipe(requestRead.put(), requestWrite.put(), &securityAttributes, 0) ||
+		!::CreatePipe(responseRead.put(), responseWrite.put(), &securityAttributes, 0))
+	{
+		return false;
+	}
+
+	// Only the worker ends are inherited, and only by this worker. A worker that inherited the ends of another
+	// worker would keep the pipes of that worker open after it crashed
+	HANDLE inheritedHandles[] = { requestRead.get(), responseWrite.get() };
+
+	SIZE_T attributeListSize = 0;
+	::InitializeProcThreadAttributeList(nullptr, 1, 0, &attributeListSize);
+	std::vector<BYTE> attributeList(attributeListSize);
+	auto pAttributeList = reinterpret_cast<LPPROC_THREAD_ATTRIBUTE_LIST>(attributeList.data());
+	if (!::InitializeProcThreadAttributeList(pAttributeList, 1, 0, &attributeListSize))
+	{
+		return false;
+	}
+	auto cleanup = wil::scope_exit([&] { ::DeleteProcThreadAttributeList(pAttributeList); });
+
+	if (!::UpdateProcThreadAttribute(pAttributeList, 0, PROC_THREAD_ATTRIBUTE_HANDLE_LIST, inheritedHandles, sizeof(inheritedHandles), nullptr, nullptr))
+	{
+		return false;
+	}
+
+	std::wstring commandLine = L"\"" + GetExecutablePath().wstring() + L"\" " +
+		std::wstring(CommandLineFlag.begin(), CommandLineFlag.end()) + L" " +
+		std::to_wstring(reinterpret_cast<uintptr_t>(requestRead.get())) + L" " +
+		std::to_wstring(reinterpret_cast<uintptr_t>(responseWrite.get()));
+
+	STARTUPINFOEXW startupInfo = {};
+	startupInfo.StartupInfo.cb = sizeof(startupInfo);
+	startupInfo.lpAttributeList = pAttributeList;
+
+	Worker.Process.reset();
+	if (!::CreateProcessW(nullptr, commandLine.data(), nullptr, nullptr, TRUE, EXTENDED_STARTUPINFO_PRESENT | CREATE_SUSPENDED,
+		nullptr, Application::ExecutableFolderPath.c_str(), &startupInfo.StartupInfo, &Worker.Process))
+	{
+		LOG_ERROR("Failed to start import worker (error={})", ::GetLastError());
+		return false;
+	}
+
+	if (Job)
+	{
+		::AssignProcessToJobObject(Job.get(), Worker.Process.hProcess);
+	}
+	::ResumeThread(Worker.Process.hThread);
+
+	// The worker ends are closed here, the pipes break as soon as the worker exits
+	Worker.Requests = std::move(requestWrite);
+	Worker.Responses = std::move(responseRead);
+	return true;
+}
+
+ImportWorkerPool::Result ImportWorkerPool::Import(const Request& Request, const std::filesystem::path& Path)
+{
+	const std::wstring& path = Path.native();
+
+	size_t index;
+	{
+		ScopedCriticalSection SCS(CriticalSection);
+		bool waitedForPath = false;
+		while (PathsInFlight.contains(path))
+		{
+			waitedForPath = true;
+			ConditionVariable.Wait(CriticalSection, INFINITE);
+		}
+
+		// Cooked by the import this one waited for
+		if (waitedForPath && IsCooked(Request.Type, Path))
+		{
+			return Result::Succeeded;
+		}
+		PathsInFlight.insert(path);
+
+		while (IdleWorkers.empty())
+		{
+			ConditionVariable.Wait(CriticalSection, INFINITE);
+		}
+
+		index = IdleWorkers.back();
+		IdleWorkers.pop_back();
+	}
+
+	// Owned by this thread until it is idle again
+	Worker& worker = Workers[index];
+
+	Result result = Result::Unavailable;
+	if (worker.Process.hProcess || Start(worker))
+	{
+		auto request = Request;
+		request.PathLength = static_cast<uint32_t>(path.size());
+
+		Response response = {};
+		if (WriteExact(worker.Requests.get(), &request, sizeof(request)) &&
+			WriteExact(worker.Requests.get(), path.data(), path.size() * sizeof(wchar_t)) &&
+			ReadExact(worker.Responses.get(), &response, sizeof(response)))
+		{
+			switch (response.Status)
+			{
+			case Cooked:
+				result = Result::Succeeded;
+				break;
+			case WriteFailed:
+				LOG_WARN("Import worker failed to write the cooked {}, importing in process", Path.string());
+				result = Result::Unavailable;
+				break;
+			default:
+				LOG_ERROR("Import worker failed to import {}", Path.string());
+				result = Result::Failed;
+				break;
+			}
+		}
+		else
+		{
+			::WaitForSingleObject(worker.Process.hProcess, INFINITE);
+
+			DWORD exitCode = 0;
+			::GetExitCodeProcess(worker.Process.hProcess, &exitCode);
+			LOG_ERROR("Import worker crashed importing {} (exit code={:#x})", Path.string(), exitCode);
+
+			// Started again by the next import
+			worker.Requests.reset();
+			worker.Responses.reset();
+			worker.Process.reset();
+			result = Result::Failed;
+		}
+	}
+
+	ScopedCriticalSection SCS(CriticalSection);
+	IdleWorkers.push_back(index);
+	PathsInFlight.erase(path);
+	// Imports wait for either a worker or their path
+	ConditionVariable.WakeAll();
+	return result;
+}
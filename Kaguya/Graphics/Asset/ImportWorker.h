@@ -0,0 +1,104 @@
+#pragma once
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+#include <wil/resource.h>
+
+#include <Core/Synchronization/CriticalSection.h>
+#include <Core/Synchronization/ConditionVariable.h>
+
+#include "Image.h"
+#include "Mesh.h"
+
+/*
+* Pool of child processes that import source assets into the cooked formats (see CookImage and CookMesh), the loaders
+* then read the cooked files like any other cooked asset. A corrupt file only takes down the worker importing it,
+* and imports run in parallel without relying on the third party importers being thread safe.
+* Workers are the editor executable started with CommandLineFlag, each worker gets a pair of anonymous pipes for
+* requests and responses. Workers are started on first use and restarted after a crash.
+*/
+class ImportWorkerPool
+{
+public:
+	static constexpr std::string_view CommandLineFlag = "--import-worker";
+
+	enum class Result
+	{
+		Succeeded,
+		Failed, // The worker failed to import the asset or crashed doing so
+		Unavailable // No worker could be started or it could not write the cooked asset, the caller imports in process
+	};
+
+	static void Initialize();
+	static void Shutdown();
+	static ImportWorkerPool& Instance();
+
+	// Entry point of a worker process, serves requests until the pipes are closed
+	static int RunWorker(int argc, char* argv[]);
+
+	// Blocks until a worker has written the cooked asset
+	Result Import(const Asset::ImageMetadata& Metadata);
+	Result Import(const Asset::MeshMetadata& Metadata);
+private:
+	ImportWorkerPool();
+	ImportWorkerPool(const ImportWorkerPool&) = delete;
+	ImportWorkerPool& operator=(const ImportWorkerPool&) = delete;
+	~ImportWorkerPool();
+
+	enum RequestType : uint32_t
+	{
+		ImageRequest,
+		MeshRequest
+	};
+
+	enum RequestOptions : uint32_t
+	{
+		sRGB = 1 << 0,
+		KeepGeometryInRAM = 1 << 1,
+		QuantizeVertices = 1 << 2,
+		GenerateLODs = 1 << 3,
+		OptimizeMesh = 1 << 4
+	};
+
+	// Followed by PathLength wide characters
+	struct Request
+	{
+		RequestType Type;
+		uint32_t Options;
+		uint32_t PathLength;
+	};
+
+	enum ResponseStatus : uint32_t
+	{
+		ImportFailed,
+		Cooked,
+		WriteFailed // Imported, but the cooked asset could not be written
+	};
+
+	struct Response
+	{
+		ResponseStatus Status;
+	};
+
+	struct Worker
+	{
+		wil::unique_process_information Process;
+		wil::unique_hfile Requests;
+		wil::unique_hfile Responses;
+	};
+
+	static bool IsCooked(RequestType Type, const std::filesystem::path& Path);
+	bool Start(Worker& Worker);
+	Result Import(const Request& Request, const std::filesystem::path& Path);
+private:
+	CriticalSection CriticalSection;
+	ConditionVariable ConditionVariable;
+	std::vector<Worker> Workers;
+	std::vector<size_t> IdleWorkers;
+	// Paths being cooked, a second import of the same path waits instead of writing the same cooked file
+	std::unordered_set<std::wstring> PathsInFlight;
+
+	// Workers are killed along with the editor
+	wil::unique_handle Job;
+};
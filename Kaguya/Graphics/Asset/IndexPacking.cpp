@@ -0,0 +1,129 @@
+#include "pch.h"
+#include "IndexPacking.h"
+
+DXGI_FORMAT SelectIndexFormat(const Asset::Submesh& Submesh)
+{
+	// Indices are relative to BaseVertexLocation so only the vertex count of the submesh matters
+	return Submesh.VertexCount <= uint32_t(std::numeric_limits<uint16_t>::max()) + 1 ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
+}
+
+IndexPackingStatistics PackIndices(Asset::Mesh& Mesh)
+{
+	IndexPackingStatistics Statistics = {};
+	Statistics.UnpackedSizeInBytes = Mesh.Indices.size() * sizeof(uint32_t);
+
+	// Every submesh starts on a 4 byte boundary so its indices can be read through a ByteAddressBuffer
+	size_t SizeInBytes = 0;
+	for (auto& Submesh : Mesh.Submeshes)
+	{
+		Submesh.IndexFormat = SelectIndexFormat(Submesh);
+		Submesh.IndexByteOffset = static_cast<uint32_t>(SizeInBytes);
+		SizeInBytes = AlignUp<size_t>(SizeInBytes + size_t(Submesh.IndexCount) * Submesh.GetIndexStride(), sizeof(uint32_t));
+	}
+
+	// LODs follow every submesh so the submeshes can be uploaded without them, see GetSubmeshIndexSizeInBytes.
+	// LODs index the same vertices so they share the format of their submesh
+	for (const auto& Submesh : Mesh.Submeshes)
+	{
+		for (uint32_t i = 0; i < Submesh.NumLODs; ++i)
+		{
+			auto& LOD = Mesh.LODs[Submesh.FirstLOD + i];
+			LOD.IndexByteOffset = static_cast<uint32_t>(SizeInBytes);
+			SizeInBytes = AlignUp<size_t>(SizeInBytes + size_t(LOD.IndexCount) * Submesh.GetIndexStride(), sizeof(uint32_t));
+		}
+	}
+
+	Mesh.CompactIndices.assign(SizeInBytes, 0);
+	for (const auto& Submesh : Mesh.Submeshes)
+	{
+		const auto Pack = [&](uint32_t StartIndexLocation, uint32_t IndexCount, uint32_t IndexByteOffset)
+		{
+			const uint32_t* pSource = Mesh.Indices.data() + StartIndexLocation;
+			BYTE* pDestination = Mesh.CompactIndices.data() + IndexByteOffset;
+			if (Submesh.IndexFormat == DXGI_FORMAT_R16_UINT)
+			{
+				std::transform(pSource, pSource + IndexCount, reinterpret_cast<uint16_t*>(pDestination), [](uint32_t Index)
+				{
+					return static_cast<uint16_t>(Index);
+				});
+			}
+			else
+			{
+				memcpy(pDestination, pSource, size_t(IndexCount) * sizeof(uint32_t));
+			}
+		};
+
+		Pack(Submesh.StartIndexLocation, Submesh.IndexCount, Submesh.IndexByteOffset);
+		for (uint32_t i = 0; i < Submesh.NumLODs; ++i)
+		{
+			const auto& LOD = Mesh.LODs[Submesh.FirstLOD + i];
+			Pack(LOD.StartIndexLocation, LOD.IndexCount, LOD.IndexByteOffset);
+		}
+
+		if (Submesh.IndexFormat == DXGI_FORMAT_R16_UINT)
+		{
+			Statistics.Num16BitSubmeshes++;
+		}
+	}
+
+	Statistics.PackedSizeInBytes = Mesh.CompactIndices.size();
+
+	Mesh.Indices.clear();
+	Mesh.Indices.shrink_to_fit();
+	return Statistics;
+}
+
+size_t GetSubmeshIndexSizeInBytes(const Asset::Mesh& Mesh)
+{
+	size_t SizeInBytes = 0;
+	for (const auto& Submesh : Mesh.Submeshes)
+	{
+		SizeInBytes = std::max<size_t>(SizeInBytes, AlignUp<size_t>(Submesh.IndexByteOffset + size_t(Submesh.IndexCount) * Submesh.GetIndexStride(), sizeof(uint32_t)));
+	}
+	return SizeInBytes;
+}
+
+std::vector<uint32_t> UnpackIndices(const Asset::Mesh& Mesh)
+{
+	if (!Mesh.Indices.empty())
+	{
+		return Mesh.Indices;
+	}
+
+	size_t NumIndices = 0;
+	for (const auto& Submesh : Mesh.Submeshes)
+	{
+		NumIndices = std::max<size_t>(NumIndices, size_t(Submesh.StartIndexLocation) + Submesh.IndexCount);
+	}
+	for (const auto& LOD : Mesh.LODs)
+	{
+		NumIndices = std::max<size_t>(NumIndices, size_t(LOD.StartIndexLocation) + LOD.IndexCount);
+	}
+
+	std::vector<uint32_t> Indices(NumIndices);
+	for (const auto& Submesh : Mesh.Submeshes)
+	{
+		const auto Unpack = [&](uint32_t StartIndexLocation, uint32_t IndexCount, uint32_t IndexByteOffset)
+		{
+			const BYTE* pSource = Mesh.CompactIndices.data() + IndexByteOffset;
+			uint32_t* pDestination = Indices.data() + StartIndexLocation;
+			if (Submesh.IndexFormat == DXGI_FORMAT_R16_UINT)
+			{
+				const uint16_t* pIndices = reinterpret_cast<const uint16_t*>(pSource);
+				std::copy(pIndices, pIndices + IndexCount, pDestination);
+			}
+			else
+			{
+				memcpy(pDestination, pSource, size_t(IndexCount) * sizeof(uint32_t));
+			}
+		};
+
+		Unpack(Submesh.StartIndexLocation, Submesh.IndexCount, Submesh.IndexByteOffset);
+		for (uint32_t i = 0; i < Submesh.NumLODs; ++i)
+		{
+			const auto& LOD = Mesh.LODs[Submesh.FirstLOD + i];
+			Unpack(LOD.StartIndexLocation, LOD.IndexCount, LOD.IndexByteOffset);
+		}
+	}
+	return Indices;
+}
@@ -0,0 +1,23 @@
+#pragma once
+#include "Mesh.h"
+
+// Index memory before and after packing
+struct IndexPackingStatistics
+{
+	size_t UnpackedSizeInBytes;	// With 32-bit indices
+	size_t PackedSizeInBytes;
+	size_t Num16BitSubmeshes;
+};
+
+// Returns the narrowest index format that can address every vertex of the submesh
+DXGI_FORMAT SelectIndexFormat(const Asset::Submesh& Submesh);
+
+// Converts Mesh.Indices into Mesh.CompactIndices and fills in the index format and byte offset of every submesh
+// and LOD, Mesh.Indices is released
+IndexPackingStatistics PackIndices(Asset::Mesh& Mesh);
+
+// Size of the start of Mesh.CompactIndices that holds the indices of the submeshes, the LODs are packed after it
+size_t GetSubmeshIndexSizeInBytes(const Asset::Mesh& Mesh);
+
+// Returns the indices of the mesh as 32-bit indices laid out like Mesh.Indices regardless of how they are stored
+std::vector<uint32_t> UnpackIndices(const Asset::Mesh& Mesh);
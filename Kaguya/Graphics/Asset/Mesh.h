@@ -5,12 +5,60 @@
 #include "../RenderDevice.h"
 #include "../Vertex.h"
 
+class SceneBundle;
+
+namespace CPU
+{
+	class BVH;
+	class EmissiveMesh;
+}
+
 namespace Asset
 {
 	struct MeshMetadata
 	{
 		std::filesystem::path Path;
 		bool KeepGeometryInRAM;
+		bool QuantizeVertices; // Store vertices as CompactVertex
+		bool GenerateLODs; // Simplified index ranges for every submesh, see LODTriangleRatios
+		bool OptimizeMesh; // Reorder triangles and vertices for the post transform vertex cache, see MeshOptimizer.h
+
+		std::shared_ptr<SceneBundle> Bundle; // Mounted scene bundle the mesh is read from, null if it is read from disk
+	};
+
+	// Simplified version of a submesh, indexes the same vertex range as the submesh
+	struct SubmeshLOD
+	{
+		uint32_t IndexCount;
+		uint32_t StartIndexLocation;
+		uint32_t IndexByteOffset; // Uses the index format of the submesh
+		float Error; // Object space distance
+	};
+
+	// Cluster of at most MaxMeshletVertices vertices and MaxMeshletTriangles triangles of a submesh,
+	// it is self contained so it can be culled, loaded and evicted on its own
+	struct Meshlet
+	{
+		uint32_t VertexOffset;		// Into Mesh::MeshletVertices
+		uint32_t TriangleOffset;	// Into Mesh::MeshletTriangles
+		uint32_t VertexCount;
+		uint32_t TriangleCount;
+
+		// Object space bounds
+		DirectX::BoundingBox BoundingBox;
+		DirectX::BoundingSphere BoundingSphere;
+
+		// Every triangle faces away from a viewer at P if
+		// dot(normalize(BoundingSphere.Center - P), ConeAxis) >= ConeCutoff + BoundingSphere.Radius / length(BoundingSphere.Center - P),
+		// ConeCutoff is 1 if the normals are spread too far apart for the test to ever succeed
+		float3 ConeAxis;
+		float ConeCutoff;
+	};
+
+	// Local vertex indices of a meshlet triangle
+	struct MeshletTriangle
+	{
+		uint8_t i0, i1, i2;
 	};
 
 	struct Submesh
@@ -19,6 +67,26 @@ namespace Asset
 		uint32_t StartIndexLocation;
 		uint32_t VertexCount;
 		uint32_t BaseVertexLocation;
+
+		// Location of the indices in Mesh::CompactIndices, always a multiple of 4
+		uint32_t IndexByteOffset;
+		DXGI_FORMAT IndexFormat; // DXGI_FORMAT_R16_UINT or DXGI_FORMAT_R32_UINT
+
+		[[nodiscard]] UINT GetIndexStride() const
+		{
+			return IndexFormat == DXGI_FORMAT_R16_UINT ? sizeof(uint16_t) : sizeof(uint32_t);
+		}
+
+		// Range of Mesh::Meshlets
+		uint32_t FirstMeshlet;
+		uint32_t NumMeshlets;
+
+		// Range of Mesh::LODs, ordered from finest to coarsest. The submesh itself is LOD 0
+		uint32_t FirstLOD;
+		uint32_t NumLODs;
+
+		// Object space bounds, compact vertex positions are quantized relative to it
+		DirectX::BoundingBox BoundingBox;
 	};
 
 	struct Mesh
@@ -27,14 +95,44 @@ namespace Asset
 
 		std::string Name;
 
+		// Only one of these is populated depending on Metadata.QuantizeVertices
 		std::vector<Vertex> Vertices;
+		std::vector<CompactVertex> CompactVertices;
+
+		// Indices are only kept as 32-bit while importing, they are packed into
+		// CompactIndices with a per submesh index format before the mesh is cooked
 		std::vector<uint32_t> Indices;
+		std::vector<BYTE> CompactIndices;
 
 		std::vector<Submesh> Submeshes;
+		std::vector<SubmeshLOD> LODs;
+
+		std::vector<Meshlet> Meshlets;
+		std::vector<uint32_t> MeshletVertices; // Relative to the base vertex of the submesh
+		std::vector<MeshletTriangle> MeshletTriangles;
+
+		std::shared_ptr<CPU::BVH> BVH; // Present for meshes read from a scene bundle, where it is built when the scene is baked, or once the CPU integrator traced the mesh
+		std::shared_ptr<const CPU::EmissiveMesh> Emitter; // Built the first time an instance of the mesh is emissive, see CPU::GetOrBuildEmissiveMesh
 
 		std::shared_ptr<Resource> VertexResource;
 		std::shared_ptr<Resource> IndexResource;
+		std::shared_ptr<Resource> QuantizationResource; // 3x4 dequantization transform per submesh, used by compact vertices
 		std::shared_ptr<Resource> AccelerationStructure;
 		BottomLevelAccelerationStructure BLAS;
+
+		[[nodiscard]] VertexFormat GetVertexFormat() const
+		{
+			return CompactVertices.empty() ? VertexFormat::Full : VertexFormat::Compact;
+		}
+
+		[[nodiscard]] UINT GetVertexStride() const
+		{
+			return GetVertexFormat() == VertexFormat::Compact ? sizeof(CompactVertex) : sizeof(Vertex);
+		}
+
+		[[nodiscard]] size_t GetNumVertices() const
+		{
+			return GetVertexFormat() == VertexFormat::Compact ? CompactVertices.size() : Vertices.size();
+		}
 	};
-}
\ No newline at end of file
+}
@@ -0,0 +1,276 @@
+#include "pch.h"
+#include "MeshClusterizer.h"
+
+using namespace DirectX;
+
+// Cones wider than this (cosine of the angle between the axis and the furthest normal) are not worth testing
+static constexpr float MinimumConeSpread = 0.1f;
+
+static constexpr uint8_t NotInMeshlet = 0xff;
+
+namespace
+{
+	class MeshletBuilder
+	{
+	public:
+		MeshletBuilder(Asset::Mesh& Mesh, const Asset::Submesh& Submesh)
+			: Mesh(Mesh),
+			Indices(std::span(Mesh.Indices).subspan(Submesh.StartIndexLocation, Submesh.IndexCount)),
+			Vertices(std::span(Mesh.Vertices).subspan(Submesh.BaseVertexLocation, Submesh.VertexCount)),
+			NumTriangles(Submesh.IndexCount / 3),
+			LocalIndices(Submesh.VertexCount, NotInMeshlet),
+			Assigned(NumTriangles, false)
+		{
+			// Vertex to triangle adjacency
+			TriangleOffsets.resize(Vertices.size() + 1, 0);
+			for (uint32_t Index : Indices)
+			{
+				TriangleOffsets[Index + 1]++;
+			}
+			std::partial_sum(TriangleOffsets.begin(), TriangleOffsets.end(), TriangleOffsets.begin());
+
+			VertexTriangles.resize(Indices.size());
+			std::vector<uint32_t> Cursor(TriangleOffsets.begin(), TriangleOffsets.end() - 1);
+			for (size_t i = 0; i < Indices.size(); ++i)
+			{
+				VertexTriangles[Cursor[Indices[i]]++] = static_cast<uint32_t>(i / 3);
+			}
+		}
+
+		void Build()
+		{
+			size_t SeedCursor = 0;
+			while (true)
+			{
+				int64_t Best = -1;
+				if (Triangles.empty())
+				{
+					// Seeds are taken in index order which is already spatially coherent, see OptimizeMesh
+					while (SeedCursor < NumTriangles && Assigned[SeedCursor])
+					{
+						SeedCursor++;
+					}
+					if (SeedCursor == NumTriangles)
+					{
+						break;
+					}
+					Best = static_cast<int64_t>(SeedCursor);
+				}
+				else if (Triangles.size() < MaxMeshletTriangles)
+				{
+					Best = FindNextTriangle();
+				}
+
+				if (Best < 0)
+				{
+					Flush();
+					continue;
+				}
+
+				AddTriangle(static_cast<uint32_t>(Best));
+			}
+		}
+	private:
+		float3 GetCentroid(uint32_t Triangle) const
+		{
+			const float3& p0 = Vertices[Indices[Triangle * 3 + 0]].Position;
+			const float3& p1 = Vertices[Indices[Triangle * 3 + 1]].Position;
+			const float3& p2 = Vertices[Indices[Triangle * 3 + 2]].Position;
+			return { (p0.x + p1.x + p2.x) / 3.0f, (p0.y + p1.y + p2.y) / 3.0f, (p0.z + p1.z + p2.z) / 3.0f };
+		}
+
+		uint32_t CountNewVertices(uint32_t Triangle) const
+		{
+			return
+				(LocalIndices[Indices[Triangle * 3 + 0]] == NotInMeshlet ? 1 : 0) +
+				(LocalIndices[Indices[Triangle * 3 + 1]] == NotInMeshlet ? 1 : 0) +
+				(LocalIndices[Indices[Triangle * 3 + 2]] == NotInMeshlet ? 1 : 0);
+		}
+
+		// Returns the unassigned triangle sharing a vertex with the meshlet that fits and adds the fewest vertices, -1 if there is none
+		int64_t FindNextTriangle() const
+		{
+			const float3 Center = { CentroidSum.x / Triangles.size(), CentroidSum.y / Triangles.size(), CentroidSum.z / Triangles.size() };
+
+			int64_t Best = -1;
+			uint32_t BestNewVertices = UINT32_MAX;
+			float BestDistance = FLT_MAX;
+			for (uint32_t Vertex : MeshletVertices)
+			{
+				for (uint32_t t = TriangleOffsets[Vertex]; t < TriangleOffsets[Vertex + 1]; ++t)
+				{
+					const uint32_t Triangle = VertexTriangles[t];
+					if (Assigned[Triangle])
+					{
+						continue;
+					}
+
+					const uint32_t NewVertices = CountNewVertices(Triangle);
+					if (MeshletVertices.size() + NewVertices > MaxMeshletVertices || NewVertices > BestNewVertices)
+					{
+						continue;
+					}
+
+					const float3 Centroid = GetCentroid(Triangle);
+					const float Distance =
+						(Centroid.x - Center.x) * (Centroid.x - Center.x) +
+						(Centroid.y - Center.y) * (Centroid.y - Center.y) +
+						(Centroid.z - Center.z) * (Centroid.z - Center.z);
+					if (NewVertices < BestNewVertices || Distance < BestDistance)
+					{
+						Best = Triangle;
+						BestNewVertices = NewVertices;
+						BestDistance = Distance;
+					}
+				}
+			}
+			return Best;
+		}
+
+		void AddTriangle(uint32_t Triangle)
+		{
+			uint8_t Local[3];
+			for (size_t k = 0; k < 3; ++k)
+			{
+				const uint32_t Index = Indices[Triangle * 3 + k];
+				if (LocalIndices[Index] == NotInMeshlet)
+				{
+					LocalIndices[Index] = static_cast<uint8_t>(MeshletVertices.size());
+					MeshletVertices.push_back(Index);
+				}
+				Local[k] = LocalIndices[Index];
+			}
+			Triangles.push_back({ Local[0], Local[1], Local[2] });
+			Assigned[Triangle] = true;
+
+			const float3 Centroid = GetCentroid(Triangle);
+			CentroidSum = { CentroidSum.x + Centroid.x, CentroidSum.y + Centroid.y, CentroidSum.z + Centroid.z };
+		}
+
+		void Flush()
+		{
+			Asset::Meshlet Meshlet = {};
+			Meshlet.VertexOffset = static_cast<uint32_t>(Mesh.MeshletVertices.size());
+			Meshlet.TriangleOffset = static_cast<uint32_t>(Mesh.MeshletTriangles.size());
+			Meshlet.VertexCount = static_cast<uint32_t>(MeshletVertices.size());
+			Meshlet.TriangleCount = static_cast<uint32_t>(Triangles.size());
+
+			std::vector<XMFLOAT3> Positions(MeshletVertices.size());
+			for (size_t i = 0; i < MeshletVertices.size(); ++i)
+			{
+				Positions[i] = Vertices[MeshletVertices[i]].Position;
+			}
+			BoundingBox::CreateFromPoints(Meshlet.BoundingBox, Positions.size(), Positions.data(), sizeof(XMFLOAT3));
+			BoundingSphere::CreateFromPoints(Meshlet.BoundingSphere, Positions.size(), Positions.data(), sizeof(XMFLOAT3));
+
+			// Normal cone around the average triangle normal
+			std::vector<XMVECTOR> Normals;
+			Normals.reserve(Triangles.size());
+			XMVECTOR Axis = XMVectorZero();
+			for (const auto& Triangle : Triangles)
+			{
+				XMVECTOR p0 = XMLoadFloat3(&Positions[Triangle.i0]);
+				XMVECTOR p1 = XMLoadFloat3(&Positions[Triangle.i1]);
+				XMVECTOR p2 = XMLoadFloat3(&Positions[Triangle.i2]);
+				XMVECTOR n = XMVector3Cross(p1 - p0, p2 - p0);
+				if (XMVectorGetX(XMVector3LengthSq(n)) == 0.0f)
+				{
+					continue;
+				}
+				n = XMVector3Normalize(n);
+				Normals.push_back(n);
+				Axis += n;
+			}
+
+			float MinimumDot = 1.0f;
+			if (!Normals.empty() && XMVectorGetX(XMVector3LengthSq(Axis)) > 0.0f)
+			{
+				Axis = XMVector3Normalize(Axis);
+				for (const auto& n : Normals)
+				{
+					MinimumDot = std::min(MinimumDot, XMVectorGetX(XMVector3Dot(Axis, n)));
+				}
+			}
+			else
+			{
+				MinimumDot = -1.0f;
+			}
+
+			XMStoreFloat3(&Meshlet.ConeAxis, Axis);
+			// The view direction has to be within 90 degrees minus the half angle of the cone from the axis
+			Meshlet.ConeCutoff = MinimumDot <= MinimumConeSpread ? 1.0f : std::sqrt(1.0f - MinimumDot * MinimumDot);
+
+			Mesh.Meshlets.push_back(Meshlet);
+			Mesh.MeshletVertices.insert(Mesh.MeshletVertices.end(), MeshletVertices.begin(), MeshletVertices.end());
+			Mesh.MeshletTriangles.insert(Mesh.MeshletTriangles.end(), Triangles.begin(), Triangles.end());
+
+			for (uint32_t Vertex : MeshletVertices)
+			{
+				LocalIndices[Vertex] = NotInMeshlet;
+			}
+			MeshletVertices.clear();
+			Triangles.clear();
+			CentroidSum = {};
+		}
+
+		Asset::Mesh& Mesh;
+		std::span<const uint32_t> Indices;
+		std::span<const Vertex> Vertices;
+		size_t NumTriangles;
+
+		std::vector<uint32_t> TriangleOffsets;
+		std::vector<uint32_t> VertexTriangles;
+
+		std::vector<uint8_t> LocalIndices; // Local index of every submesh vertex in the current meshlet
+		std::vector<bool> Assigned;
+
+		// Current meshlet
+		std::vector<uint32_t> MeshletVertices;
+		std::vector<Asset::MeshletTriangle> Triangles;
+		float3 CentroidSum = {};
+	};
+}
+
+MeshletStatistics BuildMeshlets(Asset::Mesh& Mesh)
+{
+	assert(Mesh.GetVertexFormat() == VertexFormat::Full && !Mesh.Indices.empty());
+
+	Mesh.Meshlets.clear();
+	Mesh.MeshletVertices.clear();
+	Mesh.MeshletTriangles.clear();
+
+	for (auto& Submesh : Mesh.Submeshes)
+	{
+		Submesh.FirstMeshlet = static_cast<uint32_t>(Mesh.Meshlets.size());
+
+		MeshletBuilder Builder(Mesh, Submesh);
+		Builder.Build();
+
+		Submesh.NumMeshlets = static_cast<uint32_t>(Mesh.Meshlets.size()) - Submesh.FirstMeshlet;
+	}
+
+	MeshletStatistics Statistics = {};
+	Statistics.NumMeshlets = Mesh.Meshlets.size();
+	if (Statistics.NumMeshlets > 0)
+	{
+		Statistics.AverageVertices = float(Mesh.MeshletVertices.size()) / float(Statistics.NumMeshlets);
+		Statistics.AverageTriangles = float(Mesh.MeshletTriangles.size()) / float(Statistics.NumMeshlets);
+	}
+	Statistics.NumCullableMeshlets = std::count_if(Mesh.Meshlets.begin(), Mesh.Meshlets.end(), [](const Asset::Meshlet& Meshlet)
+	{
+		return Meshlet.ConeCutoff < 1.0f;
+	});
+	return Statistics;
+}
+
+bool IsMeshletBackfacing(const Asset::Meshlet& Meshlet, const float3& ViewPosition)
+{
+	XMVECTOR Direction = XMLoadFloat3(&Meshlet.BoundingSphere.Center) - XMLoadFloat3(&ViewPosition);
+	const float Distance = XMVectorGetX(XMVector3Length(Direction));
+	return XMVectorGetX(XMVector3Dot(Direction, XMLoadFloat3(&Meshlet.ConeAxis))) >= Meshlet.ConeCutoff * Distance + Meshlet.BoundingSphere.Radius;
+}
+
+size_t GetMeshletSizeInBytes(const Asset::Mesh& Mesh, const Asset::Meshlet& Meshlet)
+{
+	return size_t(Meshlet.VertexCount) * Mesh.GetVertexStride() + size_t(Meshlet.TriangleCount) * sizeof(Asset::MeshletTriangle);
+}
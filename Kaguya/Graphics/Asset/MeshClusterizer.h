@@ -0,0 +1,25 @@
+#pragma once
+#include "Mesh.h"
+
+// 124 rather than 128 triangles leaves room for per meshlet data in a 128 byte aligned triangle block
+inline constexpr uint32_t MaxMeshletVertices = 64;
+inline constexpr uint32_t MaxMeshletTriangles = 124;
+
+struct MeshletStatistics
+{
+	size_t NumMeshlets;
+	float AverageVertices;	// Per meshlet
+	float AverageTriangles;	// Per meshlet
+	size_t NumCullableMeshlets; // Meshlets with a usable normal cone
+};
+
+// Splits every submesh into meshlets, Mesh.Vertices and Mesh.Indices must be populated. Triangles are grown
+// from a seed over shared vertices, preferring triangles that add the fewest new vertices and then the ones
+// closest to the meshlet, so meshlets are spatially compact
+MeshletStatistics BuildMeshlets(Asset::Mesh& Mesh);
+
+// Returns true if every triangle of the meshlet faces away from ViewPosition (object space)
+bool IsMeshletBackfacing(const Asset::Meshlet& Meshlet, const float3& ViewPosition);
+
+// Memory a meshlet occupies when it is made resident on its own, its vertices and triangles
+size_t GetMeshletSizeInBytes(const Asset::Mesh& Mesh, const Asset::Meshlet& Meshlet);
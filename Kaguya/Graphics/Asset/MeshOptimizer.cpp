@@ -0,0 +1,343 @@
+#include "pch.h"
+#include "MeshOptimizer.h"
+
+// Forsyth's scoring parameters, the simulated cache is an LRU cache
+static constexpr size_t ForsythCacheSize = 32;
+static constexpr float ForsythCacheDecayPower = 1.5f;
+static constexpr float ForsythLastTriangleScore = 0.75f;
+static constexpr float ForsythValenceBoostScale = 2.0f;
+static constexpr float ForsythValenceBoostPower = 0.5f;
+
+static float ForsythVertexScore(int CachePosition, uint32_t NumActiveTriangles)
+{
+	if (NumActiveTriangles == 0)
+	{
+		// No triangle needs this vertex anymore
+		return -1.0f;
+	}
+
+	float Score = 0.0f;
+	if (CachePosition >= 0)
+	{
+		if (CachePosition < 3)
+		{
+			// The vertices of the last triangle get a fixed score so the next triangle doesn't
+			// always reuse the edge that was just emitted, this avoids long thin strips
+			Score = ForsythLastTriangleScore;
+		}
+		else
+		{
+			const float Scaler = 1.0f / float(ForsythCacheSize - 3);
+			Score = std::pow(1.0f - float(CachePosition - 3) * Scaler, ForsythCacheDecayPower);
+		}
+	}
+
+	// Favor vertices with few remaining triangles so they are finished off and leave the cache
+	Score += ForsythValenceBoostScale * std::pow(float(NumActiveTriangles), -ForsythValenceBoostPower);
+	return Score;
+}
+
+// Interleaves the lower 10 bits of v with 2 zero bits
+static uint32_t ExpandBits(uint32_t v)
+{
+	v = (v * 0x00010001u) & 0xFF0000FFu;
+	v = (v * 0x00000101u) & 0x0F00F00Fu;
+	v = (v * 0x00000011u) & 0xC30C30C3u;
+	v = (v * 0x00000005u) & 0x49249249u;
+	return v;
+}
+
+static uint32_t Morton3D(float x, float y, float z)
+{
+	const auto Quantize = [](float v)
+	{
+		return static_cast<uint32_t>(std::clamp(v * 1024.0f, 0.0f, 1023.0f));
+	};
+	return (ExpandBits(Quantize(x)) << 2) | (ExpandBits(Quantize(y)) << 1) | ExpandBits(Quantize(z));
+}
+
+VertexCacheStatistics AnalyzeVertexCache(std::span<const uint32_t> Indices, size_t NumVertices, size_t CacheSize)
+{
+	VertexCacheStatistics Statistics = {};
+	Statistics.NumTriangles = Indices.size() / 3;
+
+	// Time stamp at which each vertex entered the FIFO, a vertex is in the cache if it entered less than CacheSize misses ago
+	std::vector<size_t> Timestamps(NumVertices, 0);
+	size_t Time = CacheSize + 1;
+
+	for (uint32_t Index : Indices)
+	{
+		if (Timestamps[Index] == 0)
+		{
+			Statistics.NumReferencedVertices++;
+		}
+
+		if (Time - Timestamps[Index] > CacheSize)
+		{
+			Timestamps[Index] = Time++;
+			Statistics.NumTransformedVertices++;
+		}
+	}
+
+	return Statistics;
+}
+
+VertexCacheStatistics AnalyzeVertexCache(const Asset::Mesh& Mesh, size_t CacheSize)
+{
+	VertexCacheStatistics Statistics = {};
+	for (const auto& Submesh : Mesh.Submeshes)
+	{
+		const auto SubmeshStatistics = AnalyzeVertexCache(
+			std::span(Mesh.Indices).subspan(Submesh.StartIndexLocation, Submesh.IndexCount),
+			Submesh.VertexCount,
+			CacheSize);
+
+		Statistics.NumTransformedVertices += SubmeshStatistics.NumTransformedVertices;
+		Statistics.NumTriangles += SubmeshStatistics.NumTriangles;
+		Statistics.NumReferencedVertices += SubmeshStatistics.NumReferencedVertices;
+	}
+	return Statistics;
+}
+
+void SortTrianglesSpatially(std::span<uint32_t> Indices, std::span<const Vertex> Vertices)
+{
+	const size_t NumTriangles = Indices.size() / 3;
+	if (NumTriangles < 2)
+	{
+		return;
+	}
+
+	std::vector<float3> Centroids(NumTriangles);
+	float3 Min = { FLT_MAX, FLT_MAX, FLT_MAX };
+	float3 Max = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	for (size_t i = 0; i < NumTriangles; ++i)
+	{
+		const float3& p0 = Vertices[Indices[i * 3 + 0]].Position;
+		const float3& p1 = Vertices[Indices[i * 3 + 1]].Position;
+		const float3& p2 = Vertices[Indices[i * 3 + 2]].Position;
+
+		float3& Centroid = Centroids[i];
+		Centroid = { (p0.x + p1.x + p2.x) / 3.0f, (p0.y + p1.y + p2.y) / 3.0f, (p0.z + p1.z + p2.z) / 3.0f };
+
+		Min = { std::min(Min.x, Centroid.x), std::min(Min.y, Centroid.y), std::min(Min.z, Centroid.z) };
+		Max = { std::max(Max.x, Centroid.x), std::max(Max.y, Centroid.y), std::max(Max.z, Centroid.z) };
+	}
+
+	// Uniform scale so the curve isn't stretched along the shorter axes
+	const float Extent = std::max({ Max.x - Min.x, Max.y - Min.y, Max.z - Min.z });
+	const float InverseExtent = Extent > 0.0f ? 1.0f / Extent : 0.0f;
+
+	std::vector<std::pair<uint32_t, uint32_t>> Keys(NumTriangles);
+	for (size_t i = 0; i < NumTriangles; ++i)
+	{
+		Keys[i].first = Morton3D(
+			(Centroids[i].x - Min.x) * InverseExtent,
+			(Centroids[i].y - Min.y) * InverseExtent,
+			(Centroids[i].z - Min.z) * InverseExtent);
+		Keys[i].second = static_cast<uint32_t>(i);
+	}
+	std::stable_sort(Keys.begin(), Keys.end(), [](const auto& a, const auto& b)
+	{
+		return a.first < b.first;
+	});
+
+	std::vector<uint32_t> Sorted(Indices.size());
+	for (size_t i = 0; i < NumTriangles; ++i)
+	{
+		const uint32_t Triangle = Keys[i].second;
+		Sorted[i * 3 + 0] = Indices[Triangle * 3 + 0];
+		Sorted[i * 3 + 1] = Indices[Triangle * 3 + 1];
+		Sorted[i * 3 + 2] = Indices[Triangle * 3 + 2];
+	}
+	std::copy(Sorted.begin(), Sorted.end(), Indices.begin());
+}
+
+void OptimizeVertexCache(std::span<uint32_t> Indices, size_t NumVertices)
+{
+	const size_t NumTriangles = Indices.size() / 3;
+	if (NumTriangles < 2)
+	{
+		return;
+	}
+
+	struct VertexData
+	{
+		int CachePosition = -1;
+		uint32_t NumActiveTriangles = 0;
+		uint32_t TriangleOffset = 0; // Into Adjacency
+		float Score = 0.0f;
+	};
+
+	std::vector<VertexData> VertexDatas(NumVertices);
+	for (uint32_t Index : Indices)
+	{
+		VertexDatas[Index].NumActiveTriangles++;
+	}
+
+	// Triangles adjacent to each vertex, the active ones are kept at the front of each range
+	std::vector<uint32_t> Adjacency(Indices.size());
+	{
+		uint32_t Offset = 0;
+		for (auto& Data : VertexDatas)
+		{
+			Data.TriangleOffset = Offset;
+			Offset += Data.NumActiveTriangles;
+			Data.Score = ForsythVertexScore(Data.CachePosition, Data.NumActiveTriangles);
+		}
+
+		std::vector<uint32_t> Counts(NumVertices, 0);
+		for (size_t i = 0; i < Indices.size(); ++i)
+		{
+			const uint32_t Index = Indices[i];
+			Adjacency[VertexDatas[Index].TriangleOffset + Counts[Index]++] = static_cast<uint32_t>(i / 3);
+		}
+	}
+
+	std::vector<float> TriangleScores(NumTriangles);
+	std::vector<bool> Emitted(NumTriangles, false);
+	for (size_t i = 0; i < NumTriangles; ++i)
+	{
+		TriangleScores[i] =
+			VertexDatas[Indices[i * 3 + 0]].Score +
+			VertexDatas[Indices[i * 3 + 1]].Score +
+			VertexDatas[Indices[i * 3 + 2]].Score;
+	}
+
+	std::vector<uint32_t> Output;
+	Output.reserve(Indices.size());
+
+	std::vector<uint32_t> Cache, NewCache;
+	Cache.reserve(ForsythCacheSize + 3);
+	NewCache.reserve(ForsythCacheSize + 3);
+
+	size_t InputCursor = 0;
+	int64_t BestTriangle = 0;
+	while (BestTriangle >= 0)
+	{
+		Emitted[BestTriangle] = true;
+
+		const uint32_t* pTriangle = &Indices[BestTriangle * 3];
+		for (size_t i = 0; i < 3; ++i)
+		{
+			const uint32_t Index = pTriangle[i];
+			Output.push_back(Index);
+
+			// Move the triangle out of the active part of the adjacency range
+			VertexData& Data = VertexDatas[Index];
+			uint32_t* pBegin = &Adjacency[Data.TriangleOffset];
+			uint32_t* pEnd = pBegin + Data.NumActiveTriangles;
+			std::swap(*std::find(pBegin, pEnd, static_cast<uint32_t>(BestTriangle)), *(pEnd - 1));
+			Data.NumActiveTriangles--;
+		}
+
+		// The vertices of the emitted triangle move to the front of the LRU cache
+		NewCache.assign(pTriangle, pTriangle + 3);
+		for (uint32_t Index : Cache)
+		{
+			if (Index != pTriangle[0] && Index != pTriangle[1] && Index != pTriangle[2])
+			{
+				NewCache.push_back(Index);
+			}
+		}
+
+		// Rescore the vertices whose cache position changed, including the ones pushed out of the cache
+		for (size_t i = 0; i < NewCache.size(); ++i)
+		{
+			VertexData& Data = VertexDatas[NewCache[i]];
+			Data.CachePosition = i < ForsythCacheSize ? static_cast<int>(i) : -1;
+
+			const float Score = ForsythVertexScore(Data.CachePosition, Data.NumActiveTriangles);
+			const float Delta = Score - Data.Score;
+			Data.Score = Score;
+
+			for (uint32_t t = 0; t < Data.NumActiveTriangles; ++t)
+			{
+				TriangleScores[Adjacency[Data.TriangleOffset + t]] += Delta;
+			}
+		}
+
+		// Pick the next triangle once every score is up to date, a triangle shares up to 3 vertices with the cache
+		// and is only final after all of them are rescored
+		BestTriangle = -1;
+		float BestScore = -1.0f;
+		for (size_t i = 0; i < std::min(NewCache.size(), ForsythCacheSize); ++i)
+		{
+			const VertexData& Data = VertexDatas[NewCache[i]];
+			for (uint32_t t = 0; t < Data.NumActiveTriangles; ++t)
+			{
+				const uint32_t Triangle = Adjacency[Data.TriangleOffset + t];
+				if (TriangleScores[Triangle] > BestScore)
+				{
+					BestScore = TriangleScores[Triangle];
+					BestTriangle = Triangle;
+				}
+			}
+		}
+
+		NewCache.resize(std::min(NewCache.size(), ForsythCacheSize));
+		std::swap(Cache, NewCache);
+
+		if (BestTriangle < 0)
+		{
+			// Nothing in the cache is adjacent to a remaining triangle, continue in input order
+			while (InputCursor < NumTriangles && Emitted[InputCursor])
+			{
+				InputCursor++;
+			}
+			if (InputCursor < NumTriangles)
+			{
+				BestTriangle = static_cast<int64_t>(InputCursor);
+			}
+		}
+	}
+
+	assert(Output.size() == Indices.size());
+	std::copy(Output.begin(), Output.end(), Indices.begin());
+}
+
+void OptimizeVertexFetch(std::span<uint32_t> Indices, std::span<Vertex> Vertices)
+{
+	constexpr uint32_t Unassigned = UINT32_MAX;
+
+	std::vector<uint32_t> Remap(Vertices.size(), Unassigned);
+	uint32_t NextVertex = 0;
+	for (uint32_t& Index : Indices)
+	{
+		if (Remap[Index] == Unassigned)
+		{
+			Remap[Index] = NextVertex++;
+		}
+		Index = Remap[Index];
+	}
+
+	for (uint32_t& NewIndex : Remap)
+	{
+		if (NewIndex == Unassigned)
+		{
+			NewIndex = NextVertex++;
+		}
+	}
+
+	std::vector<Vertex> Reordered(Vertices.size());
+	for (size_t i = 0; i < Vertices.size(); ++i)
+	{
+		Reordered[Remap[i]] = Vertices[i];
+	}
+	std::copy(Reordered.begin(), Reordered.end(), Vertices.begin());
+}
+
+void OptimizeMesh(Asset::Mesh& Mesh)
+{
+	assert(Mesh.GetVertexFormat() == VertexFormat::Full);
+
+	for (const auto& Submesh : Mesh.Submeshes)
+	{
+		auto Indices = std::span(Mesh.Indices).subspan(Submesh.StartIndexLocation, Submesh.IndexCount);
+		auto Vertices = std::span(Mesh.Vertices).subspan(Submesh.BaseVertexLocation, Submesh.VertexCount);
+
+		// The spatial order decides where the cache optimizer restarts, the fetch order then follows the triangle order
+		SortTrianglesSpatially(Indices, Vertices);
+		OptimizeVertexCache(Indices, Vertices.size());
+		OptimizeVertexFetch(Indices, Vertices);
+	}
+}
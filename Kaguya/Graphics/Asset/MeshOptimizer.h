@@ -0,0 +1,41 @@
+#pragma once
+#include <span>
+
+#include "Mesh.h"
+
+/*
+* Import time optimizations that reorder the geometry of a mesh without changing its appearance.
+* Every submesh is optimized independently, the index ranges and vertex ranges of the submeshes are preserved.
+*/
+
+// Post-transform vertex cache statistics, simulated with a FIFO cache
+struct VertexCacheStatistics
+{
+	size_t NumTransformedVertices;	// Cache misses
+	size_t NumTriangles;
+	size_t NumReferencedVertices;
+
+	// Average cache miss ratio, transformed vertices per triangle. 0.5 is the optimum for regular grids, 3 is the worst case
+	[[nodiscard]] float ACMR() const { return NumTriangles > 0 ? float(NumTransformedVertices) / float(NumTriangles) : 0.0f; }
+
+	// Average transform to vertex ratio, 1 is the optimum
+	[[nodiscard]] float ATVR() const { return NumReferencedVertices > 0 ? float(NumTransformedVertices) / float(NumReferencedVertices) : 0.0f; }
+};
+
+VertexCacheStatistics AnalyzeVertexCache(std::span<const uint32_t> Indices, size_t NumVertices, size_t CacheSize = 16);
+
+// Accumulated over all submeshes
+VertexCacheStatistics AnalyzeVertexCache(const Asset::Mesh& Mesh, size_t CacheSize = 16);
+
+// Sorts triangles along a Morton curve through their centroids
+void SortTrianglesSpatially(std::span<uint32_t> Indices, std::span<const Vertex> Vertices);
+
+// Reorders triangles for the post-transform vertex cache, see "Linear-Speed Vertex Cache Optimisation" by Tom Forsyth.
+// Whenever the cache runs dry the next triangle is taken in input order, so a spatially sorted input keeps most of its locality
+void OptimizeVertexCache(std::span<uint32_t> Indices, size_t NumVertices);
+
+// Reorders vertices in the order they are first referenced by the index buffer, unreferenced vertices are moved to the end
+void OptimizeVertexFetch(std::span<uint32_t> Indices, std::span<Vertex> Vertices);
+
+// Runs the spatial sort, vertex cache and vertex fetch optimizations on every submesh, Mesh.Vertices must be populated
+void OptimizeMesh(Asset::Mesh& Mesh);
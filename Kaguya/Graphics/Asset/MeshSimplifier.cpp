@@ -0,0 +1,461 @@
+#include "pch.h"
+#include "MeshSimplifier.h"
+#include "MeshOptimizer.h"
+
+// Weights of the attribute differences relative to the squared positional error in normalized space
+static constexpr float NormalWeight = 0.0625f;
+static constexpr float TextureWeight = 0.25f;
+
+// Collapses that rotate an adjacent triangle normal further than this are rejected (cosine)
+static constexpr float MinimumFlipCosine = 0.25f;
+
+// Wedges whose normals are closer than this (cosine) are split by smooth shading, not by a hard edge
+static constexpr float MinimumSmoothCosine = 0.5f;
+
+namespace
+{
+	// Symmetric 4x4 matrix, Error(p) = p^T * A * p + 2 * b^T * p + c
+	struct Quadric
+	{
+		float a00, a11, a22;
+		float a01, a02, a12;
+		float b0, b1, b2;
+		float c;
+		float Weight;
+
+		void AddPlane(const float3& n, float d, float w)
+		{
+			a00 += w * n.x * n.x; a11 += w * n.y * n.y; a22 += w * n.z * n.z;
+			a01 += w * n.x * n.y; a02 += w * n.x * n.z; a12 += w * n.y * n.z;
+			b0 += w * n.x * d; b1 += w * n.y * d; b2 += w * n.z * d;
+			c += w * d * d;
+			Weight += w;
+		}
+
+		void operator+=(const Quadric& q)
+		{
+			a00 += q.a00; a11 += q.a11; a22 += q.a22;
+			a01 += q.a01; a02 += q.a02; a12 += q.a12;
+			b0 += q.b0; b1 += q.b1; b2 += q.b2;
+			c += q.c;
+			Weight += q.Weight;
+		}
+
+		// Area weighted mean squared distance of p to the planes
+		[[nodiscard]] float Error(const float3& p) const
+		{
+			const float rx = a00 * p.x + a01 * p.y + a02 * p.z + b0;
+			const float ry = a01 * p.x + a11 * p.y + a12 * p.z + b1;
+			const float rz = a02 * p.x + a12 * p.y + a22 * p.z + b2;
+			const float e = rx * p.x + ry * p.y + rz * p.z + b0 * p.x + b1 * p.y + b2 * p.z + c;
+			return Weight > 0.0f ? std::abs(e) / Weight : 0.0f;
+		}
+	};
+
+	struct Collapse
+	{
+		uint32_t Source;
+		uint32_t Target;
+		float Cost;		// Orders the collapses, includes the attribute terms
+		float Error;	// Squared geometric error
+	};
+
+	float3 TriangleNormal(const float3& p0, const float3& p1, const float3& p2)
+	{
+		const float3 e0 = { p1.x - p0.x, p1.y - p0.y, p1.z - p0.z };
+		const float3 e1 = { p2.x - p0.x, p2.y - p0.y, p2.z - p0.z };
+		return { e0.y * e1.z - e0.z * e1.y, e0.z * e1.x - e0.x * e1.z, e0.x * e1.y - e0.y * e1.x };
+	}
+
+	float Dot(const float3& a, const float3& b)
+	{
+		return a.x * b.x + a.y * b.y + a.z * b.z;
+	}
+
+	struct PositionHash
+	{
+		size_t operator()(const float3& p) const
+		{
+			uint32_t h[3];
+			memcpy(h, &p, sizeof(h));
+			return (size_t(h[0]) * 73856093) ^ (size_t(h[1]) * 19349663) ^ (size_t(h[2]) * 83492791);
+		}
+	};
+
+	struct PositionEqual
+	{
+		bool operator()(const float3& a, const float3& b) const
+		{
+			return a.x == b.x && a.y == b.y && a.z == b.z;
+		}
+	};
+}
+
+std::vector<uint32_t> SimplifyMesh(std::span<const uint32_t> Indices, std::span<const Vertex> Vertices, size_t TargetIndexCount, float TargetError, float* pResultError)
+{
+	std::vector<uint32_t> Result(Indices.begin(), Indices.end());
+	float ResultError = 0.0f;
+
+	if (Result.size() <= TargetIndexCount || Vertices.empty())
+	{
+		if (pResultError)
+		{
+			*pResultError = ResultError;
+		}
+		return Result;
+	}
+
+	const size_t NumVertices = Vertices.size();
+
+	// Work in a unit sized space so errors are comparable between meshes
+	float3 Min = Vertices[0].Position, Max = Vertices[0].Position;
+	for (const auto& Vertex : Vertices)
+	{
+		Min = { std::min(Min.x, Vertex.Position.x), std::min(Min.y, Vertex.Position.y), std::min(Min.z, Vertex.Position.z) };
+		Max = { std::max(Max.x, Vertex.Position.x), std::max(Max.y, Vertex.Position.y), std::max(Max.z, Vertex.Position.z) };
+	}
+	const float Extent = std::max({ Max.x - Min.x, Max.y - Min.y, Max.z - Min.z });
+	const float InverseExtent = Extent > 0.0f ? 1.0f / Extent : 0.0f;
+
+	std::vector<float3> Positions(NumVertices);
+	for (size_t i = 0; i < NumVertices; ++i)
+	{
+		Positions[i] =
+		{
+			(Vertices[i].Position.x - Min.x) * InverseExtent,
+			(Vertices[i].Position.y - Min.y) * InverseExtent,
+			(Vertices[i].Position.z - Min.z) * InverseExtent
+		};
+	}
+
+	// Vertices that share a position are wedges of one corner, the topology and the quadrics are built per position so
+	// collapses move every wedge of a corner together and never open cracks along split normals or texture coordinates
+	std::vector<uint32_t> PositionRemap(NumVertices);
+	{
+		std::unordered_map<float3, uint32_t, PositionHash, PositionEqual> FirstVertex;
+		FirstVertex.reserve(NumVertices);
+		for (uint32_t i = 0; i < NumVertices; ++i)
+		{
+			PositionRemap[i] = FirstVertex.try_emplace(Vertices[i].Position, i).first->second;
+		}
+	}
+
+	// Wedges of every position, indexed by the first vertex at the position
+	std::vector<uint32_t> WedgeOffsets(NumVertices + 1, 0);
+	std::vector<uint32_t> Wedges(NumVertices);
+	{
+		for (uint32_t i = 0; i < NumVertices; ++i)
+		{
+			WedgeOffsets[PositionRemap[i] + 1]++;
+		}
+		std::partial_sum(WedgeOffsets.begin(), WedgeOffsets.end(), WedgeOffsets.begin());
+
+		std::vector<uint32_t> Cursor(WedgeOffsets.begin(), WedgeOffsets.end() - 1);
+		for (uint32_t i = 0; i < NumVertices; ++i)
+		{
+			Wedges[Cursor[PositionRemap[i]]++] = i;
+		}
+	}
+
+	const auto SameAttributes = [&](uint32_t a, uint32_t b)
+	{
+		return a == b ||
+			(Vertices[a].Texture.x == Vertices[b].Texture.x && Vertices[a].Texture.y == Vertices[b].Texture.y &&
+			Dot(Vertices[a].Normal, Vertices[b].Normal) >= MinimumSmoothCosine);
+	};
+
+	// Positions on open borders and on edges whose attributes differ across the edge are locked, corners that are only
+	// split by smooth normals stay free
+	std::vector<bool> Locked(NumVertices, false);
+	{
+		const auto Key = [&](uint32_t a, uint32_t b)
+		{
+			return (uint64_t(PositionRemap[a]) << 32) | PositionRemap[b];
+		};
+
+		std::unordered_map<uint64_t, std::pair<uint32_t, uint32_t>> HalfEdges;
+		HalfEdges.reserve(Result.size());
+		for (size_t i = 0; i < Result.size(); i += 3)
+		{
+			for (size_t e = 0; e < 3; ++e)
+			{
+				const uint32_t a = Result[i + e];
+				const uint32_t b = Result[i + (e + 1) % 3];
+				HalfEdges.try_emplace(Key(a, b), a, b);
+			}
+		}
+
+		for (size_t i = 0; i < Result.size(); i += 3)
+		{
+			for (size_t e = 0; e < 3; ++e)
+			{
+				const uint32_t a = Result[i + e];
+				const uint32_t b = Result[i + (e + 1) % 3];
+				const auto Opposite = HalfEdges.find(Key(b, a));
+				if (Opposite == HalfEdges.end() ||
+					!SameAttributes(a, Opposite->second.second) ||
+					!SameAttributes(b, Opposite->second.first))
+				{
+					Locked[PositionRemap[a]] = true;
+					Locked[PositionRemap[b]] = true;
+				}
+			}
+		}
+	}
+
+	std::vector<Quadric> Quadrics(NumVertices, Quadric{});
+	for (size_t i = 0; i < Result.size(); i += 3)
+	{
+		const float3& p0 = Positions[Result[i + 0]];
+		const float3& p1 = Positions[Result[i + 1]];
+		const float3& p2 = Positions[Result[i + 2]];
+
+		float3 n = TriangleNormal(p0, p1, p2);
+		const float Length = std::sqrt(Dot(n, n));
+		if (Length == 0.0f)
+		{
+			continue;
+		}
+		n = { n.x / Length, n.y / Length, n.z / Length };
+
+		// Weighted by area so small triangles don't dominate
+		const float Area = 0.5f * Length;
+		const float d = -Dot(n, p0);
+		for (size_t k = 0; k < 3; ++k)
+		{
+			Quadrics[PositionRemap[Result[i + k]]].AddPlane(n, d, Area);
+		}
+	}
+
+	const auto AttributeDistance = [&](uint32_t Source, uint32_t Target)
+	{
+		const auto& a = Vertices[Source];
+		const auto& b = Vertices[Target];
+		const float dn = (a.Normal.x - b.Normal.x) * (a.Normal.x - b.Normal.x) + (a.Normal.y - b.Normal.y) * (a.Normal.y - b.Normal.y) + (a.Normal.z - b.Normal.z) * (a.Normal.z - b.Normal.z);
+		const float dt = (a.Texture.x - b.Texture.x) * (a.Texture.x - b.Texture.x) + (a.Texture.y - b.Texture.y) * (a.Texture.y - b.Texture.y);
+		return NormalWeight * dn + TextureWeight * dt;
+	};
+
+	// The wedge of the target position that a wedge of the source position is replaced with
+	const auto SelectWedge = [&](uint32_t Source, uint32_t TargetPosition)
+	{
+		uint32_t Best = TargetPosition;
+		float BestDistance = FLT_MAX;
+		for (uint32_t w = WedgeOffsets[TargetPosition]; w < WedgeOffsets[TargetPosition + 1]; ++w)
+		{
+			const float Distance = AttributeDistance(Source, Wedges[w]);
+			if (Distance < BestDistance)
+			{
+				BestDistance = Distance;
+				Best = Wedges[w];
+			}
+		}
+		return Best;
+	};
+
+	// Collapses are between positions, Source and Target are the wedges of the edge the collapse was found on
+	const auto MakeCollapse = [&](uint32_t Source, uint32_t Target)
+	{
+		const float Error = Quadrics[PositionRemap[Source]].Error(Positions[Target]);
+		return Collapse{ PositionRemap[Source], PositionRemap[Target], Error + AttributeDistance(Source, Target), Error };
+	};
+
+	const float TargetCost = TargetError < FLT_MAX ? TargetError * TargetError : FLT_MAX;
+
+	std::vector<uint32_t> TriangleOffsets(NumVertices + 1);
+	std::vector<uint32_t> PositionTriangles;
+	std::vector<Collapse> Collapses;
+	std::vector<bool> Touched(NumVertices);
+	std::vector<uint32_t> Remap(NumVertices);
+
+	while (Result.size() > TargetIndexCount)
+	{
+		// Position to triangle adjacency of the current triangle list
+		std::fill(TriangleOffsets.begin(), TriangleOffsets.end(), 0);
+		for (uint32_t Index : Result)
+		{
+			TriangleOffsets[PositionRemap[Index] + 1]++;
+		}
+		std::partial_sum(TriangleOffsets.begin(), TriangleOffsets.end(), TriangleOffsets.begin());
+		PositionTriangles.resize(Result.size());
+		{
+			std::vector<uint32_t> Cursor(TriangleOffsets.begin(), TriangleOffsets.end() - 1);
+			for (size_t i = 0; i < Result.size(); ++i)
+			{
+				PositionTriangles[Cursor[PositionRemap[Result[i]]]++] = static_cast<uint32_t>(i / 3);
+			}
+		}
+
+		Collapses.clear();
+		for (size_t i = 0; i < Result.size(); i += 3)
+		{
+			for (size_t e = 0; e < 3; ++e)
+			{
+				const uint32_t a = Result[i + e];
+				const uint32_t b = Result[i + (e + 1) % 3];
+				if (!Locked[PositionRemap[a]])
+				{
+					Collapses.push_back(MakeCollapse(a, b));
+				}
+				if (!Locked[PositionRemap[b]])
+				{
+					Collapses.push_back(MakeCollapse(b, a));
+				}
+			}
+		}
+
+		std::sort(Collapses.begin(), Collapses.end(), [](const Collapse& x, const Collapse& y)
+		{
+			return x.Cost < y.Cost;
+		});
+
+		std::fill(Touched.begin(), Touched.end(), false);
+		std::iota(Remap.begin(), Remap.end(), 0);
+
+		// Every collapse of an interior edge removes 2 triangles
+		const size_t NumTrianglesToRemove = (Result.size() - TargetIndexCount) / 3;
+		size_t NumTrianglesRemoved = 0;
+		size_t NumCollapses = 0;
+
+		for (const auto& Collapse : Collapses)
+		{
+			if (Collapse.Error > TargetCost || Touched[Collapse.Source] || Touched[Collapse.Target])
+			{
+				continue;
+			}
+
+			// Reject collapses that flip or badly distort a remaining triangle
+			bool Valid = true;
+			size_t NumDegenerate = 0;
+			for (uint32_t t = TriangleOffsets[Collapse.Source]; t < TriangleOffsets[Collapse.Source + 1] && Valid; ++t)
+			{
+				const uint32_t* pTriangle = &Result[size_t(PositionTriangles[t]) * 3];
+				if (PositionRemap[pTriangle[0]] == Collapse.Target || PositionRemap[pTriangle[1]] == Collapse.Target || PositionRemap[pTriangle[2]] == Collapse.Target)
+				{
+					NumDegenerate++;
+					continue;
+				}
+
+				float3 p[3], q[3];
+				for (size_t k = 0; k < 3; ++k)
+				{
+					p[k] = Positions[pTriangle[k]];
+					q[k] = PositionRemap[pTriangle[k]] == Collapse.Source ? Positions[Collapse.Target] : p[k];
+				}
+
+				const float3 n0 = TriangleNormal(p[0], p[1], p[2]);
+				const float3 n1 = TriangleNormal(q[0], q[1], q[2]);
+				const float l = std::sqrt(Dot(n0, n0) * Dot(n1, n1));
+				Valid = l > 0.0f && Dot(n0, n1) >= MinimumFlipCosine * l;
+			}
+
+			if (!Valid)
+			{
+				continue;
+			}
+
+			// Lock the whole neighborhood for the rest of the pass, the flip test above assumes it doesn't change
+			for (uint32_t t = TriangleOffsets[Collapse.Source]; t < TriangleOffsets[Collapse.Source + 1]; ++t)
+			{
+				const uint32_t* pTriangle = &Result[size_t(PositionTriangles[t]) * 3];
+				Touched[PositionRemap[pTriangle[0]]] = Touched[PositionRemap[pTriangle[1]]] = Touched[PositionRemap[pTriangle[2]]] = true;
+			}
+
+			for (uint32_t w = WedgeOffsets[Collapse.Source]; w < WedgeOffsets[Collapse.Source + 1]; ++w)
+			{
+				Remap[Wedges[w]] = SelectWedge(Wedges[w], Collapse.Target);
+			}
+			Quadrics[Collapse.Target] += Quadrics[Collapse.Source];
+			ResultError = std::max(ResultError, Collapse.Error);
+
+			NumCollapses++;
+			NumTrianglesRemoved += NumDegenerate;
+			if (NumTrianglesRemoved >= NumTrianglesToRemove)
+			{
+				break;
+			}
+		}
+
+		if (NumCollapses == 0)
+		{
+			break;
+		}
+
+		// Apply the collapses and drop the triangles that became degenerate, wedges of one position count as one vertex
+		size_t NumIndices = 0;
+		for (size_t i = 0; i < Result.size(); i += 3)
+		{
+			const uint32_t a = Remap[Result[i + 0]];
+			const uint32_t b = Remap[Result[i + 1]];
+			const uint32_t c = Remap[Result[i + 2]];
+			const uint32_t pa = PositionRemap[a], pb = PositionRemap[b], pc = PositionRemap[c];
+			if (pa != pb && pb != pc && pc != pa)
+			{
+				Result[NumIndices++] = a;
+				Result[NumIndices++] = b;
+				Result[NumIndices++] = c;
+			}
+		}
+		Result.resize(NumIndices);
+	}
+
+	if (pResultError)
+	{
+		*pResultError = std::sqrt(ResultError);
+	}
+	return Result;
+}
+
+void GenerateLODs(Asset::Mesh& Mesh)
+{
+	assert(Mesh.GetVertexFormat() == VertexFormat::Full);
+
+	Mesh.LODs.clear();
+	for (auto& Submesh : Mesh.Submeshes)
+	{
+		Submesh.FirstLOD = static_cast<uint32_t>(Mesh.LODs.size());
+		Submesh.NumLODs = 0;
+
+		const auto Vertices = std::span(Mesh.Vertices).subspan(Submesh.BaseVertexLocation, Submesh.VertexCount);
+		const float Scale = 2.0f * std::max({ Submesh.BoundingBox.Extents.x, Submesh.BoundingBox.Extents.y, Submesh.BoundingBox.Extents.z });
+
+		uint32_t PreviousIndexCount = Submesh.IndexCount;
+		float PreviousError = 0.0f;
+		for (float Ratio : LODTriangleRatios)
+		{
+			// Always simplify the full resolution submesh so errors don't accumulate between levels,
+			// the indices are copied since Mesh.Indices grows below
+			const std::vector<uint32_t> Source(
+				Mesh.Indices.begin() + Submesh.StartIndexLocation,
+				Mesh.Indices.begin() + Submesh.StartIndexLocation + Submesh.IndexCount);
+
+			const size_t TargetIndexCount = static_cast<size_t>(Submesh.IndexCount / 3 * Ratio) * 3;
+
+			float Error = 0.0f;
+			auto Indices = SimplifyMesh(Source, Vertices, TargetIndexCount, FLT_MAX, &Error);
+
+			// Stop once the simplifier is stuck on locked vertices
+			if (Indices.empty() || Indices.size() * 10 > size_t(PreviousIndexCount) * 9)
+			{
+				break;
+			}
+
+			OptimizeVertexCache(Indices, Vertices.size());
+
+			// Errors grow with every level
+			PreviousError = std::max(PreviousError, Error * Scale);
+
+			Mesh.LODs.push_back(
+			{
+				.IndexCount = static_cast<uint32_t>(Indices.size()),
+				.StartIndexLocation = static_cast<uint32_t>(Mesh.Indices.size()),
+				.IndexByteOffset = 0,
+				.Error = PreviousError
+			});
+			Mesh.Indices.insert(Mesh.Indices.end(), Indices.begin(), Indices.end());
+
+			Submesh.NumLODs++;
+			PreviousIndexCount = static_cast<uint32_t>(Indices.size());
+		}
+	}
+}
@@ -0,0 +1,24 @@
+#pragma once
+#include <span>
+
+#include "Mesh.h"
+
+/*
+* Quadric error metric simplification, see "Surface Simplification Using Quadric Error Metrics" by Garland and Heckbert.
+* Edges are collapsed onto one of their existing vertices, so every LOD is just another index range into the vertex
+* range of its submesh. The cost of a collapse also accounts for the normal and texture coordinate the collapsed
+* vertex loses. Vertices that share a position collapse together, so split normals never open cracks. Positions on open
+* borders and on edges whose texture coordinates or hard normals differ across the edge are locked so silhouettes and UV
+* charts stay intact.
+*/
+
+// Triangle count of every generated LOD relative to its submesh
+inline constexpr float LODTriangleRatios[] = { 0.5f, 0.25f, 0.125f, 0.0625f };
+
+// Simplifies the triangle list until it has at most TargetIndexCount indices or the next collapse would exceed TargetError.
+// Errors are relative to the largest dimension of the bounds of Vertices, pResultError receives the error of the result
+std::vector<uint32_t> SimplifyMesh(std::span<const uint32_t> Indices, std::span<const Vertex> Vertices, size_t TargetIndexCount, float TargetError, float* pResultError);
+
+// Appends the LODs of every submesh to Mesh.Indices and Mesh.LODs, Mesh.Vertices and the submesh bounds must be populated.
+// LODs that fail to reduce the triangle count any further are dropped
+void GenerateLODs(Asset::Mesh& Mesh);
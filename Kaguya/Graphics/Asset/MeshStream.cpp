@@ -0,0 +1,78 @@
+#include "pch.h"
+#include "MeshStream.h"
+
+bool MeshStream::Read(const AssetStreamReader& Reader, const Asset::MeshMetadata& Metadata, Asset::Mesh& Mesh)
+{
+	auto InfoSection = Reader.GetSection<Info>(InfoSectionId);
+	if (InfoSection.size() != 1 ||
+		InfoSection[0].QuantizeVertices != static_cast<uint32_t>(Metadata.QuantizeVertices) ||
+		InfoSection[0].GenerateLODs != static_cast<uint32_t>(Metadata.GenerateLODs) ||
+		InfoSection[0].OptimizeMesh != static_cast<uint32_t>(Metadata.OptimizeMesh))
+	{
+		return false;
+	}
+
+	if (!Reader.ReadSection(SubmeshSectionId, Mesh.Submeshes) ||
+		!Reader.ReadSection(IndexSectionId, Mesh.CompactIndices) ||
+		!Reader.ReadSection(LODSectionId, Mesh.LODs) ||
+		!Reader.ReadSection(MeshletSectionId, Mesh.Meshlets) ||
+		!Reader.ReadSection(MeshletVertexSectionId, Mesh.MeshletVertices) ||
+		!Reader.ReadSection(MeshletTriangleSectionId, Mesh.MeshletTriangles))
+	{
+		return false;
+	}
+
+	const bool ReadVertices = Metadata.QuantizeVertices ?
+		Reader.ReadSection(CompactVertexSectionId, Mesh.CompactVertices) :
+		Reader.ReadSection(VertexSectionId, Mesh.Vertices);
+
+	return ReadVertices;
+}
+
+bool MeshStream::Read(const std::filesystem::path& Path, const Asset::MeshMetadata& Metadata, Asset::Mesh& Mesh)
+{
+	AssetStreamReader Reader;
+	if (!Reader.Open(Path, Version))
+	{
+		return false;
+	}
+	return Read(Reader, Metadata, Mesh);
+}
+
+void MeshStream::Write(AssetStreamWriter& Writer, const Asset::Mesh& Mesh)
+{
+	Info Info =
+	{
+		.QuantizeVertices = static_cast<uint32_t>(Mesh.Metadata.QuantizeVertices),
+		.GenerateLODs = static_cast<uint32_t>(Mesh.Metadata.GenerateLODs),
+		.OptimizeMesh = static_cast<uint32_t>(Mesh.Metadata.OptimizeMesh)
+	};
+
+	Writer.AddSection(InfoSectionId, &Info, sizeof(Info));
+	Writer.AddSection(SubmeshSectionId, Mesh.Submeshes);
+	Writer.AddSection(IndexSectionId, Mesh.CompactIndices);
+	Writer.AddSection(LODSectionId, Mesh.LODs);
+	Writer.AddSection(MeshletSectionId, Mesh.Meshlets);
+	Writer.AddSection(MeshletVertexSectionId, Mesh.MeshletVertices);
+	Writer.AddSection(MeshletTriangleSectionId, Mesh.MeshletTriangles);
+	if (Mesh.GetVertexFormat() == VertexFormat::Compact)
+	{
+		Writer.AddSection(CompactVertexSectionId, Mesh.CompactVertices);
+	}
+	else
+	{
+		Writer.AddSection(VertexSectionId, Mesh.Vertices);
+	}
+}
+
+bool MeshStream::Write(const std::filesystem::path& Path, const Asset::Mesh& Mesh)
+{
+	AssetStreamWriter Writer(Version);
+	Write(Writer, Mesh);
+	return Writer.Write(Path);
+}
+
+std::filesystem::path MeshStream::GetCookedPath(const std::filesystem::path& Path)
+{
+	return GetCookedAssetPath(Path, "Meshes", ".mesh");
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include "Mesh.h"
+#include "AssetStream.h"
+
+/*
+* Reads and writes cooked meshes, the cooked mesh is an AssetStream holding the geometry
+* exactly as it is laid out in Asset::Mesh so it can be copied out without any processing.
+*/
+class MeshStream
+{
+public:
+	// 2: Geometry is optimized for vertex cache and fetch locality
+	// 3: Indices are packed with a per submesh index format
+	// 4: LODs
+	// 5: Meshlets
+	// 6: LOD indices are packed after the indices of every submesh
+	// 7: OptimizeMesh import option
+	static constexpr uint32_t Version = 7;
+
+	static constexpr uint32_t InfoSectionId = MAKEFOURCC('I', 'N', 'F', 'O');
+	static constexpr uint32_t SubmeshSectionId = MAKEFOURCC('S', 'U', 'B', 'M');
+	static constexpr uint32_t VertexSectionId = MAKEFOURCC('V', 'E', 'R', 'T');
+	static constexpr uint32_t CompactVertexSectionId = MAKEFOURCC('C', 'V', 'R', 'T');
+	static constexpr uint32_t IndexSectionId = MAKEFOURCC('I', 'N', 'D', 'X');
+	static constexpr uint32_t LODSectionId = MAKEFOURCC('L', 'O', 'D', 'S');
+	static constexpr uint32_t MeshletSectionId = MAKEFOURCC('M', 'S', 'H', 'L');
+	static constexpr uint32_t MeshletVertexSectionId = MAKEFOURCC('M', 'S', 'H', 'V');
+	static constexpr uint32_t MeshletTriangleSectionId = MAKEFOURCC('M', 'S', 'H', 'T');
+
+	// Import options that affect the cooked data, a cooked mesh is discarded if they don't match
+	struct Info
+	{
+		uint32_t QuantizeVertices;
+		uint32_t GenerateLODs;
+		uint32_t OptimizeMesh;
+	};
+
+	static bool Read(const AssetStreamReader& Reader, const Asset::MeshMetadata& Metadata, Asset::Mesh& Mesh);
+	static bool Read(const std::filesystem::path& Path, const Asset::MeshMetadata& Metadata, Asset::Mesh& Mesh);
+
+	static void Write(AssetStreamWriter& Writer, const Asset::Mesh& Mesh);
+	static bool Write(const std::filesystem::path& Path, const Asset::Mesh& Mesh);
+
+	// Returns the path of the cooked mesh for the source mesh
+	static std::filesystem::path GetCookedPath(const std::filesystem::path& Path);
+};
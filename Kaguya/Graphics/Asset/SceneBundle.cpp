@@ -0,0 +1,83 @@
+#include "pch.h"
+#include "SceneBundle.h"
+
+bool SceneBundle::Open(const std::filesystem::path& Path)
+{
+	if (!Reader.Open(Path, Version) ||
+		!Reader.HasSection(SceneSectionId))
+	{
+		return false;
+	}
+
+	Entries = Reader.GetSection<Entry>(TableOfContentsSectionId);
+	auto Paths = Reader.GetSection<char>(PathSectionId);
+
+	Lookup.clear();
+	Lookup.reserve(Entries.size());
+	for (uint32_t i = 0; i < Entries.size(); ++i)
+	{
+		const Entry& Entry = Entries[i];
+		if (size_t(Entry.PathOffset) + Entry.PathLength > Paths.size() ||
+			Entry.SectionIndex >= Reader.GetNumSections())
+		{
+			return false;
+		}
+
+		// Scenes resolve asset paths against the executable folder before loading them, see SceneParser
+		const std::string_view RelativePath(Paths.data() + Entry.PathOffset, Entry.PathLength);
+		const auto AbsolutePath = (Application::ExecutableFolderPath / RelativePath).string();
+		Lookup[entt::hashed_string(AbsolutePath.data())] = i;
+	}
+
+	return true;
+}
+
+std::string_view SceneBundle::GetScene() const
+{
+	auto Scene = Reader.GetSection<char>(SceneSectionId);
+	return { Scene.data(), Scene.size() };
+}
+
+std::span<const BYTE> SceneBundle::Find(AssetType Type, const std::filesystem::path& Path) const
+{
+	auto iter = Lookup.find(entt::hashed_string(Path.string().data()));
+	if (iter == Lookup.end() || Entries[iter->second].Type != Type)
+	{
+		return {};
+	}
+	return Reader.GetSectionAt(Entries[iter->second].SectionIndex);
+}
+
+SceneBundleWriter::SceneBundleWriter()
+	: Writer(SceneBundle::Version, SceneBundle::SectionAlignment)
+{
+
+}
+
+void SceneBundleWriter::SetScene(std::string_view Scene)
+{
+	this->Scene = Scene;
+}
+
+void SceneBundleWriter::AddAsset(SceneBundle::AssetType Type, const std::filesystem::path& Path, std::vector<BYTE>&& Data)
+{
+	const auto RelativePath = std::filesystem::relative(Path, Application::ExecutableFolderPath).string();
+
+	SceneBundle::Entry Entry =
+	{
+		.Type = Type,
+		.SectionIndex = Writer.AddSection(SceneBundle::AssetSectionId, std::move(Data)),
+		.PathOffset = static_cast<uint32_t>(Paths.size()),
+		.PathLength = static_cast<uint32_t>(RelativePath.size())
+	};
+	Entries.push_back(Entry);
+	Paths += RelativePath;
+}
+
+bool SceneBundleWriter::Write(const std::filesystem::path& Path)
+{
+	Writer.AddSection(SceneBundle::SceneSectionId, Scene.data(), Scene.size());
+	Writer.AddSection(SceneBundle::TableOfContentsSectionId, Entries);
+	Writer.AddSection(SceneBundle::PathSectionId, Paths.data(), Paths.size());
+	return Writer.Write(Path);
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include <filesystem>
+#include <span>
+#include <string_view>
+#include <unordered_map>
+
+#include "AssetStream.h"
+
+/*
+* Single file holding a baked scene: the scene description, every cooked mesh (with its CPU BVH) and every cooked
+* image. A bundle is an AssetStream whose sections are page aligned, opening it is a single memory map and an asset
+* is only paged in when it is read. Assets are looked up by the path the scene refers to them with, a bundle is a
+* snapshot of the cooked assets and is not invalidated when the source assets change.
+*/
+class SceneBundle
+{
+public:
+	static constexpr uint32_t Version = 1;
+	static constexpr uint64_t SectionAlignment = 4_KiB;
+	static constexpr std::string_view Extension = ".bundle";
+
+	static constexpr uint32_t SceneSectionId = MAKEFOURCC('S', 'C', 'N', 'E'); // Scene description, see SceneParser
+	static constexpr uint32_t TableOfContentsSectionId = MAKEFOURCC('T', 'O', 'C', ' ');
+	static constexpr uint32_t PathSectionId = MAKEFOURCC('P', 'A', 'T', 'H');
+	static constexpr uint32_t AssetSectionId = MAKEFOURCC('A', 'S', 'E', 'T'); // One section per asset
+
+	enum class AssetType : uint32_t
+	{
+		Mesh, // MeshStream followed by the BVH sections, see CPU::BVH::Write
+		Image // Cooked DDS file
+	};
+
+	struct Entry
+	{
+		AssetType Type;
+		uint32_t SectionIndex;
+		uint32_t PathOffset; // Into the path section, relative to Application::ExecutableFolderPath
+		uint32_t PathLength;
+	};
+
+	bool Open(const std::filesystem::path& Path);
+
+	[[nodiscard]] std::string_view GetScene() const;
+
+	[[nodiscard]] size_t GetNumAssets() const { return Lookup.size(); }
+
+	// Returns the cooked asset, empty if the bundle does not contain it
+	[[nodiscard]] std::span<const BYTE> Find(AssetType Type, const std::filesystem::path& Path) const;
+private:
+	AssetStreamReader Reader;
+	std::span<const Entry> Entries;
+	std::unordered_map<entt::id_type, uint32_t> Lookup; // Hashed absolute path to entry
+};
+
+class SceneBundleWriter
+{
+public:
+	SceneBundleWriter();
+
+	void SetScene(std::string_view Scene);
+
+	// Path is absolute, it is stored relative to Application::ExecutableFolderPath the same way scenes store it
+	void AddAsset(SceneBundle::AssetType Type, const std::filesystem::path& Path, std::vector<BYTE>&& Data);
+
+	bool Write(const std::filesystem::path& Path);
+private:
+	AssetStreamWriter Writer;
+	std::vector<SceneBundle::Entry> Entries;
+	std::string Paths;
+	std::string Scene;
+};
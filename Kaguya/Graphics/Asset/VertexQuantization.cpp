@@ -0,0 +1,172 @@
+#include "pch.h"
+#include "VertexQuantization.h"
+
+#include <DirectXPackedVector.h>
+
+using namespace DirectX;
+using namespace DirectX::PackedVector;
+
+// Avoids division by zero when quantizing flat submeshes
+static constexpr float MinimumExtent = 1e-6f;
+
+int16_t EncodeSnorm16(float Value)
+{
+	return static_cast<int16_t>(std::round(std::clamp(Value, -1.0f, 1.0f) * 32767.0f));
+}
+
+float DecodeSnorm16(int16_t Value)
+{
+	return std::max(static_cast<float>(Value) / 32767.0f, -1.0f);
+}
+
+void EncodeOctahedral(const float3& Normal, int16_t Encoded[2])
+{
+	float l1 = std::abs(Normal.x) + std::abs(Normal.y) + std::abs(Normal.z);
+	if (!(l1 > 0.0f) || !std::isfinite(l1))
+	{
+		// Degenerate normals (zero length, NaN or infinite components) encode +Z
+		Encoded[0] = 0;
+		Encoded[1] = 0;
+		return;
+	}
+
+	float x = Normal.x / l1;
+	float y = Normal.y / l1;
+	if (Normal.z < 0.0f)
+	{
+		// Fold the lower hemisphere over the diagonals
+		float ox = (1.0f - std::abs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+		float oy = (1.0f - std::abs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+		x = ox;
+		y = oy;
+	}
+	Encoded[0] = EncodeSnorm16(x);
+	Encoded[1] = EncodeSnorm16(y);
+}
+
+float3 DecodeOctahedral(const int16_t Encoded[2])
+{
+	float x = DecodeSnorm16(Encoded[0]);
+	float y = DecodeSnorm16(Encoded[1]);
+	float z = 1.0f - std::abs(x) - std::abs(y);
+	float t = std::max(-z, 0.0f);
+	x += x >= 0.0f ? -t : t;
+	y += y >= 0.0f ? -t : t;
+
+	float3 Normal;
+	XMStoreFloat3(&Normal, XMVector3Normalize(XMVectorSet(x, y, z, 0.0f)));
+	return Normal;
+}
+
+CompactVertex EncodeVertex(const Vertex& Vertex, const BoundingBox& Bounds)
+{
+	CompactVertex Compact = {};
+	Compact.Position[0] = EncodeSnorm16((Vertex.Position.x - Bounds.Center.x) / std::max(Bounds.Extents.x, MinimumExtent));
+	Compact.Position[1] = EncodeSnorm16((Vertex.Position.y - Bounds.Center.y) / std::max(Bounds.Extents.y, MinimumExtent));
+	Compact.Position[2] = EncodeSnorm16((Vertex.Position.z - Bounds.Center.z) / std::max(Bounds.Extents.z, MinimumExtent));
+	Compact.Position[3] = 0;
+	Compact.Texture[0] = XMConvertFloatToHalf(Vertex.Texture.x);
+	Compact.Texture[1] = XMConvertFloatToHalf(Vertex.Texture.y);
+	EncodeOctahedral(Vertex.Normal, Compact.Normal);
+	return Compact;
+}
+
+Vertex DecodeVertex(const CompactVertex& Compact, const BoundingBox& Bounds)
+{
+	Vertex Vertex = {};
+	Vertex.Position.x = DecodeSnorm16(Compact.Position[0]) * std::max(Bounds.Extents.x, MinimumExtent) + Bounds.Center.x;
+	Vertex.Position.y = DecodeSnorm16(Compact.Position[1]) * std::max(Bounds.Extents.y, MinimumExtent) + Bounds.Center.y;
+	Vertex.Position.z = DecodeSnorm16(Compact.Position[2]) * std::max(Bounds.Extents.z, MinimumExtent) + Bounds.Center.z;
+	Vertex.Texture.x = XMConvertHalfToFloat(Compact.Texture[0]);
+	Vertex.Texture.y = XMConvertHalfToFloat(Compact.Texture[1]);
+	Vertex.Normal = DecodeOctahedral(Compact.Normal);
+	return Vertex;
+}
+
+XMFLOAT3X4 GetDequantizationTransform(const BoundingBox& Bounds)
+{
+	return XMFLOAT3X4(
+		std::max(Bounds.Extents.x, MinimumExtent), 0.0f, 0.0f, Bounds.Center.x,
+		0.0f, std::max(Bounds.Extents.y, MinimumExtent), 0.0f, Bounds.Center.y,
+		0.0f, 0.0f, std::max(Bounds.Extents.z, MinimumExtent), Bounds.Center.z);
+}
+
+void ComputeSubmeshBounds(Asset::Mesh& Mesh)
+{
+	for (auto& Submesh : Mesh.Submeshes)
+	{
+		if (Submesh.VertexCount == 0)
+		{
+			Submesh.BoundingBox = {};
+			continue;
+		}
+
+		BoundingBox::CreateFromPoints(Submesh.BoundingBox,
+			Submesh.VertexCount,
+			&Mesh.Vertices[Submesh.BaseVertexLocation].Position,
+			sizeof(Vertex));
+	}
+}
+
+VertexQuantizationError QuantizeVertices(Asset::Mesh& Mesh)
+{
+	VertexQuantizationError Error = {};
+	double SumSquaredPositionError = 0.0;
+
+	Mesh.CompactVertices.resize(Mesh.Vertices.size());
+	for (const auto& Submesh : Mesh.Submeshes)
+	{
+		for (uint32_t i = Submesh.BaseVertexLocation; i < Submesh.BaseVertexLocation + Submesh.VertexCount; ++i)
+		{
+			const Vertex& Source = Mesh.Vertices[i];
+			Mesh.CompactVertices[i] = EncodeVertex(Source, Submesh.BoundingBox);
+
+			const Vertex Decoded = DecodeVertex(Mesh.CompactVertices[i], Submesh.BoundingBox);
+
+			XMVECTOR PositionError = XMVector3Length(XMLoadFloat3(&Decoded.Position) - XMLoadFloat3(&Source.Position));
+			XMVECTOR TextureError = XMVectorAbs(XMLoadFloat2(&Decoded.Texture) - XMLoadFloat2(&Source.Texture));
+
+			float PositionErrorLength = XMVectorGetX(PositionError);
+			SumSquaredPositionError += double(PositionErrorLength) * PositionErrorLength;
+
+			Error.MaxPositionError = std::max(Error.MaxPositionError, PositionErrorLength);
+			Error.MaxTextureError = std::max({ Error.MaxTextureError, XMVectorGetX(TextureError), XMVectorGetY(TextureError) });
+
+			// Degenerate source normals have no direction to preserve, see EncodeOctahedral
+			float SourceNormalLength = XMVectorGetX(XMVector3Length(XMLoadFloat3(&Source.Normal)));
+			if (SourceNormalLength > 0.0f && std::isfinite(SourceNormalLength))
+			{
+				XMVECTOR NormalError = XMVector3AngleBetweenNormals(XMLoadFloat3(&Decoded.Normal), XMVector3Normalize(XMLoadFloat3(&Source.Normal)));
+				Error.MaxNormalError = std::max(Error.MaxNormalError, XMConvertToDegrees(XMVectorGetX(NormalError)));
+			}
+		}
+	}
+
+	if (!Mesh.Vertices.empty())
+	{
+		Error.RMSPositionError = static_cast<float>(std::sqrt(SumSquaredPositionError / Mesh.Vertices.size()));
+	}
+
+	Mesh.Vertices.clear();
+	Mesh.Vertices.shrink_to_fit();
+
+	return Error;
+}
+
+std::vector<Vertex> DecodeVertices(const Asset::Mesh& Mesh)
+{
+	if (Mesh.GetVertexFormat() == VertexFormat::Full)
+	{
+		return Mesh.Vertices;
+	}
+
+	std::vector<Vertex> Vertices(Mesh.CompactVertices.size());
+	for (const auto& Submesh : Mesh.Submeshes)
+	{
+		for (uint32_t i = Submesh.BaseVertexLocation; i < Submesh.BaseVertexLocation + Submesh.VertexCount; ++i)
+		{
+			Vertices[i] = DecodeVertex(Mesh.CompactVertices[i], Submesh.BoundingBox);
+		}
+	}
+	return Vertices;
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include "Mesh.h"
+
+// Error introduced by quantizing a mesh, measured against the source vertices
+struct VertexQuantizationError
+{
+	float MaxPositionError;	// Object space units
+	float RMSPositionError;	// Object space units
+	float MaxTextureError;	// Texture coordinate units
+	float MaxNormalError;	// Degrees
+};
+
+int16_t EncodeSnorm16(float Value);
+float DecodeSnorm16(int16_t Value);
+
+// Octahedral normal encoding, see "A Survey of Efficient Representations for Independent Unit Vectors"
+void EncodeOctahedral(const float3& Normal, int16_t Encoded[2]);
+float3 DecodeOctahedral(const int16_t Encoded[2]);
+
+CompactVertex EncodeVertex(const Vertex& Vertex, const DirectX::BoundingBox& Bounds);
+Vertex DecodeVertex(const CompactVertex& Vertex, const DirectX::BoundingBox& Bounds);
+
+// Row major 3x4 transform that takes a SNORM16 position back into object space,
+// this is the layout expected by D3D12_RAYTRACING_GEOMETRY_TRIANGLES_DESC::Transform3x4
+DirectX::XMFLOAT3X4 GetDequantizationTransform(const DirectX::BoundingBox& Bounds);
+
+// Computes Submesh::BoundingBox from the full precision vertices
+void ComputeSubmeshBounds(Asset::Mesh& Mesh);
+
+// Converts Mesh.Vertices into Mesh.CompactVertices, Mesh.Vertices is released
+VertexQuantizationError QuantizeVertices(Asset::Mesh& Mesh);
+
+// Returns the vertices of the mesh at full precision regardless of the vertex format
+std::vector<Vertex> DecodeVertices(const Asset::Mesh& Mesh);
@@ -3,6 +3,9 @@
 
 #include <ResourceUploadBatch.h>
 
+#include "Asset/IndexPacking.h"
+#include "Asset/VertexQuantization.h"
+
 using namespace DirectX;
 using Microsoft::WRL::ComPtr;
 
@@ -31,6 +34,7 @@ AssetManager& AssetManager::Instance()
 }
 
 AssetManager::AssetManager()
+	: FileWatcher(FileWatcher::Backend::Native, [this](const std::filesystem::path& Path) { Reload(Path); })
 {
 	CreateSystemTextures();
 
@@ -39,15 +43,29 @@ AssetManager::AssetManager()
 
 AssetManager::~AssetManager()
 {
-	ShutdownThread = true;
+	{
+		// Set under the lock so the upload thread cannot miss the wake between checking and sleeping
+		ScopedCriticalSection SCS(UploadCriticalSection);
+		ShutdownThread = true;
+	}
 	UploadConditionVariable.WakeAll();
 
 	::WaitForSingleObject(Thread.get(), INFINITE);
 }
 
+void AssetManager::Mount(std::shared_ptr<SceneBundle> Bundle)
+{
+	if (Bundle)
+	{
+		LOG_INFO("Mounted scene bundle with {} assets", Bundle->GetNumAssets());
+	}
+	this->Bundle = std::move(Bundle);
+}
+
 void AssetManager::AsyncLoadImage(const std::filesystem::path& Path, bool sRGB)
 {
-	if (!std::filesystem::exists(Path))
+	auto bundle = Bundle && !Bundle->Find(SceneBundle::AssetType::Image, Path).empty() ? Bundle : nullptr;
+	if (!bundle && !std::filesystem::exists(Path))
 	{
 		return;
 	}
@@ -59,23 +77,41 @@ void AssetManager::AsyncLoadImage(const std::filesystem::path& Path, bool sRGB)
 		return;
 	}
 
-	Asset::ImageMetadata metadata =
-	{
-		.Path = Path,
-		.sRGB = sRGB
-	};
-	AsyncImageLoader.RequestAsyncLoad(1, &metadata,
-		[&](auto pImage)
+	RequestImageLoad(
+		{
+			.Path = Path,
+			.sRGB = sRGB,
+			.Bundle = std::move(bundle)
+		});
+}
+
+void AssetManager::AsyncLoadMesh(const std::filesystem::path& Path, bool KeepGeometryInRAM, bool QuantizeVertices, bool GenerateLODs, bool OptimizeMesh)
+{
+	auto bundle = Bundle && !Bundle->Find(SceneBundle::AssetType::Mesh, Path).empty() ? Bundle : nullptr;
+	if (!bundle && !std::filesystem::exists(Path))
 	{
-		ScopedCriticalSection SCS(UploadCriticalSection);
+		return;
+	}
 
-		ImageUploadQueue.Enqueue(std::move(pImage));
+	entt::id_type hs = entt::hashed_string(Path.string().data());
+	if (MeshCache.Exist(hs))
+	{
+		LOG_INFO("{} Exists", Path.string());
+		return;
+	}
 
-		UploadConditionVariable.Wake();
-	});
+	RequestMeshLoad(
+		{
+			.Path = Path,
+			.KeepGeometryInRAM = KeepGeometryInRAM,
+			.QuantizeVertices = QuantizeVertices,
+			.GenerateLODs = GenerateLODs,
+			.OptimizeMesh = OptimizeMesh,
+			.Bundle = std::move(bundle)
+		});
 }
 
-void AssetManager::AsyncLoadMesh(const std::filesystem::path& Path, bool KeepGeometryInRAM)
+void AssetManager::Reload(const std::filesystem::path& Path)
 {
 	if (!std::filesystem::exists(Path))
 	{
@@ -83,20 +119,61 @@ void AssetManager::AsyncLoadMesh(const std::filesystem::path& Path, bool KeepGeo
 	}
 
 	entt::id_type hs = entt::hashed_string(Path.string().data());
-	if (MeshCache.Exist(hs))
+	auto image = ImageCache.Load(hs);
+	auto mesh = MeshCache.Load(hs);
+	if (!image && !mesh)
 	{
-		LOG_INFO("{} Exists", Path.string());
+		// The scene the asset belonged to was unloaded
+		FileWatcher.Unwatch(Path);
 		return;
 	}
 
-	Asset::MeshMetadata metadata =
+	LOG_INFO("{} changed, reloading", Path.string());
+	if (image)
 	{
-		.Path = Path,
-		.KeepGeometryInRAM = KeepGeometryInRAM,
-	};
-	AsyncMeshLoader.RequestAsyncLoad(1, &metadata,
+		RequestImageLoad(
+			{
+				.Path = image->Metadata.Path,
+				.sRGB = image->Metadata.sRGB
+			});
+	}
+	if (mesh)
+	{
+		RequestMeshLoad(
+			{
+				.Path = mesh->Metadata.Path,
+				.KeepGeometryInRAM = mesh->Metadata.KeepGeometryInRAM,
+				.QuantizeVertices = mesh->Metadata.QuantizeVertices,
+				.GenerateLODs = mesh->Metadata.GenerateLODs,
+				.OptimizeMesh = mesh->Metadata.OptimizeMesh
+			});
+	}
+}
+
+void AssetManager::RequestImageLoad(Asset::ImageMetadata Metadata)
+{
+	++NumLoadsRequested;
+	AsyncImageLoader.RequestAsyncLoad(1, &Metadata,
+		[&](auto pImage)
+	{
+		++NumLoadsFinished;
+
+		ScopedCriticalSection SCS(UploadCriticalSection);
+
+		ImageUploadQueue.Enqueue(std::move(pImage));
+
+		UploadConditionVariable.Wake();
+	});
+}
+
+void AssetManager::RequestMeshLoad(Asset::MeshMetadata Metadata)
+{
+	++NumLoadsRequested;
+	AsyncMeshLoader.RequestAsyncLoad(1, &Metadata,
 		[&](auto pMesh)
 	{
+		++NumLoadsFinished;
+
 		ScopedCriticalSection SCS(UploadCriticalSection);
 
 		MeshUploadQueue.Enqueue(std::move(pMesh));
@@ -194,6 +271,27 @@ void AssetManager::CreateSystemTextures()
 	finish.wait();
 }
 
+// Uploads every mip held by Image, mip 0 of Image is uploaded to MostDetailedMip of the resource
+static void UploadImageMips(ResourceUploadBatch& Uploader, ID3D12Resource* pResource, const TexMetadata& Metadata, const ScratchImage& Image, UINT MostDetailedMip)
+{
+	const size_t MipLevels = Image.GetMetadata().mipLevels;
+
+	std::vector<D3D12_SUBRESOURCE_DATA> subresources(MipLevels);
+	for (size_t item = 0; item < Metadata.arraySize; ++item)
+	{
+		for (size_t mip = 0; mip < MipLevels; ++mip)
+		{
+			const DirectX::Image* pImage = Image.GetImage(mip, item, 0);
+			subresources[mip].RowPitch = pImage->rowPitch;
+			subresources[mip].SlicePitch = pImage->slicePitch;
+			subresources[mip].pData = pImage->pixels;
+		}
+
+		UINT FirstSubresource = D3D12CalcSubresource(MostDetailedMip, static_cast<UINT>(item), 0, static_cast<UINT>(Metadata.mipLevels), static_cast<UINT>(Metadata.arraySize));
+		Uploader.Upload(pResource, FirstSubresource, subresources.data(), static_cast<UINT>(subresources.size()));
+	}
+}
+
 DWORD WINAPI AssetManager::ResourceUploadThreadProc(_In_ PVOID pParameter)
 {
 	auto& RenderDevice = RenderDevice::Instance();
@@ -223,16 +321,48 @@ DWORD WINAPI AssetManager::ResourceUploadThreadProc(_In_ PVOID pParameter)
 	ThrowIfFailed(pDevice->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(mFence.ReleaseAndGetAddressOf())));
 	Event.create();
 
+	// Images that still have mips to stream in, only accessed by this thread
+	std::vector<AssetHandle<Asset::Image>> StreamingImages;
+
+	// Running totals of the uploaded index buffers, compared against 32-bit indices
+	UINT64 IndexMemory = 0;
+	UINT64 UnpackedIndexMemory = 0;
+
 	while (true)
 	{
-		ScopedCriticalSection SCS(AssetManager.UploadCriticalSection);
-		AssetManager.UploadConditionVariable.Wait(AssetManager.UploadCriticalSection, INFINITE);
+		// Images replaced by a reload or unloaded with their scene are no longer in the cache, nothing samples their
+		// resource once the scene has picked up the new version so they are not refined any further
+		std::erase_if(StreamingImages, [&](const auto& Image)
+		{
+			entt::id_type hs = entt::hashed_string(Image->Metadata.Path.string().data());
+			return AssetManager.ImageCache.Load(hs) != Image;
+		});
+
+		// The lock only guards the wait, loads are queued by the loader threads while a batch is uploaded. Don't sleep
+		// while there are images left to refine or uploads that were queued during the last batch
+		{
+			ScopedCriticalSection SCS(AssetManager.UploadCriticalSection);
+			while (!AssetManager.ShutdownThread &&
+				StreamingImages.empty() &&
+				AssetManager.ImageUploadQueue.IsEmpty() &&
+				AssetManager.MeshUploadQueue.IsEmpty())
+			{
+				AssetManager.UploadConditionVariable.Wait(AssetManager.UploadCriticalSection, INFINITE);
+			}
+		}
 
 		if (AssetManager.ShutdownThread)
 		{
 			break;
 		}
 
+		// Refine streaming images by one mip at a time, the mips are read from disk before the upload batch is started
+		std::vector<ScratchImage> Mips(StreamingImages.size());
+		for (auto [i, Image] : enumerate(StreamingImages))
+		{
+			Image->Stream->ReadMips(Image->MostDetailedMip - 1, 1, Mips[i]);
+		}
+
 		Uploader.Begin(D3D12_COMMAND_LIST_TYPE_COPY);
 		mCmdAlloc->Reset();
 		mCmdList->Reset(mCmdAlloc.Get(), nullptr);
@@ -248,7 +378,8 @@ DWORD WINAPI AssetManager::ResourceUploadThreadProc(_In_ PVOID pParameter)
 			while (AssetManager.ImageUploadQueue.Dequeue(pImage, 0))
 			{
 				const auto& Image = pImage->Image;
-				const auto& Metadata = Image.GetMetadata();
+				// Streamed images only hold the mip tail, the resource is created for the full mip chain
+				const auto& Metadata = pImage->Stream ? pImage->Stream->GetMetadata() : Image.GetMetadata();
 				DXGI_FORMAT Format = Metadata.format;
 				if (pImage->Metadata.sRGB)
 					Format = DirectX::MakeSRGB(Format);
@@ -266,7 +397,8 @@ DWORD WINAPI AssetManager::ResourceUploadThreadProc(_In_ PVOID pParameter)
 					Desc = CD3DX12_RESOURCE_DESC::Tex2D(Format,
 						static_cast<UINT64>(Metadata.width),
 						static_cast<UINT>(Metadata.height),
-						static_cast<UINT16>(Metadata.arraySize));
+						static_cast<UINT16>(Metadata.arraySize),
+						static_cast<UINT16>(Metadata.mipLevels));
 					break;
 
 				case TEX_DIMENSION::TEX_DIMENSION_TEXTURE3D:
@@ -277,21 +409,33 @@ DWORD WINAPI AssetManager::ResourceUploadThreadProc(_In_ PVOID pParameter)
 					break;
 				}
 
-				std::vector<D3D12_SUBRESOURCE_DATA> subresources(Image.GetImageCount());
-				const auto pImages = Image.GetImages();
-				for (size_t i = 0; i < Image.GetImageCount(); ++i)
-				{
-					subresources[i].RowPitch = pImages[i].rowPitch;
-					subresources[i].SlicePitch = pImages[i].slicePitch;
-					subresources[i].pData = pImages[i].pixels;
-				}
-
 				D3D12MA::ALLOCATION_DESC AllocDesc = {};
 				AllocDesc.HeapType = D3D12_HEAP_TYPE_DEFAULT;
 				auto Resource = RenderDevice.CreateResource(&AllocDesc, &Desc, D3D12_RESOURCE_STATE_COMMON, nullptr);
 
-				Uploader.Upload(Resource->pResource.Get(), 0, subresources.data(), subresources.size());
+				if (pImage->Stream)
+				{
+					UploadImageMips(Uploader, Resource->pResource.Get(), Metadata, Image, pImage->MostDetailedMip);
+
+					// Mip tail has been copied into the upload batch, no need to keep it in RAM
+					pImage->Image.Release();
+				}
+				else
+				{
+					std::vector<D3D12_SUBRESOURCE_DATA> subresources(Image.GetImageCount());
+					const auto pImages = Image.GetImages();
+					for (size_t i = 0; i < Image.GetImageCount(); ++i)
+					{
+						subresources[i].RowPitch = pImages[i].rowPitch;
+						subresources[i].SlicePitch = pImages[i].slicePitch;
+						subresources[i].pData = pImages[i].pixels;
+					}
+
+					Uploader.Upload(Resource->pResource.Get(), 0, subresources.data(), subresources.size());
+				}
 
+				// The view covers every mip, the mips that are not resident yet are excluded
+				// by clamping the LOD in the shader (see Material::TextureMinLOD)
 				Descriptor SRV = RenderDevice.AllocateShaderResourceView();
 
 				RenderDevice.CreateShaderResourceView(Resource->pResource.Get(), SRV);
@@ -303,13 +447,23 @@ DWORD WINAPI AssetManager::ResourceUploadThreadProc(_In_ PVOID pParameter)
 			}
 		}
 
+		// The new mips are only sampled once MostDetailedMip is lowered after the copy has completed
+		for (auto [i, Image] : enumerate(StreamingImages))
+		{
+			UploadImageMips(Uploader, Image->Resource->pResource.Get(), Image->Stream->GetMetadata(), Mips[i], Image->MostDetailedMip - 1);
+		}
+
 		// Process Mesh
 		{
 			std::shared_ptr<Asset::Mesh> pMesh;
 			while (AssetManager.MeshUploadQueue.Dequeue(pMesh, 0))
 			{
-				UINT64 VBSizeInBytes = pMesh->Vertices.size() * sizeof(Vertex);
-				UINT64 IBSizeInBytes = pMesh->Indices.size() * sizeof(unsigned int);
+				const bool Compact = pMesh->GetVertexFormat() == VertexFormat::Compact;
+				const UINT VertexStride = pMesh->GetVertexStride();
+
+				UINT64 VBSizeInBytes = pMesh->GetNumVertices() * VertexStride;
+				// Nothing selects LODs on the GPU yet, only the indices of the submeshes are uploaded
+				UINT64 IBSizeInBytes = GetSubmeshIndexSizeInBytes(*pMesh);
 
 				D3D12MA::ALLOCATION_DESC AllocDesc = {};
 				AllocDesc.HeapType = D3D12_HEAP_TYPE_DEFAULT;
@@ -319,7 +473,7 @@ DWORD WINAPI AssetManager::ResourceUploadThreadProc(_In_ PVOID pParameter)
 
 				// Upload vertex data
 				D3D12_SUBRESOURCE_DATA Subresource = {};
-				Subresource.pData = pMesh->Vertices.data();
+				Subresource.pData = Compact ? static_cast<const void*>(pMesh->CompactVertices.data()) : static_cast<const void*>(pMesh->Vertices.data());
 				Subresource.RowPitch = VBSizeInBytes;
 				Subresource.SlicePitch = VBSizeInBytes;
 
@@ -327,28 +481,57 @@ DWORD WINAPI AssetManager::ResourceUploadThreadProc(_In_ PVOID pParameter)
 
 				// Upload index data
 				Subresource = {};
-				Subresource.pData = pMesh->Indices.data();
+				Subresource.pData = pMesh->CompactIndices.data();
 				Subresource.RowPitch = IBSizeInBytes;
 				Subresource.SlicePitch = IBSizeInBytes;
 
 				Uploader.Upload(IB->pResource.Get(), 0, &Subresource, 1);
 
+				IndexMemory += IBSizeInBytes;
+				for (const auto& Submesh : pMesh->Submeshes)
+				{
+					UnpackedIndexMemory += Submesh.IndexCount * sizeof(uint32_t);
+				}
+
 				pMesh->VertexResource = std::move(VB);
 				pMesh->IndexResource = std::move(IB);
 
-				for (const auto& Submesh : pMesh->Submeshes)
+				// Compact vertices are dequantized by the BLAS build and the hit shader with a per submesh transform
+				if (Compact)
+				{
+					std::vector<XMFLOAT3X4> Transforms;
+					Transforms.reserve(pMesh->Submeshes.size());
+					for (const auto& Submesh : pMesh->Submeshes)
+					{
+						Transforms.push_back(GetDequantizationTransform(Submesh.BoundingBox));
+					}
+
+					UINT64 QBSizeInBytes = Transforms.size() * sizeof(XMFLOAT3X4);
+					auto QB = RenderDevice.CreateBuffer(&AllocDesc, QBSizeInBytes);
+
+					Subresource = {};
+					Subresource.pData = Transforms.data();
+					Subresource.RowPitch = QBSizeInBytes;
+					Subresource.SlicePitch = QBSizeInBytes;
+
+					Uploader.Upload(QB->pResource.Get(), 0, &Subresource, 1);
+
+					pMesh->QuantizationResource = std::move(QB);
+				}
+
+				for (auto [i, Submesh] : enumerate(pMesh->Submeshes))
 				{
 					D3D12_RAYTRACING_GEOMETRY_DESC Desc = {};
 					Desc.Type = D3D12_RAYTRACING_GEOMETRY_TYPE_TRIANGLES;
 					Desc.Flags = D3D12_RAYTRACING_GEOMETRY_FLAG_OPAQUE;
-					Desc.Triangles.Transform3x4 = NULL;
-					Desc.Triangles.IndexFormat = DXGI_FORMAT_R32_UINT;
-					Desc.Triangles.VertexFormat = DXGI_FORMAT_R32G32B32_FLOAT; // Position attribute of the vertex
+					Desc.Triangles.Transform3x4 = Compact ? pMesh->QuantizationResource->pResource->GetGPUVirtualAddress() + i * sizeof(XMFLOAT3X4) : NULL;
+					Desc.Triangles.IndexFormat = Submesh.IndexFormat;
+					Desc.Triangles.VertexFormat = Compact ? DXGI_FORMAT_R16G16B16A16_SNORM : DXGI_FORMAT_R32G32B32_FLOAT; // Position attribute of the vertex
 					Desc.Triangles.IndexCount = Submesh.IndexCount;
 					Desc.Triangles.VertexCount = Submesh.VertexCount;
-					Desc.Triangles.IndexBuffer = pMesh->IndexResource->pResource->GetGPUVirtualAddress() + Submesh.StartIndexLocation * sizeof(unsigned int);
-					Desc.Triangles.VertexBuffer.StartAddress = pMesh->VertexResource->pResource->GetGPUVirtualAddress() + Submesh.BaseVertexLocation * sizeof(Vertex);
-					Desc.Triangles.VertexBuffer.StrideInBytes = sizeof(Vertex);
+					Desc.Triangles.IndexBuffer = pMesh->IndexResource->pResource->GetGPUVirtualAddress() + Submesh.IndexByteOffset;
+					Desc.Triangles.VertexBuffer.StartAddress = pMesh->VertexResource->pResource->GetGPUVirtualAddress() + Submesh.BaseVertexLocation * VertexStride;
+					Desc.Triangles.VertexBuffer.StrideInBytes = VertexStride;
 
 					pMesh->BLAS.AddGeometry(Desc);
 				}
@@ -371,6 +554,11 @@ DWORD WINAPI AssetManager::ResourceUploadThreadProc(_In_ PVOID pParameter)
 
 				Meshes.push_back(pMesh);
 			}
+
+			if (!Meshes.empty())
+			{
+				LOG_INFO("Index memory: {}(KiB), {}(KiB) with 32-bit indices", ToKiB(IndexMemory), ToKiB(UnpackedIndexMemory));
+			}
 		}
 
 		auto Future = Uploader.End(RenderDevice.CopyQueue);
@@ -383,22 +571,46 @@ DWORD WINAPI AssetManager::ResourceUploadThreadProc(_In_ PVOID pParameter)
 		mFence->SetEventOnCompletion(FenceToWait, Event.get());
 		Event.wait();
 
+		for (auto& Image : StreamingImages)
+		{
+			Image->MostDetailedMip--;
+			if (Image->MostDetailedMip == 0)
+			{
+				Image->Stream.reset();
+			}
+		}
+		std::erase_if(StreamingImages, [](const auto& Image)
+		{
+			return !Image->Stream;
+		});
+
 		for (auto& Image : Images)
 		{
 			entt::id_type hs = entt::hashed_string(Image->Metadata.Path.string().data());
 
-			AssetManager.ImageCache.Create(hs);
+			// Replaced rather than overwritten in place, a reloaded image may still be in use by the render thread
+			AssetManager.ImageCache.Replace(hs, Image);
 			auto Asset = AssetManager.ImageCache.Load(hs);
-			*Asset = std::move(*Image);
+			if (!Asset->Metadata.Bundle)
+			{
+				AssetManager.FileWatcher.Watch(Asset->Metadata.Path);
+			}
+
+			if (Asset->Stream)
+			{
+				StreamingImages.push_back(Asset);
+			}
 		}
 
 		for (auto& Mesh : Meshes)
 		{
 			entt::id_type hs = entt::hashed_string(Mesh->Metadata.Path.string().data());
 
-			AssetManager.MeshCache.Create(hs);
-			auto Asset = AssetManager.MeshCache.Load(hs);
-			*Asset = std::move(*Mesh);
+			AssetManager.MeshCache.Replace(hs, Mesh);
+			if (!Mesh->Metadata.Bundle)
+			{
+				AssetManager.FileWatcher.Watch(Mesh->Metadata.Path);
+			}
 		}
 	}
 
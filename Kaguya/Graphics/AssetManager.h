@@ -1,8 +1,10 @@
 #pragma once
 #include <Core/Synchronization/RWLock.h>
+#include <Core/FileWatcher.h>
 #include "RenderDevice.h"
 
 #include "Asset/AsyncLoader.h"
+#include "Asset/SceneBundle.h"
 
 class AssetManager
 {
@@ -27,8 +29,20 @@ public:
 		return MeshCache;
 	}
 
+	// Assets found in the mounted bundle are read from it instead of from disk, pass null to unmount
+	void Mount(std::shared_ptr<SceneBundle> Bundle);
+
 	void AsyncLoadImage(const std::filesystem::path& Path, bool sRGB);
-	void AsyncLoadMesh(const std::filesystem::path& Path, bool KeepGeometryInRAM);
+	void AsyncLoadMesh(const std::filesystem::path& Path, bool KeepGeometryInRAM, bool QuantizeVertices = false, bool GenerateLODs = false, bool OptimizeMesh = false);
+
+	// Re-imports the image and/or mesh loaded from Path with the options it was loaded with, the new version replaces
+	// the cached one once it is uploaded. Called by the file watcher when an asset changes on disk
+	void Reload(const std::filesystem::path& Path);
+
+	// Loads requested so far and the ones of them that have been loaded, their upload may still be pending. Failed
+	// loads are never counted as loaded
+	UINT64 GetNumLoadsRequested() const { return NumLoadsRequested; }
+	UINT64 GetNumLoadsFinished() const { return NumLoadsFinished; }
 private:
 	AssetManager();
 	AssetManager(const AssetManager&) = delete;
@@ -37,6 +51,9 @@ private:
 
 	void CreateSystemTextures();
 
+	void RequestImageLoad(Asset::ImageMetadata Metadata);
+	void RequestMeshLoad(Asset::MeshMetadata Metadata);
+
 	static DWORD WINAPI ResourceUploadThreadProc(_In_ PVOID pParameter);
 private:
 	struct AssetTextures
@@ -63,6 +80,14 @@ private:
 	AssetCache<Asset::Image> ImageCache;
 	AssetCache<Asset::Mesh> MeshCache;
 
+	std::shared_ptr<SceneBundle> Bundle;
+
+	std::atomic<UINT64> NumLoadsRequested = 0;
+	std::atomic<UINT64> NumLoadsFinished = 0;
+
+	// Assets read from disk are watched, bundled assets are a snapshot and are not
+	FileWatcher FileWatcher;
+
 	CriticalSection UploadCriticalSection;
 	ConditionVariable UploadConditionVariable;
 	ThreadSafeQueue<std::shared_ptr<Asset::Image>> ImageUploadQueue;
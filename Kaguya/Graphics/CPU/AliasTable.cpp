@@ -0,0 +1,149 @@
+#include "pch.h"
+#include "AliasTable.h"
+
+#include <random>
+
+namespace CPU
+{
+	AliasTable::AliasTable(std::span<const float> Weights)
+		: Bins(Weights.size())
+	{
+		const size_t n = Weights.size();
+		if (n == 0)
+		{
+			return;
+		}
+
+		// Double precision keeps the leftover probabilities from drifting on large tables
+		double sum = 0.0;
+		for (float weight : Weights)
+		{
+			sum += weight > 0.0f ? weight : 0.0;
+		}
+
+		std::vector<double> scaled(n);
+		for (size_t i = 0; i < n; ++i)
+		{
+			const double p = sum > 0.0 ? (Weights[i] > 0.0f ? Weights[i] : 0.0) / sum : 1.0 / static_cast<double>(n);
+			Bins[i].Pmf = static_cast<float>(p);
+			scaled[i] = p * static_cast<double>(n);
+		}
+
+		// Every bin below the average is topped up by one above it, which becomes its alias
+		std::vector<uint32_t> small, large;
+		for (uint32_t i = 0; i < static_cast<uint32_t>(n); ++i)
+		{
+			(scaled[i] < 1.0 ? small : large).push_back(i);
+		}
+
+		while (!small.empty() && !large.empty())
+		{
+			const uint32_t s = small.back();
+			small.pop_back();
+			const uint32_t l = large.back();
+			large.pop_back();
+
+			Bins[s].q = static_cast<float>(scaled[s]);
+			Bins[s].Alias = l;
+
+			scaled[l] = (scaled[l] + scaled[s]) - 1.0;
+			(scaled[l] < 1.0 ? small : large).push_back(l);
+		}
+
+		// What is left is 1 up to rounding
+		for (uint32_t i : small)
+		{
+			Bins[i].q = 1.0f;
+			Bins[i].Alias = i;
+		}
+		for (uint32_t i : large)
+		{
+			Bins[i].q = 1.0f;
+			Bins[i].Alias = i;
+		}
+	}
+
+	uint32_t AliasTable::Sample(std::span<const Bin> Bins, float u, float* pPmf)
+	{
+		const uint32_t n = static_cast<uint32_t>(Bins.size());
+		const float scaled = u * static_cast<float>(n);
+		const uint32_t bin = std::min(static_cast<uint32_t>(scaled), n - 1);
+		const float up = std::min(scaled - static_cast<float>(bin), 0x1.fffffep-1f);
+
+		const uint32_t index = up < Bins[bin].q ? bin : Bins[bin].Alias;
+		if (pPmf)
+		{
+			*pPmf = Bins[index].Pmf;
+		}
+		return index;
+	}
+
+	void BenchmarkLightSampling()
+	{
+		std::mt19937 generator(1337);
+		std::uniform_real_distribution<float> distribution(0.0f, 1.0f);
+
+		LOG_INFO("Alias table build time");
+		for (size_t n : { size_t(100), size_t(10000), size_t(1000000) })
+		{
+			std::vector<float> weights(n);
+			for (auto& weight : weights)
+			{
+				weight = distribution(generator);
+			}
+
+			constexpr int NumBuilds = 8;
+			const auto start = std::chrono::high_resolution_clock::now();
+			for (int i = 0; i < NumBuilds; ++i)
+			{
+				const AliasTable table(weights);
+			}
+			const auto stop = std::chrono::high_resolution_clock::now();
+			LOG_INFO("\t{:>7} weights: {:.3f}(ms)", n, std::chrono::duration<double, std::milli>(stop - start).count() / NumBuilds);
+		}
+
+		// One bright light and 99 dim ones, what each light contributes is its power times a geometric term. One light
+		// is picked per sample and its contribution divided by the probability of picking it
+		constexpr size_t NumLights = 100;
+		std::vector<float> power(NumLights, 1.0f), contribution(NumLights);
+		power[0] = 1000.0f;
+
+		double reference = 0.0;
+		for (size_t i = 0; i < NumLights; ++i)
+		{
+			contribution[i] = power[i] * (0.5f + 0.5f * distribution(generator));
+			reference += contribution[i];
+		}
+
+		const std::vector<float> uniformWeights(NumLights, 1.0f);
+		const AliasTable tables[] = { AliasTable(uniformWeights), AliasTable(power) };
+
+		constexpr uint32_t NumTrials = 1024;
+		constexpr uint32_t MaxSamples = 1024;
+		LOG_INFO("Light selection, relative RMSE over {} estimates (Uniform, Power)", NumTrials);
+		for (uint32_t numSamples = 1; numSamples <= MaxSamples; numSamples *= 4)
+		{
+			double squaredErrors[ARRAYSIZE(tables)] = {};
+			for (size_t t = 0; t < ARRAYSIZE(tables); ++t)
+			{
+				for (uint32_t trial = 0; trial < NumTrials; ++trial)
+				{
+					double sum = 0.0;
+					for (uint32_t sample = 0; sample < numSamples; ++sample)
+					{
+						float pmf;
+						const uint32_t light = tables[t].Sample(distribution(generator), &pmf);
+						sum += contribution[light] / pmf;
+					}
+
+					const double error = (sum / numSamples - reference) / reference;
+					squaredErrors[t] += error * error;
+				}
+			}
+
+			LOG_INFO("\t{:>5} spp: {:.3e} {:.3e}", numSamples,
+				std::sqrt(squaredErrors[0] / NumTrials),
+				std::sqrt(squaredErrors[1] / NumTrials));
+		}
+	}
+}
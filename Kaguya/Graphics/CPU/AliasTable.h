@@ -0,0 +1,43 @@
+#pragma once
+#include <span>
+#include <vector>
+
+/*
+* Walker's alias method with Vose's construction, built in O(n) and sampled in O(1) with a single random number.
+* The bins are uploaded to the GPU as they are, SampleAliasTable in Sampling.hlsli samples them the same way.
+*/
+namespace CPU
+{
+	class AliasTable
+	{
+	public:
+		// Must match AliasTableBin in Sampling.hlsli
+		struct Bin
+		{
+			float q; // Probability of keeping the bin instead of taking its alias
+			uint32_t Alias;
+			float Pmf; // Of the element of the bin
+		};
+
+		AliasTable() = default;
+
+		// Negative and NaN weights count as 0, weights that are all 0 give a uniform distribution
+		explicit AliasTable(std::span<const float> Weights);
+
+		// Uses all of u, the fraction left after picking a bin decides between the bin and its alias
+		[[nodiscard]] uint32_t Sample(float u, float* pPmf) const { return Sample(Bins, u, pPmf); }
+
+		// Samples bins that were copied out of a table, like the ones of every mesh light packed into one array
+		[[nodiscard]] static uint32_t Sample(std::span<const Bin> Bins, float u, float* pPmf);
+
+		[[nodiscard]] float Pmf(uint32_t Index) const { return Bins[Index].Pmf; }
+		[[nodiscard]] bool IsEmpty() const { return Bins.empty(); }
+		[[nodiscard]] const std::vector<Bin>& GetBins() const { return Bins; }
+	private:
+		std::vector<Bin> Bins;
+	};
+
+	// Logs the time it takes to build tables of different sizes and the RMSE of estimating the light arriving at a
+	// point from one bright light among many dim ones with uniform and power proportional light selection
+	void BenchmarkLightSampling();
+}
@@ -0,0 +1,433 @@
+#include "pch.h"
+#include "BSDF.h"
+#include "Sampling.h"
+
+using namespace DirectX;
+
+namespace CPU
+{
+	static float sqr(float x)
+	{
+		return x * x;
+	}
+
+	Frame::Frame(FXMVECTOR n)
+		: n(n)
+	{
+		// Same basis as CoordinateSystem in Math.hlsli
+		const float x = XMVectorGetX(n), y = XMVectorGetY(n), z = XMVectorGetZ(n);
+		const float sign = z >= 0.0f ? 1.0f : -1.0f;
+		const float a = -1.0f / (sign + z);
+		const float b = x * y * a;
+		s = XMVectorSet(1.0f + sign * x * x * a, sign * b, -sign * x, 0.0f);
+		t = XMVectorSet(b, sign + y * y * a, -y, 0.0f);
+	}
+
+	XMVECTOR Frame::ToWorld(FXMVECTOR v) const
+	{
+		return XMVectorGetX(v) * s + XMVectorGetY(v) * t + XMVectorGetZ(v) * n;
+	}
+
+	XMVECTOR Frame::ToLocal(FXMVECTOR v) const
+	{
+		return XMVectorSet(XMVectorGetX(XMVector3Dot(v, s)), XMVectorGetX(XMVector3Dot(v, t)), XMVectorGetX(XMVector3Dot(v, n)), 0.0f);
+	}
+
+	XMVECTOR Reflect(FXMVECTOR wo, FXMVECTOR n)
+	{
+		return XMVectorAdd(XMVectorNegate(wo), XMVectorScale(n, 2.0f * XMVectorGetX(XMVector3Dot(wo, n))));
+	}
+
+	bool Refract(FXMVECTOR wi, FXMVECTOR n, float eta, XMVECTOR* pWt)
+	{
+		// Compute $\cos \theta_\roman{t}$ using Snell's law
+		const float cosThetaI = XMVectorGetX(XMVector3Dot(n, wi));
+		const float sin2ThetaI = std::max(0.0f, 1.0f - cosThetaI * cosThetaI);
+		const float sin2ThetaT = eta * eta * sin2ThetaI;
+
+		// Handle total internal reflection for transmission
+		if (sin2ThetaT >= 1.0f)
+		{
+			return false;
+		}
+
+		const float cosThetaT = std::sqrt(1.0f - sin2ThetaT);
+		*pWt = XMVectorAdd(XMVectorScale(XMVectorNegate(wi), eta), XMVectorScale(n, eta * cosThetaI - cosThetaT));
+		return true;
+	}
+
+	float FrDielectric(float CosThetaI, float EtaI, float EtaT)
+	{
+		if (EtaI == EtaT)
+		{
+			return 0.0f;
+		}
+
+		CosThetaI = std::clamp(CosThetaI, -1.0f, 1.0f);
+
+		// Potentially swap indices of refraction
+		if (CosThetaI <= 0.0f)
+		{
+			std::swap(EtaI, EtaT);
+			CosThetaI = std::abs(CosThetaI);
+		}
+
+		// Compute cosThetaT using Snell's law
+		const float sinThetaI = std::sqrt(std::max(0.0f, 1.0f - CosThetaI * CosThetaI));
+		const float sinThetaT = EtaI / EtaT * sinThetaI;
+
+		// Handle total internal reflection
+		if (sinThetaT >= 1.0f)
+		{
+			return 1.0f;
+		}
+
+		const float cosThetaT = std::sqrt(std::max(0.0f, 1.0f - sinThetaT * sinThetaT));
+
+		const float Rparl = ((EtaT * CosThetaI) - (EtaI * cosThetaT)) / ((EtaT * CosThetaI) + (EtaI * cosThetaT));
+		const float Rperp = ((EtaI * CosThetaI) - (EtaT * cosThetaT)) / ((EtaI * CosThetaI) + (EtaT * cosThetaT));
+		return (Rparl * Rparl + Rperp * Rperp) * 0.5f;
+	}
+
+	XMVECTOR SampleGTR1(XMFLOAT2 Xi, float alpha)
+	{
+		const float phi = XM_2PI * Xi.x;
+		float theta = 0.0f;
+		if (alpha < 1.0f)
+		{
+			theta = std::acos(std::sqrt((1.0f - std::pow(alpha * alpha, 1.0f - Xi.y)) / (1.0f - alpha * alpha)));
+		}
+		return XMVectorSet(std::sin(theta) * std::cos(phi), std::sin(theta) * std::sin(phi), std::cos(theta), 0.0f);
+	}
+
+	XMVECTOR SampleGTR2(XMFLOAT2 Xi, float alpha)
+	{
+		const float phi = XM_2PI * Xi.x;
+		const float theta = std::acos(std::sqrt((1.0f - Xi.y) / (1.0f + (alpha * alpha - 1.0f) * Xi.y)));
+		return XMVectorSet(std::sin(theta) * std::cos(phi), std::sin(theta) * std::sin(phi), std::cos(theta), 0.0f);
+	}
+
+	float D_GTR1(float CosTheta, float alpha)
+	{
+		const float a2 = alpha * alpha;
+		return (a2 - 1.0f) / (XM_PI * std::log(a2) * (1.0f + (a2 - 1.0f) * CosTheta * CosTheta));
+	}
+
+	float D_GTR2(float CosTheta, float alpha)
+	{
+		const float a2 = alpha * alpha;
+		const float t = 1.0f + (a2 - 1.0f) * CosTheta * CosTheta;
+		return a2 / (XM_PI * t * t);
+	}
+
+	float smithG_GGX(float CosTheta, float alpha)
+	{
+		const float alpha2 = alpha * alpha;
+		const float cosTheta2 = CosTheta * CosTheta;
+		return 1.0f / (CosTheta + std::sqrt(alpha2 + cosTheta2 - alpha2 * cosTheta2));
+	}
+
+	float SchlickWeight(float CosTheta)
+	{
+		const float m = std::clamp(1.0f - CosTheta, 0.0f, 1.0f);
+		return m * m * m * m * m;
+	}
+
+	float FrSchlick(float R0, float CosTheta)
+	{
+		return Lerp(R0, 1.0f, SchlickWeight(CosTheta));
+	}
+
+	float DisneyDiffuse(FXMVECTOR wo, FXMVECTOR wi, float roughness, float subsurface)
+	{
+		const XMVECTOR wh = XMVector3Normalize(XMVectorAdd(wi, wo));
+		const float cosThetaD = XMVectorGetX(XMVector3Dot(wi, wh));
+
+		// Diffuse fresnel - go from 1 at normal incidence to .5 at grazing
+		// and mix in diffuse retro-reflection based on roughness
+		const float Fo = SchlickWeight(AbsCosTheta(wo));
+		const float Fi = SchlickWeight(AbsCosTheta(wi));
+		const float Fd90 = 0.5f + 2.0f * cosThetaD * cosThetaD * roughness;
+		const float Fd = Lerp(1.0f, Fd90, Fo) * Lerp(1.0f, Fd90, Fi);
+
+		// Based on Hanrahan-Krueger brdf approximation of isotropic bssrdf
+		// Fss90 used to "flatten" retroreflection based on roughness
+		const float Fss90 = cosThetaD * cosThetaD * roughness;
+		const float Fss = Lerp(1.0f, Fss90, Fo) * Lerp(1.0f, Fss90, Fi);
+		// 1.25 scale is used to (roughly) preserve albedo
+		const float ss = 1.25f * (Fss * (1.0f / (AbsCosTheta(wo) + AbsCosTheta(wi)) - 0.5f) + 0.5f);
+
+		return XM_1DIVPI * Lerp(Fd, ss, subsurface);
+	}
+
+	XMVECTOR LambertianReflection::f(FXMVECTOR wo, FXMVECTOR wi) const
+	{
+		if (!SameHemisphere(wo, wi))
+		{
+			return XMVectorZero();
+		}
+
+		return XMVectorScale(XMLoadFloat3(&R), XM_1DIVPI);
+	}
+
+	float LambertianReflection::Pdf(FXMVECTOR wo, FXMVECTOR wi) const
+	{
+		if (!SameHemisphere(wo, wi))
+		{
+			return 0.0f;
+		}
+
+		return CosineHemispherePdf(AbsCosTheta(wi));
+	}
+
+	bool LambertianReflection::Samplef(FXMVECTOR wo, XMFLOAT2 Xi, BSDFSample* pSample) const
+	{
+		XMVECTOR wi = SampleCosineHemisphere(Xi);
+		if (CosTheta(wo) < 0.0f)
+		{
+			wi = XMVectorMultiply(wi, XMVectorSet(1.0f, 1.0f, -1.0f, 0.0f));
+		}
+
+		*pSample =
+		{
+			.f = XMVectorScale(XMLoadFloat3(&R), XM_1DIVPI),
+			.wi = wi,
+			.pdf = CosineHemispherePdf(AbsCosTheta(wi)),
+			.Flags = Flags()
+		};
+		return true;
+	}
+
+	bool Mirror::Samplef(FXMVECTOR wo, XMFLOAT2 Xi, BSDFSample* pSample) const
+	{
+		const XMVECTOR wi = XMVectorMultiply(wo, XMVectorSet(-1.0f, -1.0f, 1.0f, 0.0f));
+
+		*pSample =
+		{
+			.f = XMVectorScale(XMLoadFloat3(&R), 1.0f / AbsCosTheta(wi)),
+			.wi = wi,
+			.pdf = 1.0f,
+			.Flags = Flags()
+		};
+		return true;
+	}
+
+	bool Glass::Samplef(FXMVECTOR wo, XMFLOAT2 Xi, BSDFSample* pSample) const
+	{
+		const float F = FrDielectric(CosTheta(wo), etaA, etaB);
+		if (Xi.x < F)
+		{
+			// Compute perfect specular reflection direction
+			const XMVECTOR wi = XMVectorMultiply(wo, XMVectorSet(-1.0f, -1.0f, 1.0f, 0.0f));
+
+			*pSample =
+			{
+				.f = XMVectorScale(XMLoadFloat3(&R), F / AbsCosTheta(wi)),
+				.wi = wi,
+				.pdf = F,
+				.Flags = BxDFFlags::SpecularReflection
+			};
+			return true;
+		}
+
+		// Figure out which $\eta$ is incident and which is transmitted
+		const bool entering = CosTheta(wo) > 0.0f;
+		const float etaI = entering ? etaA : etaB;
+		const float etaT = entering ? etaB : etaA;
+
+		// Compute ray direction for specular transmission
+		XMVECTOR wi;
+		if (!Refract(wo, XMVectorSet(0.0f, 0.0f, entering ? 1.0f : -1.0f, 0.0f), etaI / etaT, &wi))
+		{
+			return false;
+		}
+
+		// Account for non-symmetry with transmission to different medium
+		const float ft = (1.0f - F) * (etaI * etaI) / (etaT * etaT);
+
+		*pSample =
+		{
+			.f = XMVectorScale(XMLoadFloat3(&T), ft / AbsCosTheta(wi)),
+			.wi = wi,
+			.pdf = 1.0f - F,
+			.Flags = BxDFFlags::SpecularTransmission
+		};
+		return true;
+	}
+
+	XMVECTOR Disney::f(FXMVECTOR wo, FXMVECTOR wi) const
+	{
+		const XMVECTOR wh = XMVector3Normalize(XMVectorAdd(wi, wo));
+		const float cosThetaD = XMVectorGetX(XMVector3Dot(wi, wh));
+
+		const XMVECTOR color = XMLoadFloat3(&baseColor);
+		const float luminance = XMVectorGetX(XMVector3Dot(color, XMVectorSet(0.212671f, 0.715160f, 0.072169f, 0.0f)));
+		const XMVECTOR Ctint = luminance > 0.0f ? XMVectorScale(color, 1.0f / luminance) : g_XMOne;
+		const XMVECTOR Cspec0 = XMVectorLerp(XMVectorScale(XMVectorLerp(g_XMOne, Ctint, specularTint), specular * 0.08f), color, metallic);
+		const XMVECTOR Csheen = XMVectorLerp(g_XMOne, Ctint, sheenTint);
+
+		const float diffuse = DisneyDiffuse(wo, wi, roughness, subsurface);
+
+		// Sheen
+		const XMVECTOR sheenTerm = XMVectorScale(Csheen, sheen * SchlickWeight(cosThetaD));
+
+		const float a = std::max(0.001f, roughness);
+		const float Ds = D_GTR2(AbsCosTheta(wh), a);
+		const float FH = SchlickWeight(cosThetaD);
+		const XMVECTOR Fs = XMVectorLerp(Cspec0, g_XMOne, FH);
+		const float roughg = sqr(roughness * 0.5f + 0.5f);
+		const float Gs = smithG_GGX(AbsCosTheta(wo), roughg) * smithG_GGX(AbsCosTheta(wi), roughg);
+
+		// Clearcoat has ior = 1.5 hardcoded -> F0 = 0.04. It then uses the
+		// GTR1 distribution, which has even fatter tails than Trowbridge-Reitz
+		// (which is GTR2). The geometric term always based on alpha = 0.25.
+		const float gloss = Lerp(0.1f, 0.001f, clearcoatGloss);
+		const float Dr = D_GTR1(AbsCosTheta(wh), gloss);
+		const float Fr = FrSchlick(0.04f, XMVectorGetX(XMVector3Dot(wo, wh)));
+		const float Gr = smithG_GGX(AbsCosTheta(wo), 0.25f) * smithG_GGX(AbsCosTheta(wi), 0.25f);
+		const float clearcoatTerm = clearcoat * Gr * Fr * Dr / 4.0f;
+
+		const XMVECTOR diffuseAndSheen = XMVectorScale(XMVectorAdd(XMVectorScale(color, diffuse), sheenTerm), 1.0f - metallic);
+		return XMVectorAdd(XMVectorAdd(diffuseAndSheen, XMVectorScale(Fs, Gs * Ds)), XMVectorReplicate(clearcoatTerm));
+	}
+
+	float Disney::Pdf(FXMVECTOR wo, FXMVECTOR wi) const
+	{
+		const XMVECTOR wh = XMVector3Normalize(XMVectorAdd(wo, wi));
+		const float cosTheta = AbsCosTheta(wh);
+
+		const float specularAlpha = std::max(0.001f, roughness);
+		const float clearcoatAlpha = Lerp(0.1f, 0.001f, clearcoatGloss);
+
+		const float diffuseRatio = 0.5f * (1.0f - metallic);
+		const float specularRatio = 1.0f - diffuseRatio;
+
+		const float pdfGTR2 = D_GTR2(cosTheta, specularAlpha) * cosTheta;
+		const float pdfGTR1 = D_GTR1(cosTheta, clearcoatAlpha) * cosTheta;
+
+		// calculate diffuse and specular pdfs and mix ratio
+		const float ratio = 1.0f / (1.0f + clearcoat);
+		const float pdfSpec = Lerp(pdfGTR1, pdfGTR2, ratio) / (4.0f * std::abs(XMVectorGetX(XMVector3Dot(wi, wh))));
+		const float pdfDiff = AbsCosTheta(wi) * XM_1DIVPI;
+
+		// weight pdfs according to ratios
+		return diffuseRatio * pdfDiff + specularRatio * pdfSpec;
+	}
+
+	bool Disney::Samplef(FXMVECTOR wo, XMFLOAT2 Xi, BSDFSample* pSample) const
+	{
+		// http://simon-kallweit.me/rendercompo2015/report/#disneybrdf, refer to this link
+		// for how to importance sample the disney brdf
+		XMVECTOR wi;
+
+		const float diffuseRatio = 0.5f * (1.0f - metallic);
+
+		// Sample diffuse
+		if (Xi.x < diffuseRatio)
+		{
+			wi = SampleCosineHemisphere({ Xi.x / diffuseRatio, Xi.y });
+		}
+		// Sample specular
+		else
+		{
+			XMFLOAT2 specularXi = { (Xi.x - diffuseRatio) / (1.0f - diffuseRatio), Xi.y };
+
+			const float gtr2Ratio = 1.0f / (1.0f + clearcoat);
+			if (specularXi.x < gtr2Ratio)
+			{
+				specularXi.x /= gtr2Ratio;
+
+				const float alpha = std::max(0.01f, roughness * roughness);
+				wi = XMVector3Normalize(Reflect(wo, SampleGTR2(specularXi, alpha)));
+			}
+			else
+			{
+				specularXi.x = (specularXi.x - gtr2Ratio) / (1.0f - gtr2Ratio);
+
+				const float alpha = Lerp(0.1f, 0.001f, clearcoatGloss);
+				wi = XMVector3Normalize(Reflect(wo, SampleGTR1(specularXi, alpha)));
+			}
+		}
+
+		*pSample =
+		{
+			.f = f(wo, wi),
+			.wi = wi,
+			.pdf = Pdf(wo, wi),
+			.Flags = Flags()
+		};
+		return true;
+	}
+
+	BSDF::BSDF(const Material& Material)
+	{
+		switch (Material.BSDFType)
+		{
+		case BSDFTypes::Lambertian:
+			BxDF = LambertianReflection{ .R = Material.baseColor };
+			break;
+		case BSDFTypes::Mirror:
+			BxDF = Mirror{ .R = Material.baseColor };
+			break;
+		case BSDFTypes::Glass:
+			BxDF = Glass{ .R = Material.baseColor, .T = Material.T, .etaA = Material.etaA, .etaB = Material.etaB };
+			break;
+		case BSDFTypes::Disney:
+		default:
+			BxDF = Disney
+			{
+				.baseColor = Material.baseColor,
+				.metallic = Material.metallic,
+				.subsurface = Material.subsurface,
+				.specular = Material.specular,
+				.roughness = Material.roughness,
+				.specularTint = Material.specularTint,
+				.anisotropic = Material.anisotropic,
+				.sheen = Material.sheen,
+				.sheenTint = Material.sheenTint,
+				.clearcoat = Material.clearcoat,
+				.clearcoatGloss = Material.clearcoatGloss
+			};
+			break;
+		}
+	}
+
+	XMVECTOR BSDF::f(FXMVECTOR wo, FXMVECTOR wi) const
+	{
+		if (CosTheta(wo) == 0.0f)
+		{
+			return XMVectorZero();
+		}
+
+		return std::visit([&](const auto& bxdf) { return bxdf.f(wo, wi); }, BxDF);
+	}
+
+	float BSDF::Pdf(FXMVECTOR wo, FXMVECTOR wi) const
+	{
+		if (CosTheta(wo) == 0.0f)
+		{
+			return 0.0f;
+		}
+
+		return std::visit([&](const auto& bxdf) { return bxdf.Pdf(wo, wi); }, BxDF);
+	}
+
+	bool BSDF::Samplef(FXMVECTOR wo, XMFLOAT2 Xi, BSDFSample* pSample) const
+	{
+		if (CosTheta(wo) == 0.0f)
+		{
+			return false;
+		}
+
+		const bool success = std::visit([&](const auto& bxdf) { return bxdf.Samplef(wo, Xi, pSample); }, BxDF);
+		return success &&
+			!XMVector3Equal(pSample->f, XMVectorZero()) &&
+			pSample->pdf != 0.0f &&
+			CosTheta(pSample->wi) != 0.0f;
+	}
+
+	BxDFFlags BSDF::Flags() const
+	{
+		return std::visit([](const auto& bxdf) { return bxdf.Flags(); }, BxDF);
+	}
+}
@@ -0,0 +1,156 @@
+#pragma once
+#include <variant>
+#include <DirectXMath.h>
+
+#include <Core/Utility.h>
+
+#include "../Scene/Components/MeshRenderer.h"
+
+/*
+* C++ counterparts of the BxDFs in BxDF.hlsli and Disney.hlsli, they have to be kept in sync with the shaders.
+* Directions are in the local shading frame where the normal is +z, like the BxDFs in the shaders.
+*/
+namespace CPU
+{
+	enum class BxDFFlags : uint32_t
+	{
+		Unknown = 0,
+		Reflection = 1 << 0,
+		Transmission = 1 << 1,
+
+		Diffuse = 1 << 2,
+		Glossy = 1 << 3,
+		Specular = 1 << 4,
+		// Composite flags definitions
+		DiffuseReflection = Diffuse | Reflection,
+		DiffuseTransmission = Diffuse | Transmission,
+		GlossyReflection = Glossy | Reflection,
+		GlossyTransmission = Glossy | Transmission,
+		SpecularReflection = Specular | Reflection,
+		SpecularTransmission = Specular | Transmission,
+
+		All = Diffuse | Glossy | Specular | Reflection | Transmission
+	};
+}
+
+ENABLE_BITMASK_OPERATORS(CPU::BxDFFlags);
+
+namespace CPU
+{
+
+	struct BSDFSample
+	{
+		DirectX::XMVECTOR f;
+		DirectX::XMVECTOR wi;
+		float pdf;
+		BxDFFlags Flags;
+	};
+
+	inline float CosTheta(DirectX::FXMVECTOR w) { return DirectX::XMVectorGetZ(w); }
+	inline float AbsCosTheta(DirectX::FXMVECTOR w) { return std::abs(DirectX::XMVectorGetZ(w)); }
+	inline bool SameHemisphere(DirectX::FXMVECTOR v0, DirectX::FXMVECTOR v1) { return DirectX::XMVectorGetZ(v0) * DirectX::XMVectorGetZ(v1) > 0.0f; }
+
+	// Returns the direction in the local frame with the given cosine to the normal, used to set up wo for tables
+	inline DirectX::XMVECTOR DirectionFromCosTheta(float CosTheta)
+	{
+		return DirectX::XMVectorSet(std::sqrt(std::max(0.0f, 1.0f - CosTheta * CosTheta)), 0.0f, CosTheta, 0.0f);
+	}
+
+	// Orthonormal basis around n, like Frame in Math.hlsli
+	struct Frame
+	{
+		explicit Frame(DirectX::FXMVECTOR n);
+
+		[[nodiscard]] DirectX::XMVECTOR ToWorld(DirectX::FXMVECTOR v) const;
+		[[nodiscard]] DirectX::XMVECTOR ToLocal(DirectX::FXMVECTOR v) const;
+
+		DirectX::XMVECTOR s, t, n;
+	};
+
+	DirectX::XMVECTOR Reflect(DirectX::FXMVECTOR wo, DirectX::FXMVECTOR n);
+	bool Refract(DirectX::FXMVECTOR wi, DirectX::FXMVECTOR n, float eta, DirectX::XMVECTOR* pWt);
+
+	float FrDielectric(float CosThetaI, float EtaI, float EtaT);
+
+	// Terms of the Disney BRDF, see Disney.hlsli
+	DirectX::XMVECTOR SampleGTR1(DirectX::XMFLOAT2 Xi, float alpha);
+	DirectX::XMVECTOR SampleGTR2(DirectX::XMFLOAT2 Xi, float alpha);
+	float D_GTR1(float CosTheta, float alpha);
+	float D_GTR2(float CosTheta, float alpha);
+	float smithG_GGX(float CosTheta, float alpha);
+	float SchlickWeight(float CosTheta);
+	float FrSchlick(float R0, float CosTheta);
+
+	// Diffuse lobe of the Disney BRDF for a white base color, blended towards the subsurface approximation by Subsurface
+	float DisneyDiffuse(DirectX::FXMVECTOR wo, DirectX::FXMVECTOR wi, float roughness, float subsurface);
+
+	struct LambertianReflection
+	{
+		DirectX::XMVECTOR f(DirectX::FXMVECTOR wo, DirectX::FXMVECTOR wi) const;
+		float Pdf(DirectX::FXMVECTOR wo, DirectX::FXMVECTOR wi) const;
+		bool Samplef(DirectX::FXMVECTOR wo, DirectX::XMFLOAT2 Xi, BSDFSample* pSample) const;
+		BxDFFlags Flags() const { return BxDFFlags::DiffuseReflection; }
+
+		DirectX::XMFLOAT3 R;
+	};
+
+	struct Mirror
+	{
+		DirectX::XMVECTOR f(DirectX::FXMVECTOR wo, DirectX::FXMVECTOR wi) const { return DirectX::XMVectorZero(); }
+		float Pdf(DirectX::FXMVECTOR wo, DirectX::FXMVECTOR wi) const { return 0.0f; }
+		bool Samplef(DirectX::FXMVECTOR wo, DirectX::XMFLOAT2 Xi, BSDFSample* pSample) const;
+		BxDFFlags Flags() const { return BxDFFlags::SpecularReflection; }
+
+		DirectX::XMFLOAT3 R;
+	};
+
+	struct Glass
+	{
+		DirectX::XMVECTOR f(DirectX::FXMVECTOR wo, DirectX::FXMVECTOR wi) const { return DirectX::XMVectorZero(); }
+		float Pdf(DirectX::FXMVECTOR wo, DirectX::FXMVECTOR wi) const { return 0.0f; }
+		bool Samplef(DirectX::FXMVECTOR wo, DirectX::XMFLOAT2 Xi, BSDFSample* pSample) const;
+		BxDFFlags Flags() const { return BxDFFlags::Reflection | BxDFFlags::Transmission | BxDFFlags::Specular; }
+
+		DirectX::XMFLOAT3 R;
+		DirectX::XMFLOAT3 T;
+		float etaA, etaB;
+	};
+
+	struct Disney
+	{
+		DirectX::XMVECTOR f(DirectX::FXMVECTOR wo, DirectX::FXMVECTOR wi) const;
+		float Pdf(DirectX::FXMVECTOR wo, DirectX::FXMVECTOR wi) const;
+		bool Samplef(DirectX::FXMVECTOR wo, DirectX::XMFLOAT2 Xi, BSDFSample* pSample) const;
+		BxDFFlags Flags() const { return BxDFFlags::Reflection | BxDFFlags::Diffuse | BxDFFlags::Glossy; }
+
+		DirectX::XMFLOAT3 baseColor;
+		float metallic;
+		float subsurface;
+		float specular;
+		float roughness;
+		float specularTint;
+		float anisotropic;
+		float sheen;
+		float sheenTint;
+		float clearcoat;
+		float clearcoatGloss;
+	};
+
+	// Picks the BxDF by Material.BSDFType like the BSDF struct in BSDF.hlsli
+	class BSDF
+	{
+	public:
+		explicit BSDF(const Material& Material);
+
+		[[nodiscard]] DirectX::XMVECTOR f(DirectX::FXMVECTOR wo, DirectX::FXMVECTOR wi) const;
+		[[nodiscard]] float Pdf(DirectX::FXMVECTOR wo, DirectX::FXMVECTOR wi) const;
+
+		// Fails for samples that carry no energy, like the shader version
+		bool Samplef(DirectX::FXMVECTOR wo, DirectX::XMFLOAT2 Xi, BSDFSample* pSample) const;
+
+		[[nodiscard]] BxDFFlags Flags() const;
+		[[nodiscard]] bool IsSpecular() const { return EnumMaskBitSet(Flags(), BxDFFlags::Specular); }
+	private:
+		std::variant<LambertianReflection, Mirror, Glass, Disney> BxDF;
+	};
+}
@@ -0,0 +1,698 @@
+#include "pch.h"
+#include "BVH.h"
+
+#include <bit>
+
+#include "../Asset/IndexPacking.h"
+#include "../Asset/VertexQuantization.h"
+
+namespace CPU
+{
+	// Cost of traversing a node relative to intersecting a triangle
+	static constexpr float TraversalCost = 1.0f;
+	static constexpr size_t CacheLineSize = 64;
+
+	namespace
+	{
+		struct Bounds
+		{
+			float3 Min = { FLT_MAX, FLT_MAX, FLT_MAX };
+			float3 Max = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+			void Grow(const float3& p)
+			{
+				Min = { std::min(Min.x, p.x), std::min(Min.y, p.y), std::min(Min.z, p.z) };
+				Max = { std::max(Max.x, p.x), std::max(Max.y, p.y), std::max(Max.z, p.z) };
+			}
+
+			void Grow(const Bounds& b)
+			{
+				Grow(b.Min);
+				Grow(b.Max);
+			}
+
+			[[nodiscard]] float Area() const
+			{
+				const float x = Max.x - Min.x, y = Max.y - Min.y, z = Max.z - Min.z;
+				return x < 0.0f ? 0.0f : 2.0f * (x * y + y * z + z * x);
+			}
+		};
+
+		float Component(const float3& v, uint32_t Axis)
+		{
+			return (&v.x)[Axis];
+		}
+
+		float3 Subtract(const float3& a, const float3& b)
+		{
+			return { a.x - b.x, a.y - b.y, a.z - b.z };
+		}
+
+		float3 Cross(const float3& a, const float3& b)
+		{
+			return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+		}
+
+		float Dot(const float3& a, const float3& b)
+		{
+			return a.x * b.x + a.y * b.y + a.z * b.z;
+		}
+
+		// Returns the entry distance, FLT_MAX on miss
+		float IntersectBounds(const float3& Min, const float3& Max, const float3& Origin, const float3& InverseDirection, float TMin, float TMax)
+		{
+			const float tx1 = (Min.x - Origin.x) * InverseDirection.x, tx2 = (Max.x - Origin.x) * InverseDirection.x;
+			const float ty1 = (Min.y - Origin.y) * InverseDirection.y, ty2 = (Max.y - Origin.y) * InverseDirection.y;
+			const float tz1 = (Min.z - Origin.z) * InverseDirection.z, tz2 = (Max.z - Origin.z) * InverseDirection.z;
+
+			const float tNear = std::max({ std::min(tx1, tx2), std::min(ty1, ty2), std::min(tz1, tz2), TMin });
+			const float tFar = std::min({ std::max(tx1, tx2), std::max(ty1, ty2), std::max(tz1, tz2), TMax });
+			return tNear <= tFar ? tNear : FLT_MAX;
+		}
+	}
+
+	void BVH::Build(const Asset::Mesh& Mesh)
+	{
+		const auto start = std::chrono::high_resolution_clock::now();
+
+		LoadPositions(Mesh);
+
+		const auto MeshIndices = UnpackIndices(Mesh);
+
+		Indices.clear();
+		Indices.reserve(MeshIndices.size());
+		for (const auto& Submesh : Mesh.Submeshes)
+		{
+			for (uint32_t i = 0; i < Submesh.IndexCount; ++i)
+			{
+				Indices.push_back(MeshIndices[Submesh.StartIndexLocation + i] + Submesh.BaseVertexLocation);
+			}
+		}
+
+		const uint32_t NumTriangles = static_cast<uint32_t>(Indices.size() / 3);
+		const auto Centroids = ComputeCentroids();
+
+		PrimitiveIndices.resize(NumTriangles);
+		std::iota(PrimitiveIndices.begin(), PrimitiveIndices.end(), 0);
+
+		Nodes.clear();
+		Statistics = {};
+		if (NumTriangles == 0)
+		{
+			return;
+		}
+
+		// A binary tree with N leaves has at most 2N - 1 nodes, reserving up front keeps node references valid during the build
+		Nodes.reserve(size_t(NumTriangles) * 2 - 1);
+		Nodes.push_back({ .LeftFirst = 0, .NumPrimitives = NumTriangles });
+		UpdateBounds(0);
+		Subdivide(0, 0, Centroids);
+		Nodes.shrink_to_fit();
+
+		const auto stop = std::chrono::high_resolution_clock::now();
+		ComputeStatistics();
+		Statistics.BuildTime = std::chrono::duration<float, std::milli>(stop - start).count();
+	}
+
+	void BVH::BuildFromMeshlets(const Asset::Mesh& Mesh)
+	{
+		const auto start = std::chrono::high_resolution_clock::now();
+
+		LoadPositions(Mesh);
+
+		// Triangles are laid out meshlet by meshlet so every cluster is a contiguous primitive range
+		std::vector<Cluster> Clusters;
+		Clusters.reserve(Mesh.Meshlets.size());
+		Indices.clear();
+		Indices.reserve(Mesh.MeshletTriangles.size() * 3);
+		for (const auto& Submesh : Mesh.Submeshes)
+		{
+			for (uint32_t m = Submesh.FirstMeshlet; m < Submesh.FirstMeshlet + Submesh.NumMeshlets; ++m)
+			{
+				const Asset::Meshlet& Meshlet = Mesh.Meshlets[m];
+
+				Cluster Cluster = {};
+				Cluster.FirstPrimitive = static_cast<uint32_t>(Indices.size() / 3);
+				Cluster.NumPrimitives = Meshlet.TriangleCount;
+				Cluster.Centroid = Meshlet.BoundingBox.Center;
+				Cluster.Min = {
+					Meshlet.BoundingBox.Center.x - Meshlet.BoundingBox.Extents.x,
+					Meshlet.BoundingBox.Center.y - Meshlet.BoundingBox.Extents.y,
+					Meshlet.BoundingBox.Center.z - Meshlet.BoundingBox.Extents.z
+				};
+				Cluster.Max = {
+					Meshlet.BoundingBox.Center.x + Meshlet.BoundingBox.Extents.x,
+					Meshlet.BoundingBox.Center.y + Meshlet.BoundingBox.Extents.y,
+					Meshlet.BoundingBox.Center.z + Meshlet.BoundingBox.Extents.z
+				};
+				Clusters.push_back(Cluster);
+
+				for (uint32_t t = 0; t < Meshlet.TriangleCount; ++t)
+				{
+					const Asset::MeshletTriangle& Triangle = Mesh.MeshletTriangles[Meshlet.TriangleOffset + t];
+					for (uint8_t Local : { Triangle.i0, Triangle.i1, Triangle.i2 })
+					{
+						Indices.push_back(Submesh.BaseVertexLocation + Mesh.MeshletVertices[Meshlet.VertexOffset + Local]);
+					}
+				}
+			}
+		}
+
+		const uint32_t NumTriangles = static_cast<uint32_t>(Indices.size() / 3);
+		const auto Centroids = ComputeCentroids();
+
+		PrimitiveIndices.resize(NumTriangles);
+		std::iota(PrimitiveIndices.begin(), PrimitiveIndices.end(), 0);
+
+		Nodes.clear();
+		Statistics = {};
+		if (NumTriangles == 0)
+		{
+			return;
+		}
+
+		std::vector<uint32_t> ClusterIndices(Clusters.size());
+		std::iota(ClusterIndices.begin(), ClusterIndices.end(), 0);
+
+		Nodes.reserve(size_t(NumTriangles) * 2 - 1);
+		Nodes.push_back({});
+		SubdivideClusters(0, 0, ClusterIndices, Clusters, Centroids);
+		Nodes.shrink_to_fit();
+
+		const auto stop = std::chrono::high_resolution_clock::now();
+		ComputeStatistics();
+		Statistics.BuildTime = std::chrono::duration<float, std::milli>(stop - start).count();
+	}
+
+	void BVH::Write(AssetStreamWriter& Writer) const
+	{
+		Writer.AddSection(NodeSectionId, Nodes);
+		Writer.AddSection(PrimitiveSectionId, PrimitiveIndices);
+		Writer.AddSection(PositionSectionId, Positions);
+		Writer.AddSection(IndexSectionId, Indices);
+	}
+
+	bool BVH::Read(const AssetStreamReader& Reader)
+	{
+		Statistics = {};
+		if (!Reader.ReadSection(NodeSectionId, Nodes) ||
+			!Reader.ReadSection(PrimitiveSectionId, PrimitiveIndices) ||
+			!Reader.ReadSection(PositionSectionId, Positions) ||
+			!Reader.ReadSection(IndexSectionId, Indices))
+		{
+			Nodes.clear();
+			return false;
+		}
+
+		if (!Nodes.empty())
+		{
+			ComputeStatistics();
+		}
+		return true;
+	}
+
+	bool BVH::Intersect(const Ray& Ray, RayHit* pHit) const
+	{
+		if (Nodes.empty())
+		{
+			return false;
+		}
+
+		const float3 InverseDirection = { 1.0f / Ray.Direction.x, 1.0f / Ray.Direction.y, 1.0f / Ray.Direction.z };
+
+		CPU::Ray Query = Ray;
+		bool Hit = false;
+
+		uint32_t Stack[MaxDepth * 2];
+		uint32_t StackSize = 0;
+		Stack[StackSize++] = 0;
+		while (StackSize > 0)
+		{
+			const Node& Node = Nodes[Stack[--StackSize]];
+			if (IntersectBounds(Node.Min, Node.Max, Query.Origin, InverseDirection, Query.TMin, Query.TMax) == FLT_MAX)
+			{
+				continue;
+			}
+
+			if (Node.IsLeaf())
+			{
+				for (uint32_t i = 0; i < Node.NumPrimitives; ++i)
+				{
+					if (IntersectTriangle(Query, PrimitiveIndices[Node.LeftFirst + i], pHit))
+					{
+						Query.TMax = pHit->T;
+						Hit = true;
+					}
+				}
+				continue;
+			}
+
+			// Visit the nearer child first so TMax shrinks early
+			const auto& Left = Nodes[Node.LeftFirst];
+			const auto& Right = Nodes[Node.LeftFirst + 1];
+			const float tLeft = IntersectBounds(Left.Min, Left.Max, Query.Origin, InverseDirection, Query.TMin, Query.TMax);
+			const float tRight = IntersectBounds(Right.Min, Right.Max, Query.Origin, InverseDirection, Query.TMin, Query.TMax);
+			if (tLeft <= tRight)
+			{
+				if (tRight != FLT_MAX) Stack[StackSize++] = Node.LeftFirst + 1;
+				if (tLeft != FLT_MAX) Stack[StackSize++] = Node.LeftFirst;
+			}
+			else
+			{
+				if (tLeft != FLT_MAX) Stack[StackSize++] = Node.LeftFirst;
+				if (tRight != FLT_MAX) Stack[StackSize++] = Node.LeftFirst + 1;
+			}
+		}
+
+		return Hit;
+	}
+
+	bool BVH::Occluded(const Ray& Ray) const
+	{
+		if (Nodes.empty())
+		{
+			return false;
+		}
+
+		const float3 InverseDirection = { 1.0f / Ray.Direction.x, 1.0f / Ray.Direction.y, 1.0f / Ray.Direction.z };
+
+		uint32_t Stack[MaxDepth * 2];
+		uint32_t StackSize = 0;
+		Stack[StackSize++] = 0;
+		while (StackSize > 0)
+		{
+			const Node& Node = Nodes[Stack[--StackSize]];
+			if (IntersectBounds(Node.Min, Node.Max, Ray.Origin, InverseDirection, Ray.TMin, Ray.TMax) == FLT_MAX)
+			{
+				continue;
+			}
+
+			if (Node.IsLeaf())
+			{
+				RayHit Hit;
+				for (uint32_t i = 0; i < Node.NumPrimitives; ++i)
+				{
+					if (IntersectTriangle(Ray, PrimitiveIndices[Node.LeftFirst + i], &Hit))
+					{
+						return true;
+					}
+				}
+				continue;
+			}
+
+			Stack[StackSize++] = Node.LeftFirst + 1;
+			Stack[StackSize++] = Node.LeftFirst;
+		}
+
+		return false;
+	}
+
+	void BVH::Subdivide(uint32_t NodeIndex, uint32_t Depth, std::span<const float3> Centroids)
+	{
+		Node& Node = Nodes[NodeIndex];
+		if (Node.NumPrimitives <= MaxPrimitivesPerLeaf || Depth + 1 >= MaxDepth)
+		{
+			return;
+		}
+
+		const uint32_t First = Node.LeftFirst;
+		const uint32_t Last = First + Node.NumPrimitives;
+
+		Bounds CentroidBounds;
+		for (uint32_t i = First; i < Last; ++i)
+		{
+			CentroidBounds.Grow(Centroids[PrimitiveIndices[i]]);
+		}
+
+		struct Bin
+		{
+			Bounds Box;
+			uint32_t NumPrimitives = 0;
+		};
+
+		float BestCost = FLT_MAX;
+		uint32_t BestAxis = 0;
+		uint32_t BestSplit = 0;
+		for (uint32_t Axis = 0; Axis < 3; ++Axis)
+		{
+			const float Min = Component(CentroidBounds.Min, Axis);
+			const float Extent = Component(CentroidBounds.Max, Axis) - Min;
+			if (Extent <= 0.0f)
+			{
+				continue;
+			}
+
+			Bin Bins[NumBins];
+			const float Scale = float(NumBins) / Extent;
+			for (uint32_t i = First; i < Last; ++i)
+			{
+				const uint32_t Primitive = PrimitiveIndices[i];
+				const uint32_t b = std::min(NumBins - 1, static_cast<uint32_t>((Component(Centroids[Primitive], Axis) - Min) * Scale));
+				Bins[b].NumPrimitives++;
+				Bins[b].Box.Grow(Positions[Indices[Primitive * 3 + 0]]);
+				Bins[b].Box.Grow(Positions[Indices[Primitive * 3 + 1]]);
+				Bins[b].Box.Grow(Positions[Indices[Primitive * 3 + 2]]);
+			}
+
+			// Sweep from both sides, split i puts bins [0, i) on the left
+			float LeftCosts[NumBins] = {};
+			Bounds LeftBounds;
+			uint32_t LeftCount = 0;
+			for (uint32_t i = 1; i < NumBins; ++i)
+			{
+				LeftBounds.Grow(Bins[i - 1].Box);
+				LeftCount += Bins[i - 1].NumPrimitives;
+				LeftCosts[i] = LeftCount > 0 ? LeftCount * LeftBounds.Area() : 0.0f;
+			}
+
+			Bounds RightBounds;
+			uint32_t RightCount = 0;
+			for (uint32_t i = NumBins - 1; i > 0; --i)
+			{
+				RightBounds.Grow(Bins[i].Box);
+				RightCount += Bins[i].NumPrimitives;
+
+				const float Cost = LeftCosts[i] + (RightCount > 0 ? RightCount * RightBounds.Area() : 0.0f);
+				if (Cost < BestCost)
+				{
+					BestCost = Cost;
+					BestAxis = Axis;
+					BestSplit = i;
+				}
+			}
+		}
+
+		Bounds NodeBounds = { Node.Min, Node.Max };
+		const float SplitCost = TraversalCost + BestCost / NodeBounds.Area();
+		const float LeafCost = float(Node.NumPrimitives);
+		if (BestCost == FLT_MAX || SplitCost >= LeafCost)
+		{
+			return;
+		}
+
+		const float Min = Component(CentroidBounds.Min, BestAxis);
+		const float Scale = float(NumBins) / (Component(CentroidBounds.Max, BestAxis) - Min);
+		const auto Middle = std::partition(PrimitiveIndices.begin() + First, PrimitiveIndices.begin() + Last, [&](uint32_t Primitive)
+		{
+			return std::min(NumBins - 1, static_cast<uint32_t>((Component(Centroids[Primitive], BestAxis) - Min) * Scale)) < BestSplit;
+		});
+
+		const uint32_t LeftCount = static_cast<uint32_t>(std::distance(PrimitiveIndices.begin() + First, Middle));
+		if (LeftCount == 0 || LeftCount == Node.NumPrimitives)
+		{
+			return;
+		}
+
+		const uint32_t LeftIndex = static_cast<uint32_t>(Nodes.size());
+		Nodes.push_back({ .LeftFirst = First, .NumPrimitives = LeftCount });
+		Nodes.push_back({ .LeftFirst = First + LeftCount, .NumPrimitives = Node.NumPrimitives - LeftCount });
+		Node.LeftFirst = LeftIndex;
+		Node.NumPrimitives = 0;
+
+		UpdateBounds(LeftIndex);
+		UpdateBounds(LeftIndex + 1);
+		Subdivide(LeftIndex, Depth + 1, Centroids);
+		Subdivide(LeftIndex + 1, Depth + 1, Centroids);
+	}
+
+	void BVH::SubdivideClusters(uint32_t NodeIndex, uint32_t Depth, std::span<uint32_t> ClusterIndices, std::span<const Cluster> Clusters, std::span<const float3> Centroids)
+	{
+		// A single cluster becomes a leaf over its triangles which is then refined like any other node
+		if (ClusterIndices.size() == 1)
+		{
+			const Cluster& Cluster = Clusters[ClusterIndices[0]];
+			Nodes[NodeIndex] = { .LeftFirst = Cluster.FirstPrimitive, .NumPrimitives = Cluster.NumPrimitives };
+			UpdateBounds(NodeIndex);
+			Subdivide(NodeIndex, Depth, Centroids);
+			return;
+		}
+
+		Bounds NodeBounds, CentroidBounds;
+		for (uint32_t Index : ClusterIndices)
+		{
+			NodeBounds.Grow({ Clusters[Index].Min, Clusters[Index].Max });
+			CentroidBounds.Grow(Clusters[Index].Centroid);
+		}
+		Nodes[NodeIndex].Min = NodeBounds.Min;
+		Nodes[NodeIndex].Max = NodeBounds.Max;
+
+		struct Bin
+		{
+			Bounds Box;
+			uint32_t NumPrimitives = 0;
+		};
+
+		// Same binned SAH as Subdivide, clusters are weighted by their triangle count. Clusters are never split
+		// between nodes so a split is always made, falling back to the median when the centroids coincide
+		float BestCost = FLT_MAX;
+		uint32_t BestAxis = 0;
+		uint32_t BestSplit = 0;
+		for (uint32_t Axis = 0; Axis < 3; ++Axis)
+		{
+			const float Min = Component(CentroidBounds.Min, Axis);
+			const float Extent = Component(CentroidBounds.Max, Axis) - Min;
+			if (Extent <= 0.0f)
+			{
+				continue;
+			}
+
+			Bin Bins[NumBins];
+			const float Scale = float(NumBins) / Extent;
+			for (uint32_t Index : ClusterIndices)
+			{
+				const uint32_t b = std::min(NumBins - 1, static_cast<uint32_t>((Component(Clusters[Index].Centroid, Axis) - Min) * Scale));
+				Bins[b].NumPrimitives += Clusters[Index].NumPrimitives;
+				Bins[b].Box.Grow({ Clusters[Index].Min, Clusters[Index].Max });
+			}
+
+			float LeftCosts[NumBins] = {};
+			uint32_t LeftCounts[NumBins] = {};
+			Bounds LeftBounds;
+			for (uint32_t i = 1; i < NumBins; ++i)
+			{
+				LeftBounds.Grow(Bins[i - 1].Box);
+				LeftCounts[i] = LeftCounts[i - 1] + Bins[i - 1].NumPrimitives;
+				LeftCosts[i] = LeftCounts[i] > 0 ? LeftCounts[i] * LeftBounds.Area() : 0.0f;
+			}
+
+			Bounds RightBounds;
+			uint32_t RightCount = 0;
+			for (uint32_t i = NumBins - 1; i > 0; --i)
+			{
+				RightBounds.Grow(Bins[i].Box);
+				RightCount += Bins[i].NumPrimitives;
+
+				const float Cost = LeftCosts[i] + (RightCount > 0 ? RightCount * RightBounds.Area() : 0.0f);
+				if (LeftCounts[i] > 0 && RightCount > 0 && Cost < BestCost)
+				{
+					BestCost = Cost;
+					BestAxis = Axis;
+					BestSplit = i;
+				}
+			}
+		}
+
+		// Leaves of the subtree must stay above MaxDepth, the traversal stack is sized for it. Once only balanced splits
+		// still fit, clusters are split at the median along the largest centroid extent
+		const bool SplitAtMedian = Depth + 1 + std::bit_width(ClusterIndices.size()) >= MaxDepth;
+
+		size_t LeftCount = ClusterIndices.size() / 2;
+		if (SplitAtMedian)
+		{
+			const float3 Extent = {
+				CentroidBounds.Max.x - CentroidBounds.Min.x,
+				CentroidBounds.Max.y - CentroidBounds.Min.y,
+				CentroidBounds.Max.z - CentroidBounds.Min.z
+			};
+			const uint32_t Axis = Extent.x > Extent.y ? (Extent.x > Extent.z ? 0 : 2) : (Extent.y > Extent.z ? 1 : 2);
+			std::nth_element(ClusterIndices.begin(), ClusterIndices.begin() + LeftCount, ClusterIndices.end(), [&](uint32_t a, uint32_t b)
+			{
+				return Component(Clusters[a].Centroid, Axis) < Component(Clusters[b].Centroid, Axis);
+			});
+		}
+		else if (BestCost != FLT_MAX)
+		{
+			const float Min = Component(CentroidBounds.Min, BestAxis);
+			const float Scale = float(NumBins) / (Component(CentroidBounds.Max, BestAxis) - Min);
+			const auto Middle = std::partition(ClusterIndices.begin(), ClusterIndices.end(), [&](uint32_t Index)
+			{
+				return std::min(NumBins - 1, static_cast<uint32_t>((Component(Clusters[Index].Centroid, BestAxis) - Min) * Scale)) < BestSplit;
+			});
+			LeftCount = static_cast<size_t>(std::distance(ClusterIndices.begin(), Middle));
+		}
+
+		const uint32_t LeftIndex = static_cast<uint32_t>(Nodes.size());
+		Nodes.push_back({});
+		Nodes.push_back({});
+		Nodes[NodeIndex].LeftFirst = LeftIndex;
+		Nodes[NodeIndex].NumPrimitives = 0;
+
+		SubdivideClusters(LeftIndex, Depth + 1, ClusterIndices.first(LeftCount), Clusters, Centroids);
+		SubdivideClusters(LeftIndex + 1, Depth + 1, ClusterIndices.subspan(LeftCount), Clusters, Centroids);
+	}
+
+	void BVH::LoadPositions(const Asset::Mesh& Mesh)
+	{
+		std::vector<Vertex> Decoded;
+		if (Mesh.GetVertexFormat() == VertexFormat::Compact)
+		{
+			Decoded = DecodeVertices(Mesh);
+		}
+		const auto& Vertices = Mesh.GetVertexFormat() == VertexFormat::Compact ? Decoded : Mesh.Vertices;
+
+		Positions.resize(Vertices.size());
+		std::transform(Vertices.begin(), Vertices.end(), Positions.begin(), [](const Vertex& Vertex)
+		{
+			return Vertex.Position;
+		});
+	}
+
+	std::vector<float3> BVH::ComputeCentroids() const
+	{
+		std::vector<float3> Centroids(Indices.size() / 3);
+		for (size_t i = 0; i < Centroids.size(); ++i)
+		{
+			const float3& p0 = Positions[Indices[i * 3 + 0]];
+			const float3& p1 = Positions[Indices[i * 3 + 1]];
+			const float3& p2 = Positions[Indices[i * 3 + 2]];
+			Centroids[i] = { (p0.x + p1.x + p2.x) / 3.0f, (p0.y + p1.y + p2.y) / 3.0f, (p0.z + p1.z + p2.z) / 3.0f };
+		}
+		return Centroids;
+	}
+
+	void BVH::UpdateBounds(uint32_t NodeIndex)
+	{
+		Node& Node = Nodes[NodeIndex];
+
+		Bounds Bounds;
+		for (uint32_t i = 0; i < Node.NumPrimitives; ++i)
+		{
+			const uint32_t Primitive = PrimitiveIndices[Node.LeftFirst + i];
+			Bounds.Grow(Positions[Indices[Primitive * 3 + 0]]);
+			Bounds.Grow(Positions[Indices[Primitive * 3 + 1]]);
+			Bounds.Grow(Positions[Indices[Primitive * 3 + 2]]);
+		}
+		Node.Min = Bounds.Min;
+		Node.Max = Bounds.Max;
+	}
+
+	void BVH::ComputeStatistics()
+	{
+		const float RootArea = std::max(Bounds{ Nodes[0].Min, Nodes[0].Max }.Area(), FLT_MIN);
+
+		Statistics.NumNodes = Nodes.size();
+
+		size_t NumCacheLines = 0;
+		std::vector<uint64_t> CacheLines;
+
+		std::vector<std::pair<uint32_t, uint32_t>> Stack = { { 0, 1 } };
+		while (!Stack.empty())
+		{
+			const auto [NodeIndex, Depth] = Stack.back();
+			Stack.pop_back();
+
+			const Node& Node = Nodes[NodeIndex];
+			const float Area = Bounds{ Node.Min, Node.Max }.Area() / RootArea;
+			Statistics.MaxDepth = std::max(Statistics.MaxDepth, Depth);
+
+			if (!Node.IsLeaf())
+			{
+				Statistics.SAHCost += TraversalCost * Area;
+				Stack.push_back({ Node.LeftFirst, Depth + 1 });
+				Stack.push_back({ Node.LeftFirst + 1, Depth + 1 });
+				continue;
+			}
+
+			Statistics.NumLeaves++;
+			Statistics.SAHCost += Area * Node.NumPrimitives;
+
+			// Index and position lines live in different buffers, tag them apart with the top bit
+			CacheLines.clear();
+			for (uint32_t i = 0; i < Node.NumPrimitives; ++i)
+			{
+				const uint32_t Primitive = PrimitiveIndices[Node.LeftFirst + i];
+				for (uint32_t k = 0; k < 3; ++k)
+				{
+					CacheLines.push_back((size_t(Primitive) * 3 + k) * sizeof(uint32_t) / CacheLineSize);
+					CacheLines.push_back((size_t(Indices[Primitive * 3 + k]) * sizeof(float3) / CacheLineSize) | (1ull << 63));
+				}
+			}
+			std::sort(CacheLines.begin(), CacheLines.end());
+			NumCacheLines += std::distance(CacheLines.begin(), std::unique(CacheLines.begin(), CacheLines.end()));
+		}
+
+		Statistics.CacheLinesPerLeaf = float(NumCacheLines) / float(Statistics.NumLeaves);
+	}
+
+	bool BVH::IntersectTriangle(const Ray& Ray, uint32_t PrimitiveIndex, RayHit* pHit) const
+	{
+		// Möller-Trumbore
+		constexpr float Epsilon = 1e-8f;
+
+		const float3& p0 = Positions[Indices[PrimitiveIndex * 3 + 0]];
+		const float3& p1 = Positions[Indices[PrimitiveIndex * 3 + 1]];
+		const float3& p2 = Positions[Indices[PrimitiveIndex * 3 + 2]];
+
+		const float3 e1 = Subtract(p1, p0);
+		const float3 e2 = Subtract(p2, p0);
+		const float3 p = Cross(Ray.Direction, e2);
+		const float Determinant = Dot(e1, p);
+		if (std::abs(Determinant) < Epsilon)
+		{
+			return false;
+		}
+
+		const float InverseDeterminant = 1.0f / Determinant;
+		const float3 s = Subtract(Ray.Origin, p0);
+		const float u = Dot(s, p) * InverseDeterminant;
+		if (u < 0.0f || u > 1.0f)
+		{
+			return false;
+		}
+
+		const float3 q = Cross(s, e1);
+		const float v = Dot(Ray.Direction, q) * InverseDeterminant;
+		if (v < 0.0f || u + v > 1.0f)
+		{
+			return false;
+		}
+
+		const float t = Dot(e2, q) * InverseDeterminant;
+		if (t < Ray.TMin || t > Ray.TMax)
+		{
+			return false;
+		}
+
+		pHit->T = t;
+		pHit->U = u;
+		pHit->V = v;
+		pHit->PrimitiveIndex = PrimitiveIndex;
+		return true;
+	}
+
+	std::shared_ptr<BVH> GetOrBuildBVH(Asset::Mesh& Mesh)
+	{
+		if (!Mesh.BVH)
+		{
+			if (Mesh.GetNumVertices() == 0)
+			{
+				LOG_WARN("{} has neither a BVH nor geometry in RAM", Mesh.Name);
+				return nullptr;
+			}
+
+			// Leaves of a meshlet BVH never cross meshlets, see BuildFromMeshlets
+			auto bvh = std::make_shared<BVH>();
+			if (!Mesh.Meshlets.empty())
+			{
+				bvh->BuildFromMeshlets(Mesh);
+			}
+			else
+			{
+				bvh->Build(Mesh);
+			}
+			LOG_INFO("{}: BVH built in {}(ms)", Mesh.Name, bvh->GetStatistics().BuildTime);
+			Mesh.BVH = std::move(bvh);
+		}
+		return Mesh.BVH;
+	}
+}
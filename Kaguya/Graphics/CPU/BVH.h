@@ -0,0 +1,127 @@
+#pragma once
+#include <span>
+
+#include "../Asset/Mesh.h"
+#include "../Asset/AssetStream.h"
+
+namespace CPU
+{
+	struct Ray
+	{
+		float3 Origin;
+		float TMin;
+		float3 Direction;
+		float TMax;
+	};
+
+	struct RayHit
+	{
+		float T;
+		float U; // Barycentrics
+		float V;
+		uint32_t PrimitiveIndex; // Triangle index in build order, see BVH::GetTriangle
+	};
+
+	struct BVHStatistics
+	{
+		size_t NumNodes;
+		size_t NumLeaves;
+		uint32_t MaxDepth;
+		float SAHCost;
+
+		// Average number of distinct 64 byte cache lines of index and position data a leaf touches,
+		// this only depends on how the mesh is laid out in memory so it measures the ordering of the mesh
+		float CacheLinesPerLeaf;
+
+		float BuildTime; // Milliseconds
+	};
+
+	/*
+	* Binned SAH bounding volume hierarchy over the triangles of a mesh, used by CPU side ray queries.
+	* Leaves reference triangles of the mesh through the index buffer instead of storing their own copy,
+	* so memory access during traversal follows the vertex and index order of the mesh.
+	*/
+	class BVH
+	{
+	public:
+		static constexpr uint32_t NumBins = 16;
+		static constexpr uint32_t MaxPrimitivesPerLeaf = 4;
+		static constexpr uint32_t MaxDepth = 64;
+
+		struct Node
+		{
+			float3 Min;
+			uint32_t LeftFirst; // Left child for interior nodes (right child is LeftFirst + 1), first primitive for leaves
+			float3 Max;
+			uint32_t NumPrimitives; // 0 for interior nodes
+
+			[[nodiscard]] bool IsLeaf() const { return NumPrimitives > 0; }
+		};
+		static_assert(sizeof(Node) == 32);
+
+		// Builds over every submesh, works with either vertex format and packed or unpacked indices
+		void Build(const Asset::Mesh& Mesh);
+
+		// Builds over the meshlets of the mesh, see BuildMeshlets. The top levels are built over meshlet bounds
+		// and every meshlet becomes a subtree of its own, so the triangles of a leaf never cross meshlets
+		void BuildFromMeshlets(const Asset::Mesh& Mesh);
+
+		// Sections of a BVH stored alongside a cooked mesh, see SceneBundle
+		static constexpr uint32_t NodeSectionId = MAKEFOURCC('B', 'V', 'H', 'N');
+		static constexpr uint32_t PrimitiveSectionId = MAKEFOURCC('B', 'V', 'H', 'P');
+		static constexpr uint32_t PositionSectionId = MAKEFOURCC('B', 'V', 'H', 'V');
+		static constexpr uint32_t IndexSectionId = MAKEFOURCC('B', 'V', 'H', 'I');
+
+		void Write(AssetStreamWriter& Writer) const;
+
+		// Returns false if the stream does not contain a BVH
+		bool Read(const AssetStreamReader& Reader);
+
+		[[nodiscard]] bool IsEmpty() const { return Nodes.empty(); }
+		[[nodiscard]] const BVHStatistics& GetStatistics() const { return Statistics; }
+		[[nodiscard]] const std::vector<Node>& GetNodes() const { return Nodes; }
+
+		// Indices of a hit triangle, offset by the base vertex of its submesh
+		[[nodiscard]] const uint32_t* GetTriangle(uint32_t PrimitiveIndex) const { return &Indices[size_t(PrimitiveIndex) * 3]; }
+		[[nodiscard]] const float3& GetPosition(uint32_t Index) const { return Positions[Index]; }
+		[[nodiscard]] uint32_t GetNumTriangles() const { return static_cast<uint32_t>(Indices.size() / 3); }
+
+		// Closest hit, returns false on miss
+		bool Intersect(const Ray& Ray, RayHit* pHit) const;
+
+		// Any hit, used for shadow rays
+		[[nodiscard]] bool Occluded(const Ray& Ray) const;
+	private:
+		struct Cluster
+		{
+			float3 Min;
+			float3 Max;
+			float3 Centroid;
+			uint32_t FirstPrimitive;
+			uint32_t NumPrimitives;
+		};
+
+		void LoadPositions(const Asset::Mesh& Mesh);
+		[[nodiscard]] std::vector<float3> ComputeCentroids() const;
+
+		void Subdivide(uint32_t NodeIndex, uint32_t Depth, std::span<const float3> Centroids);
+		void SubdivideClusters(uint32_t NodeIndex, uint32_t Depth, std::span<uint32_t> ClusterIndices, std::span<const Cluster> Clusters, std::span<const float3> Centroids);
+		void UpdateBounds(uint32_t NodeIndex);
+		void ComputeStatistics();
+
+		bool IntersectTriangle(const Ray& Ray, uint32_t PrimitiveIndex, RayHit* pHit) const;
+
+		// Mesh geometry in the order of the mesh (meshlet order for BuildFromMeshlets), indices are offset by the base vertex of their submesh
+		std::vector<float3> Positions;
+		std::vector<uint32_t> Indices;
+
+		std::vector<uint32_t> PrimitiveIndices; // Leaves reference ranges of this
+		std::vector<Node> Nodes;
+
+		BVHStatistics Statistics = {};
+	};
+
+	// Returns the BVH of the mesh and builds it first if the mesh does not have one yet, must be called on the main
+	// thread. Null when the mesh has neither a BVH nor geometry in RAM
+	std::shared_ptr<BVH> GetOrBuildBVH(Asset::Mesh& Mesh);
+}
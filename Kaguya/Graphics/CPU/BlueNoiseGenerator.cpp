@@ -0,0 +1,624 @@
+#include "pch.h"
+#include "BlueNoiseGenerator.h"
+#include "Parallel.h"
+
+#include <complex>
+#include <future>
+#include <numeric>
+#include <random>
+
+using namespace DirectX;
+
+namespace CPU
+{
+	namespace
+	{
+		// Texels per block and blocks per group of the hierarchy searched for the tightest cluster and the largest void
+		constexpr size_t BlockSize = 16;
+		constexpr size_t GroupSize = 16;
+
+		// Ranks a slice assigns before the next slices get their turn, temporal neighbors lag behind by at most this
+		constexpr size_t RanksPerStep = 64;
+
+		// Fraction of texels in the initial point set
+		constexpr float InitialDensity = 0.1f;
+
+		bool IsPowerOfTwo(size_t Value)
+		{
+			return Value != 0 && (Value & (Value - 1)) == 0;
+		}
+
+		// Toroidal wrap for power of two sizes
+		size_t Wrap(ptrdiff_t Value, size_t Size)
+		{
+			return static_cast<size_t>(Value) & (Size - 1);
+		}
+
+		void Validate(const BlueNoiseGenerator::Options& Options)
+		{
+			if (!IsPowerOfTwo(Options.Width) || Options.Width < 16 ||
+				!IsPowerOfTwo(Options.Height) || Options.Height < 16 ||
+				!IsPowerOfTwo(Options.Depth) ||
+				(Options.NumChannels != 1 && Options.NumChannels != 2 && Options.NumChannels != 4) ||
+				Options.Sigma <= 0.0f || Options.TemporalSigma < 0.0f)
+			{
+				throw std::exception("Invalid blue noise options");
+			}
+		}
+
+		// Gaussian truncated at 3 sigma along one axis of a torus of Size texels
+		struct Kernel
+		{
+			Kernel(float Sigma, size_t Size)
+			{
+				// Clamped so the kernel never wraps onto itself
+				Radius = std::min(static_cast<int>(std::ceil(3.0f * Sigma)), static_cast<int>(Size - 1) / 2);
+				for (int i = -Radius; i <= Radius; ++i)
+				{
+					Weights.push_back(i == 0 ? 1.0f : std::exp(-static_cast<float>(i * i) / (2.0f * Sigma * Sigma)));
+				}
+			}
+
+			float operator[](int Offset) const
+			{
+				return Weights[Radius + Offset];
+			}
+
+			// The kernel is even, so its DFT is real
+			std::vector<float> Spectrum(size_t Size) const
+			{
+				std::vector<float> spectrum(Size);
+				for (size_t u = 0; u < Size; ++u)
+				{
+					double value = Weights[Radius];
+					for (int i = 1; i <= Radius; ++i)
+					{
+						value += 2.0 * Weights[Radius + i] * std::cos(2.0 * XM_PI * static_cast<double>(u * i % Size) / static_cast<double>(Size));
+					}
+					spectrum[u] = static_cast<float>(value);
+				}
+				return spectrum;
+			}
+
+			int Radius;
+			std::vector<float> Weights;
+		};
+
+		// Iterative radix-2 FFT of power of two sizes, the inverse transform is not scaled
+		class FFT
+		{
+		public:
+			explicit FFT(size_t Size)
+				: Size(Size),
+				Twiddles(Size / 2)
+			{
+				for (size_t k = 0; k < Size / 2; ++k)
+				{
+					const double angle = -2.0 * XM_PI * static_cast<double>(k) / static_cast<double>(Size);
+					Twiddles[k] = { static_cast<float>(std::cos(angle)), static_cast<float>(std::sin(angle)) };
+				}
+			}
+
+			void Transform(std::complex<float>* Data, bool Inverse) const
+			{
+				for (size_t i = 1, j = 0; i < Size; ++i)
+				{
+					size_t bit = Size >> 1;
+					for (; j & bit; bit >>= 1)
+					{
+						j ^= bit;
+					}
+					j ^= bit;
+
+					if (i < j)
+					{
+						std::swap(Data[i], Data[j]);
+					}
+				}
+
+				for (size_t length = 2; length <= Size; length <<= 1)
+				{
+					const size_t half = length / 2;
+					const size_t twiddleStride = Size / length;
+					for (size_t i = 0; i < Size; i += length)
+					{
+						for (size_t k = 0; k < half; ++k)
+						{
+							const std::complex<float> w = Inverse ? std::conj(Twiddles[k * twiddleStride]) : Twiddles[k * twiddleStride];
+							const std::complex<float> even = Data[i + k];
+							const std::complex<float> odd = Data[i + k + half] * w;
+							Data[i + k] = even + odd;
+							Data[i + k + half] = even - odd;
+						}
+					}
+				}
+			}
+
+			// Transforms every line along each axis of a Width x Height x Depth volume
+			static void Transform3D(std::vector<std::complex<float>>& Volume, size_t Width, size_t Height, size_t Depth, bool Inverse)
+			{
+				const size_t sizes[] = { Width, Height, Depth };
+				const size_t strides[] = { 1, Width, Width * Height };
+				for (size_t axis = 0; axis < 3; ++axis)
+				{
+					const size_t size = sizes[axis];
+					const size_t stride = strides[axis];
+					if (size == 1)
+					{
+						continue;
+					}
+
+					const FFT fft(size);
+					ParallelFor(Volume.size() / size, 64, [&](size_t Begin, size_t End)
+					{
+						std::vector<std::complex<float>> line(size);
+						for (size_t i = Begin; i < End; ++i)
+						{
+							// Lines start at every texel whose coordinate along the axis is 0
+							const size_t base = (i / stride) * stride * size + i % stride;
+							for (size_t k = 0; k < size; ++k)
+							{
+								line[k] = Volume[base + k * stride];
+							}
+
+							fft.Transform(line.data(), Inverse);
+
+							for (size_t k = 0; k < size; ++k)
+							{
+								Volume[base + k * stride] = line[k];
+							}
+						}
+					});
+				}
+			}
+		private:
+			size_t Size;
+			std::vector<std::complex<float>> Twiddles;
+		};
+
+		class VoidAndCluster
+		{
+		public:
+			explicit VoidAndCluster(const BlueNoiseGenerator::Options& Options)
+				: Width(Options.Width),
+				Height(Options.Height),
+				Depth(Options.Depth),
+				NumTexels(Options.Width * Options.Height),
+				NumBlocks(NumTexels / BlockSize),
+				NumGroups(NumBlocks / GroupSize),
+				KernelX(Options.Sigma, Options.Width),
+				KernelY(Options.Sigma, Options.Height),
+				KernelT(Options.TemporalSigma, Options.Depth)
+			{
+				// Slices closer than this share energy texels and cannot take ranks concurrently
+				SliceStride = 1;
+				while (SliceStride < static_cast<size_t>(2 * KernelT.Radius + 1))
+				{
+					SliceStride <<= 1;
+				}
+				SliceStride = std::min(SliceStride, Depth);
+
+				Current.Energy.resize(NumTexels * Depth);
+				Current.Blocks.resize(NumBlocks * Depth);
+				Current.Groups.resize(NumGroups * Depth);
+			}
+
+			std::vector<uint32_t> Rank(uint32_t Seed)
+			{
+				const size_t numInitialPoints = std::max<size_t>(static_cast<size_t>(InitialDensity * static_cast<float>(NumTexels)), 1);
+
+				// Start from white noise
+				std::mt19937 random(Seed);
+				std::vector<uint32_t> texels(NumTexels);
+				Current.Points.assign(NumTexels * Depth, 0);
+				for (size_t slice = 0; slice < Depth; ++slice)
+				{
+					std::iota(texels.begin(), texels.end(), 0);
+					for (size_t i = 0; i < numInitialPoints; ++i)
+					{
+						std::swap(texels[i], texels[i + random() % (NumTexels - i)]);
+						Current.Points[slice * NumTexels + texels[i]] = 1;
+					}
+				}
+
+				EvaluateEnergy();
+
+				// Move points from the tightest cluster to the largest void until no slice changes
+				std::vector<uint8_t> stable(Depth, 0);
+				for (size_t iteration = 0; iteration < NumTexels && std::find(stable.begin(), stable.end(), 0) != stable.end(); iteration += RanksPerStep)
+				{
+					ForEachSlice([&](size_t Slice)
+					{
+						for (size_t i = 0; i < RanksPerStep && !stable[Slice]; ++i)
+						{
+							const size_t cluster = Find(Slice, true);
+							Toggle(Slice, cluster);
+							const size_t largestVoid = Find(Slice, false);
+							Toggle(Slice, largestVoid);
+							stable[Slice] = largestVoid == cluster;
+						}
+					});
+				}
+
+				const State initial = Current;
+				std::vector<uint32_t> ranks(NumTexels * Depth);
+
+				// Phase 1: remove the tightest clusters, the initial points are ranked from last to first
+				ForEachRank(numInitialPoints, [&](size_t Slice, size_t Rank)
+				{
+					const size_t texel = Find(Slice, true);
+					Toggle(Slice, texel);
+					ranks[Slice * NumTexels + texel] = static_cast<uint32_t>(numInitialPoints - 1 - Rank);
+				});
+
+				// Phase 2 and 3: fill the largest voids. The kernel sums to the same value at every texel of the torus, so
+				// the empty texel with the lowest energy is also the tightest cluster of empty texels and phase 3 needs
+				// no inverted pattern
+				Current = initial;
+				ForEachRank(NumTexels - numInitialPoints, [&](size_t Slice, size_t Rank)
+				{
+					const size_t texel = Find(Slice, false);
+					Toggle(Slice, texel);
+					ranks[Slice * NumTexels + texel] = static_cast<uint32_t>(numInitialPoints + Rank);
+				});
+
+				return ranks;
+			}
+		private:
+			// Energies of the texels in a block or group, points are ranked by MaxCluster and empty texels by MinVoid
+			struct Extrema
+			{
+				float MinVoid;
+				float MaxCluster;
+			};
+
+			struct State
+			{
+				std::vector<uint8_t> Points;
+				std::vector<float> Energy;
+				std::vector<Extrema> Blocks;
+				std::vector<Extrema> Groups;
+			};
+
+			// Energy = Points convolved with the kernel, evaluated as a product of spectra
+			void EvaluateEnergy()
+			{
+				std::vector<std::complex<float>> volume(Current.Points.begin(), Current.Points.end());
+				FFT::Transform3D(volume, Width, Height, Depth, false);
+
+				const std::vector<float> spectrumX = KernelX.Spectrum(Width);
+				const std::vector<float> spectrumY = KernelY.Spectrum(Height);
+				const std::vector<float> spectrumT = KernelT.Spectrum(Depth);
+				ParallelFor(Depth * Height, 64, [&](size_t Begin, size_t End)
+				{
+					for (size_t row = Begin; row < End; ++row)
+					{
+						const float weight = spectrumT[row / Height] * spectrumY[row % Height];
+						for (size_t x = 0; x < Width; ++x)
+						{
+							volume[row * Width + x] *= weight * spectrumX[x];
+						}
+					}
+				});
+
+				FFT::Transform3D(volume, Width, Height, Depth, true);
+
+				const float scale = 1.0f / static_cast<float>(volume.size());
+				for (size_t i = 0; i < volume.size(); ++i)
+				{
+					Current.Energy[i] = volume[i].real() * scale;
+				}
+
+				for (size_t slice = 0; slice < Depth; ++slice)
+				{
+					for (size_t block = 0; block < NumBlocks; ++block)
+					{
+						RefreshBlock(slice, block);
+					}
+					for (size_t group = 0; group < NumGroups; ++group)
+					{
+						RefreshGroup(slice, group);
+					}
+				}
+			}
+
+			void RefreshBlock(size_t Slice, size_t Block)
+			{
+				Extrema extrema = { std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity() };
+				const size_t first = Slice * NumTexels + Block * BlockSize;
+				for (size_t i = first; i < first + BlockSize; ++i)
+				{
+					if (Current.Points[i])
+					{
+						extrema.MaxCluster = std::max(extrema.MaxCluster, Current.Energy[i]);
+					}
+					else
+					{
+						extrema.MinVoid = std::min(extrema.MinVoid, Current.Energy[i]);
+					}
+				}
+				Current.Blocks[Slice * NumBlocks + Block] = extrema;
+			}
+
+			void RefreshGroup(size_t Slice, size_t Group)
+			{
+				Extrema extrema = { std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity() };
+				const size_t first = Slice * NumBlocks + Group * GroupSize;
+				for (size_t i = first; i < first + GroupSize; ++i)
+				{
+					extrema.MinVoid = std::min(extrema.MinVoid, Current.Blocks[i].MinVoid);
+					extrema.MaxCluster = std::max(extrema.MaxCluster, Current.Blocks[i].MaxCluster);
+				}
+				Current.Groups[Slice * NumGroups + Group] = extrema;
+			}
+
+			// Returns the texel of the point with the highest energy or of the empty texel with the lowest energy
+			size_t Find(size_t Slice, bool TightestCluster) const
+			{
+				auto Score = [TightestCluster](const Extrema& Extrema)
+				{
+					return TightestCluster ? Extrema.MaxCluster : -Extrema.MinVoid;
+				};
+
+				const Extrema* pGroups = &Current.Groups[Slice * NumGroups];
+				size_t group = 0;
+				for (size_t i = 1; i < NumGroups; ++i)
+				{
+					group = Score(pGroups[i]) > Score(pGroups[group]) ? i : group;
+				}
+
+				const Extrema* pBlocks = &Current.Blocks[Slice * NumBlocks];
+				size_t block = group * GroupSize;
+				for (size_t i = block + 1; i < (group + 1) * GroupSize; ++i)
+				{
+					block = Score(pBlocks[i]) > Score(pBlocks[block]) ? i : block;
+				}
+
+				const size_t first = block * BlockSize;
+				size_t texel = first;
+				float best = -std::numeric_limits<float>::infinity();
+				for (size_t i = first; i < first + BlockSize; ++i)
+				{
+					const size_t index = Slice * NumTexels + i;
+					const float score = TightestCluster ? Current.Energy[index] : -Current.Energy[index];
+					if (static_cast<bool>(Current.Points[index]) == TightestCluster && score >= best)
+					{
+						best = score;
+						texel = i;
+					}
+				}
+				return texel;
+			}
+
+			// Adds or removes a point and splats the kernel into the energy of the slices within its temporal radius
+			void Toggle(size_t Slice, size_t Texel)
+			{
+				const size_t index = Slice * NumTexels + Texel;
+				Current.Points[index] ^= 1;
+
+				const float sign = Current.Points[index] ? 1.0f : -1.0f;
+				const ptrdiff_t x = static_cast<ptrdiff_t>(Texel % Width);
+				const ptrdiff_t y = static_cast<ptrdiff_t>(Texel / Width);
+
+				// Columns covered by the kernel, rows that wrap around are rescanned entirely
+				const bool wraps = x - KernelX.Radius < 0 || x + KernelX.Radius >= static_cast<ptrdiff_t>(Width);
+				const size_t firstColumn = wraps ? 0 : static_cast<size_t>(x - KernelX.Radius);
+				const size_t lastColumn = wraps ? Width - 1 : static_cast<size_t>(x + KernelX.Radius);
+
+				for (int dt = -KernelT.Radius; dt <= KernelT.Radius; ++dt)
+				{
+					const size_t slice = Wrap(static_cast<ptrdiff_t>(Slice) + dt, Depth);
+					float* pEnergy = &Current.Energy[slice * NumTexels];
+
+					for (int dy = -KernelY.Radius; dy <= KernelY.Radius; ++dy)
+					{
+						const size_t row = Wrap(y + dy, Height);
+						const float weight = sign * KernelT[dt] * KernelY[dy];
+						if (wraps)
+						{
+							for (int dx = -KernelX.Radius; dx <= KernelX.Radius; ++dx)
+							{
+								pEnergy[row * Width + Wrap(x + dx, Width)] += weight * KernelX[dx];
+							}
+						}
+						else
+						{
+							float* pRow = pEnergy + row * Width + firstColumn;
+							for (size_t i = 0; i < KernelX.Weights.size(); ++i)
+							{
+								pRow[i] += weight * KernelX.Weights[i];
+							}
+						}
+
+						for (size_t block = (row * Width + firstColumn) / BlockSize; block <= (row * Width + lastColumn) / BlockSize; ++block)
+						{
+							RefreshBlock(slice, block);
+						}
+					}
+
+					// Rows are contiguous unless they wrap around vertically, then every group of the slice is rescanned
+					const ptrdiff_t firstRow = y - KernelY.Radius;
+					const ptrdiff_t lastRow = y + KernelY.Radius;
+					const bool wrapsVertically = firstRow < 0 || lastRow >= static_cast<ptrdiff_t>(Height);
+					const size_t firstGroup = wrapsVertically ? 0 : static_cast<size_t>(firstRow) * Width / BlockSize / GroupSize;
+					const size_t lastGroup = wrapsVertically ? NumGroups - 1 : (static_cast<size_t>(lastRow) * Width + Width - 1) / BlockSize / GroupSize;
+					for (size_t group = firstGroup; group <= lastGroup; ++group)
+					{
+						RefreshGroup(slice, group);
+					}
+				}
+			}
+
+			// Calls Function(Slice) for every slice, slices SliceStride apart run concurrently
+			template<typename TFunction>
+			void ForEachSlice(TFunction Function)
+			{
+				for (size_t offset = 0; offset < SliceStride; ++offset)
+				{
+					ParallelFor(Depth / SliceStride, 1, [&](size_t Begin, size_t End)
+					{
+						for (size_t i = Begin; i < End; ++i)
+						{
+							Function(offset + i * SliceStride);
+						}
+					});
+				}
+			}
+
+			// Calls Function(Slice, Rank) for ranks [0, Count) of every slice, slices advance RanksPerStep ranks at a time
+			template<typename TFunction>
+			void ForEachRank(size_t Count, TFunction Function)
+			{
+				for (size_t first = 0; first < Count; first += RanksPerStep)
+				{
+					const size_t last = std::min(first + RanksPerStep, Count);
+					ForEachSlice([&](size_t Slice)
+					{
+						for (size_t rank = first; rank < last; ++rank)
+						{
+							Function(Slice, rank);
+						}
+					});
+				}
+			}
+
+			size_t Width;
+			size_t Height;
+			size_t Depth;
+			size_t NumTexels;
+			size_t NumBlocks;
+			size_t NumGroups;
+			size_t SliceStride;
+
+			Kernel KernelX;
+			Kernel KernelY;
+			Kernel KernelT;
+
+			State Current;
+		};
+	}
+
+	int BlueNoiseGenerator::Run(int argc, char* argv[])
+	{
+		Log::Create();
+
+		if (argc < 3)
+		{
+			LOG_ERROR("Usage: {} <OutputFile> [--width N] [--height N] [--depth N] [--channels N] [--temporal-sigma X] [--seed N]", CommandLineFlag);
+			return EXIT_FAILURE;
+		}
+
+		Options options;
+		for (int i = 3; i < argc; ++i)
+		{
+			const std::string_view argument = argv[i];
+			if (argument == "--width" && i + 1 < argc)
+			{
+				options.Width = std::stoul(argv[++i]);
+			}
+			else if (argument == "--height" && i + 1 < argc)
+			{
+				options.Height = std::stoul(argv[++i]);
+			}
+			else if (argument == "--depth" && i + 1 < argc)
+			{
+				options.Depth = std::stoul(argv[++i]);
+			}
+			else if (argument == "--channels" && i + 1 < argc)
+			{
+				options.NumChannels = std::stoul(argv[++i]);
+			}
+			else if (argument == "--temporal-sigma" && i + 1 < argc)
+			{
+				options.TemporalSigma = std::stof(argv[++i]);
+			}
+			else if (argument == "--seed" && i + 1 < argc)
+			{
+				options.Seed = static_cast<uint32_t>(std::stoul(argv[++i]));
+			}
+			else
+			{
+				LOG_ERROR("Unknown option {}", argument);
+				return EXIT_FAILURE;
+			}
+		}
+
+		try
+		{
+			Generate(argv[2], options);
+		}
+		catch (std::exception& e)
+		{
+			LOG_ERROR("Failed to generate blue noise: {}", e.what());
+			return EXIT_FAILURE;
+		}
+
+		return EXIT_SUCCESS;
+	}
+
+	void BlueNoiseGenerator::Generate(const std::filesystem::path& Path, const Options& Options)
+	{
+		Validate(Options);
+
+		const auto start = std::chrono::high_resolution_clock::now();
+
+		DXGI_FORMAT format;
+		switch (Options.NumChannels)
+		{
+		case 1: format = DXGI_FORMAT_R8_UNORM; break;
+		case 2: format = DXGI_FORMAT_R8G8_UNORM; break;
+		default: format = DXGI_FORMAT_R8G8B8A8_UNORM; break;
+		}
+
+		ScratchImage image;
+		ThrowIfFailed(image.Initialize2D(format, Options.Width, Options.Height, Options.Depth, 1));
+
+		// Channels are independent sets, they are ranked concurrently on top of the slices ranked concurrently in a set
+		std::vector<std::future<std::vector<uint32_t>>> channels;
+		for (size_t channel = 0; channel < Options.NumChannels; ++channel)
+		{
+			channels.push_back(std::async(std::launch::async, [&Options, channel]()
+			{
+				return GenerateRanks(Options, Options.Seed + static_cast<uint32_t>(channel) * 0x9e3779b9u);
+			}));
+		}
+
+		const size_t numTexels = Options.Width * Options.Height;
+		for (size_t channel = 0; channel < Options.NumChannels; ++channel)
+		{
+			const std::vector<uint32_t> ranks = channels[channel].get();
+
+			for (size_t slice = 0; slice < Options.Depth; ++slice)
+			{
+				const Image* pImage = image.GetImage(0, slice, 0);
+				for (size_t y = 0; y < Options.Height; ++y)
+				{
+					uint8_t* pRow = pImage->pixels + y * pImage->rowPitch;
+					for (size_t x = 0; x < Options.Width; ++x)
+					{
+						// Every 8-bit level gets the same number of texels
+						const uint64_t rank = ranks[slice * numTexels + y * Options.Width + x];
+						pRow[x * Options.NumChannels + channel] = static_cast<uint8_t>(rank * 256 / numTexels);
+					}
+				}
+			}
+		}
+
+		std::error_code ec;
+		std::filesystem::create_directories(Path.parent_path(), ec);
+
+		ThrowIfFailed(SaveToDDSFile(image.GetImages(), image.GetImageCount(), image.GetMetadata(), DDS_FLAGS_NONE, Path.c_str()));
+
+		const auto stop = std::chrono::high_resolution_clock::now();
+		LOG_INFO("{}x{}x{} blue noise with {} channels generated in {}(ms)",
+			Options.Width, Options.Height, Options.Depth, Options.NumChannels, std::chrono::duration_cast<std::chrono::milliseconds>(stop - start).count());
+	}
+
+	std::vector<uint32_t> BlueNoiseGenerator::GenerateRanks(const Options& Options, uint32_t Seed)
+	{
+		Validate(Options);
+
+		VoidAndCluster voidAndCluster(Options);
+		return voidAndCluster.Rank(Seed);
+	}
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include <filesystem>
+#include <string_view>
+#include <vector>
+
+/*
+* Generates blue noise textures with the void-and-cluster method (Ulichney 1993). A set is Depth slices of
+* Width x Height texels, every slice ranks all of its texels so thresholding it at any level gives a blue noise
+* point set, and every texel holds NumChannels independently generated sets.
+* For Depth > 1 the energy kernel also spans neighboring slices (toroidally), points repel in time as well as in
+* space and a pixel stepping through the slices sees a well distributed sequence, suited for progressive accumulation.
+* The energy of a whole point set is evaluated with FFTs, points added or removed afterwards splat the truncated
+* kernel. Slices that are far enough apart in time are ranked concurrently, and so are the channels.
+*/
+namespace CPU
+{
+	class BlueNoiseGenerator
+	{
+	public:
+		static constexpr std::string_view CommandLineFlag = "--generate-blue-noise";
+
+		struct Options
+		{
+			size_t Width = 128; // Powers of two, at least 16
+			size_t Height = 128;
+			size_t Depth = 64; // Power of two, 1 for a static tile
+			size_t NumChannels = 4; // 1, 2 or 4
+			float Sigma = 1.9f; // Spatial standard deviation of the energy kernel in texels
+			float TemporalSigma = 0.75f; // Temporal standard deviation in slices, larger values trade spatial for temporal quality
+			uint32_t Seed = 0;
+		};
+
+		// Entry point of the editor executable started with CommandLineFlag:
+		// --generate-blue-noise <OutputFile> [--width N] [--height N] [--depth N] [--channels N] [--temporal-sigma X] [--seed N]
+		static int Run(int argc, char* argv[]);
+
+		// Writes the set as an 8-bit UNORM DDS texture array, texel values are floor(rank * 256 / (Width * Height)) / 255
+		static void Generate(const std::filesystem::path& Path, const Options& Options);
+
+		// Returns the rank of every texel of a single channel, slice after slice. Ranks of a slice are a permutation of
+		// [0, Width * Height)
+		static std::vector<uint32_t> GenerateRanks(const Options& Options, uint32_t Seed);
+	};
+}
@@ -0,0 +1,326 @@
+#include "pch.h"
+#include "EnvironmentMap.h"
+#include "Parallel.h"
+#include "Sampling.h"
+#include "../Asset/Image.h"
+#include "../Asset/SceneBundle.h"
+
+#include <random>
+
+using namespace DirectX;
+
+namespace CPU
+{
+	namespace
+	{
+		float Luminance(const float3& L)
+		{
+			return 0.212671f * L.x + 0.715160f * L.y + 0.072169f * L.z;
+		}
+
+		// Fills Cdf with the N + 1 values of the CDF of Function, returns its sum. Functions that are 0 everywhere get
+		// a uniform CDF
+		double BuildCdf(const float* Function, size_t N, float* Cdf)
+		{
+			double sum = 0.0;
+			Cdf[0] = 0.0f;
+			for (size_t i = 0; i < N; ++i)
+			{
+				sum += Function[i];
+				Cdf[i + 1] = static_cast<float>(sum);
+			}
+
+			for (size_t i = 1; i <= N; ++i)
+			{
+				Cdf[i] = sum > 0.0 ? static_cast<float>(Cdf[i] / sum) : static_cast<float>(i) / static_cast<float>(N);
+			}
+			Cdf[N] = 1.0f;
+			return sum;
+		}
+
+		// Inverts the CDF, returns the continuous position in [0, 1) and the density there
+		float SampleCdf(const float* Cdf, size_t N, float u, float* pPdf)
+		{
+			// Last entry that is <= u, bins of zero width are never picked
+			const size_t i = std::clamp<size_t>(std::upper_bound(Cdf, Cdf + N + 1, u) - Cdf, 1, N) - 1;
+			const float width = Cdf[i + 1] - Cdf[i];
+			const float du = width > 0.0f ? (u - Cdf[i]) / width : 0.0f;
+
+			*pPdf = width * static_cast<float>(N);
+			return std::min((static_cast<float>(i) + du) / static_cast<float>(N), 0x1.fffffep-1f);
+		}
+
+		XMFLOAT2 DirectionToUV(FXMVECTOR wi)
+		{
+			XMFLOAT3 w;
+			XMStoreFloat3(&w, XMVector3Normalize(wi));
+
+			float phi = std::atan2(w.z, w.x);
+			if (phi < 0.0f)
+			{
+				phi += XM_2PI;
+			}
+			const float theta = std::acos(std::clamp(w.y, -1.0f, 1.0f));
+			return { phi * XM_1DIV2PI, theta * XM_1DIVPI };
+		}
+
+		XMVECTOR UVToDirection(XMFLOAT2 UV, float* pSinTheta)
+		{
+			const float theta = UV.y * XM_PI;
+			const float phi = UV.x * XM_2PI;
+			const float sinTheta = std::sin(theta);
+
+			*pSinTheta = sinTheta;
+			return XMVectorSet(sinTheta * std::cos(phi), std::cos(theta), sinTheta * std::sin(phi), 0.0f);
+		}
+	}
+
+	EnvironmentMap::EnvironmentMap(uint32_t Width, uint32_t Height, std::vector<float3> Radiance)
+		: Width(Width),
+		Height(Height),
+		Radiance(std::move(Radiance)),
+		Cdfs(size_t(Height) + 1 + size_t(Height) * (size_t(Width) + 1))
+	{
+		std::vector<float> rowIntegrals(Height);
+		float* pConditionals = Cdfs.data() + Height + 1;
+
+		ParallelFor(Height, 16, [&](size_t Begin, size_t End)
+		{
+			std::vector<float> function(Width);
+			for (size_t y = Begin; y < End; ++y)
+			{
+				const float sinTheta = std::sin((static_cast<float>(y) + 0.5f) / static_cast<float>(Height) * XM_PI);
+				for (size_t x = 0; x < Width; ++x)
+				{
+					function[x] = std::max(Luminance(this->Radiance[y * Width + x]), 0.0f) * sinTheta;
+				}
+				rowIntegrals[y] = static_cast<float>(BuildCdf(function.data(), Width, pConditionals + y * (size_t(Width) + 1)));
+			}
+		});
+
+		Black = BuildCdf(rowIntegrals.data(), Height, Cdfs.data()) == 0.0;
+	}
+
+	XMVECTOR EnvironmentMap::Le(FXMVECTOR wi) const
+	{
+		const XMFLOAT2 uv = DirectionToUV(wi);
+		const uint32_t x = std::min(static_cast<uint32_t>(uv.x * static_cast<float>(Width)), Width - 1);
+		const uint32_t y = std::min(static_cast<uint32_t>(uv.y * static_cast<float>(Height)), Height - 1);
+		return XMLoadFloat3(&Radiance[size_t(y) * Width + x]);
+	}
+
+	bool EnvironmentMap::Sample(XMFLOAT2 Xi, XMVECTOR* pWi, float* pPdf) const
+	{
+		if (Black)
+		{
+			return false;
+		}
+
+		float marginalPdf, conditionalPdf;
+		const float v = SampleCdf(Cdfs.data(), Height, Xi.y, &marginalPdf);
+		const uint32_t y = std::min(static_cast<uint32_t>(v * static_cast<float>(Height)), Height - 1);
+		const float u = SampleCdf(Cdfs.data() + Height + 1 + size_t(y) * (Width + 1), Width, Xi.x, &conditionalPdf);
+
+		// Jacobian of the equirectangular mapping
+		float sinTheta;
+		*pWi = UVToDirection({ u, v }, &sinTheta);
+		if (sinTheta == 0.0f || marginalPdf * conditionalPdf == 0.0f)
+		{
+			return false;
+		}
+
+		*pPdf = marginalPdf * conditionalPdf / (2.0f * XM_PI * XM_PI * sinTheta);
+		return true;
+	}
+
+	float EnvironmentMap::Pdf(FXMVECTOR wi) const
+	{
+		if (Black)
+		{
+			return 0.0f;
+		}
+
+		const XMFLOAT2 uv = DirectionToUV(wi);
+		const float sinTheta = std::sin(uv.y * XM_PI);
+		if (sinTheta == 0.0f)
+		{
+			return 0.0f;
+		}
+
+		const uint32_t x = std::min(static_cast<uint32_t>(uv.x * static_cast<float>(Width)), Width - 1);
+		const uint32_t y = std::min(static_cast<uint32_t>(uv.y * static_cast<float>(Height)), Height - 1);
+		const float* pConditional = Cdfs.data() + Height + 1 + size_t(y) * (Width + 1);
+
+		const float marginalPdf = (Cdfs[y + 1] - Cdfs[y]) * static_cast<float>(Height);
+		const float conditionalPdf = (pConditional[x + 1] - pConditional[x]) * static_cast<float>(Width);
+		return marginalPdf * conditionalPdf / (2.0f * XM_PI * XM_PI * sinTheta);
+	}
+
+	std::shared_ptr<const EnvironmentMap> CreateEnvironmentMap(const DirectX::Image& Image)
+	{
+		ScratchImage converted;
+		const DirectX::Image* pImage = &Image;
+		if (Image.format != DXGI_FORMAT_R32G32B32A32_FLOAT)
+		{
+			ThrowIfFailed(Convert(Image, DXGI_FORMAT_R32G32B32A32_FLOAT, TEX_FILTER_DEFAULT, TEX_THRESHOLD_DEFAULT, converted));
+			pImage = converted.GetImage(0, 0, 0);
+		}
+
+		const uint32_t width = static_cast<uint32_t>(pImage->width);
+		const uint32_t height = static_cast<uint32_t>(pImage->height);
+
+		std::vector<float3> radiance(size_t(width) * height);
+		for (uint32_t y = 0; y < height; ++y)
+		{
+			auto pRow = reinterpret_cast<const XMFLOAT4*>(pImage->pixels + y * pImage->rowPitch);
+			for (uint32_t x = 0; x < width; ++x)
+			{
+				radiance[size_t(y) * width + x] = { pRow[x].x, pRow[x].y, pRow[x].z };
+			}
+		}
+
+		const auto start = std::chrono::high_resolution_clock::now();
+		auto environmentMap = std::make_shared<const EnvironmentMap>(width, height, std::move(radiance));
+		const auto stop = std::chrono::high_resolution_clock::now();
+		LOG_INFO("Environment map {}x{}: distribution built in {}(ms)", width, height, std::chrono::duration<double, std::milli>(stop - start).count());
+		return environmentMap;
+	}
+
+	std::shared_ptr<const EnvironmentMap> GetOrBuildEnvironmentMap(Asset::Image& Image)
+	{
+		// Only HDR images can light the scene
+		const auto& path = Image.Metadata.Path;
+		if (Image.Environment || Image.EnvironmentFailed || path.extension() != ".hdr")
+		{
+			return Image.Environment;
+		}
+
+		ImageStream stream;
+		bool opened;
+		if (Image.Metadata.Bundle)
+		{
+			const auto data = Image.Metadata.Bundle->Find(SceneBundle::AssetType::Image, path);
+			opened = !data.empty() && stream.Open(data.data(), data.size(), Image.Metadata.Bundle);
+		}
+		else
+		{
+			opened = stream.Open(ImageStream::GetCookedPath(path));
+		}
+
+		if (!opened)
+		{
+			LOG_ERROR("Failed to read {}, the environment light is ignored", path.string());
+			Image.EnvironmentFailed = true;
+			return nullptr;
+		}
+
+		// Wider images are sampled at a coarser mip
+		const TexMetadata& metadata = stream.GetMetadata();
+		size_t mip = 0;
+		while (mip + 1 < metadata.mipLevels && std::max<size_t>(metadata.width >> mip, 1) > EnvironmentMap::MaxWidth)
+		{
+			++mip;
+		}
+
+		ScratchImage scratchImage;
+		stream.ReadMips(mip, 1, scratchImage);
+		Image.Environment = CreateEnvironmentMap(*scratchImage.GetImage(0, 0, 0));
+		return Image.Environment;
+	}
+
+	void BenchmarkEnvironmentSampling()
+	{
+		// Dim sky that gets brighter towards the horizon and a sun 40 degrees up that covers about 0.01% of the sphere
+		constexpr uint32_t Width = 2048, Height = 1024;
+		const XMVECTOR sun = XMVector3Normalize(XMVectorSet(0.5f, std::tan(XMConvertToRadians(40.0f)), 0.5f, 0.0f));
+		const float cosSun = std::cos(XMConvertToRadians(1.2f));
+
+		std::vector<float3> radiance(size_t(Width) * Height);
+		for (uint32_t y = 0; y < Height; ++y)
+		{
+			for (uint32_t x = 0; x < Width; ++x)
+			{
+				float sinTheta;
+				const XMVECTOR w = UVToDirection({ (x + 0.5f) / Width, (y + 0.5f) / Height }, &sinTheta);
+				const float up = XMVectorGetY(w);
+				const float sky = up > 0.0f ? 0.5f + 0.5f * (1.0f - up) : 0.05f;
+
+				float3& L = radiance[size_t(y) * Width + x];
+				L = { 0.6f * sky, 0.7f * sky, sky };
+				if (XMVectorGetX(XMVector3Dot(w, sun)) > cosSun)
+				{
+					L = { 20000.0f, 19000.0f, 17000.0f };
+				}
+			}
+		}
+
+		constexpr int NumBuilds = 8;
+		const auto start = std::chrono::high_resolution_clock::now();
+		for (int i = 0; i < NumBuilds; ++i)
+		{
+			const EnvironmentMap map(Width, Height, radiance);
+		}
+		const auto stop = std::chrono::high_resolution_clock::now();
+		LOG_INFO("Environment map {}x{}: distribution built in {:.3f}(ms) on {} threads", Width, Height,
+			std::chrono::duration<double, std::milli>(stop - start).count() / NumBuilds, std::max(std::thread::hardware_concurrency(), 1u));
+
+		const EnvironmentMap map(Width, Height, std::move(radiance));
+
+		// Irradiance of a point facing +y, the map is constant over every texel
+		const XMVECTOR n = XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f);
+		double reference = 0.0;
+		for (uint32_t y = 0; y < Height; ++y)
+		{
+			for (uint32_t x = 0; x < Width; ++x)
+			{
+				float sinTheta;
+				const XMVECTOR w = UVToDirection({ (x + 0.5f) / Width, (y + 0.5f) / Height }, &sinTheta);
+				const float cosTheta = XMVectorGetX(XMVector3Dot(w, n));
+				if (cosTheta > 0.0f)
+				{
+					const double solidAngle = (XM_2PI / Width) * (XM_PI / Height) * sinTheta;
+					reference += XMVectorGetY(map.Le(w)) * cosTheta * solidAngle;
+				}
+			}
+		}
+
+		std::mt19937 generator(1337);
+		std::uniform_real_distribution<float> distribution(0.0f, 1.0f);
+
+		constexpr uint32_t NumTrials = 1024;
+		constexpr uint32_t MaxSamples = 1024;
+		LOG_INFO("Environment sampling, relative RMSE of the irradiance over {} estimates (Uniform sphere, Environment map)", NumTrials);
+		for (uint32_t numSamples = 1; numSamples <= MaxSamples; numSamples *= 4)
+		{
+			double squaredErrors[2] = {};
+			for (uint32_t trial = 0; trial < NumTrials; ++trial)
+			{
+				double sums[2] = {};
+				for (uint32_t sample = 0; sample < numSamples; ++sample)
+				{
+					const XMFLOAT2 Xi = { distribution(generator), distribution(generator) };
+
+					const XMVECTOR uniform = SampleUniformSphere(Xi);
+					sums[0] += XMVectorGetY(map.Le(uniform)) * std::max(XMVectorGetX(XMVector3Dot(uniform, n)), 0.0f) / UniformSpherePdf();
+
+					XMVECTOR wi;
+					float pdf;
+					if (map.Sample(Xi, &wi, &pdf))
+					{
+						sums[1] += XMVectorGetY(map.Le(wi)) * std::max(XMVectorGetX(XMVector3Dot(wi, n)), 0.0f) / pdf;
+					}
+				}
+
+				for (int i = 0; i < 2; ++i)
+				{
+					const double error = (sums[i] / numSamples - reference) / reference;
+					squaredErrors[i] += error * error;
+				}
+			}
+
+			LOG_INFO("\t{:>5} spp: {:.3e} {:.3e}", numSamples,
+				std::sqrt(squaredErrors[0] / NumTrials),
+				std::sqrt(squaredErrors[1] / NumTrials));
+		}
+	}
+}
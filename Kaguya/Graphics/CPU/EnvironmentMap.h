@@ -0,0 +1,65 @@
+#pragma once
+#include <memory>
+#include <vector>
+#include <DirectXMath.h>
+#include <DirectXTex.h>
+
+#include "../SharedDefines.h"
+
+namespace Asset
+{
+	struct Image;
+}
+
+namespace CPU
+{
+	/*
+	* Equirectangular environment map sampled with a piecewise constant 2D distribution (pbrt): a row is picked from the
+	* marginal CDF of the rows, then a column from the CDF of that row, both by inverting the CDF so stratified samples
+	* stay stratified. Texels are weighted by their luminance times the sine of their polar angle, which is what the
+	* solid angle they cover scales with. The CDFs are uploaded as they are, EnvironmentMap.hlsli samples them the same
+	* way. u follows the azimuth around +y, v goes from +y at the top row to -y at the bottom one.
+	*/
+	class EnvironmentMap
+	{
+	public:
+		// Wider images are sampled at their first mip that is at most this wide
+		static constexpr uint32_t MaxWidth = 1024;
+
+		// Rows are built in parallel, Radiance holds Width * Height texels
+		EnvironmentMap(uint32_t Width, uint32_t Height, std::vector<float3> Radiance);
+
+		// Radiance arriving from the direction wi, point sampled like the path tracer
+		[[nodiscard]] DirectX::XMVECTOR Le(DirectX::FXMVECTOR wi) const;
+
+		// Picks a direction in proportion to the radiance arriving along it, the pdf is per solid angle.
+		// Returns false for maps that are black everywhere
+		bool Sample(DirectX::XMFLOAT2 Xi, DirectX::XMVECTOR* pWi, float* pPdf) const;
+
+		// Solid angle pdf of Sample picking wi
+		[[nodiscard]] float Pdf(DirectX::FXMVECTOR wi) const;
+
+		[[nodiscard]] uint32_t GetWidth() const { return Width; }
+		[[nodiscard]] uint32_t GetHeight() const { return Height; }
+		[[nodiscard]] bool IsBlack() const { return Black; }
+
+		// Marginal CDF of the rows (Height + 1 values) followed by the CDF of every row (Width + 1 values each)
+		[[nodiscard]] const std::vector<float>& GetCdfs() const { return Cdfs; }
+	private:
+		uint32_t Width, Height;
+		std::vector<float3> Radiance;
+		std::vector<float> Cdfs;
+		bool Black = false;
+	};
+
+	// Converts an equirectangular image to float RGB and builds its distribution, logs the build time
+	std::shared_ptr<const EnvironmentMap> CreateEnvironmentMap(const DirectX::Image& Image);
+
+	// Builds the distribution of the image the first time an environment light references it. The mip is read from the
+	// cooked image since the texels in RAM belong to the upload thread. Returns null if the cooked image cannot be read
+	std::shared_ptr<const EnvironmentMap> GetOrBuildEnvironmentMap(Asset::Image& Image);
+
+	// Logs the time it takes to build the distribution of a 2048x1024 sky with a small sun, and the relative RMSE of the
+	// irradiance it gives a point facing up estimated with uniform sphere sampling and with the distribution
+	void BenchmarkEnvironmentSampling();
+}
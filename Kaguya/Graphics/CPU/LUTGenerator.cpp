@@ -0,0 +1,266 @@
+#include "pch.h"
+#include "LUTGenerator.h"
+#include "BSDF.h"
+#include "Sampling.h"
+#include "Parallel.h"
+
+using namespace DirectX;
+
+namespace CPU
+{
+	namespace
+	{
+		struct Table
+		{
+			Table(size_t Width, size_t Height, size_t NumChannels)
+				: Width(Width),
+				Height(Height),
+				NumChannels(NumChannels),
+				Texels(Width * Height * NumChannels)
+			{
+			}
+
+			float* At(size_t X, size_t Y)
+			{
+				return &Texels[(Y * Width + X) * NumChannels];
+			}
+
+			void Save(const std::filesystem::path& Path, bool Float32) const
+			{
+				DXGI_FORMAT format, storedFormat;
+				switch (NumChannels)
+				{
+				case 1:
+					format = DXGI_FORMAT_R32_FLOAT;
+					storedFormat = Float32 ? DXGI_FORMAT_R32_FLOAT : DXGI_FORMAT_R16_FLOAT;
+					break;
+				case 2:
+					format = DXGI_FORMAT_R32G32_FLOAT;
+					storedFormat = Float32 ? DXGI_FORMAT_R32G32_FLOAT : DXGI_FORMAT_R16G16_FLOAT;
+					break;
+				default:
+					format = DXGI_FORMAT_R32G32B32A32_FLOAT;
+					storedFormat = Float32 ? DXGI_FORMAT_R32G32B32A32_FLOAT : DXGI_FORMAT_R16G16B16A16_FLOAT;
+					break;
+				}
+
+				ScratchImage image;
+				ThrowIfFailed(image.Initialize2D(format, Width, Height, 1, 1));
+
+				const Image* pImage = image.GetImage(0, 0, 0);
+				const size_t rowSize = Width * NumChannels * sizeof(float);
+				for (size_t y = 0; y < Height; ++y)
+				{
+					std::memcpy(pImage->pixels + y * pImage->rowPitch, &Texels[y * Width * NumChannels], rowSize);
+				}
+
+				if (storedFormat != format)
+				{
+					ScratchImage converted;
+					ThrowIfFailed(Convert(*pImage, storedFormat, TEX_FILTER_DEFAULT, TEX_THRESHOLD_DEFAULT, converted));
+					image = std::move(converted);
+				}
+
+				ThrowIfFailed(SaveToDDSFile(*image.GetImage(0, 0, 0), DDS_FLAGS_NONE, Path.c_str()));
+			}
+
+			size_t Width;
+			size_t Height;
+			size_t NumChannels;
+			std::vector<float> Texels;
+		};
+
+		float TexelCenter(size_t Index, size_t Resolution)
+		{
+			return (static_cast<float>(Index) + 0.5f) / static_cast<float>(Resolution);
+		}
+	}
+
+	int LUTGenerator::Run(int argc, char* argv[])
+	{
+		Log::Create();
+
+		if (argc < 3)
+		{
+			LOG_ERROR("Usage: {} <OutputFolder> [--resolution N] [--samples N] [--float32]", CommandLineFlag);
+			return EXIT_FAILURE;
+		}
+
+		Options options;
+		for (int i = 3; i < argc; ++i)
+		{
+			const std::string_view argument = argv[i];
+			if (argument == "--resolution" && i + 1 < argc)
+			{
+				options.Resolution = std::stoul(argv[++i]);
+			}
+			else if (argument == "--samples" && i + 1 < argc)
+			{
+				options.NumSamples = static_cast<uint32_t>(std::stoul(argv[++i]));
+			}
+			else if (argument == "--float32")
+			{
+				options.Float32 = true;
+			}
+			else
+			{
+				LOG_ERROR("Unknown option {}", argument);
+				return EXIT_FAILURE;
+			}
+		}
+
+		try
+		{
+			Generate(argv[2], options);
+		}
+		catch (std::exception& e)
+		{
+			LOG_ERROR("Failed to generate LUTs: {}", e.what());
+			return EXIT_FAILURE;
+		}
+
+		return EXIT_SUCCESS;
+	}
+
+	void LUTGenerator::Generate(const std::filesystem::path& OutputFolder, const Options& Options)
+	{
+		if (Options.Resolution == 0 || Options.NumSamples == 0)
+		{
+			throw std::exception("Invalid LUT options");
+		}
+
+		const auto start = std::chrono::high_resolution_clock::now();
+
+		const size_t resolution = Options.Resolution;
+		Table brdf(resolution, resolution, 2);
+		Table specularAverageAlbedo(resolution, 1, 1);
+		Table diffuseAlbedo(resolution, resolution, 2);
+		Table dielectricAlbedo(resolution, resolution, 4);
+
+		ParallelFor(resolution, 1, [&](size_t Begin, size_t End)
+		{
+			for (size_t y = Begin; y < End; ++y)
+			{
+				const float roughness = TexelCenter(y, resolution);
+				const float eta = Lerp(MinEta, MaxEta, TexelCenter(y, resolution));
+
+				float averageAlbedo = 0.0f;
+				for (size_t x = 0; x < resolution; ++x)
+				{
+					const float cosThetaO = TexelCenter(x, resolution);
+
+					const XMFLOAT2 specular = IntegrateSpecular(cosThetaO, roughness, Options.NumSamples);
+					brdf.At(x, y)[0] = specular.x;
+					brdf.At(x, y)[1] = specular.y;
+
+					// E_avg = 2 * integral of E(mu) * mu over [0, 1], with F0 = 1 the albedo is scale + bias
+					averageAlbedo += 2.0f * (specular.x + specular.y) * cosThetaO / static_cast<float>(resolution);
+
+					const XMFLOAT2 diffuse = IntegrateDiffuse(cosThetaO, roughness, Options.NumSamples);
+					diffuseAlbedo.At(x, y)[0] = diffuse.x;
+					diffuseAlbedo.At(x, y)[1] = diffuse.y;
+
+					const XMFLOAT4 dielectric = IntegrateDielectric(cosThetaO, eta, Options.NumSamples);
+					std::memcpy(dielectricAlbedo.At(x, y), &dielectric, sizeof(XMFLOAT4));
+				}
+
+				specularAverageAlbedo.At(y, 0)[0] = averageAlbedo;
+			}
+		});
+
+		std::error_code ec;
+		std::filesystem::create_directories(OutputFolder, ec);
+
+		brdf.Save(OutputFolder / "BRDF.dds", Options.Float32);
+		specularAverageAlbedo.Save(OutputFolder / "SpecularAverageAlbedo.dds", Options.Float32);
+		diffuseAlbedo.Save(OutputFolder / "DisneyDiffuseAlbedo.dds", Options.Float32);
+		dielectricAlbedo.Save(OutputFolder / "DielectricAlbedo.dds", Options.Float32);
+
+		const auto stop = std::chrono::high_resolution_clock::now();
+		LOG_INFO("{}x{} LUTs with {} samples per texel generated in {}(ms)",
+			resolution, resolution, Options.NumSamples, std::chrono::duration_cast<std::chrono::milliseconds>(stop - start).count());
+	}
+
+	XMFLOAT2 LUTGenerator::IntegrateSpecular(float CosThetaO, float Roughness, uint32_t NumSamples)
+	{
+		// Same parameterization as the specular term of Disney::f
+		const float alpha = std::max(0.001f, Roughness);
+		const float roughg = (Roughness * 0.5f + 0.5f) * (Roughness * 0.5f + 0.5f);
+
+		const XMVECTOR wo = DirectionFromCosTheta(CosThetaO);
+		const float Go = smithG_GGX(CosThetaO, roughg);
+
+		float scale = 0.0f, bias = 0.0f;
+		for (uint32_t i = 0; i < NumSamples; ++i)
+		{
+			// Half vectors are distributed like D, so D cancels out of f * cos / pdf
+			const XMVECTOR wh = SampleGTR2(Hammersley(i, NumSamples), alpha);
+			const XMVECTOR wi = Reflect(wo, wh);
+
+			const float cosThetaI = CosTheta(wi);
+			const float woDotWh = XMVectorGetX(XMVector3Dot(wo, wh));
+			if (cosThetaI <= 0.0f || woDotWh <= 0.0f)
+			{
+				continue;
+			}
+
+			const float value = Go * smithG_GGX(cosThetaI, roughg) * cosThetaI * 4.0f * woDotWh / CosTheta(wh);
+			const float Fc = SchlickWeight(woDotWh);
+			scale += (1.0f - Fc) * value;
+			bias += Fc * value;
+		}
+
+		return { scale / static_cast<float>(NumSamples), bias / static_cast<float>(NumSamples) };
+	}
+
+	XMFLOAT2 LUTGenerator::IntegrateDiffuse(float CosThetaO, float Roughness, uint32_t NumSamples)
+	{
+		const XMVECTOR wo = DirectionFromCosTheta(CosThetaO);
+
+		float albedo = 0.0f, subsurfaceAlbedo = 0.0f;
+		for (uint32_t i = 0; i < NumSamples; ++i)
+		{
+			// Cosine weighted, f * cos / pdf = f * pi
+			const XMVECTOR wi = SampleCosineHemisphere(Hammersley(i, NumSamples));
+			if (CosTheta(wi) <= 0.0f)
+			{
+				continue;
+			}
+
+			albedo += XM_PI * DisneyDiffuse(wo, wi, Roughness, 0.0f);
+			subsurfaceAlbedo += XM_PI * DisneyDiffuse(wo, wi, Roughness, 1.0f);
+		}
+
+		return { albedo / static_cast<float>(NumSamples), subsurfaceAlbedo / static_cast<float>(NumSamples) };
+	}
+
+	XMFLOAT4 LUTGenerator::IntegrateDielectric(float CosThetaO, float Eta, uint32_t NumSamples)
+	{
+		const Glass glass = { .R = { 1.0f, 1.0f, 1.0f }, .T = { 1.0f, 1.0f, 1.0f }, .etaA = 1.0f, .etaB = Eta };
+
+		auto Integrate = [&](FXMVECTOR wo, float* pReflectance, float* pTransmittance)
+		{
+			*pReflectance = *pTransmittance = 0.0f;
+			for (uint32_t i = 0; i < NumSamples; ++i)
+			{
+				BSDFSample sample;
+				if (!glass.Samplef(wo, Hammersley(i, NumSamples), &sample) || sample.pdf == 0.0f)
+				{
+					continue;
+				}
+
+				const float value = XMVectorGetX(sample.f) * AbsCosTheta(sample.wi) / sample.pdf;
+				*(EnumMaskBitSet(sample.Flags, BxDFFlags::Transmission) ? pTransmittance : pReflectance) += value;
+			}
+			*pReflectance /= static_cast<float>(NumSamples);
+			*pTransmittance /= static_cast<float>(NumSamples);
+		};
+
+		const XMVECTOR wo = DirectionFromCosTheta(CosThetaO);
+
+		XMFLOAT4 albedo;
+		Integrate(wo, &albedo.x, &albedo.y);
+		Integrate(XMVectorMultiply(wo, XMVectorSet(1.0f, 1.0f, -1.0f, 0.0f)), &albedo.z, &albedo.w);
+		return albedo;
+	}
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <filesystem>
+#include <string_view>
+#include <DirectXMath.h>
+
+/*
+* Generates the lookup tables in Assets/LUT by integrating the C++ versions of the shipped BxDFs (see BSDF.h) with
+* Hammersley points, rows are integrated in parallel. Every table is a DDS file, texel centers map x to cos theta_o
+* in (0, 1] and y to the roughness or the index of refraction of the lobe.
+* - BRDF.dds: RG = split sum scale and bias of the Disney specular lobe, F0 * R + G is its directional albedo
+* - SpecularAverageAlbedo.dds: R = cosine weighted average of the specular albedo per roughness (width x 1),
+*   together with the albedo it gives the energy lost to single scattering for energy compensation
+* - DisneyDiffuseAlbedo.dds: RG = albedo of the Disney diffuse lobe for a white base color, without and with subsurface
+* - DielectricAlbedo.dds: RGBA = reflectance and transmittance of the Glass BxDF entering the surface, then leaving it.
+*   y maps to eta in [MinEta, MaxEta]
+*/
+namespace CPU
+{
+	class LUTGenerator
+	{
+	public:
+		static constexpr std::string_view CommandLineFlag = "--generate-luts";
+
+		static constexpr float MinEta = 1.0f;
+		static constexpr float MaxEta = 3.0f;
+
+		struct Options
+		{
+			size_t Resolution = 512;
+			uint32_t NumSamples = 1024;
+			bool Float32 = false; // The shipped tables are 16-bit floats
+		};
+
+		// Entry point of the editor executable started with CommandLineFlag:
+		// --generate-luts <OutputFolder> [--resolution N] [--samples N] [--float32]
+		static int Run(int argc, char* argv[]);
+
+		static void Generate(const std::filesystem::path& OutputFolder, const Options& Options);
+
+		// Returns the split sum scale and bias of the Disney specular lobe
+		static DirectX::XMFLOAT2 IntegrateSpecular(float CosThetaO, float Roughness, uint32_t NumSamples);
+
+		// Returns the albedo of the Disney diffuse lobe without and with subsurface
+		static DirectX::XMFLOAT2 IntegrateDiffuse(float CosThetaO, float Roughness, uint32_t NumSamples);
+
+		// Returns the reflectance and transmittance of the Glass BxDF going from eta 1 to Eta, then from Eta to 1
+		static DirectX::XMFLOAT4 IntegrateDielectric(float CosThetaO, float Eta, uint32_t NumSamples);
+	};
+}
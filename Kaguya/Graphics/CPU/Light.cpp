@@ -0,0 +1,214 @@
+#include "pch.h"
+#include "Light.h"
+
+using namespace DirectX;
+
+namespace CPU
+{
+	namespace
+	{
+		// Area-preserving parametrization of the spherical rectangle a rectangle subtends from a point,
+		// see SphericalRectangle in Math.hlsli
+		struct SphericalRectangle
+		{
+			SphericalRectangle(FXMVECTOR s, FXMVECTOR ex, FXMVECTOR ey, GXMVECTOR o)
+				: o(o)
+			{
+				const float exl = XMVectorGetX(XMVector3Length(ex));
+				const float eyl = XMVectorGetX(XMVector3Length(ey));
+
+				// Local reference system 'R'
+				x = ex / exl;
+				y = ey / eyl;
+				z = XMVector3Cross(x, y);
+
+				// Rectangle coordinates in the local reference system
+				const XMVECTOR d = s - o;
+				z0 = XMVectorGetX(XMVector3Dot(d, z));
+
+				// Flip 'z' to make it point against 'Q'
+				if (z0 > 0.0f)
+				{
+					z = -z;
+					z0 = -z0;
+				}
+
+				z0sq = z0 * z0;
+				x0 = XMVectorGetX(XMVector3Dot(d, x));
+				y0 = XMVectorGetX(XMVector3Dot(d, y));
+				x1 = x0 + exl;
+				y1 = y0 + eyl;
+				y0sq = y0 * y0;
+				y1sq = y1 * y1;
+
+				// Vectors to the four vertices
+				const XMVECTOR v00 = XMVectorSet(x0, y0, z0, 0.0f);
+				const XMVECTOR v01 = XMVectorSet(x0, y1, z0, 0.0f);
+				const XMVECTOR v10 = XMVectorSet(x1, y0, z0, 0.0f);
+				const XMVECTOR v11 = XMVectorSet(x1, y1, z0, 0.0f);
+
+				// Normals to the edges
+				const XMVECTOR n0 = XMVector3Normalize(XMVector3Cross(v00, v10));
+				const XMVECTOR n1 = XMVector3Normalize(XMVector3Cross(v10, v11));
+				const XMVECTOR n2 = XMVector3Normalize(XMVector3Cross(v11, v01));
+				const XMVECTOR n3 = XMVector3Normalize(XMVector3Cross(v01, v00));
+
+				// Internal angles (gamma_i)
+				const float g0 = std::acos(std::clamp(-XMVectorGetX(XMVector3Dot(n0, n1)), -1.0f, 1.0f));
+				const float g1 = std::acos(std::clamp(-XMVectorGetX(XMVector3Dot(n1, n2)), -1.0f, 1.0f));
+				const float g2 = std::acos(std::clamp(-XMVectorGetX(XMVector3Dot(n2, n3)), -1.0f, 1.0f));
+				const float g3 = std::acos(std::clamp(-XMVectorGetX(XMVector3Dot(n3, n0)), -1.0f, 1.0f));
+
+				b0 = XMVectorGetZ(n0);
+				b1 = XMVectorGetZ(n2);
+				b0sq = b0 * b0;
+				k = XM_2PI - g2 - g3;
+
+				SolidAngle = g0 + g1 - k;
+			}
+
+			[[nodiscard]] XMVECTOR Sample(float u, float v) const
+			{
+				// 1. compute 'cu'
+				const float au = u * SolidAngle + k;
+				const float fu = (std::cos(au) * b0 - b1) / std::sin(au);
+				float cu = 1.0f / std::sqrt(fu * fu + b0sq) * (fu > 0.0f ? 1.0f : -1.0f);
+				cu = std::clamp(cu, -1.0f, 1.0f); // Avoid NaNs
+
+				// 2. compute 'xu'
+				float xu = -(cu * z0) / std::sqrt(1.0f - cu * cu);
+				xu = std::clamp(xu, x0, x1); // Avoid Infs
+
+				// 3. compute 'yv'
+				const float d = std::sqrt(xu * xu + z0sq);
+				const float h0 = y0 / std::sqrt(d * d + y0sq);
+				const float h1 = y1 / std::sqrt(d * d + y1sq);
+				const float hv = h0 + v * (h1 - h0), hv2 = hv * hv;
+				const float yv = (hv2 < 1.0f - 1e-6f) ? (hv * d) / std::sqrt(1.0f - hv2) : y1;
+
+				// 4. transform (xu, yv, z0) to world coords
+				return o + xu * x + yv * y + z0 * z;
+			}
+
+			XMVECTOR o, x, y, z;
+			float z0, z0sq;
+			float x0, y0, y0sq;
+			float x1, y1, y1sq;
+			float b0, b1, b0sq, k;
+			float SolidAngle;
+		};
+	}
+
+	bool SampleLi(const HLSL::Light& Light, FXMVECTOR p, XMFLOAT2 Xi, LightSample* pSample)
+	{
+		if (Light.Type == LightType::PointLight)
+		{
+			const XMVECTOR position = XMLoadFloat3(&Light.Position);
+			const float d2 = XMVectorGetX(XMVector3LengthSq(position - p));
+			if (d2 == 0.0f)
+			{
+				return false;
+			}
+
+			pSample->Li = XMLoadFloat3(&Light.I) / d2;
+			pSample->wi = XMVector3Normalize(position - p);
+			pSample->p = position;
+			pSample->pdf = 1.0f;
+			return true;
+		}
+
+		if (Light.Type == LightType::QuadLight)
+		{
+			const XMVECTOR p0 = XMLoadFloat3(&Light.Points[0]);
+			const XMVECTOR ex = XMLoadFloat3(&Light.Points[1]) - p0;
+			const XMVECTOR ey = XMLoadFloat3(&Light.Points[3]) - p0;
+			const SphericalRectangle squad(p0, ex, ey, p);
+			if (!(squad.SolidAngle > 0.0f))
+			{
+				return false;
+			}
+
+			const XMVECTOR y = squad.Sample(Xi.x, Xi.y);
+			pSample->Li = XMLoadFloat3(&Light.I);
+			pSample->wi = XMVector3Normalize(y - p);
+			pSample->p = y;
+			pSample->pdf = 1.0f / squad.SolidAngle;
+			return true;
+		}
+
+		return false;
+	}
+
+	float LightPower(const HLSL::Light& Light)
+	{
+		const float luminance = 0.212671f * Light.I.x + 0.715160f * Light.I.y + 0.072169f * Light.I.z;
+		if (Light.Type == LightType::PointLight)
+		{
+			return 4.0f * XM_PI * luminance;
+		}
+
+		if (Light.Type == LightType::QuadLight)
+		{
+			const XMVECTOR p0 = XMLoadFloat3(&Light.Points[0]);
+			const XMVECTOR ex = XMLoadFloat3(&Light.Points[1]) - p0;
+			const XMVECTOR ey = XMLoadFloat3(&Light.Points[3]) - p0;
+			const float area = XMVectorGetX(XMVector3Length(XMVector3Cross(ex, ey)));
+			return 2.0f * XM_PI * luminance * area;
+		}
+
+		if (Light.Type == LightType::MeshLight)
+		{
+			// Triangles emit from both sides like quads
+			return 2.0f * XM_PI * luminance * Light.Area;
+		}
+
+		return 0.0f;
+	}
+
+	bool IntersectLight(const HLSL::Light& Light, FXMVECTOR p, FXMVECTOR wi, float* pDistance, LightSample* pSample)
+	{
+		if (Light.Type != LightType::QuadLight)
+		{
+			return false;
+		}
+
+		const XMVECTOR p0 = XMLoadFloat3(&Light.Points[0]);
+		const XMVECTOR ex = XMLoadFloat3(&Light.Points[1]) - p0;
+		const XMVECTOR ey = XMLoadFloat3(&Light.Points[3]) - p0;
+		const XMVECTOR n = XMVector3Cross(ex, ey);
+
+		const float denominator = XMVectorGetX(XMVector3Dot(wi, n));
+		if (denominator == 0.0f)
+		{
+			return false;
+		}
+
+		const float t = XMVectorGetX(XMVector3Dot(p0 - p, n)) / denominator;
+		if (t <= 0.0f)
+		{
+			return false;
+		}
+
+		// Parametric coordinates of the hit point along the edges
+		const XMVECTOR y = p + t * wi;
+		const float u = XMVectorGetX(XMVector3Dot(y - p0, ex) / XMVector3LengthSq(ex));
+		const float v = XMVectorGetX(XMVector3Dot(y - p0, ey) / XMVector3LengthSq(ey));
+		if (u < 0.0f || u > 1.0f || v < 0.0f || v > 1.0f)
+		{
+			return false;
+		}
+
+		const SphericalRectangle squad(p0, ex, ey, p);
+		if (!(squad.SolidAngle > 0.0f))
+		{
+			return false;
+		}
+
+		*pDistance = t;
+		pSample->Li = XMLoadFloat3(&Light.I);
+		pSample->wi = wi;
+		pSample->p = y;
+		pSample->pdf = 1.0f / squad.SolidAngle;
+		return true;
+	}
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <DirectXMath.h>
+
+#include "../Scene/Components/Light.h"
+#include "../Scene/Components/MeshRenderer.h"
+#include "../SharedTypes.h"
+
+// C++ counterpart of SampleLi in BSDF.hlsli, lights are the HLSL::Light descriptions uploaded to the GPU
+namespace CPU
+{
+	struct LightSample
+	{
+		DirectX::XMVECTOR Li;
+		DirectX::XMVECTOR wi;
+		DirectX::XMVECTOR p; // Point on the light the shadow ray is traced to
+		float pdf; // Solid angle, 1 for point lights
+	};
+
+	// Point lights are delta lights, quad lights are two sided and sampled by solid angle. Mesh lights are sampled with
+	// SampleMeshLi in MeshLight.h, they need the triangles of the scene
+	bool SampleLi(const HLSL::Light& Light, DirectX::FXMVECTOR p, DirectX::XMFLOAT2 Xi, LightSample* pSample);
+
+	// Finds the point where the ray from p along wi hits the light with the pdf SampleLi gives wi, like IntersectLight in
+	// BSDF.hlsli. Point lights cannot be hit
+	bool IntersectLight(const HLSL::Light& Light, DirectX::FXMVECTOR p, DirectX::FXMVECTOR wi, float* pDistance, LightSample* pSample);
+
+	// Luminance of the power the light emits, quad and mesh lights emit from both sides
+	[[nodiscard]] float LightPower(const HLSL::Light& Light);
+
+	[[nodiscard]] inline bool IsDeltaLight(const HLSL::Light& Light)
+	{
+		return Light.Type == LightType::PointLight;
+	}
+}
@@ -0,0 +1,633 @@
+#include "pch.h"
+#include "LightBVH.h"
+
+#include <random>
+
+#include "AliasTable.h"
+#include "Light.h"
+
+using namespace DirectX;
+
+namespace CPU
+{
+	namespace
+	{
+		float SafeSqrt(float x)
+		{
+			return std::sqrt(std::max(x, 0.0f));
+		}
+
+		float SafeACos(float x)
+		{
+			return std::acos(std::clamp(x, -1.0f, 1.0f));
+		}
+
+		// cos(a - b) and sin(a - b) with the difference clamped at 0
+		float CosSubClamped(float SinThetaA, float CosThetaA, float SinThetaB, float CosThetaB)
+		{
+			return CosThetaA > CosThetaB ? 1.0f : CosThetaA * CosThetaB + SinThetaA * SinThetaB;
+		}
+
+		float SinSubClamped(float SinThetaA, float CosThetaA, float SinThetaB, float CosThetaB)
+		{
+			return CosThetaA > CosThetaB ? 0.0f : SinThetaA * CosThetaB - CosThetaA * SinThetaB;
+		}
+
+		// Smallest cone that holds the cones (wa, CosThetaA) and (wb, CosThetaB)
+		void UnionCones(FXMVECTOR wa, float CosThetaA, FXMVECTOR wb, float CosThetaB, XMVECTOR* pw, float* pCosTheta)
+		{
+			const float thetaA = SafeACos(CosThetaA);
+			const float thetaB = SafeACos(CosThetaB);
+			const float thetaD = SafeACos(XMVectorGetX(XMVector3Dot(wa, wb)));
+
+			if (std::min(thetaD + thetaB, XM_PI) <= thetaA)
+			{
+				*pw = wa;
+				*pCosTheta = CosThetaA;
+				return;
+			}
+			if (std::min(thetaD + thetaA, XM_PI) <= thetaB)
+			{
+				*pw = wb;
+				*pCosTheta = CosThetaB;
+				return;
+			}
+
+			const float thetaO = (thetaA + thetaD + thetaB) * 0.5f;
+			const XMVECTOR axis = XMVector3Cross(wa, wb);
+			if (thetaO >= XM_PI || XMVectorGetX(XMVector3LengthSq(axis)) == 0.0f)
+			{
+				*pw = wa;
+				*pCosTheta = -1.0f;
+				return;
+			}
+
+			// Rotate wa towards wb, axis is orthogonal to wa so Rodrigues' formula loses its last term
+			const float thetaR = thetaO - thetaA;
+			*pw = XMVector3Normalize(wa * std::cos(thetaR) + XMVector3Cross(XMVector3Normalize(axis), wa) * std::sin(thetaR));
+			*pCosTheta = std::cos(thetaO);
+		}
+
+		// Nodes without power are empty
+		LightBVH::Node Union(const LightBVH::Node& a, const LightBVH::Node& b)
+		{
+			if (a.Phi == 0.0f)
+			{
+				return b;
+			}
+			if (b.Phi == 0.0f)
+			{
+				return a;
+			}
+
+			XMVECTOR w;
+			LightBVH::Node node = {};
+			UnionCones(XMLoadFloat3(&a.w), a.CosTheta_o, XMLoadFloat3(&b.w), b.CosTheta_o, &w, &node.CosTheta_o);
+			XMStoreFloat3(&node.Min, XMVectorMin(XMLoadFloat3(&a.Min), XMLoadFloat3(&b.Min)));
+			XMStoreFloat3(&node.Max, XMVectorMax(XMLoadFloat3(&a.Max), XMLoadFloat3(&b.Max)));
+			XMStoreFloat3(&node.w, w);
+			node.Phi = a.Phi + b.Phi;
+			node.CosTheta_e = std::min(a.CosTheta_e, b.CosTheta_e);
+			node.Flags = (a.Flags | b.Flags) & LightBVH::Node::TwoSided;
+			return node;
+		}
+
+		LightBVH::Node LightBounds(const HLSL::Light& Light)
+		{
+			LightBVH::Node node = {};
+			node.Phi = LightPower(Light);
+
+			if (Light.Type == LightType::PointLight)
+			{
+				// Emits in all directions
+				node.Min = node.Max = Light.Position;
+				node.w = { 0.0f, 0.0f, 1.0f };
+				node.CosTheta_o = -1.0f;
+				node.CosTheta_e = 0.0f;
+			}
+			else if (Light.Type == LightType::QuadLight)
+			{
+				XMVECTOR min = XMLoadFloat3(&Light.Points[0]), max = min;
+				for (const auto& point : Light.Points)
+				{
+					min = XMVectorMin(min, XMLoadFloat3(&point));
+					max = XMVectorMax(max, XMLoadFloat3(&point));
+				}
+
+				const XMVECTOR p0 = XMLoadFloat3(&Light.Points[0]);
+				const XMVECTOR ex = XMLoadFloat3(&Light.Points[1]) - p0;
+				const XMVECTOR ey = XMLoadFloat3(&Light.Points[3]) - p0;
+
+				// Diffuse emitter, one normal and light up to the horizon on both sides
+				XMStoreFloat3(&node.Min, min);
+				XMStoreFloat3(&node.Max, max);
+				XMStoreFloat3(&node.w, XMVector3Normalize(XMVector3Cross(ex, ey)));
+				node.CosTheta_o = 1.0f;
+				node.CosTheta_e = 0.0f;
+				node.Flags = LightBVH::Node::TwoSided;
+			}
+			else if (Light.Type == LightType::MeshLight)
+			{
+				// Triangles may face any direction, the world bounds were stored when the light was made
+				node.Min = Light.Points[0];
+				node.Max = Light.Points[1];
+				node.w = { 0.0f, 0.0f, 1.0f };
+				node.CosTheta_o = -1.0f;
+				node.CosTheta_e = 0.0f;
+			}
+			else
+			{
+				node.Phi = 0.0f;
+			}
+
+			if (!(node.Phi > 0.0f))
+			{
+				node.Phi = 0.0f;
+			}
+			return node;
+		}
+
+		// Upper bound of what the lights of the node contribute to p, the cosine at the receiver is left out when n is 0
+		float Importance(const LightBVH::Node& Node, FXMVECTOR p, FXMVECTOR n)
+		{
+			const XMVECTOR min = XMLoadFloat3(&Node.Min);
+			const XMVECTOR max = XMLoadFloat3(&Node.Max);
+			const XMVECTOR center = (min + max) * 0.5f;
+
+			// Keeps the importance finite for points inside the bounds
+			const float d2 = std::max(XMVectorGetX(XMVector3LengthSq(p - center)), XMVectorGetX(XMVector3Length(max - min)) * 0.5f);
+			if (d2 == 0.0f)
+			{
+				return 0.0f;
+			}
+
+			const XMVECTOR wi = XMVector3Normalize(p - center);
+			float cosTheta_w = XMVectorGetX(XMVector3Dot(XMLoadFloat3(&Node.w), wi));
+			if (Node.Flags & LightBVH::Node::TwoSided)
+			{
+				cosTheta_w = std::abs(cosTheta_w);
+			}
+			const float sinTheta_w = SafeSqrt(1.0f - cosTheta_w * cosTheta_w);
+
+			// Directions the bounding sphere of the node subtends from p
+			const float r2 = XMVectorGetX(XMVector3LengthSq(max - center));
+			const float distance2 = XMVectorGetX(XMVector3LengthSq(p - center));
+			const float cosTheta_b = distance2 < r2 ? -1.0f : SafeSqrt(1.0f - r2 / distance2);
+			const float sinTheta_b = SafeSqrt(1.0f - cosTheta_b * cosTheta_b);
+
+			// Smallest angle between wi and an emitter normal, then shrunk by the angle of the bounds
+			const float sinTheta_o = SafeSqrt(1.0f - Node.CosTheta_o * Node.CosTheta_o);
+			const float cosTheta_x = CosSubClamped(sinTheta_w, cosTheta_w, sinTheta_o, Node.CosTheta_o);
+			const float sinTheta_x = SinSubClamped(sinTheta_w, cosTheta_w, sinTheta_o, Node.CosTheta_o);
+			const float cosTheta_p = CosSubClamped(sinTheta_x, cosTheta_x, sinTheta_b, cosTheta_b);
+			if (cosTheta_p <= Node.CosTheta_e)
+			{
+				return 0.0f;
+			}
+
+			float importance = Node.Phi * cosTheta_p / d2;
+
+			if (XMVectorGetX(XMVector3LengthSq(n)) > 0.0f)
+			{
+				const float cosTheta_i = std::abs(XMVectorGetX(XMVector3Dot(wi, n)));
+				const float sinTheta_i = SafeSqrt(1.0f - cosTheta_i * cosTheta_i);
+				importance *= CosSubClamped(sinTheta_i, cosTheta_i, sinTheta_b, cosTheta_b);
+			}
+
+			return std::max(importance, 0.0f);
+		}
+
+		// Surface area orientation heuristic, power times the measure of the directions the lights emit in times the
+		// area of their bounds, Kr penalizes thin slabs
+		float EvaluateCost(const LightBVH::Node& Bounds, const XMFLOAT3& Extent, int Dim)
+		{
+			const float theta_o = SafeACos(Bounds.CosTheta_o);
+			const float theta_e = SafeACos(Bounds.CosTheta_e);
+			const float theta_w = std::min(theta_o + theta_e, XM_PI);
+			const float sinTheta_o = SafeSqrt(1.0f - Bounds.CosTheta_o * Bounds.CosTheta_o);
+			const float M_omega = XM_2PI * (1.0f - Bounds.CosTheta_o) +
+				XM_PIDIV2 * (2.0f * theta_w * sinTheta_o - std::cos(theta_o - 2.0f * theta_w) - 2.0f * theta_o * sinTheta_o + Bounds.CosTheta_o);
+
+			const float extent[] = { Extent.x, Extent.y, Extent.z };
+			const float Kr = std::max({ extent[0], extent[1], extent[2] }) / extent[Dim];
+
+			const float dx = Bounds.Max.x - Bounds.Min.x;
+			const float dy = Bounds.Max.y - Bounds.Min.y;
+			const float dz = Bounds.Max.z - Bounds.Min.z;
+			const float area = 2.0f * (dx * dy + dy * dz + dz * dx);
+
+			return Bounds.Phi * M_omega * Kr * area;
+		}
+
+		float Component(const float3& v, int Dim)
+		{
+			return Dim == 0 ? v.x : Dim == 1 ? v.y : v.z;
+		}
+
+		constexpr float OneMinusEpsilon = 0x1.fffffep-1f;
+	}
+
+	void LightBVH::Build(std::span<const HLSL::Light> Lights)
+	{
+		if (Lights.size() > MaxLights)
+		{
+			throw std::exception("Too many lights for the light BVH");
+		}
+
+		Nodes.clear();
+		BitTrails.assign(Lights.size(), InvalidBitTrail);
+
+		std::vector<BuildLight> buildLights;
+		buildLights.reserve(Lights.size());
+		for (uint32_t i = 0; i < static_cast<uint32_t>(Lights.size()); ++i)
+		{
+			const Node bounds = LightBounds(Lights[i]);
+			if (bounds.Phi > 0.0f)
+			{
+				float3 centroid;
+				XMStoreFloat3(&centroid, (XMLoadFloat3(&bounds.Min) + XMLoadFloat3(&bounds.Max)) * 0.5f);
+				buildLights.push_back({ i, bounds, centroid });
+			}
+		}
+
+		if (buildLights.empty())
+		{
+			return;
+		}
+
+		Nodes.reserve(2 * buildLights.size() - 1);
+		Subdivide(buildLights, 0, 0);
+	}
+
+	uint32_t LightBVH::Subdivide(std::span<BuildLight> Lights, uint32_t BitTrail, uint32_t Depth)
+	{
+		const uint32_t nodeIndex = static_cast<uint32_t>(Nodes.size());
+		Nodes.emplace_back();
+
+		if (Lights.size() == 1)
+		{
+			Node& leaf = Nodes[nodeIndex];
+			leaf = Lights[0].Bounds;
+			leaf.ChildOrLightIndex = Lights[0].LightIndex;
+			leaf.Flags |= Node::Leaf;
+			BitTrails[Lights[0].LightIndex] = BitTrail;
+			return nodeIndex;
+		}
+
+		Node bounds = {};
+		XMVECTOR centroidMin = XMLoadFloat3(&Lights[0].Centroid), centroidMax = centroidMin;
+		for (const auto& light : Lights)
+		{
+			bounds = Union(bounds, light.Bounds);
+			centroidMin = XMVectorMin(centroidMin, XMLoadFloat3(&light.Centroid));
+			centroidMax = XMVectorMax(centroidMax, XMLoadFloat3(&light.Centroid));
+		}
+
+		XMFLOAT3 extent, centroidExtent;
+		XMStoreFloat3(&extent, XMLoadFloat3(&bounds.Max) - XMLoadFloat3(&bounds.Min));
+		XMStoreFloat3(&centroidExtent, centroidMax - centroidMin);
+		float3 centroidLow;
+		XMStoreFloat3(&centroidLow, centroidMin);
+
+		auto bucketOf = [&](const BuildLight& Light, int Dim)
+		{
+			const float offset = (Component(Light.Centroid, Dim) - Component(centroidLow, Dim)) / Component(centroidExtent, Dim);
+			return std::min(static_cast<uint32_t>(offset * NumBuckets), NumBuckets - 1);
+		};
+
+		// Bucketed SAOH split, both sides of a split must get lights
+		float minCost = std::numeric_limits<float>::infinity();
+		int splitDim = -1;
+		uint32_t splitBucket = 0;
+		if (Depth < MaxSAHDepth)
+		{
+			for (int dim = 0; dim < 3; ++dim)
+			{
+				if (Component(centroidExtent, dim) == 0.0f)
+				{
+					continue;
+				}
+
+				Node buckets[NumBuckets] = {};
+				uint32_t counts[NumBuckets] = {};
+				for (const auto& light : Lights)
+				{
+					const uint32_t b = bucketOf(light, dim);
+					buckets[b] = Union(buckets[b], light.Bounds);
+					counts[b]++;
+				}
+
+				for (uint32_t i = 0; i < NumBuckets - 1; ++i)
+				{
+					Node below = {}, above = {};
+					uint32_t numBelow = 0, numAbove = 0;
+					for (uint32_t j = 0; j <= i; ++j)
+					{
+						below = Union(below, buckets[j]);
+						numBelow += counts[j];
+					}
+					for (uint32_t j = i + 1; j < NumBuckets; ++j)
+					{
+						above = Union(above, buckets[j]);
+						numAbove += counts[j];
+					}
+
+					if (numBelow == 0 || numAbove == 0)
+					{
+						continue;
+					}
+
+					// Sides made of a single point light cost nothing, those splits are left to the median
+					const float cost = EvaluateCost(below, extent, dim) + EvaluateCost(above, extent, dim);
+					if (cost > 0.0f && cost < minCost)
+					{
+						minCost = cost;
+						splitDim = dim;
+						splitBucket = i;
+					}
+				}
+			}
+		}
+
+		size_t mid;
+		if (splitDim >= 0)
+		{
+			const auto it = std::partition(Lights.begin(), Lights.end(), [&](const BuildLight& Light)
+			{
+				return bucketOf(Light, splitDim) <= splitBucket;
+			});
+			mid = static_cast<size_t>(it - Lights.begin());
+		}
+		else
+		{
+			// Median along the widest axis of the centroids, keeps the tree balanced once the SAOH is no longer used
+			const int dim = centroidExtent.x >= centroidExtent.y && centroidExtent.x >= centroidExtent.z ? 0 : centroidExtent.y >= centroidExtent.z ? 1 : 2;
+			mid = Lights.size() / 2;
+			std::nth_element(Lights.begin(), Lights.begin() + mid, Lights.end(), [dim](const BuildLight& a, const BuildLight& b)
+			{
+				return Component(a.Centroid, dim) < Component(b.Centroid, dim);
+			});
+		}
+
+		Subdivide(Lights.subspan(0, mid), BitTrail, Depth + 1);
+		const uint32_t secondChild = Subdivide(Lights.subspan(mid), BitTrail | (1u << Depth), Depth + 1);
+
+		Node& node = Nodes[nodeIndex];
+		node = bounds;
+		node.ChildOrLightIndex = secondChild;
+		return nodeIndex;
+	}
+
+	bool LightBVH::Sample(FXMVECTOR p, FXMVECTOR n, float u, uint32_t* pLightIndex, float* pPmf) const
+	{
+		if (Nodes.empty())
+		{
+			return false;
+		}
+
+		uint32_t nodeIndex = 0;
+		float pmf = 1.0f;
+		while (!Nodes[nodeIndex].IsLeaf())
+		{
+			const uint32_t children[] = { nodeIndex + 1, Nodes[nodeIndex].ChildOrLightIndex };
+			const float importance0 = Importance(Nodes[children[0]], p, n);
+			const float importance1 = Importance(Nodes[children[1]], p, n);
+			if (importance0 == 0.0f && importance1 == 0.0f)
+			{
+				return false;
+			}
+
+			// Reuse u for the next level
+			const float p0 = importance0 / (importance0 + importance1);
+			if (u < p0)
+			{
+				nodeIndex = children[0];
+				u = std::min(u / p0, OneMinusEpsilon);
+				pmf *= p0;
+			}
+			else
+			{
+				nodeIndex = children[1];
+				u = std::min((u - p0) / (1.0f - p0), OneMinusEpsilon);
+				pmf *= 1.0f - p0;
+			}
+		}
+
+		// A leaf is only picked through a parent that saw it contribute, except when it is the root
+		if (nodeIndex == 0 && Importance(Nodes[0], p, n) == 0.0f)
+		{
+			return false;
+		}
+
+		*pLightIndex = Nodes[nodeIndex].ChildOrLightIndex;
+		*pPmf = pmf;
+		return true;
+	}
+
+	float LightBVH::Pmf(FXMVECTOR p, FXMVECTOR n, uint32_t LightIndex) const
+	{
+		if (LightIndex >= BitTrails.size() || BitTrails[LightIndex] == InvalidBitTrail)
+		{
+			return 0.0f;
+		}
+
+		uint32_t bitTrail = BitTrails[LightIndex];
+		uint32_t nodeIndex = 0;
+		float pmf = 1.0f;
+		while (!Nodes[nodeIndex].IsLeaf())
+		{
+			const uint32_t children[] = { nodeIndex + 1, Nodes[nodeIndex].ChildOrLightIndex };
+			const float importance0 = Importance(Nodes[children[0]], p, n);
+			const float importance1 = Importance(Nodes[children[1]], p, n);
+			if (importance0 == 0.0f && importance1 == 0.0f)
+			{
+				return 0.0f;
+			}
+
+			const uint32_t child = bitTrail & 1;
+			pmf *= (child ? importance1 : importance0) / (importance0 + importance1);
+			nodeIndex = children[child];
+			bitTrail >>= 1;
+		}
+
+		if (nodeIndex == 0 && Importance(Nodes[0], p, n) == 0.0f)
+		{
+			return 0.0f;
+		}
+		return pmf;
+	}
+
+	bool LightBVH::IntersectBounds(const Node& Node, const float3& Origin, const float3& InvDirection, float TMax)
+	{
+		float tMin = 0.0f;
+		const auto slab = [&](float Min, float Max, float Origin, float InvDirection)
+		{
+			float t0 = (Min - Origin) * InvDirection;
+			float t1 = (Max - Origin) * InvDirection;
+			if (t0 > t1)
+			{
+				std::swap(t0, t1);
+			}
+
+			// NaN for rays in the plane of a flat side fail both comparisons and leave the interval as it is
+			tMin = t0 > tMin ? t0 : tMin;
+			TMax = t1 < TMax ? t1 : TMax;
+		};
+		slab(Node.Min.x, Node.Max.x, Origin.x, InvDirection.x);
+		slab(Node.Min.y, Node.Max.y, Origin.y, InvDirection.y);
+		slab(Node.Min.z, Node.Max.z, Origin.z, InvDirection.z);
+		return tMin <= TMax;
+	}
+
+	void BenchmarkLightBVH()
+	{
+		std::mt19937 generator(1337);
+		std::uniform_real_distribution<float> distribution(0.0f, 1.0f);
+
+		// A ceiling of small lights, alternating between quads facing random directions and points, a few of them much
+		// brighter than the rest
+		constexpr uint32_t GridSize = 64;
+		constexpr float Spacing = 0.5f;
+		constexpr float QuadSize = 0.1f;
+		std::vector<HLSL::Light> lights;
+		lights.reserve(GridSize * GridSize);
+		for (uint32_t z = 0; z < GridSize; ++z)
+		{
+			for (uint32_t x = 0; x < GridSize; ++x)
+			{
+				HLSL::Light light = {};
+				light.Position = { (static_cast<float>(x) - GridSize * 0.5f) * Spacing, 4.0f, (static_cast<float>(z) - GridSize * 0.5f) * Spacing };
+
+				const float intensity = 1.0f + 100.0f * std::pow(distribution(generator), 16.0f);
+				light.I = { intensity, intensity, intensity };
+
+				if ((x + z) % 2 == 0)
+				{
+					light.Type = LightType::PointLight;
+				}
+				else
+				{
+					light.Type = LightType::QuadLight;
+
+					const XMVECTOR normal = XMVector3Normalize(XMVectorSet(distribution(generator) - 0.5f, -1.0f, distribution(generator) - 0.5f, 0.0f));
+					const XMVECTOR tangent = XMVector3Normalize(XMVector3Cross(normal, XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f)));
+					const XMVECTOR bitangent = XMVector3Cross(normal, tangent);
+					const XMVECTOR center = XMLoadFloat3(&light.Position);
+					const XMVECTOR ex = tangent * QuadSize, ey = bitangent * QuadSize;
+					XMStoreFloat3(&light.Points[0], center - 0.5f * ex - 0.5f * ey);
+					XMStoreFloat3(&light.Points[1], center + 0.5f * ex - 0.5f * ey);
+					XMStoreFloat3(&light.Points[2], center + 0.5f * ex + 0.5f * ey);
+					XMStoreFloat3(&light.Points[3], center - 0.5f * ex + 0.5f * ey);
+				}
+				lights.push_back(light);
+			}
+		}
+
+		std::vector<float> powers(lights.size());
+		for (size_t i = 0; i < lights.size(); ++i)
+		{
+			powers[i] = LightPower(lights[i]);
+		}
+
+		const AliasTable powerTable(powers);
+		LightBVH bvh;
+		{
+			const auto start = std::chrono::high_resolution_clock::now();
+			bvh.Build(lights);
+			const auto stop = std::chrono::high_resolution_clock::now();
+			LOG_INFO("Light BVH over {} lights: {} nodes, {:.3f}(ms)", lights.size(), bvh.GetNodes().size(), std::chrono::duration<double, std::milli>(stop - start).count());
+		}
+
+		// Irradiance at points a little below the ceiling, facing it
+		struct ShadingPoint
+		{
+			XMVECTOR p, n;
+			double Reference;
+		};
+
+		auto contribution = [](const HLSL::Light& Light, FXMVECTOR p, FXMVECTOR n, XMFLOAT2 Xi)
+		{
+			LightSample sample;
+			if (!SampleLi(Light, p, Xi, &sample))
+			{
+				return 0.0f;
+			}
+
+			XMFLOAT3 Li;
+			XMStoreFloat3(&Li, sample.Li);
+			const float luminance = 0.212671f * Li.x + 0.715160f * Li.y + 0.072169f * Li.z;
+			return luminance * std::max(XMVectorGetX(XMVector3Dot(n, sample.wi)), 0.0f) / sample.pdf;
+		};
+
+		constexpr uint32_t NumPoints = 64;
+		constexpr uint32_t NumReferenceStrata = 4; // Per dimension, per quad light, the quads are small next to their distance
+		std::vector<ShadingPoint> points(NumPoints);
+		for (auto& point : points)
+		{
+			const float extent = GridSize * Spacing;
+			point.p = XMVectorSet((distribution(generator) - 0.5f) * extent, 3.0f, (distribution(generator) - 0.5f) * extent, 0.0f);
+			point.n = XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f);
+
+			point.Reference = 0.0;
+			for (const auto& light : lights)
+			{
+				if (IsDeltaLight(light))
+				{
+					point.Reference += contribution(light, point.p, point.n, { 0.0f, 0.0f });
+					continue;
+				}
+
+				double sum = 0.0;
+				for (uint32_t i = 0; i < NumReferenceStrata; ++i)
+				{
+					for (uint32_t j = 0; j < NumReferenceStrata; ++j)
+					{
+						const XMFLOAT2 Xi = { (i + 0.5f) / NumReferenceStrata, (j + 0.5f) / NumReferenceStrata };
+						sum += contribution(light, point.p, point.n, Xi);
+					}
+				}
+				point.Reference += sum / (NumReferenceStrata * NumReferenceStrata);
+			}
+		}
+
+		// Same number of shadow rays for both, only the choice of light differs
+		constexpr uint32_t NumTrials = 16;
+		constexpr uint32_t MaxSamples = 256;
+		LOG_INFO("Direct lighting from {} lights, relative RMSE over {} points (Power, Light BVH)", lights.size(), NumPoints);
+		for (uint32_t numSamples = 1; numSamples <= MaxSamples; numSamples *= 4)
+		{
+			double squaredErrors[2] = {};
+			for (const auto& point : points)
+			{
+				for (uint32_t trial = 0; trial < NumTrials; ++trial)
+				{
+					double sums[2] = {};
+					for (uint32_t sample = 0; sample < numSamples; ++sample)
+					{
+						const float u = distribution(generator);
+						const XMFLOAT2 Xi = { distribution(generator), distribution(generator) };
+
+						float pmf;
+						uint32_t light = powerTable.Sample(u, &pmf);
+						sums[0] += contribution(lights[light], point.p, point.n, Xi) / pmf;
+
+						if (bvh.Sample(point.p, point.n, u, &light, &pmf))
+						{
+							sums[1] += contribution(lights[light], point.p, point.n, Xi) / pmf;
+						}
+					}
+
+					for (size_t i = 0; i < ARRAYSIZE(sums); ++i)
+					{
+						const double error = (sums[i] / numSamples - point.Reference) / point.Reference;
+						squaredErrors[i] += error * error;
+					}
+				}
+			}
+
+			LOG_INFO("\t{:>5} spp: {:.3e} {:.3e}", numSamples,
+				std::sqrt(squaredErrors[0] / (NumPoints * NumTrials)),
+				std::sqrt(squaredErrors[1] / (NumPoints * NumTrials)));
+		}
+	}
+}
@@ -0,0 +1,126 @@
+#pragma once
+#include <span>
+#include <vector>
+#include <DirectXMath.h>
+
+#include "../SharedTypes.h"
+
+namespace CPU
+{
+	/*
+	* Bounding volume hierarchy over the lights of a scene for many-light sampling (Conty Estevez and Kulla 2018, as in
+	* pbrt-v4). Every node bounds the positions, power and emission directions of the lights below it. Sampling walks
+	* down from the root and picks each child in proportion to an estimate of what it contributes to the shading point,
+	* so the pmf of a light depends on the point and its normal. Nodes are laid out depth first for upload,
+	* LightBVH.hlsli walks them the same way.
+	*/
+	class LightBVH
+	{
+	public:
+		static constexpr uint32_t NumBuckets = 12;
+
+		// Bit trails are 32 bit, below this depth lights are split at the median so leaves stay above depth 32
+		static constexpr uint32_t MaxSAHDepth = 15;
+		static constexpr uint32_t MaxLights = 1 << 16;
+
+		static constexpr uint32_t InvalidBitTrail = ~0u;
+
+		// Must match LightBVHNode in LightBVH.hlsli
+		struct Node
+		{
+			enum : uint32_t
+			{
+				Leaf = 1 << 0,
+				TwoSided = 1 << 1
+			};
+
+			float3 Min;
+			float Phi; // Luminance of the power of the lights below
+			float3 Max;
+			uint32_t ChildOrLightIndex; // Second child for interior nodes, the first one follows the node, light for leaves
+			float3 w; // Axis of the cone of normals
+			float CosTheta_o; // Spread of the normals around w
+			float CosTheta_e; // Angle past a normal light is emitted at
+			uint32_t Flags;
+
+			[[nodiscard]] bool IsLeaf() const { return Flags & Leaf; }
+		};
+		static_assert(sizeof(Node) == 56);
+
+		// Lights without power are left out and never sampled, throws if there are more than MaxLights
+		void Build(std::span<const HLSL::Light> Lights);
+
+		// Picks a light for the point p with normal n, returns false when no light can reach it
+		bool Sample(DirectX::FXMVECTOR p, DirectX::FXMVECTOR n, float u, uint32_t* pLightIndex, float* pPmf) const;
+
+		// Probability of Sample picking the light for p and n
+		[[nodiscard]] float Pmf(DirectX::FXMVECTOR p, DirectX::FXMVECTOR n, uint32_t LightIndex) const;
+
+		// Calls Visitor(LightIndex) for the leaves whose bounds the ray enters before TMax. Visitor returns the distance of
+		// the closest light hit so far, subtrees past it are skipped. Finds the light a BSDF sampled ray passes without
+		// testing every light
+		template<typename TVisitor>
+		void Traverse(DirectX::FXMVECTOR Origin, DirectX::FXMVECTOR Direction, float TMax, TVisitor Visitor) const
+		{
+			if (Nodes.empty())
+			{
+				return;
+			}
+
+			float3 origin, invDirection;
+			DirectX::XMStoreFloat3(&origin, Origin);
+			DirectX::XMStoreFloat3(&invDirection, DirectX::XMVectorReciprocal(Direction));
+
+			// Bit trails are 32 bit so no leaf is deeper than 32, at most one node is pushed per level
+			uint32_t stack[32];
+			uint32_t stackSize = 0;
+			uint32_t nodeIndex = 0;
+			while (true)
+			{
+				const Node& node = Nodes[nodeIndex];
+				if (IntersectBounds(node, origin, invDirection, TMax))
+				{
+					if (!node.IsLeaf())
+					{
+						stack[stackSize++] = node.ChildOrLightIndex;
+						nodeIndex = nodeIndex + 1;
+						continue;
+					}
+					TMax = Visitor(node.ChildOrLightIndex);
+				}
+
+				if (stackSize == 0)
+				{
+					break;
+				}
+				nodeIndex = stack[--stackSize];
+			}
+		}
+
+		[[nodiscard]] bool IsEmpty() const { return Nodes.empty(); }
+		[[nodiscard]] const std::vector<Node>& GetNodes() const { return Nodes; }
+
+		// Path from the root to the leaf of every light, bit i set takes the second child at depth i.
+		// InvalidBitTrail for lights that are not in the tree
+		[[nodiscard]] const std::vector<uint32_t>& GetBitTrails() const { return BitTrails; }
+	private:
+		struct BuildLight
+		{
+			uint32_t LightIndex;
+			Node Bounds;
+			float3 Centroid;
+		};
+
+		uint32_t Subdivide(std::span<BuildLight> Lights, uint32_t BitTrail, uint32_t Depth);
+
+		// Slab test against [0, TMax], quad lights have flat bounds
+		static bool IntersectBounds(const Node& Node, const float3& Origin, const float3& InvDirection, float TMax);
+
+		std::vector<Node> Nodes;
+		std::vector<uint32_t> BitTrails;
+	};
+
+	// Logs the relative RMSE of direct lighting from thousands of lights with the same number of shadow rays per point,
+	// picking lights in proportion to their power and with the light BVH
+	void BenchmarkLightBVH();
+}
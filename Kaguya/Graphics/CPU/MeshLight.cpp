@@ -0,0 +1,161 @@
+#include "pch.h"
+#include "MeshLight.h"
+
+using namespace DirectX;
+
+namespace CPU
+{
+	EmissiveMesh::EmissiveMesh(const BVH& BVH)
+	{
+		const uint32_t numTriangles = BVH.GetNumTriangles();
+		Positions.reserve(size_t(numTriangles) * 3);
+
+		std::vector<float> areas(numTriangles);
+		double area = 0.0;
+		for (uint32_t i = 0; i < numTriangles; ++i)
+		{
+			const uint32_t* triangle = BVH.GetTriangle(i);
+			for (uint32_t j = 0; j < 3; ++j)
+			{
+				Positions.push_back(BVH.GetPosition(triangle[j]));
+			}
+
+			const XMVECTOR p0 = XMLoadFloat3(&Positions[size_t(i) * 3 + 0]);
+			const XMVECTOR p1 = XMLoadFloat3(&Positions[size_t(i) * 3 + 1]);
+			const XMVECTOR p2 = XMLoadFloat3(&Positions[size_t(i) * 3 + 2]);
+			areas[i] = 0.5f * XMVectorGetX(XMVector3Length(XMVector3Cross(p1 - p0, p2 - p0)));
+			area += areas[i];
+		}
+
+		TriangleSampler = AliasTable(areas);
+		Area = static_cast<float>(area);
+	}
+
+	std::shared_ptr<const EmissiveMesh> GetOrBuildEmissiveMesh(Asset::Mesh& Mesh)
+	{
+		if (!Mesh.Emitter)
+		{
+			const auto bvh = GetOrBuildBVH(Mesh);
+			if (!bvh)
+			{
+				return nullptr;
+			}
+
+			const auto start = std::chrono::high_resolution_clock::now();
+			auto emitter = std::make_shared<const EmissiveMesh>(*bvh);
+			const auto stop = std::chrono::high_resolution_clock::now();
+			LOG_INFO("{}: {} emissive triangles built in {}(ms)", Mesh.Name, emitter->GetNumTriangles(), std::chrono::duration<double, std::milli>(stop - start).count());
+			Mesh.Emitter = std::move(emitter);
+		}
+		return Mesh.Emitter;
+	}
+
+	HLSL::Light MeshLightTriangles::Add(const EmissiveMesh& Mesh, FXMMATRIX World, const float3& Radiance)
+	{
+		HLSL::Light light = {};
+		light.Type = LightType::MeshLight;
+		light.I = Radiance;
+		light.FirstTriangle = static_cast<uint32_t>(Triangles.size());
+		light.NumTriangles = Mesh.GetNumTriangles();
+		light.ObjectArea = Mesh.GetArea();
+
+		XMVECTOR min = XMVectorReplicate(FLT_MAX);
+		XMVECTOR max = XMVectorReplicate(-FLT_MAX);
+		float area = 0.0f;
+
+		const auto positions = Mesh.GetPositions();
+		for (uint32_t i = 0; i < light.NumTriangles; ++i)
+		{
+			XMVECTOR p[3];
+			for (uint32_t j = 0; j < 3; ++j)
+			{
+				p[j] = XMVector3TransformCoord(XMLoadFloat3(&positions[size_t(i) * 3 + j]), World);
+				min = XMVectorMin(min, p[j]);
+				max = XMVectorMax(max, p[j]);
+			}
+			area += 0.5f * XMVectorGetX(XMVector3Length(XMVector3Cross(p[1] - p[0], p[2] - p[0])));
+
+			HLSL::EmissiveTriangle& triangle = Triangles.emplace_back();
+			XMStoreFloat3(&triangle.p0, p[0]);
+			XMStoreFloat3(&triangle.p1, p[1]);
+			XMStoreFloat3(&triangle.p2, p[2]);
+		}
+
+		const auto& bins = Mesh.GetTriangleSampler().GetBins();
+		Bins.insert(Bins.end(), bins.begin(), bins.end());
+
+		XMStoreFloat3(&light.Position, (min + max) * 0.5f);
+		XMStoreFloat3(&light.Points[0], min);
+		XMStoreFloat3(&light.Points[1], max);
+		light.Area = area;
+		return light;
+	}
+
+	void MeshLightTriangles::Clear()
+	{
+		Triangles.clear();
+		Bins.clear();
+	}
+
+	bool SampleMeshLi(const HLSL::Light& Light, const MeshLightTriangles& Triangles, FXMVECTOR p, float u, XMFLOAT2 Xi, LightSample* pSample)
+	{
+		if (Light.NumTriangles == 0)
+		{
+			return false;
+		}
+
+		float pmf;
+		const std::span<const AliasTable::Bin> bins(Triangles.Bins.data() + Light.FirstTriangle, Light.NumTriangles);
+		const uint32_t index = AliasTable::Sample(bins, u, &pmf);
+		const HLSL::EmissiveTriangle& triangle = Triangles.Triangles[Light.FirstTriangle + index];
+
+		const XMVECTOR p0 = XMLoadFloat3(&triangle.p0);
+		const XMVECTOR p1 = XMLoadFloat3(&triangle.p1);
+		const XMVECTOR p2 = XMLoadFloat3(&triangle.p2);
+		const XMVECTOR n = XMVector3Cross(p1 - p0, p2 - p0);
+		const float area = 0.5f * XMVectorGetX(XMVector3Length(n));
+		if (area == 0.0f)
+		{
+			return false;
+		}
+
+		// Uniform barycentrics
+		const float su = std::sqrt(Xi.x);
+		const float b0 = 1.0f - su;
+		const float b1 = Xi.y * su;
+		const XMVECTOR y = b0 * p0 + b1 * p1 + (1.0f - b0 - b1) * p2;
+
+		const XMVECTOR d = y - p;
+		const float d2 = XMVectorGetX(XMVector3LengthSq(d));
+		const XMVECTOR wi = XMVector3Normalize(d);
+		const float cosTheta = std::abs(XMVectorGetX(XMVector3Dot(XMVector3Normalize(n), wi)));
+		if (d2 == 0.0f || cosTheta == 0.0f)
+		{
+			return false;
+		}
+
+		pSample->Li = XMLoadFloat3(&Light.I);
+		pSample->wi = wi;
+		pSample->p = y;
+		pSample->pdf = pmf / area * d2 / cosTheta;
+		return true;
+	}
+
+	float MeshLightPdf(const HLSL::Light& Light, const MeshLightTriangles& Triangles, uint32_t TriangleIndex, FXMVECTOR p, FXMVECTOR y)
+	{
+		const HLSL::EmissiveTriangle& triangle = Triangles.Triangles[Light.FirstTriangle + TriangleIndex];
+		const XMVECTOR p0 = XMLoadFloat3(&triangle.p0);
+		const XMVECTOR n = XMVector3Cross(XMLoadFloat3(&triangle.p1) - p0, XMLoadFloat3(&triangle.p2) - p0);
+		const float area = 0.5f * XMVectorGetX(XMVector3Length(n));
+
+		const XMVECTOR d = y - p;
+		const float d2 = XMVectorGetX(XMVector3LengthSq(d));
+		const float cosTheta = std::abs(XMVectorGetX(XMVector3Dot(XMVector3Normalize(n), XMVector3Normalize(d))));
+		if (area == 0.0f || d2 == 0.0f || cosTheta == 0.0f)
+		{
+			return 0.0f;
+		}
+
+		return Triangles.Bins[Light.FirstTriangle + TriangleIndex].Pmf / area * d2 / cosTheta;
+	}
+}
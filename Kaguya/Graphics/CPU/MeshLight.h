@@ -0,0 +1,62 @@
+#pragma once
+#include <memory>
+#include <span>
+#include <vector>
+#include <DirectXMath.h>
+
+#include "AliasTable.h"
+#include "BVH.h"
+#include "Light.h"
+
+namespace CPU
+{
+	/*
+	* Triangles of an emissive mesh with an alias table that picks them in proportion to their area. Materials emit the
+	* same radiance everywhere, so area times radiance reduces to area. The table is built in object space once per mesh
+	* and kept with the mesh in the mesh cache, instances that do not scale uniformly keep using it and divide by the
+	* world space area of the triangle they picked instead, which stays unbiased.
+	*/
+	class EmissiveMesh
+	{
+	public:
+		// Triangles are in the order of the BVH, so the primitive index of a hit indexes the table
+		explicit EmissiveMesh(const BVH& BVH);
+
+		[[nodiscard]] const AliasTable& GetTriangleSampler() const { return TriangleSampler; }
+		[[nodiscard]] std::span<const float3> GetPositions() const { return Positions; }
+		[[nodiscard]] uint32_t GetNumTriangles() const { return static_cast<uint32_t>(Positions.size() / 3); }
+		[[nodiscard]] float GetArea() const { return Area; }
+	private:
+		std::vector<float3> Positions; // 3 per triangle, object space
+		AliasTable TriangleSampler;
+		float Area = 0.0f; // Object space
+	};
+
+	[[nodiscard]] inline bool IsEmissive(const float3& Radiance)
+	{
+		return Radiance.x > 0.0f || Radiance.y > 0.0f || Radiance.z > 0.0f;
+	}
+
+	// Returns the emissive triangles of the mesh and builds them the first time, must be called on the main thread.
+	// Null when the mesh has neither a BVH nor geometry in RAM
+	std::shared_ptr<const EmissiveMesh> GetOrBuildEmissiveMesh(Asset::Mesh& Mesh);
+
+	// World space triangles of the mesh lights of a scene and the alias table bins that pick them, the triangles of a
+	// light start at HLSL::Light::FirstTriangle in both. Uploaded to the GPU as they are
+	struct MeshLightTriangles
+	{
+		// Appends the triangles of an instance and returns its light
+		HLSL::Light Add(const EmissiveMesh& Mesh, DirectX::FXMMATRIX World, const float3& Radiance);
+
+		void Clear();
+
+		std::vector<HLSL::EmissiveTriangle> Triangles;
+		std::vector<AliasTable::Bin> Bins;
+	};
+
+	// Picks a triangle with u and a point on it uniformly by area with Xi, the pdf is converted to solid angle at p
+	bool SampleMeshLi(const HLSL::Light& Light, const MeshLightTriangles& Triangles, DirectX::FXMVECTOR p, float u, DirectX::XMFLOAT2 Xi, LightSample* pSample);
+
+	// Solid angle pdf of SampleMeshLi picking the point y of triangle TriangleIndex of the light from p
+	[[nodiscard]] float MeshLightPdf(const HLSL::Light& Light, const MeshLightTriangles& Triangles, uint32_t TriangleIndex, DirectX::FXMVECTOR p, DirectX::FXMVECTOR y);
+}
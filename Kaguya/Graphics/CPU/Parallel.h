@@ -0,0 +1,33 @@
+#pragma once
+#include <algorithm>
+#include <future>
+#include <thread>
+#include <vector>
+
+namespace CPU
+{
+	// Splits [0, Count) into one range per hardware thread, every range but the last has at least Grain items.
+	// Function(Begin, End) is called for every range concurrently, the first range runs on the calling thread
+	template<typename TFunction>
+	void ParallelFor(size_t Count, size_t Grain, TFunction Function)
+	{
+		const size_t numThreads = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+		const size_t rangeSize = std::max((Count + numThreads - 1) / numThreads, std::max<size_t>(Grain, 1));
+
+		std::vector<std::future<void>> ranges;
+		for (size_t begin = rangeSize; begin < Count; begin += rangeSize)
+		{
+			ranges.push_back(std::async(std::launch::async, [&Function, begin, end = std::min(begin + rangeSize, Count)]()
+			{
+				Function(begin, end);
+			}));
+		}
+
+		Function(0, std::min(rangeSize, Count));
+
+		for (auto& range : ranges)
+		{
+			range.get();
+		}
+	}
+}
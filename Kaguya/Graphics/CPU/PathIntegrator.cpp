@@ -0,0 +1,970 @@
+#include "pch.h"
+#include "PathIntegrator.h"
+#include "Light.h"
+#include "Sampling.h"
+
+using namespace DirectX;
+
+namespace CPU
+{
+	namespace
+	{
+		float Luminance(FXMVECTOR L)
+		{
+			return XMVectorGetX(XMVector3Dot(L, XMVectorSet(0.212671f, 0.715160f, 0.072169f, 0.0f)));
+		}
+
+		// White noise for the lens, like RandomFloat01 in Random.hlsli
+		float RandomFloat01(uint32_t& Seed)
+		{
+			Seed = WangHash(Seed);
+			return std::min(static_cast<float>(Seed) * 0x1p-32f, 0x1.fffffep-1f);
+		}
+
+		// Like Interaction::SpawnRayTo in BSDF.hlsli
+		Ray SpawnRayTo(FXMVECTOR p0, FXMVECTOR p1)
+		{
+			constexpr float ShadowEpsilon = 0.0001f;
+
+			const XMVECTOR d = p1 - p0;
+			const float distance = XMVectorGetX(XMVector3Length(d));
+
+			Ray ray;
+			XMStoreFloat3(&ray.Origin, p0);
+			XMStoreFloat3(&ray.Direction, d / distance);
+			ray.TMin = 0.0001f;
+			ray.TMax = distance - ShadowEpsilon;
+			return ray;
+		}
+
+		// Paths of a wavefront batch, every field has its own array so a stage only loads the fields it uses
+		struct PathStates
+		{
+			// Grows the arrays to at least NumPaths paths, they never shrink
+			void Reserve(size_t NumPaths)
+			{
+				if (NumPaths <= Origin.size())
+				{
+					return;
+				}
+
+				Origin.resize(NumPaths);
+				Direction.resize(NumPaths);
+				TMin.resize(NumPaths);
+				TMax.resize(NumPaths);
+				Beta.resize(NumPaths);
+				L.resize(NumPaths);
+				ScatteringPdf.resize(NumPaths);
+				ScatteringNormal.resize(NumPaths);
+				Hits.resize(NumPaths);
+				HitSurface.resize(NumPaths);
+				Pixel.resize(NumPaths);
+				SampleIndex.resize(NumPaths);
+			}
+
+			[[nodiscard]] Ray GetRay(uint32_t Path) const { return { Origin[Path], TMin[Path], Direction[Path], TMax[Path] }; }
+
+			std::vector<float3> Origin;
+			std::vector<float3> Direction;
+			std::vector<float> TMin;
+			std::vector<float> TMax;
+			std::vector<XMFLOAT3> Beta;
+			std::vector<XMFLOAT3> L;
+			std::vector<float> ScatteringPdf; // Of the BSDF sample that spawned the ray, 0 for specular samples
+			std::vector<XMFLOAT3> ScatteringNormal; // At the origin of the ray
+			std::vector<RaytracingScene::Hit> Hits;
+			std::vector<uint8_t> HitSurface;
+			std::vector<XMUINT2> Pixel;
+			std::vector<uint32_t> SampleIndex;
+		};
+
+		// Shadow rays of one bounce and the radiance they add to their path when they are unoccluded
+		struct ShadowRays
+		{
+			void Clear()
+			{
+				Origin.clear();
+				Direction.clear();
+				TMin.clear();
+				TMax.clear();
+				Contribution.clear();
+				Path.clear();
+			}
+
+			void Push(uint32_t Path, const Ray& Ray, FXMVECTOR Contribution)
+			{
+				Origin.push_back(Ray.Origin);
+				Direction.push_back(Ray.Direction);
+				TMin.push_back(Ray.TMin);
+				TMax.push_back(Ray.TMax);
+				XMStoreFloat3(&this->Contribution.emplace_back(), Contribution);
+				this->Path.push_back(Path);
+			}
+
+			[[nodiscard]] Ray GetRay(uint32_t Index) const { return { Origin[Index], TMin[Index], Direction[Index], TMax[Index] }; }
+			[[nodiscard]] uint32_t Size() const { return static_cast<uint32_t>(Path.size()); }
+
+			std::vector<float3> Origin;
+			std::vector<float3> Direction;
+			std::vector<float> TMin;
+			std::vector<float> TMax;
+			std::vector<XMFLOAT3> Contribution;
+			std::vector<uint32_t> Path;
+			std::vector<uint8_t> Occluded; // Written when the rays are traced
+		};
+
+		uint32_t DirectionOctant(const float3& Direction)
+		{
+			return (Direction.x < 0.0f ? 1u : 0u) | (Direction.y < 0.0f ? 2u : 0u) | (Direction.z < 0.0f ? 4u : 0u);
+		}
+
+		// Bin of the BxDF that BSDF picks for Material
+		uint32_t BSDFBin(const Material& Material)
+		{
+			return Material.BSDFType >= 0 && Material.BSDFType < BSDFTypes::NumBSDFTypes ? Material.BSDFType : BSDFTypes::Disney;
+		}
+
+		// Stable counting sort of Indices by Bin(Index), which must be below NumBins. Scratch is reused between calls
+		template<uint32_t NumBins, typename TBin>
+		void BinIndices(std::vector<uint32_t>& Indices, std::vector<uint32_t>& Scratch, TBin Bin)
+		{
+			std::array<uint32_t, NumBins + 1> offsets = {};
+			for (uint32_t index : Indices)
+			{
+				++offsets[Bin(index) + 1];
+			}
+			std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+
+			Scratch.resize(Indices.size());
+			for (uint32_t index : Indices)
+			{
+				Scratch[offsets[Bin(index)]++] = index;
+			}
+			std::swap(Indices, Scratch);
+		}
+	}
+
+	struct PathIntegrator::WavefrontState
+	{
+		PathStates Paths;
+		ShadowRays Shadows;
+		std::vector<uint32_t> Active, Next, Scratch;
+	};
+
+	void PixelStatistics::Add(float Luminance)
+	{
+		++NumSamples;
+		const float delta = Luminance - Mean;
+		Mean += delta / static_cast<float>(NumSamples);
+		M2 += delta * (Luminance - Mean);
+	}
+
+	float PixelStatistics::RelativeError() const
+	{
+		if (NumSamples < 2)
+		{
+			return std::numeric_limits<float>::infinity();
+		}
+
+		const float n = static_cast<float>(NumSamples);
+		const float variance = M2 / (n - 1.0f);
+		return std::sqrt(variance / n) / std::max(Mean, AdaptiveSamplingMinLuminance);
+	}
+
+	uint32_t NumAdaptiveSamples(float RelativeError, uint32_t NumSamples, float Threshold, uint32_t MaxSamples)
+	{
+		if (MaxSamples == 0)
+		{
+			return 0;
+		}
+
+		if (NumSamples < AdaptiveSamplingMinSamples)
+		{
+			return std::min(AdaptiveSamplingMinSamples - NumSamples, MaxSamples);
+		}
+
+		if (RelativeError <= Threshold)
+		{
+			return 0;
+		}
+
+		if (Threshold <= 0.0f)
+		{
+			return MaxSamples;
+		}
+
+		const float ratio = RelativeError / Threshold;
+		const float needed = std::ceil(static_cast<float>(NumSamples) * (ratio * ratio - 1.0f));
+		return static_cast<uint32_t>(std::clamp(needed, 1.0f, static_cast<float>(MaxSamples)));
+	}
+
+	PathIntegrator::PathIntegrator(std::shared_ptr<const RaytracingScene> Scene, const Options& Options)
+		: Scene(std::move(Scene)),
+		Settings(Options),
+		Scheduler(Options.Width, Options.Height, Options.TileSize, Options.Order),
+		Image(size_t(Options.Width) * Options.Height, XMFLOAT3(0.0f, 0.0f, 0.0f)),
+		Pixels(size_t(Options.Width) * Options.Height)
+	{
+		if (Settings.Sampler == SamplerType::BlueNoise)
+		{
+			throw std::exception("The CPU path integrator does not support the blue noise sampler");
+		}
+
+		if (Settings.Wavefront)
+		{
+			Wavefronts.resize(TileScheduler::GetMaxNumWorkers());
+			for (auto& wavefront : Wavefronts)
+			{
+				wavefront = std::make_unique<WavefrontState>();
+			}
+		}
+	}
+
+	PathIntegrator::~PathIntegrator() = default;
+
+	void PathIntegrator::Render()
+	{
+		const auto start = std::chrono::high_resolution_clock::now();
+
+		const uint32_t numTiles = Scheduler.GetNumTiles();
+		const uint64_t numSteals = Scheduler.GetNumSteals();
+		Stats = { .NumTiles = numTiles };
+		NumRays = 0;
+
+		// Samples every tile gets in the next pass, all tiles have the same number of samples before the first pass
+		std::vector<uint32_t> tileSamples(numTiles, std::min(AdaptiveSamplingMinSamples, Settings.MaxSamplesPerPixel));
+		std::vector<uint32_t> activeTiles;
+		for (;;)
+		{
+			// In the order of the scheduler, so every worker starts on neighboring tiles
+			activeTiles.clear();
+			for (uint32_t i : Scheduler.GetOrder())
+			{
+				if (tileSamples[i] > 0)
+				{
+					activeTiles.push_back(i);
+				}
+			}
+
+			if (activeTiles.empty() || Cancelled)
+			{
+				break;
+			}
+
+			Scheduler.Run(activeTiles, [&](const Tile& Tile, size_t Worker)
+			{
+				if (Settings.Wavefront)
+				{
+					RenderTileWavefront(Tile, tileSamples[Tile.Index], Worker);
+				}
+				else
+				{
+					RenderTile(Tile, tileSamples[Tile.Index]);
+				}
+				if (Settings.OnTileFinished)
+				{
+					Settings.OnTileFinished(Tile, Stats.NumPasses);
+				}
+			}, Cancelled);
+			++Stats.NumPasses;
+
+			if (!Settings.PreviewPath.empty() && !Cancelled)
+			{
+				// A preview that can't be written (e.g. the file is open elsewhere) must not stop the render
+				try
+				{
+					Save(Settings.PreviewPath);
+				}
+				catch (std::exception& e)
+				{
+					LOG_WARN("Failed to save preview {}: {}", Settings.PreviewPath.string(), e.what());
+				}
+			}
+
+			// Every pixel of a tile has the same number of samples, a tile is as converged as its worst pixel
+			Stats.NumConvergedTiles = 0;
+			Stats.MaxRelativeError = 0.0f;
+			for (uint32_t tile = 0; tile < numTiles; ++tile)
+			{
+				const Tile extent = Scheduler.GetTile(tile);
+
+				float error = 0.0f;
+				for (uint32_t y = extent.Y; y < extent.Y + extent.Height; ++y)
+				{
+					for (uint32_t x = extent.X; x < extent.X + extent.Width; ++x)
+					{
+						error = std::max(error, Pixels[size_t(y) * Settings.Width + x].RelativeError());
+					}
+				}
+
+				const uint32_t numSamples = Pixels[size_t(extent.Y) * Settings.Width + extent.X].NumSamples;
+
+				// At most double the samples per pass, the variance estimates of the first passes are noisy
+				const uint32_t maxSamples = std::min(numSamples, Settings.MaxSamplesPerPixel - numSamples);
+
+				tileSamples[tile] = Settings.Adaptive ?
+					NumAdaptiveSamples(error, numSamples, Settings.ErrorThreshold, maxSamples) :
+					maxSamples;
+
+				Stats.NumConvergedTiles += error <= Settings.ErrorThreshold ? 1 : 0;
+				Stats.MaxRelativeError = std::max(Stats.MaxRelativeError, error);
+			}
+
+			if (!Settings.Adaptive && Settings.ErrorThreshold > 0.0f && Stats.NumConvergedTiles == numTiles)
+			{
+				break;
+			}
+
+			LOG_INFO("CPU path integrator pass {}: {} of {} tiles converged, max relative error: {:.2f}%",
+				Stats.NumPasses, Stats.NumConvergedTiles, numTiles, Stats.MaxRelativeError * 100.0f);
+		}
+
+		for (const auto& pixel : Pixels)
+		{
+			Stats.NumSamples += pixel.NumSamples;
+		}
+		Stats.NumRays = NumRays;
+		Stats.NumSteals = Scheduler.GetNumSteals() - numSteals;
+
+		const auto stop = std::chrono::high_resolution_clock::now();
+		Stats.RenderTime = std::chrono::duration<float, std::milli>(stop - start).count();
+
+		LOG_INFO("CPU path integrator: {} samples ({:.1f} per pixel) in {} passes, {} of {} tiles converged to {}% in {}(ms)",
+			Stats.NumSamples, static_cast<double>(Stats.NumSamples) / static_cast<double>(Pixels.size()), Stats.NumPasses,
+			Stats.NumConvergedTiles, numTiles, Settings.ErrorThreshold * 100.0f, Stats.RenderTime);
+		LOG_INFO("CPU path integrator: {} rays, {:.2f} per sample, {:.2f}M rays/s ({})", Stats.NumRays,
+			static_cast<double>(Stats.NumRays) / static_cast<double>(std::max<uint64_t>(Stats.NumSamples, 1)),
+			static_cast<double>(Stats.NumRays) / (static_cast<double>(Stats.RenderTime) * 1000.0),
+			Settings.Wavefront ? "wavefront" : "megakernel");
+		LOG_INFO("CPU path integrator: {} tiles of {} pixels, {} stolen between threads", numTiles, Settings.TileSize,
+			Stats.NumSteals);
+	}
+
+	void PathIntegrator::Save(const std::filesystem::path& Path) const
+	{
+		ScratchImage image, samples;
+		ThrowIfFailed(image.Initialize2D(DXGI_FORMAT_R32G32B32A32_FLOAT, Settings.Width, Settings.Height, 1, 1));
+		ThrowIfFailed(samples.Initialize2D(DXGI_FORMAT_R32G32B32A32_FLOAT, Settings.Width, Settings.Height, 1, 1));
+
+		uint32_t maxSamples = 1;
+		for (const auto& pixel : Pixels)
+		{
+			maxSamples = std::max(maxSamples, pixel.NumSamples);
+		}
+
+		const DirectX::Image* pImage = image.GetImage(0, 0, 0);
+		const DirectX::Image* pSamples = samples.GetImage(0, 0, 0);
+		for (uint32_t y = 0; y < Settings.Height; ++y)
+		{
+			auto pImageRow = reinterpret_cast<XMFLOAT4*>(pImage->pixels + y * pImage->rowPitch);
+			auto pSamplesRow = reinterpret_cast<XMFLOAT4*>(pSamples->pixels + y * pSamples->rowPitch);
+			for (uint32_t x = 0; x < Settings.Width; ++x)
+			{
+				const size_t index = size_t(y) * Settings.Width + x;
+				const XMFLOAT3& L = Image[index];
+				const float density = static_cast<float>(Pixels[index].NumSamples) / static_cast<float>(maxSamples);
+				pImageRow[x] = { L.x, L.y, L.z, 1.0f };
+				pSamplesRow[x] = { density, density, density, 1.0f };
+			}
+		}
+
+		auto samplesPath = Path;
+		samplesPath.replace_filename(Path.stem().wstring() + L"Samples" + Path.extension().wstring());
+
+		ThrowIfFailed(SaveToHDRFile(*pImage, Path.c_str()));
+		ThrowIfFailed(SaveToHDRFile(*pSamples, samplesPath.c_str()));
+	}
+
+	void PathIntegrator::RenderTile(const Tile& Tile, uint32_t NumSamples)
+	{
+		Sampler sampler(Settings.Sampler);
+		uint64_t numRays = 0;
+		for (uint32_t y = Tile.Y; y < Tile.Y + Tile.Height; ++y)
+		{
+			for (uint32_t x = Tile.X; x < Tile.X + Tile.Width; ++x)
+			{
+				const size_t index = size_t(y) * Settings.Width + x;
+				PixelStatistics& statistics = Pixels[index];
+				XMVECTOR mean = XMLoadFloat3(&Image[index]);
+
+				for (uint32_t sample = 0; sample < NumSamples; ++sample)
+				{
+					const uint32_t sampleIndex = statistics.NumSamples;
+					const Ray ray = GenerateCameraRay({ x, y }, sampleIndex, sampler);
+
+					XMVECTOR L = Li(ray, { x, y }, sampleIndex, sampler, numRays);
+
+					// Replace NaN components with zero, like the ray generation shader
+					L = XMVectorSelect(L, XMVectorZero(), XMVectorIsNaN(L));
+
+					statistics.Add(Luminance(L));
+					mean += (L - mean) / static_cast<float>(statistics.NumSamples);
+				}
+
+				XMStoreFloat3(&Image[index], mean);
+			}
+		}
+		NumRays += numRays;
+	}
+
+	void PathIntegrator::RenderTileWavefront(const Tile& Tile, uint32_t NumSamples, size_t Worker)
+	{
+		// Batches hold the same samples of every pixel of the tile
+		const uint32_t numPixels = Tile.Width * Tile.Height;
+		const uint32_t samplesPerBatch = std::max(std::min(MaxWavefrontPaths / numPixels, NumSamples), 1u);
+
+		Sampler sampler(Settings.Sampler);
+		uint64_t numRays = 0;
+		WavefrontState& wavefront = *Wavefronts[Worker];
+		PathStates& paths = wavefront.Paths;
+		ShadowRays& shadowRays = wavefront.Shadows;
+		std::vector<uint32_t>& active = wavefront.Active;
+		std::vector<uint32_t>& next = wavefront.Next;
+		std::vector<uint32_t>& scratch = wavefront.Scratch;
+		paths.Reserve(size_t(numPixels) * samplesPerBatch);
+		for (uint32_t firstSample = 0; firstSample < NumSamples; firstSample += samplesPerBatch)
+		{
+			const uint32_t numBatchSamples = std::min(samplesPerBatch, NumSamples - firstSample);
+			const uint32_t numPaths = numPixels * numBatchSamples;
+
+			// Camera rays, the paths of a pixel follow each other in sample order
+			for (uint32_t path = 0; path < numPaths; ++path)
+			{
+				const uint32_t pixelIndex = path / numBatchSamples;
+				const XMUINT2 pixel = { Tile.X + pixelIndex % Tile.Width, Tile.Y + pixelIndex / Tile.Width };
+				const uint32_t sampleIndex = Pixels[size_t(pixel.y) * Settings.Width + pixel.x].NumSamples + path % numBatchSamples;
+
+				const Ray ray = GenerateCameraRay(pixel, sampleIndex, sampler);
+				paths.Origin[path] = ray.Origin;
+				paths.Direction[path] = ray.Direction;
+				paths.TMin[path] = ray.TMin;
+				paths.TMax[path] = ray.TMax;
+				paths.Beta[path] = XMFLOAT3(1.0f, 1.0f, 1.0f);
+				paths.L[path] = XMFLOAT3(0.0f, 0.0f, 0.0f);
+				paths.ScatteringPdf[path] = 0.0f;
+				paths.ScatteringNormal[path] = XMFLOAT3(0.0f, 0.0f, 0.0f);
+				paths.Pixel[path] = pixel;
+				paths.SampleIndex[path] = sampleIndex;
+			}
+
+			active.resize(numPaths);
+			std::iota(active.begin(), active.end(), 0u);
+
+			// Every iteration advances the paths by one bounce like one iteration of the loop in Li
+			for (uint32_t depth = 0; depth <= Settings.MaxDepth && !active.empty(); ++depth)
+			{
+				// Closest hits, rays in the same octant visit the children of BVH nodes in the same order
+				BinIndices<8>(active, scratch, [&](uint32_t Path) { return DirectionOctant(paths.Direction[Path]); });
+				for (uint32_t path : active)
+				{
+					paths.HitSurface[path] = Scene->Intersect(paths.GetRay(path), &paths.Hits[path]);
+				}
+				numRays += active.size();
+
+				// Emission, paths that left the scene or took their last bounce end here
+				next.clear();
+				for (uint32_t path : active)
+				{
+					const Ray ray = paths.GetRay(path);
+					const RaytracingScene::Hit& hit = paths.Hits[path];
+					const bool hitSurface = paths.HitSurface[path];
+					const XMVECTOR beta = XMLoadFloat3(&paths.Beta[path]);
+					const float scatteringPdf = paths.ScatteringPdf[path];
+
+					XMVECTOR L = XMLoadFloat3(&paths.L[path]);
+					if (depth > 0)
+					{
+						L += beta * LightEmission(ray, hitSurface ? hit.RayHit.T : ray.TMax, scatteringPdf, XMLoadFloat3(&paths.ScatteringNormal[path]));
+					}
+
+					if (hitSurface)
+					{
+						L += beta * SurfaceEmission(ray, hit, scatteringPdf, XMLoadFloat3(&paths.ScatteringNormal[path]));
+					}
+					else
+					{
+						L += beta * EnvironmentEmission(ray, scatteringPdf);
+					}
+					XMStoreFloat3(&paths.L[path], L);
+
+					if (hitSurface && depth < Settings.MaxDepth)
+					{
+						next.push_back(path);
+					}
+				}
+				std::swap(active, next);
+
+				// Shading, the surfaces of every BxDF one after the other
+				BinIndices<BSDFTypes::NumBSDFTypes>(active, scratch, [&](uint32_t Path)
+				{
+					return BSDFBin(Scene->Instances[paths.Hits[Path].InstanceIndex].Material);
+				});
+
+				shadowRays.Clear();
+				next.clear();
+				for (uint32_t path : active)
+				{
+					const SurfaceInteraction si = Scene->GetSurfaceInteraction(paths.GetRay(path), paths.Hits[path]);
+					const BSDF bsdf(Scene->Instances[si.InstanceIndex].Material);
+					const Frame frame(si.n);
+
+					sampler.StartPixelSample(paths.Pixel[path], paths.SampleIndex[path], CameraDimensions + depth * BounceDimensions);
+					const float uLight = sampler.Get1D();
+					const XMFLOAT2 XiLight = sampler.Get2D();
+					const XMFLOAT2 XiBSDF = sampler.Get2D();
+					const float uRR = sampler.Get1D();
+					const float uTriangle = sampler.Get1D();
+					const XMFLOAT2 XiEnvironment = sampler.Get2D();
+
+					XMVECTOR beta = XMLoadFloat3(&paths.Beta[path]);
+					if (!bsdf.IsSpecular())
+					{
+						Ray shadowRay;
+						const XMVECTOR Ld = SampleOneLight(si, bsdf, frame, uLight, uTriangle, XiLight, &shadowRay);
+						if (!XMVector3Equal(Ld, XMVectorZero()))
+						{
+							shadowRays.Push(path, shadowRay, beta * Ld);
+						}
+
+						const XMVECTOR Le = SampleEnvironment(si, bsdf, frame, XiEnvironment, &shadowRay);
+						if (!XMVector3Equal(Le, XMVectorZero()))
+						{
+							shadowRays.Push(path, shadowRay, beta * Le);
+						}
+					}
+
+					BSDFSample bsdfSample;
+					if (!bsdf.Samplef(frame.ToLocal(si.wo), XiBSDF, &bsdfSample))
+					{
+						continue;
+					}
+
+					beta *= bsdfSample.f * AbsCosTheta(bsdfSample.wi) / bsdfSample.pdf;
+
+					// TMax is kept like in Li
+					XMStoreFloat3(&paths.Origin[path], si.p);
+					XMStoreFloat3(&paths.Direction[path], frame.ToWorld(bsdfSample.wi));
+					paths.TMin[path] = 0.0001f;
+					paths.ScatteringPdf[path] = EnumMaskBitSet(bsdfSample.Flags, BxDFFlags::Specular) ? 0.0f : bsdfSample.pdf;
+					XMStoreFloat3(&paths.ScatteringNormal[path], si.n);
+
+					XMFLOAT3 rr;
+					XMStoreFloat3(&rr, beta);
+					const float rrMaxComponentValue = std::max(rr.x, std::max(rr.y, rr.z));
+					if (rrMaxComponentValue <= 0.0f)
+					{
+						continue;
+					}
+
+					if (Settings.RussianRoulette && depth + 1 >= Settings.RussianRouletteMinDepth)
+					{
+						const float survival = std::max(rrMaxComponentValue, Settings.RussianRouletteMinSurvival);
+						if (survival < 1.0f)
+						{
+							if (uRR >= survival)
+							{
+								continue;
+							}
+							beta /= survival;
+						}
+					}
+
+					XMStoreFloat3(&paths.Beta[path], beta);
+					next.push_back(path);
+				}
+				std::swap(active, next);
+
+				// Shadow rays are traced in octant order as well, their radiance is added in the order it was sampled
+				// so the sums match Li
+				next.resize(shadowRays.Size());
+				std::iota(next.begin(), next.end(), 0u);
+				BinIndices<8>(next, scratch, [&](uint32_t Index) { return DirectionOctant(shadowRays.Direction[Index]); });
+
+				shadowRays.Occluded.resize(shadowRays.Size());
+				for (uint32_t index : next)
+				{
+					shadowRays.Occluded[index] = Scene->Occluded(shadowRays.GetRay(index));
+				}
+				numRays += shadowRays.Size();
+
+				for (uint32_t index = 0; index < shadowRays.Size(); ++index)
+				{
+					if (!shadowRays.Occluded[index])
+					{
+						const uint32_t path = shadowRays.Path[index];
+						XMStoreFloat3(&paths.L[path], XMLoadFloat3(&paths.L[path]) + XMLoadFloat3(&shadowRays.Contribution[index]));
+					}
+				}
+			}
+
+			// Same accumulation as RenderTile
+			for (uint32_t pixelIndex = 0; pixelIndex < numPixels; ++pixelIndex)
+			{
+				const uint32_t firstPath = pixelIndex * numBatchSamples;
+				const XMUINT2 pixel = paths.Pixel[firstPath];
+				const size_t index = size_t(pixel.y) * Settings.Width + pixel.x;
+				PixelStatistics& statistics = Pixels[index];
+				XMVECTOR mean = XMLoadFloat3(&Image[index]);
+
+				for (uint32_t path = firstPath; path < firstPath + numBatchSamples; ++path)
+				{
+					XMVECTOR L = XMLoadFloat3(&paths.L[path]);
+					L = XMVectorSelect(L, XMVectorZero(), XMVectorIsNaN(L));
+
+					statistics.Add(Luminance(L));
+					mean += (L - mean) / static_cast<float>(statistics.NumSamples);
+				}
+
+				XMStoreFloat3(&Image[index], mean);
+			}
+		}
+		NumRays += numRays;
+	}
+
+	Ray PathIntegrator::GenerateCameraRay(XMUINT2 Pixel, uint32_t SampleIndex, Sampler& Sampler) const
+	{
+		const HLSL::Camera& camera = Scene->Camera;
+
+		// Subpixel jitter for anti aliasing
+		Sampler.StartPixelSample(Pixel, SampleIndex);
+		const XMFLOAT2 jitter = Sampler.Get2D();
+		const float px = (static_cast<float>(Pixel.x) + jitter.x - 0.5f) / static_cast<float>(Settings.Width);
+		const float py = (static_cast<float>(Pixel.y) + jitter.y - 0.5f) / static_cast<float>(Settings.Height);
+		const float ndcX = 2.0f * px - 1.0f;
+		const float ndcY = -2.0f * py + 1.0f;
+
+		const XMVECTOR position = XMLoadFloat4(&camera.Position);
+		const XMVECTOR u = XMLoadFloat4(&camera.U);
+		const XMVECTOR v = XMLoadFloat4(&camera.V);
+		const XMVECTOR w = XMLoadFloat4(&camera.W);
+
+		// Same as Camera::GenerateCameraRay in SharedTypes.hlsli, the direction has length 1 along w
+		const XMVECTOR direction = (ndcX * u + ndcY * v + w) / XMVectorGetX(XMVector3Length(w));
+		const XMVECTOR focalPoint = position + camera.FocalLength * direction;
+
+		uint32_t seed = (Pixel.x * 1973u + Pixel.y * 9277u + SampleIndex * 26699u) | 1u;
+		const float theta = XM_2PI * RandomFloat01(seed);
+		const float radius = camera.RelativeAperture * RandomFloat01(seed);
+		const XMVECTOR origin = position +
+			radius * std::cos(theta) * XMVector3Normalize(u) +
+			radius * std::sin(theta) * XMVector3Normalize(v);
+
+		Ray ray;
+		XMStoreFloat3(&ray.Origin, origin);
+		XMStoreFloat3(&ray.Direction, XMVector3Normalize(focalPoint - origin));
+		ray.TMin = camera.NearZ;
+		ray.TMax = camera.FarZ;
+		return ray;
+	}
+
+	XMVECTOR PathIntegrator::Li(Ray Ray, XMUINT2 Pixel, uint32_t SampleIndex, Sampler& Sampler, uint64_t& NumRays) const
+	{
+		XMVECTOR L = XMVectorZero();
+		XMVECTOR beta = XMVectorSplatOne();
+		float scatteringPdf = 0.0f; // Of the BSDF sample that spawned the ray, 0 for specular samples
+		XMVECTOR scatteringNormal = XMVectorZero(); // At the origin of the ray
+
+		// The ray leaving the last bounce is traced as well, it only gathers the lights it passes
+		for (uint32_t depth = 0; depth <= Settings.MaxDepth; ++depth)
+		{
+			++NumRays;
+			RaytracingScene::Hit hit;
+			const bool hitSurface = Scene->Intersect(Ray, &hit);
+
+			// Lights the ray passed before the surface, lights are not visible to camera rays
+			if (depth > 0)
+			{
+				L += beta * LightEmission(Ray, hitSurface ? hit.RayHit.T : Ray.TMax, scatteringPdf, scatteringNormal);
+			}
+
+			// Emissive surfaces and the environment are visible to every ray
+			if (hitSurface)
+			{
+				L += beta * SurfaceEmission(Ray, hit, scatteringPdf, scatteringNormal);
+			}
+			else
+			{
+				L += beta * EnvironmentEmission(Ray, scatteringPdf);
+			}
+
+			if (!hitSurface || depth == Settings.MaxDepth)
+			{
+				break;
+			}
+
+			const SurfaceInteraction si = Scene->GetSurfaceInteraction(Ray, hit);
+			const BSDF bsdf(Scene->Instances[si.InstanceIndex].Material);
+			const Frame frame(si.n);
+
+			// Every bounce draws all of its dimensions so the dimension of a decision only depends on the depth
+			Sampler.StartPixelSample(Pixel, SampleIndex, CameraDimensions + depth * BounceDimensions);
+			const float uLight = Sampler.Get1D();
+			const XMFLOAT2 XiLight = Sampler.Get2D();
+			const XMFLOAT2 XiBSDF = Sampler.Get2D();
+			const float uRR = Sampler.Get1D();
+			const float uTriangle = Sampler.Get1D();
+			const XMFLOAT2 XiEnvironment = Sampler.Get2D();
+
+			if (!bsdf.IsSpecular())
+			{
+				// Samples without a contribution trace no shadow ray
+				Ray lightRay, environmentRay;
+				const XMVECTOR Ld = SampleOneLight(si, bsdf, frame, uLight, uTriangle, XiLight, &lightRay);
+				const XMVECTOR Le = SampleEnvironment(si, bsdf, frame, XiEnvironment, &environmentRay);
+				if (!XMVector3Equal(Ld, XMVectorZero()))
+				{
+					++NumRays;
+					if (!Scene->Occluded(lightRay))
+					{
+						L += beta * Ld;
+					}
+				}
+				if (!XMVector3Equal(Le, XMVectorZero()))
+				{
+					++NumRays;
+					if (!Scene->Occluded(environmentRay))
+					{
+						L += beta * Le;
+					}
+				}
+			}
+
+			BSDFSample bsdfSample;
+			if (!bsdf.Samplef(frame.ToLocal(si.wo), XiBSDF, &bsdfSample))
+			{
+				break;
+			}
+
+			beta *= bsdfSample.f * AbsCosTheta(bsdfSample.wi) / bsdfSample.pdf;
+
+			XMStoreFloat3(&Ray.Origin, si.p);
+			XMStoreFloat3(&Ray.Direction, frame.ToWorld(bsdfSample.wi));
+			Ray.TMin = 0.0001f; // Avoid self intersection
+			scatteringPdf = EnumMaskBitSet(bsdfSample.Flags, BxDFFlags::Specular) ? 0.0f : bsdfSample.pdf;
+			scatteringNormal = si.n;
+
+			// Russian roulette, like ClosestHit in PathTrace.hlsl
+			XMFLOAT3 rr;
+			XMStoreFloat3(&rr, beta);
+			const float rrMaxComponentValue = std::max(rr.x, std::max(rr.y, rr.z));
+			if (rrMaxComponentValue <= 0.0f)
+			{
+				break;
+			}
+
+			if (Settings.RussianRoulette && depth + 1 >= Settings.RussianRouletteMinDepth)
+			{
+				const float survival = std::max(rrMaxComponentValue, Settings.RussianRouletteMinSurvival);
+				if (survival < 1.0f)
+				{
+					if (uRR >= survival)
+					{
+						break;
+					}
+					beta /= survival;
+				}
+			}
+		}
+
+		return L;
+	}
+
+	XMVECTOR PathIntegrator::SampleOneLight(const SurfaceInteraction& si, const BSDF& BSDF, const Frame& Frame, float uLight, float uTriangle, XMFLOAT2 XiLight, Ray* pShadowRay) const
+	{
+		uint32_t lightIndex;
+		float lightPdf;
+		if (!Scene->SampleLight(Settings.LightSampling, si.p, si.n, uLight, &lightIndex, &lightPdf))
+		{
+			return XMVectorZero();
+		}
+
+		const HLSL::Light& light = Scene->Lights[lightIndex];
+
+		// Like EstimateDirect in PathTrace.hlsl
+		LightSample lightSample;
+		const bool sampled = light.Type == LightType::MeshLight ?
+			SampleMeshLi(light, Scene->MeshLights, si.p, uTriangle, XiLight, &lightSample) :
+			SampleLi(light, si.p, XiLight, &lightSample);
+		if (!sampled || lightSample.pdf <= 0.0f || XMVector3Equal(lightSample.Li, XMVectorZero()))
+		{
+			return XMVectorZero();
+		}
+
+		const XMVECTOR wo = Frame.ToLocal(si.wo);
+		const XMVECTOR wi = Frame.ToLocal(lightSample.wi);
+		const XMVECTOR f = BSDF.f(wo, wi) * AbsCosTheta(wi);
+		if (XMVector3Equal(f, XMVectorZero()))
+		{
+			return XMVectorZero();
+		}
+
+		*pShadowRay = SpawnRayTo(si.p, lightSample.p);
+
+		// BSDF sampling finds the light as well, see LightEmission and SurfaceEmission
+		float weight = 1.0f;
+		if (!IsDeltaLight(light) && Settings.MultipleImportanceSampling)
+		{
+			weight = PowerHeuristic(1, lightPdf * lightSample.pdf, 1, BSDF.Pdf(wo, wi));
+		}
+
+		return f * lightSample.Li * weight / (lightSample.pdf * lightPdf);
+	}
+
+	XMVECTOR PathIntegrator::SampleEnvironment(const SurfaceInteraction& si, const BSDF& BSDF, const Frame& Frame, XMFLOAT2 Xi, Ray* pShadowRay) const
+	{
+		XMVECTOR wiWorld;
+		float lightPdf;
+		if (!Scene->Environment || !Scene->Environment->Sample(Xi, &wiWorld, &lightPdf))
+		{
+			return XMVectorZero();
+		}
+
+		// Like SampleEnvironmentLight in PathTrace.hlsl
+		const XMVECTOR wo = Frame.ToLocal(si.wo);
+		const XMVECTOR wi = Frame.ToLocal(wiWorld);
+		const XMVECTOR f = BSDF.f(wo, wi) * AbsCosTheta(wi);
+		if (XMVector3Equal(f, XMVectorZero()))
+		{
+			return XMVectorZero();
+		}
+
+		XMStoreFloat3(&pShadowRay->Origin, si.p);
+		XMStoreFloat3(&pShadowRay->Direction, wiWorld);
+		pShadowRay->TMin = 0.0001f;
+		pShadowRay->TMax = FLT_MAX;
+
+		float weight = 1.0f;
+		if (Settings.MultipleImportanceSampling)
+		{
+			weight = PowerHeuristic(1, lightPdf, 1, BSDF.Pdf(wo, wi));
+		}
+
+		const XMVECTOR Le = Scene->Environment->Le(wiWorld) * XMLoadFloat3(&Scene->EnvironmentScale);
+		return f * Le * weight / lightPdf;
+	}
+
+	XMVECTOR PathIntegrator::LightEmission(const Ray& Ray, float TMax, float ScatteringPdf, FXMVECTOR n) const
+	{
+		// Without MIS lights are only found by sampling them, unless the direction came from a specular BSDF
+		if (!Settings.MultipleImportanceSampling && ScatteringPdf > 0.0f)
+		{
+			return XMVectorZero();
+		}
+
+		const XMVECTOR origin = XMLoadFloat3(&Ray.Origin);
+		const XMVECTOR direction = XMLoadFloat3(&Ray.Direction);
+
+		// Lights are not in the scene BVH, only the lights whose bounds the ray enters in the light BVH are tested,
+		// like LightEmission in PathTrace.hlsl. Lights without power are not in the tree and emit nothing
+		LightSample closest = {};
+		float closestDistance = TMax;
+		uint32_t closestIndex = 0;
+		bool hit = false;
+		Scene->LightTree.Traverse(origin, direction, TMax, [&](uint32_t LightIndex)
+		{
+			float distance;
+			LightSample sample;
+			if (IntersectLight(Scene->Lights[LightIndex], origin, direction, &distance, &sample) && distance < closestDistance)
+			{
+				closest = sample;
+				closestDistance = distance;
+				closestIndex = LightIndex;
+				hit = true;
+			}
+			return closestDistance;
+		});
+
+		// Specular directions cannot be found by sampling the light
+		if (!hit || ScatteringPdf == 0.0f)
+		{
+			return hit ? closest.Li : XMVectorZero();
+		}
+
+		const float lightPdf = Scene->LightPmf(Settings.LightSampling, origin, n, closestIndex) * closest.pdf;
+		return closest.Li * PowerHeuristic(1, ScatteringPdf, 1, lightPdf);
+	}
+
+	XMVECTOR PathIntegrator::SurfaceEmission(const Ray& Ray, const RaytracingScene::Hit& Hit, float ScatteringPdf, FXMVECTOR n) const
+	{
+		const RaytracingScene::Instance& instance = Scene->Instances[Hit.InstanceIndex];
+		if (instance.LightIndex == UINT32_MAX)
+		{
+			return XMVectorZero();
+		}
+
+		// Camera rays and specular directions cannot be found by sampling the light
+		const XMVECTOR Le = XMLoadFloat3(&instance.Material.emissive);
+		if (ScatteringPdf == 0.0f)
+		{
+			return Le;
+		}
+
+		if (!Settings.MultipleImportanceSampling)
+		{
+			return XMVectorZero();
+		}
+
+		const XMVECTOR origin = XMLoadFloat3(&Ray.Origin);
+		const XMVECTOR y = XMVectorMultiplyAdd(XMVectorReplicate(Hit.RayHit.T), XMLoadFloat3(&Ray.Direction), origin);
+		const float lightPdf = Scene->LightPmf(Settings.LightSampling, origin, n, instance.LightIndex) *
+			MeshLightPdf(Scene->Lights[instance.LightIndex], Scene->MeshLights, Hit.RayHit.PrimitiveIndex, origin, y);
+		return Le * PowerHeuristic(1, ScatteringPdf, 1, lightPdf);
+	}
+
+	XMVECTOR PathIntegrator::EnvironmentEmission(const Ray& Ray, float ScatteringPdf) const
+	{
+		if (!Scene->Environment)
+		{
+			return XMVectorZero();
+		}
+
+		// Camera rays and specular directions cannot be found by sampling the environment
+		const XMVECTOR direction = XMLoadFloat3(&Ray.Direction);
+		const XMVECTOR Le = Scene->Environment->Le(direction) * XMLoadFloat3(&Scene->EnvironmentScale);
+		if (ScatteringPdf == 0.0f)
+		{
+			return Le;
+		}
+
+		if (!Settings.MultipleImportanceSampling)
+		{
+			return XMVectorZero();
+		}
+
+		return Le * PowerHeuristic(1, ScatteringPdf, 1, Scene->Environment->Pdf(direction));
+	}
+
+	void BenchmarkWavefront(std::shared_ptr<const RaytracingScene> Scene, PathIntegrator::Options Options)
+	{
+		Options.Adaptive = false;
+		Options.ErrorThreshold = 0.0f;
+		Options.OnTileFinished = nullptr;
+		Options.PreviewPath.clear();
+
+		std::vector<XMFLOAT3> images[2];
+		double raysPerSecond[2] = {};
+		for (int i = 0; i < 2; ++i)
+		{
+			Options.Wavefront = i == 1;
+			PathIntegrator integrator(Scene, Options);
+			integrator.Render();
+			images[i] = integrator.GetImage();
+
+			const PathIntegrator::Statistics& statistics = integrator.GetStatistics();
+			raysPerSecond[i] = static_cast<double>(statistics.NumRays) / (static_cast<double>(statistics.RenderTime) / 1000.0);
+			LOG_INFO("{} {}x{} at {} spp: {} rays in {}(ms), {:.2f}M rays/s", Options.Wavefront ? "Wavefront" : "Megakernel",
+				Options.Width, Options.Height, Options.MaxSamplesPerPixel, statistics.NumRays, statistics.RenderTime, raysPerSecond[i] / 1e6);
+		}
+
+		// Both modes trace the same paths, any difference is a bug in one of them
+		float maxDifference = 0.0f;
+		for (size_t i = 0; i < images[0].size(); ++i)
+		{
+			const XMVECTOR difference = XMVectorAbs(XMLoadFloat3(&images[0][i]) - XMLoadFloat3(&images[1][i]));
+			maxDifference = std::max(maxDifference, XMVectorGetX(XMVector3Dot(difference, XMVectorSplatOne())));
+		}
+
+		LOG_INFO("Wavefront: {:.2f}x the rays per second of the megakernel, largest difference between the images: {}",
+			raysPerSecond[1] / raysPerSecond[0], maxDifference);
+	}
+}
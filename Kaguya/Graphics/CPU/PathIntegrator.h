@@ -0,0 +1,155 @@
+#pragma once
+#include <atomic>
+#include <filesystem>
+#include <functional>
+#include <vector>
+#include <DirectXMath.h>
+
+#include "BSDF.h"
+#include "RaytracingScene.h"
+#include "Sampler.h"
+#include "TileScheduler.h"
+
+/*
+* Path tracer on the CPU that follows PathTrace.hlsl, one light sample, one environment sample and one BSDF sample per
+* bounce with the same sample dimensions and Russian roulette. It shades with the geometric normal and ignores textures, it is meant to
+* validate sampling changes before they go to the GPU.
+*
+* Every pixel keeps the running mean and variance of the luminance of its samples (Welford). Images are rendered in
+* passes over square tiles, see TileScheduler. With adaptive sampling every tile gets the samples it still needs to
+* converge according to the relative error of its worst pixel, so samples go where the error is highest, and converged
+* tiles stop. Without it every tile gets the same number of samples until all of them converged. Every finished tile is
+* handed to OnTileFinished, the image is complete for the pass at the end of every pass. AdaptiveSampling.hlsli applies
+* the same rule on the GPU with tiles of AdaptiveSamplingTileSize pixels.
+*
+* Tiles are rendered one path at a time by Li, or in the wavefront mode as batches of up to MaxWavefrontPaths paths that
+* advance one bounce at a time through separate stages: camera rays, closest hits, emission, shading and shadow rays.
+* Rays are binned by the octant of their direction before they are traced and surfaces by their BSDFType before they
+* are shaded, so every stage runs over rays that take similar paths through the BVHs and the same BxDF code. Paths draw
+* the same sample dimensions in both modes and the image is the same, only the order of the work differs.
+*/
+namespace CPU
+{
+	// Must match AdaptiveSampling.hlsli
+	constexpr uint32_t AdaptiveSamplingTileSize = 16;
+	constexpr uint32_t AdaptiveSamplingMinSamples = 16; // Samples before the variance of a pixel is trusted
+	constexpr float AdaptiveSamplingMinLuminance = 0.01f; // Lower bound of the mean the error is relative to
+
+	// Running mean and variance of the luminance of the samples of a pixel
+	struct PixelStatistics
+	{
+		void Add(float Luminance);
+
+		// Standard error of the mean relative to the mean, infinite below 2 samples
+		[[nodiscard]] float RelativeError() const;
+
+		float Mean = 0.0f;
+		float M2 = 0.0f; // Sum of squared differences from the mean
+		uint32_t NumSamples = 0;
+	};
+
+	// Samples to add to a tile whose pixels have NumSamples samples and whose worst pixel has RelativeError,
+	// 0 once it is below Threshold. The standard error falls with the square root of the sample count, so a tile
+	// needs NumSamples * (RelativeError / Threshold)^2 samples in total, the result is clamped to [1, MaxSamples]
+	[[nodiscard]] uint32_t NumAdaptiveSamples(float RelativeError, uint32_t NumSamples, float Threshold, uint32_t MaxSamples);
+
+	class PathIntegrator
+	{
+	public:
+		// Sample dimensions drawn for the camera and for every bounce, see PathTrace.hlsl
+		static constexpr uint32_t CameraDimensions = 2;
+		static constexpr uint32_t BounceDimensions = 9;
+
+		// Paths a tile renders at once in the wavefront mode, the samples of a tile are split into batches of this size
+		static constexpr uint32_t MaxWavefrontPaths = 16384;
+
+		struct Options
+		{
+			uint32_t Width = 0;
+			uint32_t Height = 0;
+			uint32_t MaxDepth = 6;
+			bool RussianRoulette = true;
+			uint32_t RussianRouletteMinDepth = 3; // Bounces before a path can be terminated
+			float RussianRouletteMinSurvival = 0.05f; // Lower bound of the survival probability
+			bool MultipleImportanceSampling = true; // Of light and BSDF samples, false samples direct lighting from the lights only
+			LightSamplingStrategy LightSampling = LightSamplingStrategy::BVH;
+			SamplerType Sampler = SamplerType::Sobol; // BlueNoise is not supported
+			uint32_t MaxSamplesPerPixel = 1024;
+			bool Adaptive = true;
+			float ErrorThreshold = 0.01f; // Relative, 0 renders MaxSamplesPerPixel everywhere
+			uint32_t TileSize = AdaptiveSamplingTileSize; // Pixels per side, tiles are scheduled and converge as a whole
+			TileOrder Order = TileOrder::Hilbert;
+			// Called on the worker thread that rendered the tile, its pixels are not written again during the pass
+			std::function<void(const Tile& Tile, uint32_t Pass)> OnTileFinished;
+			std::filesystem::path PreviewPath; // Saved after every pass unless it is empty
+			bool Wavefront = false; // Renders tiles with RenderTileWavefront instead of Li
+		};
+
+		struct Statistics
+		{
+			uint32_t NumPasses;
+			uint64_t NumSamples;
+			uint64_t NumSteals; // Of tiles between the worker threads
+			uint64_t NumRays; // Camera, bounce and shadow rays
+			uint32_t NumTiles;
+			uint32_t NumConvergedTiles;
+			float MaxRelativeError; // Of the worst pixel
+			float RenderTime; // Milliseconds
+		};
+
+		PathIntegrator(std::shared_ptr<const RaytracingScene> Scene, const Options& Options);
+		~PathIntegrator();
+
+		void Render();
+
+		// Makes a running Render return after the tiles it is working on, callable from any thread
+		void Cancel() { Cancelled = true; }
+
+		// Writes the image as a Radiance HDR file and the samples per pixel, normalized to the maximum, next to it as
+		// <Name>Samples.hdr
+		void Save(const std::filesystem::path& Path) const;
+
+		[[nodiscard]] const Statistics& GetStatistics() const { return Stats; }
+		[[nodiscard]] const std::vector<DirectX::XMFLOAT3>& GetImage() const { return Image; }
+		[[nodiscard]] const std::vector<PixelStatistics>& GetPixelStatistics() const { return Pixels; }
+	private:
+		void RenderTile(const Tile& Tile, uint32_t NumSamples);
+		void RenderTileWavefront(const Tile& Tile, uint32_t NumSamples, size_t Worker);
+
+		// Li adds the rays it traces to NumRays
+		[[nodiscard]] Ray GenerateCameraRay(DirectX::XMUINT2 Pixel, uint32_t SampleIndex, Sampler& Sampler) const;
+		[[nodiscard]] DirectX::XMVECTOR Li(Ray Ray, DirectX::XMUINT2 Pixel, uint32_t SampleIndex, Sampler& Sampler, uint64_t& NumRays) const;
+		// SampleOneLight and SampleEnvironment return the contribution of the sample if pShadowRay is unoccluded, the
+		// shadow ray is left to the caller and only valid for a contribution other than 0. uTriangle picks the triangle
+		// of mesh lights
+		[[nodiscard]] DirectX::XMVECTOR SampleOneLight(const SurfaceInteraction& si, const BSDF& BSDF, const Frame& Frame, float uLight, float uTriangle, DirectX::XMFLOAT2 XiLight, Ray* pShadowRay) const;
+		// Weighted against the BSDF only, the environment is not one of the lights that are picked from
+		[[nodiscard]] DirectX::XMVECTOR SampleEnvironment(const SurfaceInteraction& si, const BSDF& BSDF, const Frame& Frame, DirectX::XMFLOAT2 Xi, Ray* pShadowRay) const;
+		// n is the normal at the origin of the ray, the light BVH pmf depends on it
+		[[nodiscard]] DirectX::XMVECTOR LightEmission(const Ray& Ray, float TMax, float ScatteringPdf, DirectX::FXMVECTOR n) const;
+		// Radiance of the emissive instance the ray hit, weighted against sampling its mesh light
+		[[nodiscard]] DirectX::XMVECTOR SurfaceEmission(const Ray& Ray, const RaytracingScene::Hit& Hit, float ScatteringPdf, DirectX::FXMVECTOR n) const;
+		// Radiance of the environment along a ray that left the scene, weighted against SampleEnvironment
+		[[nodiscard]] DirectX::XMVECTOR EnvironmentEmission(const Ray& Ray, float ScatteringPdf) const;
+	private:
+		std::shared_ptr<const RaytracingScene> Scene;
+		Options Settings;
+
+		TileScheduler Scheduler;
+
+		std::vector<DirectX::XMFLOAT3> Image; // Mean radiance
+		std::vector<PixelStatistics> Pixels;
+
+		// Paths and shadow rays of the wavefront batches of every worker of the scheduler, kept between tiles and passes
+		struct WavefrontState;
+		std::vector<std::unique_ptr<WavefrontState>> Wavefronts;
+
+		std::atomic<bool> Cancelled = false;
+		std::atomic<uint64_t> NumRays = 0;
+		Statistics Stats = {};
+	};
+
+	// Renders the scene with Options once one path at a time and once in the wavefront mode, without adaptive
+	// sampling, and logs the rays per second of both and the largest difference between the images
+	void BenchmarkWavefront(std::shared_ptr<const RaytracingScene> Scene, PathIntegrator::Options Options);
+}
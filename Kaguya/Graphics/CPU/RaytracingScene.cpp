@@ -0,0 +1,181 @@
+#include "pch.h"
+#include "RaytracingScene.h"
+#include "Light.h"
+
+using namespace DirectX;
+
+namespace CPU
+{
+	namespace
+	{
+		// The direction is not normalized so hit distances stay in world space
+		Ray ToObjectSpace(const Ray& WorldRay, const RaytracingScene::Instance& Instance)
+		{
+			const XMMATRIX inverseWorld = XMLoadFloat4x4(&Instance.InverseWorld);
+
+			Ray objectRay = WorldRay;
+			XMStoreFloat3(&objectRay.Origin, XMVector3TransformCoord(XMLoadFloat3(&WorldRay.Origin), inverseWorld));
+			XMStoreFloat3(&objectRay.Direction, XMVector3TransformNormal(XMLoadFloat3(&WorldRay.Direction), inverseWorld));
+			return objectRay;
+		}
+	}
+
+	RaytracingScene::RaytracingScene(::Scene& Scene)
+	{
+		Camera = GetHLSLCameraDesc(Scene.Camera);
+
+		std::vector<std::pair<uint32_t, std::shared_ptr<const EmissiveMesh>>> emitters;
+
+		auto meshes = Scene.Registry.view<Transform, MeshFilter, MeshRenderer>();
+		for (auto [handle, transform, meshFilter, meshRenderer] : meshes.each())
+		{
+			if (!meshFilter.Mesh)
+			{
+				continue;
+			}
+
+			// Meshes without a BVH and without geometry in RAM are skipped
+			auto& mesh = meshFilter.Mesh.Get();
+			const auto bvh = GetOrBuildBVH(mesh);
+			if (!bvh || bvh->IsEmpty())
+			{
+				continue;
+			}
+
+			const XMMATRIX world = transform.Matrix();
+			const auto& root = bvh->GetNodes()[0];
+
+			Instance instance = {};
+			instance.BVH = bvh;
+			XMStoreFloat4x4(&instance.World, world);
+			XMStoreFloat4x4(&instance.InverseWorld, XMMatrixInverse(nullptr, world));
+			BoundingBox bounds;
+			BoundingBox::CreateFromPoints(bounds, XMLoadFloat3(&root.Min), XMLoadFloat3(&root.Max));
+			bounds.Transform(instance.Bounds, world);
+			instance.Material = meshRenderer.Material;
+			instance.LightIndex = UINT32_MAX;
+			if (IsEmissive(instance.Material.emissive))
+			{
+				emitters.emplace_back(static_cast<uint32_t>(Instances.size()), GetOrBuildEmissiveMesh(mesh));
+			}
+			Instances.push_back(std::move(instance));
+		}
+
+		auto lights = Scene.Registry.view<Transform, Light>();
+		for (auto [handle, transform, light] : lights.each())
+		{
+			if (light.Type == EnvironmentLight)
+			{
+				if (!Environment && light.Texture && GetOrBuildEnvironmentMap(light.Texture.Get()))
+				{
+					Environment = light.Texture->Environment;
+					EnvironmentScale = light.I;
+				}
+				continue;
+			}
+			Lights.push_back(GetHLSLLightDesc(transform, light));
+		}
+
+		for (const auto& [instanceIndex, emitter] : emitters)
+		{
+			Instance& instance = Instances[instanceIndex];
+			instance.LightIndex = static_cast<uint32_t>(Lights.size());
+			Lights.push_back(MeshLights.Add(*emitter, XMLoadFloat4x4(&instance.World), instance.Material.emissive));
+		}
+
+		std::vector<float> power(Lights.size());
+		std::transform(Lights.begin(), Lights.end(), power.begin(), LightPower);
+		LightSampler = AliasTable(power);
+
+		const auto start = std::chrono::high_resolution_clock::now();
+		LightTree.Build(Lights);
+		const auto stop = std::chrono::high_resolution_clock::now();
+		LOG_INFO("Light BVH: {} nodes built in {}(ms)", LightTree.GetNodes().size(), std::chrono::duration<double, std::milli>(stop - start).count());
+	}
+
+	bool RaytracingScene::Intersect(const Ray& Ray, Hit* pHit) const
+	{
+		const XMVECTOR origin = XMLoadFloat3(&Ray.Origin);
+		const XMVECTOR direction = XMLoadFloat3(&Ray.Direction);
+
+		CPU::Ray query = Ray;
+		bool hit = false;
+		for (uint32_t i = 0; i < static_cast<uint32_t>(Instances.size()); ++i)
+		{
+			const Instance& instance = Instances[i];
+
+			float distance;
+			if (!instance.Bounds.Intersects(origin, direction, distance) || distance > query.TMax)
+			{
+				continue;
+			}
+
+			if (instance.BVH->Intersect(ToObjectSpace(query, instance), &pHit->RayHit))
+			{
+				query.TMax = pHit->RayHit.T;
+				pHit->InstanceIndex = i;
+				hit = true;
+			}
+		}
+		return hit;
+	}
+
+	bool RaytracingScene::Occluded(const Ray& Ray) const
+	{
+		const XMVECTOR origin = XMLoadFloat3(&Ray.Origin);
+		const XMVECTOR direction = XMLoadFloat3(&Ray.Direction);
+
+		for (const auto& instance : Instances)
+		{
+			float distance;
+			if (instance.Bounds.Intersects(origin, direction, distance) && distance <= Ray.TMax &&
+				instance.BVH->Occluded(ToObjectSpace(Ray, instance)))
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	SurfaceInteraction RaytracingScene::GetSurfaceInteraction(const Ray& Ray, const Hit& Hit) const
+	{
+		const Instance& instance = Instances[Hit.InstanceIndex];
+
+		const uint32_t* triangle = instance.BVH->GetTriangle(Hit.RayHit.PrimitiveIndex);
+		const XMVECTOR p0 = XMLoadFloat3(&instance.BVH->GetPosition(triangle[0]));
+		const XMVECTOR p1 = XMLoadFloat3(&instance.BVH->GetPosition(triangle[1]));
+		const XMVECTOR p2 = XMLoadFloat3(&instance.BVH->GetPosition(triangle[2]));
+
+		// Normals transform with the inverse transpose
+		const XMMATRIX normalMatrix = XMMatrixTranspose(XMLoadFloat4x4(&instance.InverseWorld));
+		const XMVECTOR direction = XMLoadFloat3(&Ray.Direction);
+
+		SurfaceInteraction si;
+		si.p = XMVectorMultiplyAdd(XMVectorReplicate(Hit.RayHit.T), direction, XMLoadFloat3(&Ray.Origin));
+		si.wo = -direction;
+		si.n = XMVector3Normalize(XMVector3TransformNormal(XMVector3Cross(p1 - p0, p2 - p0), normalMatrix));
+		si.InstanceIndex = Hit.InstanceIndex;
+		return si;
+	}
+
+	bool RaytracingScene::SampleLight(LightSamplingStrategy Strategy, FXMVECTOR p, FXMVECTOR n, float u, uint32_t* pLightIndex, float* pPmf) const
+	{
+		if (Strategy == LightSamplingStrategy::BVH)
+		{
+			return LightTree.Sample(p, n, u, pLightIndex, pPmf);
+		}
+
+		if (LightSampler.IsEmpty())
+		{
+			return false;
+		}
+
+		*pLightIndex = LightSampler.Sample(u, pPmf);
+		return true;
+	}
+
+	float RaytracingScene::LightPmf(LightSamplingStrategy Strategy, FXMVECTOR p, FXMVECTOR n, uint32_t LightIndex) const
+	{
+		return Strategy == LightSamplingStrategy::BVH ? LightTree.Pmf(p, n, LightIndex) : LightSampler.Pmf(LightIndex);
+	}
+}
@@ -0,0 +1,83 @@
+#pragma once
+#include <memory>
+#include <vector>
+#include <DirectXCollision.h>
+
+#include "AliasTable.h"
+#include "BVH.h"
+#include "EnvironmentMap.h"
+#include "LightBVH.h"
+#include "MeshLight.h"
+#include "../Scene/Scene.h"
+
+namespace CPU
+{
+	struct SurfaceInteraction
+	{
+		DirectX::XMVECTOR p;
+		DirectX::XMVECTOR wo;
+		DirectX::XMVECTOR n; // Geometric normal, also used as the shading normal
+		uint32_t InstanceIndex;
+	};
+
+	enum class LightSamplingStrategy
+	{
+		Power, // In proportion to the power of the lights
+		BVH // In proportion to what the lights contribute to the shading point, see LightBVH
+	};
+
+	/*
+	* Instances, materials, lights and camera of a Scene copied for the CPU integrators, so they can render in the
+	* background while the scene keeps changing. Every instance references the BVH of its mesh, which owns a copy of the
+	* positions and indices it traces. Instances are tested one after the other against their world bounds, there is no
+	* top level hierarchy.
+	*/
+	class RaytracingScene
+	{
+	public:
+		struct Instance
+		{
+			std::shared_ptr<const CPU::BVH> BVH;
+			DirectX::XMFLOAT4X4 World;
+			DirectX::XMFLOAT4X4 InverseWorld;
+			DirectX::BoundingBox Bounds; // World space
+			::Material Material;
+			uint32_t LightIndex; // Mesh light of an emissive instance, UINT32_MAX otherwise
+		};
+
+		struct Hit
+		{
+			CPU::RayHit RayHit;
+			uint32_t InstanceIndex;
+		};
+
+		// Must be called on the main thread. Builds the BVH of meshes that do not have one yet and keeps it with the
+		// mesh, meshes without a BVH and without geometry in RAM are skipped. Emissive instances become mesh lights that
+		// follow the lights of the scene, the triangle tables of their meshes are also kept with the mesh. The first
+		// environment light whose image has a distribution becomes the Environment, it is not one of the Lights
+		explicit RaytracingScene(::Scene& Scene);
+
+		// Closest hit, returns false on miss
+		bool Intersect(const Ray& Ray, Hit* pHit) const;
+
+		// Any hit, used for shadow rays
+		[[nodiscard]] bool Occluded(const Ray& Ray) const;
+
+		[[nodiscard]] SurfaceInteraction GetSurfaceInteraction(const Ray& Ray, const Hit& Hit) const;
+
+		// Picks a light for the point p with normal n, returns false when there is no light to pick
+		bool SampleLight(LightSamplingStrategy Strategy, DirectX::FXMVECTOR p, DirectX::FXMVECTOR n, float u, uint32_t* pLightIndex, float* pPmf) const;
+
+		// Probability of SampleLight picking the light for p and n
+		[[nodiscard]] float LightPmf(LightSamplingStrategy Strategy, DirectX::FXMVECTOR p, DirectX::FXMVECTOR n, uint32_t LightIndex) const;
+
+		std::vector<Instance> Instances;
+		std::vector<HLSL::Light> Lights;
+		MeshLightTriangles MeshLights;
+		AliasTable LightSampler; // Picks lights in proportion to their power
+		LightBVH LightTree;
+		std::shared_ptr<const EnvironmentMap> Environment; // Null without an environment light
+		DirectX::XMFLOAT3 EnvironmentScale;
+		HLSL::Camera Camera;
+	};
+}
@@ -0,0 +1,323 @@
+#include "pch.h"
+#include "Sampler.h"
+#include "Parallel.h"
+
+#include <fstream>
+#include <iomanip>
+
+using namespace DirectX;
+
+namespace CPU
+{
+	namespace
+	{
+		// Primitive polynomial degree s, coefficients a and initial direction numbers m of Sobol dimensions 1 to 3, from
+		// new-joe-kuo-6.21201 (Joe and Kuo 2008). Dimension 0 is the van der Corput sequence
+		struct DirectionNumbers
+		{
+			uint32_t s;
+			uint32_t a;
+			uint32_t m[3];
+		};
+
+		constexpr DirectionNumbers JoeKuo[NumSobolDimensions - 1] =
+		{
+			{ 1, 0, { 1 } },
+			{ 2, 1, { 1, 3 } },
+			{ 3, 1, { 1, 3, 1 } }
+		};
+
+		constexpr std::array<uint32_t, NumSobolDimensions * SobolMatrixSize> BuildSobolMatrices()
+		{
+			std::array<uint32_t, NumSobolDimensions * SobolMatrixSize> matrices = {};
+			for (uint32_t i = 0; i < SobolMatrixSize; ++i)
+			{
+				matrices[i] = 1u << (31 - i);
+			}
+
+			for (uint32_t dimension = 1; dimension < NumSobolDimensions; ++dimension)
+			{
+				const DirectionNumbers& numbers = JoeKuo[dimension - 1];
+				uint32_t* v = &matrices[dimension * SobolMatrixSize];
+				for (uint32_t i = 0; i < numbers.s; ++i)
+				{
+					v[i] = numbers.m[i] << (31 - i);
+				}
+
+				for (uint32_t i = numbers.s; i < SobolMatrixSize; ++i)
+				{
+					v[i] = v[i - numbers.s] ^ (v[i - numbers.s] >> numbers.s);
+					for (uint32_t k = 1; k < numbers.s; ++k)
+					{
+						v[i] ^= ((numbers.a >> (numbers.s - 1 - k)) & 1) * v[i - k];
+					}
+				}
+			}
+			return matrices;
+		}
+
+		uint32_t ReverseBits(uint32_t Value)
+		{
+			Value = (Value << 16) | (Value >> 16);
+			Value = ((Value & 0x00ff00ff) << 8) | ((Value & 0xff00ff00) >> 8);
+			Value = ((Value & 0x0f0f0f0f) << 4) | ((Value & 0xf0f0f0f0) >> 4);
+			Value = ((Value & 0x33333333) << 2) | ((Value & 0xcccccccc) >> 2);
+			Value = ((Value & 0x55555555) << 1) | ((Value & 0xaaaaaaaa) >> 1);
+			return Value;
+		}
+
+		// 24 bits fit in a float exactly, the result is in [0, 1)
+		float ToFloat01(uint32_t Value)
+		{
+			return static_cast<float>(Value >> 8) * 0x1p-24f;
+		}
+	}
+
+	const std::array<uint32_t, NumSobolDimensions * SobolMatrixSize> SobolMatrices = BuildSobolMatrices();
+
+	uint32_t WangHash(uint32_t Seed)
+	{
+		Seed = (Seed ^ 61u) ^ (Seed >> 16);
+		Seed *= 9u;
+		Seed = Seed ^ (Seed >> 4);
+		Seed *= 0x27d4eb2du;
+		Seed = Seed ^ (Seed >> 15);
+		return Seed;
+	}
+
+	uint32_t SobolSample(uint32_t Index, uint32_t Dimension)
+	{
+		uint32_t value = 0;
+		for (const uint32_t* pColumn = &SobolMatrices[Dimension * SobolMatrixSize]; Index; Index >>= 1, ++pColumn)
+		{
+			value ^= (Index & 1) * *pColumn;
+		}
+		return value;
+	}
+
+	uint32_t OwenScramble(uint32_t Value, uint32_t Seed)
+	{
+		Value = ReverseBits(Value);
+		Value += Seed;
+		Value ^= Value * 0x6c50b47cu;
+		Value ^= Value * 0xb82f1e52u;
+		Value ^= Value * 0xc7afe638u;
+		Value ^= Value * 0x8d22f6e6u;
+		return ReverseBits(Value);
+	}
+
+	int Sampler::Run(int argc, char* argv[])
+	{
+		Log::Create();
+
+		if (argc < 3)
+		{
+			LOG_ERROR("Usage: {} <OutputFile>", CommandLineFlag);
+			return EXIT_FAILURE;
+		}
+
+		try
+		{
+			WriteSobolMatrices(argv[2]);
+		}
+		catch (std::exception& e)
+		{
+			LOG_ERROR("Failed to write Sobol matrices: {}", e.what());
+			return EXIT_FAILURE;
+		}
+
+		return EXIT_SUCCESS;
+	}
+
+	void Sampler::WriteSobolMatrices(const std::filesystem::path& Path)
+	{
+		std::ofstream stream(Path, std::ios::trunc);
+		if (!stream)
+		{
+			throw std::exception("Could not open file");
+		}
+
+		stream << "// Generated with " << CommandLineFlag << " from the direction numbers in Graphics/CPU/Sampler.cpp, do not edit\n";
+		stream << "#ifndef SOBOL_MATRICES_HLSLI\n";
+		stream << "#define SOBOL_MATRICES_HLSLI\n\n";
+		stream << "static const uint NumSobolDimensions = " << NumSobolDimensions << ";\n";
+		stream << "static const uint SobolMatrixSize = " << SobolMatrixSize << ";\n\n";
+		stream << "static const uint SobolMatrices[NumSobolDimensions * SobolMatrixSize] =\n{\n";
+		for (uint32_t dimension = 0; dimension < NumSobolDimensions; ++dimension)
+		{
+			for (uint32_t i = 0; i < SobolMatrixSize; i += 8)
+			{
+				stream << "\t";
+				for (uint32_t j = i; j < i + 8; ++j)
+				{
+					const uint32_t index = dimension * SobolMatrixSize + j;
+					stream << "0x" << std::hex << std::setw(8) << std::setfill('0') << SobolMatrices[index] << std::dec;
+					stream << (index + 1 < SobolMatrices.size() ? (j + 1 < i + 8 ? ", " : ",") : "");
+				}
+				stream << "\n";
+			}
+		}
+		stream << "};\n\n";
+		stream << "#endif // SOBOL_MATRICES_HLSLI\n";
+
+		LOG_INFO("Sobol matrices written to {}", Path.string());
+	}
+
+	Sampler::Sampler(SamplerType Type)
+		: Type(Type)
+	{
+		if (Type == SamplerType::BlueNoise)
+		{
+			throw std::exception("The blue noise sampler reads the blue noise texture, it is only implemented in Sampler.hlsli");
+		}
+	}
+
+	void Sampler::StartPixelSample(XMUINT2 Pixel, uint32_t SampleIndex, uint32_t Dimension)
+	{
+		this->Pixel = Pixel;
+		this->SampleIndex = SampleIndex;
+		this->Dimension = Dimension;
+
+		// Same seed as the ray generation shader
+		Seed = (Pixel.x * 1973u + Pixel.y * 9277u + SampleIndex * 26699u) | 1u;
+	}
+
+	float Sampler::Get1D()
+	{
+		const uint32_t dimension = Dimension++;
+		if (Type == SamplerType::Sobol)
+		{
+			return Sobol(0, dimension);
+		}
+
+		Seed = WangHash(Seed);
+		return ToFloat01(Seed);
+	}
+
+	XMFLOAT2 Sampler::Get2D()
+	{
+		if (Type == SamplerType::Sobol)
+		{
+			// Both values come from the same index, the first two Sobol dimensions form a (0, 2)-sequence
+			const uint32_t dimension = Dimension;
+			Dimension += 2;
+			return { Sobol(0, dimension), Sobol(1, dimension) };
+		}
+
+		const float x = Get1D();
+		const float y = Get1D();
+		return { x, y };
+	}
+
+	float Sampler::Sobol(uint32_t SobolDimension, uint32_t Dimension) const
+	{
+		// The index is shuffled per draw so draws are not correlated with each other
+		const uint32_t seed = WangHash(Dimension);
+		const uint32_t index = OwenScramble(SampleIndex, seed);
+		const float value = ToFloat01(OwenScramble(SobolSample(index, SobolDimension), WangHash(seed + SobolDimension + 1)));
+
+		const float rotated = value + Rotation(Dimension + SobolDimension);
+		return rotated >= 1.0f ? rotated - 1.0f : rotated;
+	}
+
+	float Sampler::Rotation(uint32_t Dimension) const
+	{
+		return ToFloat01(WangHash(Pixel.x + WangHash(Pixel.y + WangHash(Dimension))));
+	}
+
+	void BenchmarkSamplers(uint32_t MaxSamplesPerPixel)
+	{
+		constexpr uint32_t Resolution = 32;
+		constexpr uint32_t NumPixels = Resolution * Resolution;
+
+		// Integral of exp(-x^2) over [0, 1]
+		constexpr double Gaussian = 0.7468241328124271;
+
+		struct Integrand
+		{
+			std::string_view Name;
+			double Reference;
+			double(*Evaluate)(Sampler&);
+		};
+
+		const Integrand integrands[] =
+		{
+			{ "Smooth (2D Gaussian)", Gaussian * Gaussian, [](Sampler& Generator)
+			{
+				const XMFLOAT2 Xi = Generator.Get2D();
+				return std::exp(-double(Xi.x) * Xi.x - double(Xi.y) * Xi.y);
+			} },
+			{ "Discontinuous (quarter disk)", XM_PIDIV4, [](Sampler& Generator)
+			{
+				const XMFLOAT2 Xi = Generator.Get2D();
+				return Xi.x * Xi.x + Xi.y * Xi.y < 1.0f ? 1.0 : 0.0;
+			} },
+			{ "Three bounces (6D Gaussian)", std::pow(Gaussian, 6.0), [](Sampler& Generator)
+			{
+				double value = 1.0;
+				for (int bounce = 0; bounce < 3; ++bounce)
+				{
+					const XMFLOAT2 Xi = Generator.Get2D();
+					value *= std::exp(-double(Xi.x) * Xi.x - double(Xi.y) * Xi.y);
+				}
+				return value;
+			} }
+		};
+
+		const SamplerType samplerTypes[] = { SamplerType::Independent, SamplerType::Sobol };
+
+		uint32_t numLevels = 0;
+		while ((1u << numLevels) <= MaxSamplesPerPixel)
+		{
+			++numLevels;
+		}
+
+		LOG_INFO("Sampler benchmark, RMSE over {} pixels (Independent, Sobol)", NumPixels);
+		for (const auto& integrand : integrands)
+		{
+			LOG_INFO("{}", integrand.Name);
+
+			// Squared errors of the estimates after 1, 2, 4, ... samples, summed over pixels
+			std::vector<double> squaredErrors[ARRAYSIZE(samplerTypes)];
+			for (size_t i = 0; i < ARRAYSIZE(samplerTypes); ++i)
+			{
+				CriticalSection criticalSection;
+				squaredErrors[i].resize(numLevels);
+
+				ParallelFor(NumPixels, 64, [&](size_t Begin, size_t End)
+				{
+					std::vector<double> errors(numLevels);
+					Sampler sampler(samplerTypes[i]);
+					for (size_t pixel = Begin; pixel < End; ++pixel)
+					{
+						double sum = 0.0;
+						for (uint32_t sample = 0, level = 0; level < numLevels; ++sample)
+						{
+							sampler.StartPixelSample({ static_cast<uint32_t>(pixel % Resolution), static_cast<uint32_t>(pixel / Resolution) }, sample);
+							sum += integrand.Evaluate(sampler);
+
+							if (sample + 1 == (1u << level))
+							{
+								const double error = sum / static_cast<double>(sample + 1) - integrand.Reference;
+								errors[level++] += error * error;
+							}
+						}
+					}
+
+					ScopedCriticalSection SCS(criticalSection);
+					for (uint32_t level = 0; level < numLevels; ++level)
+					{
+						squaredErrors[i][level] += errors[level];
+					}
+				});
+			}
+
+			for (uint32_t level = 0; level < numLevels; ++level)
+			{
+				LOG_INFO("\t{:>5} spp: {:.3e} {:.3e}", 1u << level,
+					std::sqrt(squaredErrors[0][level] / NumPixels),
+					std::sqrt(squaredErrors[1][level] / NumPixels));
+			}
+		}
+	}
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include <array>
+#include <filesystem>
+#include <string_view>
+#include <DirectXMath.h>
+
+/*
+* C++ counterpart of Sampler.hlsli. Every Get1D/Get2D call consumes the next dimension(s) of the pixel sample, callers
+* start bounces at fixed dimensions so a decision draws the same dimension regardless of earlier branches.
+* - Independent: white noise from WangHash, like RandomFloat01
+* - BlueNoise: spatiotemporal blue noise texture, only implemented on the GPU
+* - Sobol: padded Sobol (Burley 2020), every 1D or 2D draw reads the first Sobol dimensions with the sample index and
+*   the values Owen scrambled by a hash of the draw's dimension. Pixels share the sequence and are decorrelated by a
+*   per pixel Cranley-Patterson rotation, hashed here and read from the blue noise texture on the GPU when it is loaded
+*/
+namespace CPU
+{
+	// Must match SamplerType_* in Sampler.hlsli
+	enum class SamplerType : uint32_t
+	{
+		Independent,
+		BlueNoise,
+		Sobol,
+		NumSamplerTypes
+	};
+
+	constexpr uint32_t NumSobolDimensions = 4;
+	constexpr uint32_t SobolMatrixSize = 32;
+
+	// Generator matrices built from the Joe-Kuo direction numbers, Shaders/SobolMatrices.hlsli is written from them
+	extern const std::array<uint32_t, NumSobolDimensions * SobolMatrixSize> SobolMatrices;
+
+	uint32_t WangHash(uint32_t Seed);
+
+	uint32_t SobolSample(uint32_t Index, uint32_t Dimension);
+
+	// Hash based nested uniform (Owen) scrambling of the bits of Value, Laine and Karras 2011 / Burley 2020
+	uint32_t OwenScramble(uint32_t Value, uint32_t Seed);
+
+	class Sampler
+	{
+	public:
+		static constexpr std::string_view CommandLineFlag = "--generate-sobol-matrices";
+
+		// Entry point of the editor executable started with CommandLineFlag: --generate-sobol-matrices <OutputFile>
+		static int Run(int argc, char* argv[]);
+
+		// Writes SobolMatrices as an HLSL header
+		static void WriteSobolMatrices(const std::filesystem::path& Path);
+
+		explicit Sampler(SamplerType Type);
+
+		void StartPixelSample(DirectX::XMUINT2 Pixel, uint32_t SampleIndex, uint32_t Dimension = 0);
+
+		float Get1D();
+		DirectX::XMFLOAT2 Get2D();
+	private:
+		float Sobol(uint32_t SobolDimension, uint32_t Dimension) const;
+		float Rotation(uint32_t Dimension) const;
+	private:
+		SamplerType Type;
+		DirectX::XMUINT2 Pixel = {};
+		uint32_t SampleIndex = 0;
+		uint32_t Dimension = 0;
+		uint32_t Seed = 0;
+	};
+
+	// Logs the RMSE of every sampler over many pixels for doubling sample counts up to MaxSamplesPerPixel, integrating
+	// smooth, discontinuous and multi-bounce integrands with known values
+	void BenchmarkSamplers(uint32_t MaxSamplesPerPixel);
+}
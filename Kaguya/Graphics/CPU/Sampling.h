@@ -0,0 +1,102 @@
+#pragma once
+#include <DirectXMath.h>
+
+#include <Core/Math.h>
+
+// C++ counterparts of Sampling.hlsli, used by the CPU side integrators and table generators
+namespace CPU
+{
+	inline DirectX::XMFLOAT2 SampleConcentricDisk(DirectX::XMFLOAT2 Xi)
+	{
+		// Map Xi to $[-1,1]^2$
+		const float x = 2.0f * Xi.x - 1.0f;
+		const float y = 2.0f * Xi.y - 1.0f;
+
+		// Handle degeneracy at the origin
+		if (x == 0.0f && y == 0.0f)
+		{
+			return { 0.0f, 0.0f };
+		}
+
+		// Apply concentric mapping to point
+		float radius, theta;
+		if (std::abs(x) > std::abs(y))
+		{
+			radius = x;
+			theta = DirectX::XM_PIDIV4 * (y / x);
+		}
+		else
+		{
+			radius = y;
+			theta = DirectX::XM_PIDIV2 - DirectX::XM_PIDIV4 * (x / y);
+		}
+
+		return { radius * std::cos(theta), radius * std::sin(theta) };
+	}
+
+	inline DirectX::XMVECTOR SampleUniformHemisphere(DirectX::XMFLOAT2 Xi)
+	{
+		const float z = Xi.x;
+		const float r = std::sqrt(std::max(0.0f, 1.0f - z * z));
+		const float phi = DirectX::XM_2PI * Xi.y;
+		return DirectX::XMVectorSet(r * std::cos(phi), r * std::sin(phi), z, 0.0f);
+	}
+
+	inline float UniformHemispherePdf()
+	{
+		return DirectX::XM_1DIV2PI;
+	}
+
+	inline DirectX::XMVECTOR SampleUniformSphere(DirectX::XMFLOAT2 Xi)
+	{
+		const float z = 1.0f - 2.0f * Xi.x;
+		const float r = std::sqrt(std::max(0.0f, 1.0f - z * z));
+		const float phi = DirectX::XM_2PI * Xi.y;
+		return DirectX::XMVectorSet(r * std::cos(phi), r * std::sin(phi), z, 0.0f);
+	}
+
+	inline float UniformSpherePdf()
+	{
+		return 1.0f / (4.0f * DirectX::XM_PI);
+	}
+
+	inline DirectX::XMVECTOR SampleCosineHemisphere(DirectX::XMFLOAT2 Xi)
+	{
+		const DirectX::XMFLOAT2 p = SampleConcentricDisk(Xi);
+		const float z = std::sqrt(std::max(0.0f, 1.0f - p.x * p.x - p.y * p.y));
+		return DirectX::XMVectorSet(p.x, p.y, z, 0.0f);
+	}
+
+	inline float CosineHemispherePdf(float CosTheta)
+	{
+		return CosTheta * DirectX::XM_1DIVPI;
+	}
+
+	inline float BalanceHeuristic(int nf, float fPdf, int ng, float gPdf)
+	{
+		return (nf * fPdf) / (nf * fPdf + ng * gPdf);
+	}
+
+	inline float PowerHeuristic(int nf, float fPdf, int ng, float gPdf)
+	{
+		const float f = nf * fPdf, g = ng * gPdf;
+		return (f * f) / (f * f + g * g);
+	}
+
+	// Van der Corput sequence, reverses the bits of Index
+	inline float RadicalInverse2(uint32_t Index)
+	{
+		Index = (Index << 16) | (Index >> 16);
+		Index = ((Index & 0x55555555) << 1) | ((Index & 0xAAAAAAAA) >> 1);
+		Index = ((Index & 0x33333333) << 2) | ((Index & 0xCCCCCCCC) >> 2);
+		Index = ((Index & 0x0F0F0F0F) << 4) | ((Index & 0xF0F0F0F0) >> 4);
+		Index = ((Index & 0x00FF00FF) << 8) | ((Index & 0xFF00FF00) >> 8);
+		return static_cast<float>(Index) * 0x1p-32f;
+	}
+
+	// Point Index of a NumSamples point Hammersley set in [0, 1)^2
+	inline DirectX::XMFLOAT2 Hammersley(uint32_t Index, uint32_t NumSamples)
+	{
+		return { (static_cast<float>(Index) + 0.5f) / static_cast<float>(NumSamples), RadicalInverse2(Index) };
+	}
+}
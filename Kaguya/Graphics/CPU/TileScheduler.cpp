@@ -0,0 +1,203 @@
+#include "pch.h"
+#include "TileScheduler.h"
+
+#include <deque>
+#include <mutex>
+#include <thread>
+
+namespace CPU
+{
+	namespace
+	{
+		struct WorkerQueue
+		{
+			std::mutex Mutex;
+			std::deque<uint32_t> Tiles; // The owner pops the front, thieves take the back
+		};
+
+		bool PopFront(WorkerQueue& Queue, uint32_t* pTile)
+		{
+			std::scoped_lock lock(Queue.Mutex);
+			if (Queue.Tiles.empty())
+			{
+				return false;
+			}
+
+			*pTile = Queue.Tiles.front();
+			Queue.Tiles.pop_front();
+			return true;
+		}
+
+		uint32_t NextPowerOfTwo(uint32_t x)
+		{
+			uint32_t n = 1;
+			while (n < x)
+			{
+				n <<= 1;
+			}
+			return n;
+		}
+	}
+
+	TileScheduler::TileScheduler(uint32_t Width, uint32_t Height, uint32_t TileSize, TileOrder Order)
+		: Width(Width),
+		Height(Height),
+		TileSize(std::max(TileSize, 1u)),
+		NumTilesX((Width + this->TileSize - 1) / this->TileSize),
+		NumTilesY((Height + this->TileSize - 1) / this->TileSize),
+		Order(size_t(NumTilesX) * NumTilesY)
+	{
+		std::iota(this->Order.begin(), this->Order.end(), 0u);
+		if (Order == TileOrder::Scanline)
+		{
+			return;
+		}
+
+		// Tiles outside of the image are skipped by sorting the ones inside by their distance along the curve
+		const uint32_t n = NextPowerOfTwo(std::max(NumTilesX, NumTilesY));
+		std::vector<uint32_t> keys(this->Order.size());
+		for (uint32_t i = 0; i < static_cast<uint32_t>(keys.size()); ++i)
+		{
+			const uint32_t x = i % NumTilesX, y = i / NumTilesX;
+			keys[i] = Order == TileOrder::Morton ? MortonIndex(x, y) : HilbertIndex(n, x, y);
+		}
+
+		std::sort(this->Order.begin(), this->Order.end(), [&](uint32_t a, uint32_t b)
+		{
+			return keys[a] < keys[b];
+		});
+	}
+
+	void TileScheduler::Run(std::span<const uint32_t> Tiles, const std::function<void(const Tile&, size_t)>& Function, const std::atomic<bool>& Cancelled)
+	{
+		const size_t numWorkers = std::min(GetMaxNumWorkers(), std::max<size_t>(Tiles.size(), 1));
+
+		// Contiguous runs along the curve
+		std::vector<WorkerQueue> queues(numWorkers);
+		for (size_t i = 0; i < numWorkers; ++i)
+		{
+			const size_t begin = Tiles.size() * i / numWorkers;
+			const size_t end = Tiles.size() * (i + 1) / numWorkers;
+			queues[i].Tiles.assign(Tiles.begin() + begin, Tiles.begin() + end);
+		}
+
+		const auto steal = [&](size_t Thief, uint32_t* pTile)
+		{
+			for (;;)
+			{
+				// Victims are picked by how much work they have left, the queue may have shrunk by the time it is locked
+				size_t victim = Thief;
+				size_t victimSize = 0;
+				for (size_t i = 0; i < numWorkers; ++i)
+				{
+					std::scoped_lock lock(queues[i].Mutex);
+					if (i != Thief && queues[i].Tiles.size() > victimSize)
+					{
+						victim = i;
+						victimSize = queues[i].Tiles.size();
+					}
+				}
+
+				if (victim == Thief)
+				{
+					return false;
+				}
+
+				std::vector<uint32_t> stolen;
+				{
+					std::scoped_lock lock(queues[victim].Mutex);
+					auto& tiles = queues[victim].Tiles;
+					const size_t first = tiles.size() / 2;
+					stolen.assign(tiles.begin() + first, tiles.end());
+					tiles.erase(tiles.begin() + first, tiles.end());
+				}
+
+				if (stolen.empty())
+				{
+					continue;
+				}
+				++NumSteals;
+
+				*pTile = stolen.front();
+				std::scoped_lock lock(queues[Thief].Mutex);
+				queues[Thief].Tiles.insert(queues[Thief].Tiles.end(), stolen.begin() + 1, stolen.end());
+				return true;
+			}
+		};
+
+		const auto work = [&](size_t Worker)
+		{
+			uint32_t tile;
+			while (!Cancelled && (PopFront(queues[Worker], &tile) || steal(Worker, &tile)))
+			{
+				Function(GetTile(tile), Worker);
+			}
+		};
+
+		std::vector<std::future<void>> workers;
+		for (size_t i = 1; i < numWorkers; ++i)
+		{
+			workers.push_back(std::async(std::launch::async, work, i));
+		}
+
+		work(0);
+
+		for (auto& worker : workers)
+		{
+			worker.get();
+		}
+	}
+
+	size_t TileScheduler::GetMaxNumWorkers()
+	{
+		return std::max<size_t>(std::thread::hardware_concurrency(), 1);
+	}
+
+	Tile TileScheduler::GetTile(uint32_t Index) const
+	{
+		Tile tile;
+		tile.Index = Index;
+		tile.X = Index % NumTilesX * TileSize;
+		tile.Y = Index / NumTilesX * TileSize;
+		tile.Width = std::min(TileSize, Width - tile.X);
+		tile.Height = std::min(TileSize, Height - tile.Y);
+		return tile;
+	}
+
+	uint32_t MortonIndex(uint32_t x, uint32_t y)
+	{
+		const auto part1By1 = [](uint32_t v)
+		{
+			v &= 0x0000ffff;
+			v = (v | (v << 8)) & 0x00ff00ff;
+			v = (v | (v << 4)) & 0x0f0f0f0f;
+			v = (v | (v << 2)) & 0x33333333;
+			v = (v | (v << 1)) & 0x55555555;
+			return v;
+		};
+		return part1By1(x) | (part1By1(y) << 1);
+	}
+
+	uint32_t HilbertIndex(uint32_t N, uint32_t x, uint32_t y)
+	{
+		uint32_t d = 0;
+		for (uint32_t s = N / 2; s > 0; s /= 2)
+		{
+			const uint32_t rx = (x & s) > 0 ? 1 : 0;
+			const uint32_t ry = (y & s) > 0 ? 1 : 0;
+			d += s * s * ((3 * rx) ^ ry);
+
+			// Rotate the quadrant so the curve inside it starts and ends next to its neighbors
+			if (ry == 0)
+			{
+				if (rx == 1)
+				{
+					x = N - 1 - x;
+					y = N - 1 - y;
+				}
+				std::swap(x, y);
+			}
+		}
+		return d;
+	}
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <atomic>
+#include <functional>
+#include <span>
+#include <vector>
+
+/*
+* Hands the tiles of an image to one worker per hardware thread. Tiles are ordered along a space filling curve and
+* every worker starts with a contiguous run of that order, so the tiles a worker renders one after the other are
+* neighbors on screen and share the geometry they hit. A worker takes tiles from the front of its queue, once it is
+* empty it steals the back half of the fullest queue it finds, which is the part of that run farthest from where its
+* owner is working. Passes over the tiles are driven by the caller, every Run returns once all of its tiles finished.
+*/
+namespace CPU
+{
+	enum class TileOrder
+	{
+		Scanline,
+		Morton, // Z-order, interleaves the bits of the tile coordinates
+		Hilbert // No jumps between consecutive tiles, better locality than Morton for the same cost
+	};
+
+	struct Tile
+	{
+		uint32_t Index; // Row major
+		uint32_t X, Y; // Of the top left pixel
+		uint32_t Width, Height; // Smaller than the tile size on the right and bottom edges
+	};
+
+	class TileScheduler
+	{
+	public:
+		TileScheduler(uint32_t Width, uint32_t Height, uint32_t TileSize, TileOrder Order);
+
+		// Calls Function(Tile, Worker) for every tile of Tiles concurrently and returns once all of them finished. Worker
+		// is below GetMaxNumWorkers and no two calls with the same Worker overlap. Tiles should be in the order of
+		// GetOrder, workers stop taking tiles once Cancelled is set
+		void Run(std::span<const uint32_t> Tiles, const std::function<void(const Tile&, size_t)>& Function, const std::atomic<bool>& Cancelled);
+
+		// One per hardware thread
+		[[nodiscard]] static size_t GetMaxNumWorkers();
+
+		[[nodiscard]] Tile GetTile(uint32_t Index) const;
+		[[nodiscard]] uint32_t GetNumTiles() const { return NumTilesX * NumTilesY; }
+
+		// Row major tile indices sorted along the curve
+		[[nodiscard]] const std::vector<uint32_t>& GetOrder() const { return Order; }
+
+		// Of all runs so far
+		[[nodiscard]] uint64_t GetNumSteals() const { return NumSteals; }
+	private:
+		uint32_t Width, Height, TileSize;
+		uint32_t NumTilesX, NumTilesY;
+		std::vector<uint32_t> Order;
+		std::atomic<uint64_t> NumSteals = 0;
+	};
+
+	// Distance of (x, y) along the Morton and Hilbert curves that fill a grid of N x N cells, N a power of 2
+	[[nodiscard]] uint32_t MortonIndex(uint32_t x, uint32_t y);
+	[[nodiscard]] uint32_t HilbertIndex(uint32_t N, uint32_t x, uint32_t y);
+}
@@ -36,8 +36,68 @@ void PathIntegrator::Settings::RenderGui()
 		bool Dirty = false;
 		Dirty |= ImGui::SliderScalar("Num Samples Per Pixel", ImGuiDataType_U32, &NumSamplesPerPixel, &MinimumSamples, &MaximumSamples);
 		Dirty |= ImGui::SliderScalar("Max Depth", ImGuiDataType_U32, &MaxDepth, &MinimumDepth, &MaximumDepth);
+		Dirty |= ImGui::Checkbox("Russian Roulette", &RussianRoulette);
+		if (RussianRoulette)
+		{
+			Dirty |= ImGui::SliderScalar("Russian Roulette Min Depth", ImGuiDataType_U32, &RussianRouletteMinDepth, &MinimumDepth, &MaximumDepth);
+			Dirty |= ImGui::SliderFloat("Russian Roulette Min Survival", &RussianRouletteMinSurvival, 0.01f, 1.0f, "%.2f");
+		}
+		Dirty |= ImGui::Checkbox("Multiple Importance Sampling", &MultipleImportanceSampling);
+		const char* LightSamplingStrategies[] = { "Power", "Light BVH" };
+		Dirty |= ImGui::Combo("Light Sampling", &LightSampling, LightSamplingStrategies, ARRAYSIZE(LightSamplingStrategies));
+		const char* SamplerTypes[] = { "Independent", "Blue Noise", "Sobol" };
+		static_assert(ARRAYSIZE(SamplerTypes) == static_cast<size_t>(CPU::SamplerType::NumSamplerTypes));
+		Dirty |= ImGui::Combo("Sampler", &Sampler, SamplerTypes, ARRAYSIZE(SamplerTypes));
+		Dirty |= ImGui::Checkbox("Adaptive Sampling", &AdaptiveSampling);
+		if (AdaptiveSampling)
+		{
+			Dirty |= ImGui::SliderFloat("Error Threshold (%)", &ErrorThreshold, 0.1f, 10.0f, "%.1f");
+		}
 		ImGui::Text("Num Samples Accumulated: %u", NumAccumulatedSamples);
 
+		constexpr UINT MinimumReferenceSamples = CPU::AdaptiveSamplingMinSamples;
+		constexpr UINT MaximumReferenceSamples = 16384;
+		ImGui::SliderScalar("Reference Samples Per Pixel", ImGuiDataType_U32, &ReferenceSamplesPerPixel, &MinimumReferenceSamples, &MaximumReferenceSamples);
+		constexpr UINT MinimumReferenceTileSize = 4;
+		constexpr UINT MaximumReferenceTileSize = 128;
+		ImGui::SliderScalar("Reference Tile Size", ImGuiDataType_U32, &ReferenceTileSize, &MinimumReferenceTileSize, &MaximumReferenceTileSize);
+		const char* TileOrders[] = { "Scanline", "Morton", "Hilbert" };
+		ImGui::Combo("Reference Tile Order", &ReferenceTileOrder, TileOrders, ARRAYSIZE(TileOrders));
+		ImGui::Checkbox("Reference Wavefront", &ReferenceWavefront);
+		if (pPathIntegrator && pPathIntegrator->m_ReferenceRender.valid())
+		{
+			// Reference.hdr is saved after every pass
+			const UINT64 progress = pPathIntegrator->m_ReferenceProgress.load();
+			ImGui::Text("Rendering reference on the CPU... pass %u, %u tiles finished",
+				static_cast<UINT>(progress >> 32) + 1, static_cast<UINT>(progress));
+		}
+		else if (ImGui::Button("Render Reference on CPU"))
+		{
+			ReferenceRequested = true;
+		}
+#if defined(_DEBUG)
+		if (ImGui::Button("Benchmark Samplers"))
+		{
+			CPU::BenchmarkSamplers(1024);
+		}
+		if (ImGui::Button("Benchmark Light Sampling"))
+		{
+			CPU::BenchmarkLightSampling();
+		}
+		if (ImGui::Button("Benchmark Light BVH"))
+		{
+			CPU::BenchmarkLightBVH();
+		}
+		if (ImGui::Button("Benchmark Environment Sampling"))
+		{
+			CPU::BenchmarkEnvironmentSampling();
+		}
+		if (ImGui::Button("Benchmark Wavefront"))
+		{
+			WavefrontBenchmarkRequested = true;
+		}
+#endif
+
 		if (Dirty)
 		{
 			if (pPathIntegrator)
@@ -50,6 +110,15 @@ void PathIntegrator::Settings::RenderGui()
 	}
 }
 
+PathIntegrator::~PathIntegrator()
+{
+	if (m_ReferenceRender.valid())
+	{
+		m_Reference->Cancel();
+		m_ReferenceRender.wait();
+	}
+}
+
 void PathIntegrator::Create()
 {
 	Settings::RestoreDefaults();
@@ -59,6 +128,9 @@ void PathIntegrator::Create()
 
 	UAV = RenderDevice.AllocateUnorderedAccessView();
 	SRV = RenderDevice.AllocateShaderResourceView();
+	BlueNoiseSRV = RenderDevice.AllocateShaderResourceView();
+	MomentsUAV = RenderDevice.AllocateUnorderedAccessView();
+	TileSamplesUAV = RenderDevice.AllocateUnorderedAccessView();
 
 	GlobalRS = RenderDevice.CreateRootSignature([](RootSignatureBuilder& Builder)
 	{
@@ -68,6 +140,12 @@ void PathIntegrator::Create()
 		Builder.AddRootSRVParameter(RootSRV(0, 0));	// g_Scene					t0 | space0
 		Builder.AddRootSRVParameter(RootSRV(1, 0));	// g_Materials				t1 | space0
 		Builder.AddRootSRVParameter(RootSRV(2, 0));	// g_Lights					t2 | space0
+		Builder.AddRootSRVParameter(RootSRV(3, 0));	// g_LightAliasTable		t3 | space0
+		Builder.AddRootSRVParameter(RootSRV(4, 0));	// g_LightBVH				t4 | space0
+		Builder.AddRootSRVParameter(RootSRV(5, 0));	// g_LightBitTrails			t5 | space0
+		Builder.AddRootSRVParameter(RootSRV(6, 0));	// g_EmissiveTriangles		t6 | space0
+		Builder.AddRootSRVParameter(RootSRV(7, 0));	// g_EmissiveTriangleAliasTable	t7 | space0
+		Builder.AddRootSRVParameter(RootSRV(8, 0));	// g_EnvironmentDistribution	t8 | space0
 
 		Builder.AddStaticSampler(0, D3D12_FILTER_MIN_MAG_MIP_POINT, D3D12_TEXTURE_ADDRESS_MODE_WRAP, 16);	// g_SamplerPointWrap			s0 | space0;
 		Builder.AddStaticSampler(1, D3D12_FILTER_MIN_MAG_MIP_POINT, D3D12_TEXTURE_ADDRESS_MODE_CLAMP, 16);	// g_SamplerPointClamp			s1 | space0;
@@ -79,10 +157,11 @@ void PathIntegrator::Create()
 
 	LocalHitGroupRS = RenderDevice::Instance().CreateRootSignature([](RootSignatureBuilder& Builder)
 	{
-		Builder.AddRootConstantsParameter<void>(RootConstants<void>(0, 1, 1)); // RootConstants b0 | space1
+		Builder.AddRootConstantsParameter<void>(RootConstants<void>(0, 1, 3)); // RootConstants b0 | space1
 
 		Builder.AddRootSRVParameter(RootSRV(0, 1));	// VertexBuffer				t0 | space1
 		Builder.AddRootSRVParameter(RootSRV(1, 1));	// IndexBuffer				t1 | space1
+		Builder.AddRootSRVParameter(RootSRV(2, 1));	// QuantizationTransform	t2 | space1
 
 		Builder.SetAsLocalRootSignature();
 	}, false);
@@ -108,12 +187,23 @@ void PathIntegrator::Create()
 
 		Builder.SetGlobalRootSignature(&GlobalRS);
 
-		Builder.SetRaytracingShaderConfig(12 * sizeof(float) + 2 * sizeof(unsigned int), SizeOfBuiltInTriangleIntersectionAttributes);
+		Builder.SetRaytracingShaderConfig(16 * sizeof(float) + 3 * sizeof(unsigned int), SizeOfBuiltInTriangleIntersectionAttributes);
 
 		// +1 for Primary, +1 for Shadow
 		Builder.SetRaytracingPipelineConfig(2);
 	});
 
+	AdaptiveSamplingRS = RenderDevice.CreateRootSignature([](RootSignatureBuilder& Builder)
+	{
+		Builder.AddRootConstantsParameter(RootConstants<void>(0, 0, 6)); // register(b0, space0)
+	});
+
+	AdaptiveSamplingPSO = RenderDevice.CreateComputePipelineState([&](ComputePipelineStateBuilder& Builder)
+	{
+		Builder.pRootSignature = &AdaptiveSamplingRS;
+		Builder.pCS = &Shaders::CS::AdaptiveSampling;
+	});
+
 	RayGenerationSID = RTPSO.GetShaderIdentifier(L"RayGeneration");
 	MissSID = RTPSO.GetShaderIdentifier(L"Miss");
 	ShadowMissSID = RTPSO.GetShaderIdentifier(L"ShadowMiss");
@@ -158,6 +248,62 @@ void PathIntegrator::Create()
 		uploader.Upload(m_MissShaderTable->pResource.Get(), missSBTUpload);
 	}
 
+	// Blue Noise, checked in and regenerated with the GenerateBlueNoise target (see Graphics/CPU/BlueNoiseGenerator.h).
+	// The path tracer samples white noise without it
+	{
+		const auto path = Application::ExecutableFolderPath / "Assets/LUT/BlueNoise.dds";
+
+		TexMetadata texMetadata;
+		ScratchImage scratchImage;
+		if (SUCCEEDED(LoadFromDDSFile(path.c_str(), DDS_FLAGS_NONE, &texMetadata, scratchImage)))
+		{
+			// Sets generated with --channels 1, 2 or 4
+			switch (texMetadata.format)
+			{
+			case DXGI_FORMAT_R8_UNORM: BlueNoiseChannels = 1; break;
+			case DXGI_FORMAT_R8G8_UNORM: BlueNoiseChannels = 2; break;
+			case DXGI_FORMAT_R8G8B8A8_UNORM: BlueNoiseChannels = 4; break;
+			default: BlueNoiseChannels = 0; break;
+			}
+		}
+
+		if (BlueNoiseChannels > 0)
+		{
+			auto resourceDesc = CD3DX12_RESOURCE_DESC::Tex2D(texMetadata.format,
+				texMetadata.width,
+				static_cast<UINT>(texMetadata.height),
+				static_cast<UINT16>(texMetadata.arraySize),
+				1);
+
+			m_BlueNoise = RenderDevice.CreateResource(&allocationDesc,
+				&resourceDesc, D3D12_RESOURCE_STATE_COMMON, nullptr);
+
+			// Always viewed as an array, static tiles have a single slice
+			D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+			srvDesc.Format = texMetadata.format;
+			srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+			srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2DARRAY;
+			srvDesc.Texture2DArray.MipLevels = 1;
+			srvDesc.Texture2DArray.ArraySize = static_cast<UINT>(texMetadata.arraySize);
+			RenderDevice.Device->CreateShaderResourceView(m_BlueNoise->pResource.Get(), &srvDesc, BlueNoiseSRV.CpuHandle);
+
+			std::vector<D3D12_SUBRESOURCE_DATA> subresources(scratchImage.GetImageCount());
+			const Image* pImages = scratchImage.GetImages();
+			for (size_t i = 0; i < scratchImage.GetImageCount(); ++i)
+			{
+				subresources[i].RowPitch = pImages[i].rowPitch;
+				subresources[i].SlicePitch = pImages[i].slicePitch;
+				subresources[i].pData = pImages[i].pixels;
+			}
+
+			uploader.Upload(m_BlueNoise->pResource.Get(), 0, subresources.data(), static_cast<UINT>(subresources.size()));
+		}
+		else
+		{
+			LOG_WARN("{} is missing or not R8_UNORM, R8G8_UNORM or R8G8B8A8_UNORM, build the GenerateBlueNoise target to regenerate it", path.string());
+		}
+	}
+
 	auto finish = uploader.End(RenderDevice.CopyQueue);
 	finish.wait();
 
@@ -193,6 +339,20 @@ void PathIntegrator::SetResolution(UINT Width, UINT Height)
 	RenderDevice.CreateUnorderedAccessView(m_RenderTarget->pResource.Get(), UAV);
 	RenderDevice.CreateShaderResourceView(m_RenderTarget->pResource.Get(), SRV);
 
+	m_Moments = RenderDevice.CreateResource(&allocationDesc,
+		&resourceDesc, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, nullptr);
+
+	RenderDevice.CreateUnorderedAccessView(m_Moments->pResource.Get(), MomentsUAV);
+
+	// One texel per tile, only x (samples) and y (relative error) are used but the bindless table holds float4 textures
+	resourceDesc.Width = RoundUpAndDivide(Width, CPU::AdaptiveSamplingTileSize);
+	resourceDesc.Height = RoundUpAndDivide(Height, CPU::AdaptiveSamplingTileSize);
+
+	m_TileSamples = RenderDevice.CreateResource(&allocationDesc,
+		&resourceDesc, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, nullptr);
+
+	RenderDevice.CreateUnorderedAccessView(m_TileSamples->pResource.Get(), TileSamplesUAV);
+
 	Reset();
 }
 
@@ -208,22 +368,33 @@ void PathIntegrator::UpdateShaderTable(const RaytracingAccelerationStructure& Ra
 	HitGroupShaderTable.Clear();
 	for (auto [i, meshRenderer] : enumerate(RaytracingAccelerationStructure.MeshRenderers))
 	{
-		auto meshFilter = meshRenderer->pMeshFilter;
+		const auto& mesh = meshRenderer->pMeshFilter->Mesh;
 
-		const auto& vertexBuffer = meshFilter->Mesh->VertexResource->pResource;
-		const auto& indexBuffer = meshFilter->Mesh->IndexResource->pResource;
+		const auto& vertexBuffer = mesh->VertexResource->pResource;
+		const auto& indexBuffer = mesh->IndexResource->pResource;
+		const UINT vertexStride = mesh->GetVertexStride();
+		const bool compact = mesh->GetVertexFormat() == VertexFormat::Compact;
 
-		ShaderTable<RootArgument>::Record shaderRecord = {};
-		shaderRecord.ShaderIdentifier = DefaultSID;
-		shaderRecord.RootArguments = 
+		// InstanceContributionToHitGroupIndex advances by the number of geometries in the BLAS,
+		// so every submesh gets its own record with the buffers offset to the start of the submesh
+		for (auto [j, submesh] : enumerate(mesh->Submeshes))
 		{
-			.MaterialIndex = (UINT)i,
-			.Padding = 0,
-			.VertexBuffer = vertexBuffer->GetGPUVirtualAddress(),
-			.IndexBuffer = indexBuffer->GetGPUVirtualAddress()
-		};
-
-		HitGroupShaderTable.AddShaderRecord(shaderRecord);
+			ShaderTable<RootArgument>::Record shaderRecord = {};
+			shaderRecord.ShaderIdentifier = DefaultSID;
+			shaderRecord.RootArguments =
+			{
+				.MaterialIndex = (UINT)i,
+				.VertexFormat = (UINT)mesh->GetVertexFormat(),
+				.IndexStride = submesh.GetIndexStride(),
+				.Padding = 0,
+				.VertexBuffer = vertexBuffer->GetGPUVirtualAddress() + submesh.BaseVertexLocation * vertexStride,
+				.IndexBuffer = indexBuffer->GetGPUVirtualAddress() + submesh.IndexByteOffset,
+				// Not accessed for full precision vertices
+				.QuantizationTransform = compact ? mesh->QuantizationResource->pResource->GetGPUVirtualAddress() + j * sizeof(XMFLOAT3X4) : 0
+			};
+
+			HitGroupShaderTable.AddShaderRecord(shaderRecord);
+		}
 	}
 
 	UINT64 shaderTableSizeInBytes = HitGroupShaderTable.GetSizeInBytes();
@@ -241,6 +412,13 @@ void PathIntegrator::Render(D3D12_GPU_VIRTUAL_ADDRESS SystemConstants,
 	const RaytracingAccelerationStructure& RaytracingAccelerationStructure,
 	D3D12_GPU_VIRTUAL_ADDRESS Materials,
 	D3D12_GPU_VIRTUAL_ADDRESS Lights,
+	D3D12_GPU_VIRTUAL_ADDRESS LightAliasTable,
+	D3D12_GPU_VIRTUAL_ADDRESS LightBVH,
+	D3D12_GPU_VIRTUAL_ADDRESS LightBitTrails,
+	D3D12_GPU_VIRTUAL_ADDRESS EmissiveTriangles,
+	D3D12_GPU_VIRTUAL_ADDRESS EmissiveTriangleAliasTable,
+	D3D12_GPU_VIRTUAL_ADDRESS EnvironmentDistribution,
+	const EnvironmentDesc& Environment,
 	CommandList& CommandList)
 {
 	auto& RenderDevice = RenderDevice::Instance();
@@ -250,15 +428,49 @@ void PathIntegrator::Render(D3D12_GPU_VIRTUAL_ADDRESS SystemConstants,
 		uint NumSamplesPerPixel;
 		uint MaxDepth;
 		uint NumAccumulatedSamples;
+		uint Sampler;
 
 		uint RenderTarget;
+		int BlueNoise;
+		uint Moments;
+		int TileSamples;
+
+		uint RussianRouletteMinDepth;
+		float RussianRouletteMinSurvival;
+
+		uint MultipleImportanceSampling;
+		uint LightSampling;
+
+		float3 EnvironmentScale;
+		int Environment;
+		float EnvironmentMinLOD;
+		uint EnvironmentWidth;
+		uint EnvironmentHeight;
+		uint BlueNoiseChannels;
 	} g_RenderPassData = {};
 
 	g_RenderPassData.NumSamplesPerPixel = Settings::NumSamplesPerPixel;
 	g_RenderPassData.MaxDepth = Settings::MaxDepth;
 	g_RenderPassData.NumAccumulatedSamples = Settings::NumAccumulatedSamples++;
+	g_RenderPassData.Sampler = static_cast<uint>(Settings::Sampler);
 
 	g_RenderPassData.RenderTarget = UAV.Index;
+	g_RenderPassData.BlueNoise = m_BlueNoise ? static_cast<int>(BlueNoiseSRV.Index) : -1;
+	g_RenderPassData.Moments = MomentsUAV.Index;
+	g_RenderPassData.TileSamples = Settings::AdaptiveSampling ? static_cast<int>(TileSamplesUAV.Index) : -1;
+
+	g_RenderPassData.RussianRouletteMinDepth = Settings::RussianRoulette ? Settings::RussianRouletteMinDepth : Settings::MaxDepth + 1;
+	g_RenderPassData.RussianRouletteMinSurvival = Settings::RussianRouletteMinSurvival;
+
+	g_RenderPassData.MultipleImportanceSampling = Settings::MultipleImportanceSampling ? 1 : 0;
+	g_RenderPassData.LightSampling = static_cast<uint>(Settings::LightSampling);
+
+	g_RenderPassData.EnvironmentScale = Environment.Scale;
+	g_RenderPassData.Environment = Environment.Texture;
+	g_RenderPassData.EnvironmentMinLOD = Environment.MinLOD;
+	g_RenderPassData.EnvironmentWidth = Environment.Width;
+	g_RenderPassData.EnvironmentHeight = Environment.Height;
+	g_RenderPassData.BlueNoiseChannels = BlueNoiseChannels;
 
 	GraphicsResource constantBuffer = RenderDevice.Device.GraphicsMemory()->AllocateConstant(g_RenderPassData);
 
@@ -269,6 +481,12 @@ void PathIntegrator::Render(D3D12_GPU_VIRTUAL_ADDRESS SystemConstants,
 	CommandList->SetComputeRootShaderResourceView(2, RaytracingAccelerationStructure);
 	CommandList->SetComputeRootShaderResourceView(3, Materials);
 	CommandList->SetComputeRootShaderResourceView(4, Lights);
+	CommandList->SetComputeRootShaderResourceView(5, LightAliasTable);
+	CommandList->SetComputeRootShaderResourceView(6, LightBVH);
+	CommandList->SetComputeRootShaderResourceView(7, LightBitTrails);
+	CommandList->SetComputeRootShaderResourceView(8, EmissiveTriangles);
+	CommandList->SetComputeRootShaderResourceView(9, EmissiveTriangleAliasTable);
+	CommandList->SetComputeRootShaderResourceView(10, EnvironmentDistribution);
 
 	RenderDevice.BindDescriptorTable<PipelineState::Type::Compute>(GlobalRS, CommandList);
 
@@ -284,4 +502,108 @@ void PathIntegrator::Render(D3D12_GPU_VIRTUAL_ADDRESS SystemConstants,
 
 	CommandList.DispatchRays(&desc);
 	CommandList.UAVBarrier(m_RenderTarget->pResource.Get());
+	CommandList.UAVBarrier(m_Moments->pResource.Get());
+
+	// Decide the samples of every tile for the next frame from the moments of its pixels, a tile takes at most 4 times
+	// the samples per pixel in a frame so the frame time stays bounded
+	if (Settings::AdaptiveSampling)
+	{
+		struct Settings
+		{
+			uint MomentsIndex;
+			uint TileSamplesIndex;
+			uint MaxSamplesPerPixel;
+			float ErrorThreshold;
+			uint Width;
+			uint Height;
+		} Settings = {};
+		Settings.MomentsIndex = MomentsUAV.Index;
+		Settings.TileSamplesIndex = TileSamplesUAV.Index;
+		Settings.MaxSamplesPerPixel = 4 * PathIntegrator::Settings::NumSamplesPerPixel;
+		Settings.ErrorThreshold = PathIntegrator::Settings::ErrorThreshold / 100.0f;
+		Settings.Width = Width;
+		Settings.Height = Height;
+
+		CommandList->SetPipelineState(AdaptiveSamplingPSO);
+		CommandList->SetComputeRootSignature(AdaptiveSamplingRS);
+		CommandList->SetComputeRoot32BitConstants(0, 6, &Settings, 0);
+
+		RenderDevice.BindDescriptorTable<PipelineState::Type::Compute>(AdaptiveSamplingRS, CommandList);
+
+		CommandList.Dispatch2D<CPU::AdaptiveSamplingTileSize, CPU::AdaptiveSamplingTileSize>(Width, Height);
+		CommandList.UAVBarrier(m_TileSamples->pResource.Get());
+	}
+}
+
+void PathIntegrator::RenderReference(Scene& Scene)
+{
+	if (m_ReferenceRender.valid() &&
+		m_ReferenceRender.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+	{
+		m_ReferenceRender.get();
+		m_Reference.reset();
+	}
+
+	if ((!Settings::ReferenceRequested && !Settings::WavefrontBenchmarkRequested) || m_ReferenceRender.valid())
+	{
+		return;
+	}
+
+	CPU::PathIntegrator::Options options;
+	options.Width = Width;
+	options.Height = Height;
+	options.MaxDepth = Settings::MaxDepth;
+	options.RussianRoulette = Settings::RussianRoulette;
+	options.RussianRouletteMinDepth = Settings::RussianRouletteMinDepth;
+	options.RussianRouletteMinSurvival = Settings::RussianRouletteMinSurvival;
+	options.MultipleImportanceSampling = Settings::MultipleImportanceSampling;
+	options.LightSampling = static_cast<CPU::LightSamplingStrategy>(Settings::LightSampling);
+	// The CPU samplers have no blue noise, the GPU falls back to white noise as well without the texture
+	options.Sampler = Settings::Sampler == static_cast<int>(CPU::SamplerType::BlueNoise) ?
+		CPU::SamplerType::Independent :
+		static_cast<CPU::SamplerType>(Settings::Sampler);
+	options.MaxSamplesPerPixel = Settings::ReferenceSamplesPerPixel;
+	options.Adaptive = Settings::AdaptiveSampling;
+	options.ErrorThreshold = Settings::ErrorThreshold / 100.0f;
+	options.TileSize = Settings::ReferenceTileSize;
+	options.Order = static_cast<CPU::TileOrder>(Settings::ReferenceTileOrder);
+	options.OnTileFinished = [this](const CPU::Tile&, uint32_t Pass)
+	{
+		// The pass and its tile count change together, a tile of a new pass restarts the count
+		UINT64 progress = m_ReferenceProgress.load();
+		UINT64 next;
+		do
+		{
+			next = static_cast<UINT>(progress >> 32) == Pass ? progress + 1 : (static_cast<UINT64>(Pass) << 32) | 1;
+		} while (!m_ReferenceProgress.compare_exchange_weak(progress, next));
+	};
+	options.PreviewPath = Application::ExecutableFolderPath / "Reference.hdr";
+	options.Wavefront = Settings::ReferenceWavefront;
+
+	// Blocks until both modes finished, a reference that was requested as well starts in the next frame
+	if (Settings::WavefrontBenchmarkRequested)
+	{
+		Settings::WavefrontBenchmarkRequested = false;
+
+		constexpr UINT WavefrontBenchmarkSamples = 16;
+		options.MaxSamplesPerPixel = WavefrontBenchmarkSamples;
+		CPU::BenchmarkWavefront(std::make_shared<CPU::RaytracingScene>(Scene), options);
+		return;
+	}
+	Settings::ReferenceRequested = false;
+
+	m_ReferenceProgress = 0;
+	m_Reference = std::make_shared<CPU::PathIntegrator>(std::make_shared<CPU::RaytracingScene>(Scene), options);
+	m_ReferenceRender = std::async(std::launch::async, [pReference = m_Reference]()
+	{
+		try
+		{
+			pReference->Render();
+			pReference->Save(Application::ExecutableFolderPath / "Reference.hdr");
+		}
+		catch (std::exception& e)
+		{
+			LOG_ERROR("Failed to render reference: {}", e.what());
+		}
+	});
 }
\ No newline at end of file
@@ -1,6 +1,10 @@
 #pragma once
+#include <future>
+
 #include "RenderDevice.h"
 #include "RaytracingAccelerationStructure.h"
+#include "CPU/PathIntegrator.h"
+#include "CPU/Sampler.h"
 
 class PathIntegrator
 {
@@ -15,7 +19,21 @@ public:
 
 		inline static UINT NumSamplesPerPixel;
 		inline static UINT MaxDepth;
+		inline static bool RussianRoulette;
+		inline static UINT RussianRouletteMinDepth; // Bounces before a path can be terminated
+		inline static float RussianRouletteMinSurvival; // Lower bound of the survival probability
+		inline static bool MultipleImportanceSampling; // Of light and BSDF samples for direct lighting
+		inline static int LightSampling; // CPU::LightSamplingStrategy
 		inline static UINT NumAccumulatedSamples;
+		inline static int Sampler; // CPU::SamplerType
+		inline static bool AdaptiveSampling;
+		inline static float ErrorThreshold; // Percent of the mean, per pixel
+		inline static UINT ReferenceSamplesPerPixel; // Most samples a pixel of the CPU reference takes
+		inline static UINT ReferenceTileSize; // Pixels per side of the tiles the CPU threads render
+		inline static int ReferenceTileOrder; // CPU::TileOrder
+		inline static bool ReferenceWavefront; // Renders the CPU reference in the wavefront mode
+		inline static bool ReferenceRequested; // Requests a CPU reference of the current view
+		inline static bool WavefrontBenchmarkRequested; // Requests CPU::BenchmarkWavefront on the current view
 
 		inline static PathIntegrator* pPathIntegrator = nullptr;
 
@@ -23,7 +41,21 @@ public:
 		{
 			NumSamplesPerPixel = 4;
 			MaxDepth = 6;
+			RussianRoulette = true;
+			RussianRouletteMinDepth = 3;
+			RussianRouletteMinSurvival = 0.05f;
+			MultipleImportanceSampling = true;
+			LightSampling = static_cast<int>(CPU::LightSamplingStrategy::BVH);
 			NumAccumulatedSamples = 0;
+			Sampler = static_cast<int>(CPU::SamplerType::Sobol);
+			AdaptiveSampling = false;
+			ErrorThreshold = 1.0f;
+			ReferenceSamplesPerPixel = 1024;
+			ReferenceTileSize = CPU::AdaptiveSamplingTileSize;
+			ReferenceTileOrder = static_cast<int>(CPU::TileOrder::Hilbert);
+			ReferenceWavefront = false;
+			ReferenceRequested = false;
+			WavefrontBenchmarkRequested = false;
 		}
 
 		static void RenderGui();
@@ -31,6 +63,17 @@ public:
 
 	static constexpr UINT NumHitGroups = 1;
 
+	// Environment light of the scene, see EnvironmentMap.hlsli
+	struct EnvironmentDesc
+	{
+		int Texture = -1; // SRV of the image, -1 when there is no environment light
+		float MinLOD = 0.0f;
+		UINT Width = 0, Height = 0; // Of the distribution
+		float3 Scale = { 0.0f, 0.0f, 0.0f };
+	};
+
+	~PathIntegrator();
+
 	void Create();
 
 	void SetResolution(UINT Width, UINT Height);
@@ -44,8 +87,19 @@ public:
 		const RaytracingAccelerationStructure& RaytracingAccelerationStructure,
 		D3D12_GPU_VIRTUAL_ADDRESS Materials,
 		D3D12_GPU_VIRTUAL_ADDRESS Lights,
+		D3D12_GPU_VIRTUAL_ADDRESS LightAliasTable,
+		D3D12_GPU_VIRTUAL_ADDRESS LightBVH,
+		D3D12_GPU_VIRTUAL_ADDRESS LightBitTrails,
+		D3D12_GPU_VIRTUAL_ADDRESS EmissiveTriangles,
+		D3D12_GPU_VIRTUAL_ADDRESS EmissiveTriangleAliasTable,
+		D3D12_GPU_VIRTUAL_ADDRESS EnvironmentDistribution,
+		const EnvironmentDesc& Environment,
 		CommandList& CommandList);
 
+	// Starts a CPU render of Scene in the background when one was requested and none is running, the result is saved
+	// next to the executable as Reference.hdr
+	void RenderReference(Scene& Scene);
+
 	auto GetSRV() const
 	{
 		return SRV;
@@ -60,10 +114,19 @@ private:
 
 	RootSignature GlobalRS, LocalHitGroupRS;
 	RaytracingPipelineState RTPSO;
+	RootSignature AdaptiveSamplingRS;
+	PipelineState AdaptiveSamplingPSO;
 	Descriptor UAV;
 	Descriptor SRV;
+	Descriptor BlueNoiseSRV;
+	Descriptor MomentsUAV;
+	Descriptor TileSamplesUAV;
 
 	std::shared_ptr<Resource> m_RenderTarget;
+	std::shared_ptr<Resource> m_BlueNoise;
+	UINT BlueNoiseChannels = 0; // 1, 2 or 4 independent sets per texel
+	std::shared_ptr<Resource> m_Moments;
+	std::shared_ptr<Resource> m_TileSamples;
 	std::shared_ptr<Resource> m_RayGenerationShaderTable;
 	std::shared_ptr<Resource> m_MissShaderTable;
 	std::shared_ptr<Resource> m_HitGroupShaderTable;
@@ -72,12 +135,19 @@ private:
 	struct RootArgument
 	{
 		UINT64 MaterialIndex : 32;
+		UINT64 VertexFormat : 32;
+		UINT64 IndexStride : 32;
 		UINT64 Padding : 32;
 		D3D12_GPU_VIRTUAL_ADDRESS VertexBuffer;
 		D3D12_GPU_VIRTUAL_ADDRESS IndexBuffer;
+		D3D12_GPU_VIRTUAL_ADDRESS QuantizationTransform;
 	};
 
 	ShaderTable<void> RayGenerationShaderTable;
 	ShaderTable<void> MissShaderTable;
 	ShaderTable<RootArgument> HitGroupShaderTable;
+
+	std::shared_ptr<CPU::PathIntegrator> m_Reference;
+	std::future<void> m_ReferenceRender;
+	std::atomic<UINT64> m_ReferenceProgress = 0; // Pass in the high 32 bits, tiles finished in that pass in the low 32 bits, shown in the GUI
 };
\ No newline at end of file
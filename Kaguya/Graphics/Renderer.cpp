@@ -5,6 +5,7 @@
 
 #include "RenderDevice.h"
 #include "Scene/Entity.h"
+#include "CPU/Light.h"
 
 #include <wincodec.h> // GUID for different file formats, needed for ScreenGrab
 #include <ScreenGrab.h> // DirectX::SaveWICTextureToFile
@@ -90,6 +91,24 @@ void Renderer::Initialize()
 
 	Lights = RenderDevice.CreateBuffer(&Desc, sizeof(HLSL::Light) * Scene::MAX_LIGHT_SUPPORTED, D3D12_RESOURCE_FLAG_NONE, 0, D3D12_RESOURCE_STATE_GENERIC_READ);
 	ThrowIfFailed(Lights->pResource->Map(0, nullptr, reinterpret_cast<void**>(&pLights)));
+
+	LightAliasTable = RenderDevice.CreateBuffer(&Desc, sizeof(CPU::AliasTable::Bin) * Scene::MAX_LIGHT_SUPPORTED, D3D12_RESOURCE_FLAG_NONE, 0, D3D12_RESOURCE_STATE_GENERIC_READ);
+	ThrowIfFailed(LightAliasTable->pResource->Map(0, nullptr, reinterpret_cast<void**>(&pLightAliasTable)));
+
+	LightBVH = RenderDevice.CreateBuffer(&Desc, sizeof(CPU::LightBVH::Node) * (2 * Scene::MAX_LIGHT_SUPPORTED - 1), D3D12_RESOURCE_FLAG_NONE, 0, D3D12_RESOURCE_STATE_GENERIC_READ);
+	ThrowIfFailed(LightBVH->pResource->Map(0, nullptr, reinterpret_cast<void**>(&pLightBVH)));
+
+	LightBitTrails = RenderDevice.CreateBuffer(&Desc, sizeof(uint32_t) * Scene::MAX_LIGHT_SUPPORTED, D3D12_RESOURCE_FLAG_NONE, 0, D3D12_RESOURCE_STATE_GENERIC_READ);
+	ThrowIfFailed(LightBitTrails->pResource->Map(0, nullptr, reinterpret_cast<void**>(&pLightBitTrails)));
+
+	EmissiveTriangles = RenderDevice.CreateBuffer(&Desc, sizeof(HLSL::EmissiveTriangle) * Scene::MAX_EMISSIVE_TRIANGLE_SUPPORTED, D3D12_RESOURCE_FLAG_NONE, 0, D3D12_RESOURCE_STATE_GENERIC_READ);
+	ThrowIfFailed(EmissiveTriangles->pResource->Map(0, nullptr, reinterpret_cast<void**>(&pEmissiveTriangles)));
+
+	EmissiveTriangleAliasTable = RenderDevice.CreateBuffer(&Desc, sizeof(CPU::AliasTable::Bin) * Scene::MAX_EMISSIVE_TRIANGLE_SUPPORTED, D3D12_RESOURCE_FLAG_NONE, 0, D3D12_RESOURCE_STATE_GENERIC_READ);
+	ThrowIfFailed(EmissiveTriangleAliasTable->pResource->Map(0, nullptr, reinterpret_cast<void**>(&pEmissiveTriangleAliasTable)));
+
+	EnvironmentDistribution = RenderDevice.CreateBuffer(&Desc, sizeof(float) * Scene::MAX_ENVIRONMENT_CDF_SUPPORTED, D3D12_RESOURCE_FLAG_NONE, 0, D3D12_RESOURCE_STATE_GENERIC_READ);
+	ThrowIfFailed(EnvironmentDistribution->pResource->Map(0, nullptr, reinterpret_cast<void**>(&pEnvironmentDistribution)));
 }
 
 void Renderer::Render(const Time& Time, Scene& Scene)
@@ -97,6 +116,9 @@ void Renderer::Render(const Time& Time, Scene& Scene)
 	auto& RenderDevice = RenderDevice::Instance();
 
 	UINT numMaterials = 0, numLights = 0;
+	std::vector<Emitter> emitters;
+	std::shared_ptr<const CPU::EnvironmentMap> environment;
+	PathIntegrator::EnvironmentDesc environmentDesc;
 
 	{
 		RaytracingAccelerationStructure.Clear();
@@ -106,7 +128,19 @@ void Renderer::Render(const Time& Time, Scene& Scene)
 			if (meshFilter.Mesh)
 			{
 				RaytracingAccelerationStructure.AddInstance(&meshRenderer);
-				pMaterials[numMaterials++] = GetHLSLMaterialDesc(meshRenderer.Material);
+				pMaterials[numMaterials] = GetHLSLMaterialDesc(meshRenderer.Material);
+
+				// Meshes without geometry on the CPU cannot be sampled, BSDF sampling still finds them
+				auto& mesh = meshFilter.Mesh.Get();
+				if (CPU::IsEmissive(meshRenderer.Material.emissive) && (mesh.BVH || mesh.GetNumVertices() > 0))
+				{
+					Emitter& emitter = emitters.emplace_back();
+					emitter.Mesh = CPU::GetOrBuildEmissiveMesh(mesh);
+					XMStoreFloat4x4(&emitter.World, Scene.Registry.get<Transform>(handle).Matrix());
+					emitter.Radiance = meshRenderer.Material.emissive;
+					emitter.MaterialIndex = numMaterials;
+				}
+				numMaterials++;
 			}
 		}
 	}
@@ -114,8 +148,111 @@ void Renderer::Render(const Time& Time, Scene& Scene)
 		auto view = Scene.Registry.view<Transform, Light>();
 		for (auto [handle, transform, light] : view.each())
 		{
+			// Sampled on its own from its distribution, see SampleEnvironmentLight in PathTrace.hlsl
+			if (light.Type == EnvironmentLight)
+			{
+				if (!environment && light.Texture && CPU::GetOrBuildEnvironmentMap(light.Texture.Get()))
+				{
+					environment = light.Texture->Environment;
+					environmentDesc.Texture = static_cast<int>(light.Texture->SRV.Index);
+					environmentDesc.MinLOD = static_cast<float>(light.Texture->MostDetailedMip);
+					environmentDesc.Width = environment->GetWidth();
+					environmentDesc.Height = environment->GetHeight();
+					environmentDesc.Scale = light.I;
+				}
+				continue;
+			}
+
+			if (numLights == Scene::MAX_LIGHT_SUPPORTED)
+			{
+				break;
+			}
 			pLights[numLights++] = GetHLSLLightDesc(transform, light);
 		}
+
+		if (environment && environment->GetCdfs().size() > Scene::MAX_ENVIRONMENT_CDF_SUPPORTED)
+		{
+			LOG_WARN("Environment distribution of {}x{} texels does not fit, the environment light is ignored", environment->GetWidth(), environment->GetHeight());
+			environment = nullptr;
+			environmentDesc = {};
+		}
+
+		if (environment != Environment)
+		{
+			if (environment)
+			{
+				std::copy(environment->GetCdfs().begin(), environment->GetCdfs().end(), pEnvironmentDistribution);
+			}
+			Environment = std::move(environment);
+		}
+
+		// The image is refined by the streamer as well
+		if (std::memcmp(&environmentDesc, &EnvironmentDesc, sizeof(EnvironmentDesc)) != 0)
+		{
+			EnvironmentDesc = environmentDesc;
+			PathIntegrator.Reset();
+		}
+
+		const auto sameEmitter = [](const Emitter& a, const Emitter& b)
+		{
+			return a.Mesh == b.Mesh &&
+				std::memcmp(&a.World, &b.World, sizeof(a.World)) == 0 &&
+				std::memcmp(&a.Radiance, &b.Radiance, sizeof(a.Radiance)) == 0;
+		};
+		if (!std::equal(emitters.begin(), emitters.end(), Emitters.begin(), Emitters.end(), sameEmitter))
+		{
+			CPU::MeshLightTriangles triangles;
+			MeshLightDescs.clear();
+			for (const auto& emitter : emitters)
+			{
+				if (triangles.Triangles.size() + emitter.Mesh->GetNumTriangles() > Scene::MAX_EMISSIVE_TRIANGLE_SUPPORTED)
+				{
+					LOG_WARN("Emissive triangle limit reached, {} triangles are only found by BSDF sampling", emitter.Mesh->GetNumTriangles());
+					MeshLightDescs.push_back({});
+					continue;
+				}
+				MeshLightDescs.push_back(triangles.Add(*emitter.Mesh, XMLoadFloat4x4(&emitter.World), emitter.Radiance));
+			}
+
+			std::copy(triangles.Triangles.begin(), triangles.Triangles.end(), pEmissiveTriangles);
+			std::copy(triangles.Bins.begin(), triangles.Bins.end(), pEmissiveTriangleAliasTable);
+		}
+		Emitters = std::move(emitters);
+
+		// Mesh lights follow the lights of the scene
+		for (size_t i = 0; i < Emitters.size(); ++i)
+		{
+			if (numLights == Scene::MAX_LIGHT_SUPPORTED)
+			{
+				break;
+			}
+
+			if (MeshLightDescs[i].NumTriangles > 0)
+			{
+				pMaterials[Emitters[i].MaterialIndex].LightIndex = static_cast<int>(numLights);
+				pLights[numLights++] = MeshLightDescs[i];
+			}
+		}
+
+		if (LightDescs.size() != numLights || std::memcmp(LightDescs.data(), pLights, sizeof(HLSL::Light) * numLights) != 0)
+		{
+			LightDescs.assign(pLights, pLights + numLights);
+
+			std::vector<float> lightPowers(numLights);
+			std::transform(LightDescs.begin(), LightDescs.end(), lightPowers.begin(), CPU::LightPower);
+			const CPU::AliasTable table(lightPowers);
+			std::copy(table.GetBins().begin(), table.GetBins().end(), pLightAliasTable);
+
+			CPU::LightBVH bvh;
+			bvh.Build(LightDescs);
+			if (bvh.IsEmpty())
+			{
+				// A leaf without power, SampleLightBVH finds no light under it
+				*pLightBVH = { .Flags = CPU::LightBVH::Node::Leaf };
+			}
+			std::copy(bvh.GetNodes().begin(), bvh.GetNodes().end(), pLightBVH);
+			std::copy(bvh.GetBitTrails().begin(), bvh.GetBitTrails().end(), pLightBitTrails);
+		}
 	}
 
 	if (!RaytracingAccelerationStructure.Empty())
@@ -165,8 +302,17 @@ void Renderer::Render(const Time& Time, Scene& Scene)
 			RaytracingAccelerationStructure,
 			Materials->pResource->GetGPUVirtualAddress(),
 			Lights->pResource->GetGPUVirtualAddress(),
+			LightAliasTable->pResource->GetGPUVirtualAddress(),
+			LightBVH->pResource->GetGPUVirtualAddress(),
+			LightBitTrails->pResource->GetGPUVirtualAddress(),
+			EmissiveTriangles->pResource->GetGPUVirtualAddress(),
+			EmissiveTriangleAliasTable->pResource->GetGPUVirtualAddress(),
+			EnvironmentDistribution->pResource->GetGPUVirtualAddress(),
+			EnvironmentDesc,
 			GraphicsContext);
 
+		PathIntegrator.RenderReference(Scene);
+
 		Picking.UpdateShaderTable(RaytracingAccelerationStructure, GraphicsContext);
 		Picking.ShootPickingRay(SceneConstants.GpuAddress(), RaytracingAccelerationStructure, GraphicsContext);
 
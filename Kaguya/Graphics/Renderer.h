@@ -1,6 +1,10 @@
 #pragma once
 #include <Core/RenderSystem.h>
 
+#include "CPU/AliasTable.h"
+#include "CPU/EnvironmentMap.h"
+#include "CPU/LightBVH.h"
+#include "CPU/MeshLight.h"
 #include "RaytracingAccelerationStructure.h"
 #include "PathIntegrator.h"
 #include "Picking.h"
@@ -40,4 +44,34 @@ private:
 	HLSL::Material* pMaterials = nullptr;
 	std::shared_ptr<Resource> Lights;
 	HLSL::Light* pLights = nullptr;
+	std::shared_ptr<Resource> LightAliasTable;
+	CPU::AliasTable::Bin* pLightAliasTable = nullptr;
+	std::shared_ptr<Resource> LightBVH;
+	CPU::LightBVH::Node* pLightBVH = nullptr;
+	std::shared_ptr<Resource> LightBitTrails;
+	uint32_t* pLightBitTrails = nullptr;
+	std::shared_ptr<Resource> EmissiveTriangles;
+	HLSL::EmissiveTriangle* pEmissiveTriangles = nullptr;
+	std::shared_ptr<Resource> EmissiveTriangleAliasTable;
+	CPU::AliasTable::Bin* pEmissiveTriangleAliasTable = nullptr;
+	std::shared_ptr<Resource> EnvironmentDistribution;
+	float* pEnvironmentDistribution = nullptr;
+	std::vector<HLSL::Light> LightDescs; // The alias table and the light BVH were built from, they are rebuilt when the lights change
+
+	// Environment light the distribution was copied from, the accumulation restarts when it changes
+	std::shared_ptr<const CPU::EnvironmentMap> Environment;
+	PathIntegrator::EnvironmentDesc EnvironmentDesc;
+
+	struct Emitter
+	{
+		std::shared_ptr<const CPU::EmissiveMesh> Mesh;
+		DirectX::XMFLOAT4X4 World;
+		float3 Radiance;
+		UINT MaterialIndex;
+	};
+
+	// The mesh lights were made from, they are remade when an emissive instance changes. A mesh light has no
+	// triangles when the emissive triangle buffer was full
+	std::vector<Emitter> Emitters;
+	std::vector<HLSL::Light> MeshLightDescs;
 };
\ No newline at end of file
@@ -28,6 +28,7 @@ struct Shaders
 	struct CS
 	{
 		inline static Shader InstanceGeneration;
+		inline static Shader AdaptiveSampling;
 
 		inline static Shader PostProcess_BloomMask;
 		inline static Shader PostProcess_BloomDownsample;
@@ -0,0 +1,569 @@
+#include "pch.h"
+#include "BinarySceneParser.h"
+
+#include "Scene.h"
+#include "Entity.h"
+#include "SceneParser.h"
+
+#include "../AssetManager.h"
+#include "../Asset/AssetStream.h"
+
+#include <random>
+
+namespace BinaryScene
+{
+	static constexpr uint32_t InfoSectionId = MAKEFOURCC('I', 'N', 'F', 'O');
+	static constexpr uint32_t CameraSectionId = MAKEFOURCC('C', 'A', 'M', 'R');
+	static constexpr uint32_t StringSectionId = MAKEFOURCC('S', 'T', 'R', 'S');
+	static constexpr uint32_t ImageSectionId = MAKEFOURCC('I', 'M', 'G', 'S');
+	static constexpr uint32_t MeshSectionId = MAKEFOURCC('M', 'S', 'H', 'S');
+
+	// Every column is stored as an entity section followed by a record section
+	static constexpr uint32_t TagSectionIds[] = { MAKEFOURCC('T', 'A', 'G', 'E'), MAKEFOURCC('T', 'A', 'G', 'R') };
+	static constexpr uint32_t TransformSectionIds[] = { MAKEFOURCC('X', 'F', 'M', 'E'), MAKEFOURCC('X', 'F', 'M', 'R') };
+	static constexpr uint32_t MeshFilterSectionIds[] = { MAKEFOURCC('M', 'F', 'L', 'E'), MAKEFOURCC('M', 'F', 'L', 'R') };
+	static constexpr uint32_t MeshRendererSectionIds[] = { MAKEFOURCC('M', 'R', 'D', 'E'), MAKEFOURCC('M', 'R', 'D', 'R') };
+	static constexpr uint32_t LightSectionIds[] = { MAKEFOURCC('L', 'G', 'T', 'E'), MAKEFOURCC('L', 'G', 'T', 'R') };
+
+	struct Info
+	{
+		uint32_t NumEntities;
+	};
+
+	template<typename T>
+	static void WriteColumn(AssetStreamWriter& Writer, const uint32_t (&SectionIds)[2], const Column<T>& Column)
+	{
+		Writer.AddSection(SectionIds[0], Column.Entities);
+		Writer.AddSection(SectionIds[1], Column.Records);
+	}
+
+	template<typename T>
+	static bool ReadColumn(const AssetStreamReader& Reader, const uint32_t (&SectionIds)[2], uint32_t NumEntities, Column<T>& Column)
+	{
+		if (!Reader.ReadSection(SectionIds[0], Column.Entities) ||
+			!Reader.ReadSection(SectionIds[1], Column.Records) ||
+			Column.Entities.size() != Column.Records.size())
+		{
+			return false;
+		}
+
+		return std::all_of(Column.Entities.begin(), Column.Entities.end(), [NumEntities](uint32_t Entity)
+		{
+			return Entity < NumEntities;
+		});
+	}
+
+	StringRef Document::AddString(std::string_view String)
+	{
+		StringRef Ref = { static_cast<uint32_t>(Strings.size()), static_cast<uint32_t>(String.size()) };
+		Strings += String;
+		return Ref;
+	}
+
+	std::string_view Document::GetString(StringRef String) const
+	{
+		return std::string_view(Strings).substr(String.Offset, String.Length);
+	}
+
+	uint32_t Document::AddImage(UINT64 Key, std::string_view Path, bool sRGB)
+	{
+		auto [iter, inserted] = ImageIndices.try_emplace(Key, static_cast<uint32_t>(Images.size()));
+		if (inserted)
+		{
+			Images.push_back({ .Path = AddString(Path), .sRGB = static_cast<uint32_t>(sRGB) });
+		}
+		return iter->second;
+	}
+
+	uint32_t Document::AddMesh(UINT64 Key, std::string_view Path, const MeshRecord& Metadata)
+	{
+		auto [iter, inserted] = MeshIndices.try_emplace(Key, static_cast<uint32_t>(Meshes.size()));
+		if (inserted)
+		{
+			MeshRecord& Record = Meshes.emplace_back(Metadata);
+			Record.Path = AddString(Path);
+		}
+		return iter->second;
+	}
+
+	uint32_t Document::FindImage(UINT64 Key) const
+	{
+		auto iter = ImageIndices.find(Key);
+		return iter != ImageIndices.end() ? iter->second : InvalidIndex;
+	}
+
+	uint32_t Document::FindMesh(UINT64 Key) const
+	{
+		auto iter = MeshIndices.find(Key);
+		return iter != MeshIndices.end() ? iter->second : InvalidIndex;
+	}
+
+	void Document::Write(AssetStreamWriter& Writer) const
+	{
+		Info Info = { .NumEntities = NumEntities };
+		Writer.AddSection(InfoSectionId, &Info, sizeof(Info));
+		Writer.AddSection(CameraSectionId, &Camera, sizeof(Camera));
+		Writer.AddSection(StringSectionId, Strings.data(), Strings.size());
+		Writer.AddSection(ImageSectionId, Images);
+		Writer.AddSection(MeshSectionId, Meshes);
+
+		WriteColumn(Writer, TagSectionIds, Tags);
+		WriteColumn(Writer, TransformSectionIds, Transforms);
+		WriteColumn(Writer, MeshFilterSectionIds, MeshFilters);
+		WriteColumn(Writer, MeshRendererSectionIds, MeshRenderers);
+		WriteColumn(Writer, LightSectionIds, Lights);
+	}
+
+	bool Document::Read(const AssetStreamReader& Reader)
+	{
+		auto InfoSection = Reader.GetSection<Info>(InfoSectionId);
+		auto CameraSection = Reader.GetSection<CameraRecord>(CameraSectionId);
+		if (InfoSection.size() != 1 || CameraSection.size() != 1)
+		{
+			return false;
+		}
+
+		NumEntities = InfoSection[0].NumEntities;
+		Camera = CameraSection[0];
+
+		auto StringSection = Reader.GetSection<char>(StringSectionId);
+		Strings.assign(StringSection.begin(), StringSection.end());
+
+		if (!Reader.ReadSection(ImageSectionId, Images) ||
+			!Reader.ReadSection(MeshSectionId, Meshes) ||
+			!ReadColumn(Reader, TagSectionIds, NumEntities, Tags) ||
+			!ReadColumn(Reader, TransformSectionIds, NumEntities, Transforms) ||
+			!ReadColumn(Reader, MeshFilterSectionIds, NumEntities, MeshFilters) ||
+			!ReadColumn(Reader, MeshRendererSectionIds, NumEntities, MeshRenderers) ||
+			!ReadColumn(Reader, LightSectionIds, NumEntities, Lights))
+		{
+			return false;
+		}
+
+		if (!std::all_of(Images.begin(), Images.end(), [&](const ImageRecord& Image) { return size_t(Image.Path.Offset) + Image.Path.Length <= Strings.size(); }) ||
+			!std::all_of(Meshes.begin(), Meshes.end(), [&](const MeshRecord& Mesh) { return size_t(Mesh.Path.Offset) + Mesh.Path.Length <= Strings.size(); }))
+		{
+			return false;
+		}
+
+		ImageIndices.clear();
+		for (auto [i, Image] : enumerate(Images))
+		{
+			ImageIndices.emplace(GetAssetKey(GetString(Image.Path)), static_cast<uint32_t>(i));
+		}
+		MeshIndices.clear();
+		for (auto [i, Mesh] : enumerate(Meshes))
+		{
+			MeshIndices.emplace(GetAssetKey(GetString(Mesh.Path)), static_cast<uint32_t>(i));
+		}
+
+		return true;
+	}
+
+	bool Document::Save(const std::filesystem::path& Path) const
+	{
+		AssetStreamWriter Writer(Version);
+		Write(Writer);
+		return Writer.Write(Path);
+	}
+
+	bool Document::Load(const std::filesystem::path& Path)
+	{
+		AssetStreamReader Reader;
+		return Reader.Open(Path, Version) && Read(Reader);
+	}
+
+	UINT64 GetAssetKey(std::string_view Path)
+	{
+		// Scenes store paths relative to the executable folder, the caches are keyed by the absolute path
+		const auto path = (Application::ExecutableFolderPath / Path).string();
+		return entt::hashed_string(path.data());
+	}
+
+	CameraRecord MakeRecord(const Camera& Camera)
+	{
+		return
+		{
+			.Position = Camera.Transform.Position,
+			.Scale = Camera.Transform.Scale,
+			.Orientation = Camera.Transform.Orientation,
+			.FoVY = Camera.FoVY,
+			.NearZ = Camera.NearZ,
+			.FarZ = Camera.FarZ,
+			.FocalLength = Camera.FocalLength,
+			.RelativeAperture = Camera.RelativeAperture,
+			.ShutterTime = Camera.ShutterTime,
+			.SensorSensitivity = Camera.SensorSensitivity
+		};
+	}
+
+	TransformRecord MakeRecord(const Transform& Transform)
+	{
+		return
+		{
+			.Position = Transform.Position,
+			.Scale = Transform.Scale,
+			.Orientation = Transform.Orientation
+		};
+	}
+
+	MeshRendererRecord MakeRecord(const Material& Material)
+	{
+		MeshRendererRecord Record =
+		{
+			.BSDFType = Material.BSDFType,
+			.baseColor = Material.baseColor,
+			.metallic = Material.metallic,
+			.subsurface = Material.subsurface,
+			.specular = Material.specular,
+			.roughness = Material.roughness,
+			.specularTint = Material.specularTint,
+			.anisotropic = Material.anisotropic,
+			.sheen = Material.sheen,
+			.sheenTint = Material.sheenTint,
+			.clearcoat = Material.clearcoat,
+			.clearcoatGloss = Material.clearcoatGloss,
+			.T = Material.T,
+			.etaA = Material.etaA,
+			.etaB = Material.etaB,
+			.emissive = Material.emissive
+		};
+		std::fill(std::begin(Record.Textures), std::end(Record.Textures), InvalidIndex);
+		return Record;
+	}
+
+	LightRecord MakeRecord(const Light& Light)
+	{
+		return
+		{
+			.Type = static_cast<uint32_t>(Light.Type),
+			.I = Light.I,
+			.Width = Light.Width,
+			.Height = Light.Height,
+			.Texture = InvalidIndex
+		};
+	}
+
+	void Apply(const CameraRecord& Record, Camera& Camera)
+	{
+		Camera.Transform.Position = Record.Position;
+		Camera.Transform.Scale = Record.Scale;
+		Camera.Transform.Orientation = Record.Orientation;
+		Camera.FoVY = Record.FoVY;
+		Camera.AspectRatio = 1.0f;
+		Camera.NearZ = Record.NearZ;
+		Camera.FarZ = Record.FarZ;
+		Camera.FocalLength = Record.FocalLength;
+		Camera.RelativeAperture = Record.RelativeAperture;
+		Camera.ShutterTime = Record.ShutterTime;
+		Camera.SensorSensitivity = Record.SensorSensitivity;
+	}
+
+	void Apply(const TransformRecord& Record, Transform& Transform)
+	{
+		Transform.Position = Record.Position;
+		Transform.Scale = Record.Scale;
+		Transform.Orientation = Record.Orientation;
+	}
+
+	void Apply(const MeshRendererRecord& Record, Material& Material)
+	{
+		Material.BSDFType = Record.BSDFType;
+		Material.baseColor = Record.baseColor;
+		Material.metallic = Record.metallic;
+		Material.subsurface = Record.subsurface;
+		Material.specular = Record.specular;
+		Material.roughness = Record.roughness;
+		Material.specularTint = Record.specularTint;
+		Material.anisotropic = Record.anisotropic;
+		Material.sheen = Record.sheen;
+		Material.sheenTint = Record.sheenTint;
+		Material.clearcoat = Record.clearcoat;
+		Material.clearcoatGloss = Record.clearcoatGloss;
+		Material.T = Record.T;
+		Material.etaA = Record.etaA;
+		Material.etaB = Record.etaB;
+		Material.emissive = Record.emissive;
+	}
+
+	void Apply(const LightRecord& Record, Light& Light)
+	{
+		Light.Type = static_cast<LightType>(Record.Type);
+		Light.I = Record.I;
+		Light.Width = Record.Width;
+		Light.Height = Record.Height;
+	}
+
+	void CaptureEntities(Scene* pScene, Document& Document)
+	{
+		Document.Camera = MakeRecord(pScene->Camera);
+
+		pScene->Registry.each([&](auto Handle)
+		{
+			Entity entity(Handle, pScene);
+			if (!entity)
+			{
+				return;
+			}
+
+			const uint32_t index = Document.NumEntities++;
+			if (entity.HasComponent<Tag>())
+			{
+				Document.Tags.Add(index, Document.AddString(entity.GetComponent<Tag>().Name));
+			}
+			if (entity.HasComponent<Transform>())
+			{
+				Document.Transforms.Add(index, MakeRecord(entity.GetComponent<Transform>()));
+			}
+			if (entity.HasComponent<MeshFilter>())
+			{
+				Document.MeshFilters.Add(index, { .Mesh = Document.FindMesh(entity.GetComponent<MeshFilter>().Key) });
+			}
+			if (entity.HasComponent<MeshRenderer>())
+			{
+				const auto& material = entity.GetComponent<MeshRenderer>().Material;
+
+				MeshRendererRecord record = MakeRecord(material);
+				for (int i = 0; i < TextureTypes::NumTextureTypes; ++i)
+				{
+					record.Textures[i] = Document.FindImage(material.TextureKeys[i]);
+				}
+				Document.MeshRenderers.Add(index, record);
+			}
+			if (entity.HasComponent<Light>())
+			{
+				const auto& light = entity.GetComponent<Light>();
+
+				LightRecord record = MakeRecord(light);
+				record.Texture = Document.FindImage(light.TextureKey);
+				Document.Lights.Add(index, record);
+			}
+		});
+	}
+
+	Document Capture(Scene* pScene)
+	{
+		auto& AssetManager = AssetManager::Instance();
+
+		Document Document;
+
+		// Sorted by path like the YAML format so saving the same scene twice gives the same file
+		std::map<std::string, std::pair<UINT64, AssetHandle<Asset::Image>>> sortedImages;
+		AssetManager.GetImageCache().Each_ThreadSafe([&](UINT64 Key, AssetHandle<Asset::Image> Resource)
+		{
+			sortedImages.insert({ Resource->Metadata.Path.string(), { Key, Resource } });
+		});
+		for (const auto& [path, image] : sortedImages)
+		{
+			const auto& [key, resource] = image;
+			Document.AddImage(key, std::filesystem::relative(path, Application::ExecutableFolderPath).string(), resource->Metadata.sRGB);
+		}
+
+		std::map<std::string, std::pair<UINT64, AssetHandle<Asset::Mesh>>> sortedMeshes;
+		AssetManager.GetMeshCache().Each_ThreadSafe([&](UINT64 Key, AssetHandle<Asset::Mesh> Resource)
+		{
+			sortedMeshes.insert({ Resource->Metadata.Path.string(), { Key, Resource } });
+		});
+		for (const auto& [path, mesh] : sortedMeshes)
+		{
+			const auto& [key, resource] = mesh;
+			MeshRecord metadata =
+			{
+				.KeepGeometryInRAM = resource->Metadata.KeepGeometryInRAM,
+				.QuantizeVertices = resource->Metadata.QuantizeVertices,
+				.GenerateLODs = resource->Metadata.GenerateLODs,
+				.OptimizeMesh = resource->Metadata.OptimizeMesh
+			};
+			Document.AddMesh(key, std::filesystem::relative(path, Application::ExecutableFolderPath).string(), metadata);
+		}
+
+		CaptureEntities(pScene, Document);
+		return Document;
+	}
+
+	// Inserts one component per record of the column, every component type goes into the registry in one go
+	template<IsAComponent T, typename TRecord, typename Function>
+	static void InsertComponents(Scene* pScene, std::span<const entt::entity> Entities, const Column<TRecord>& Column, Function Assign)
+	{
+		std::vector<entt::entity> handles(Column.Entities.size());
+		std::transform(Column.Entities.begin(), Column.Entities.end(), handles.begin(), [&](uint32_t Entity)
+		{
+			return Entities[Entity];
+		});
+
+		pScene->Registry.insert<T>(handles.begin(), handles.end());
+		for (size_t i = 0; i < handles.size(); ++i)
+		{
+			auto& component = pScene->Registry.get<T>(handles[i]);
+			component.Handle = handles[i];
+			component.pScene = pScene;
+			component.IsEdited = true;
+			Assign(component, Column.Records[i]);
+		}
+	}
+
+	void RestoreEntities(const Document& Document, Scene* pScene)
+	{
+		Camera camera = {};
+		Apply(Document.Camera, camera);
+		pScene->Camera = camera;
+		pScene->PreviousCamera = camera;
+
+		std::vector<UINT64> imageKeys(Document.Images.size());
+		for (auto [i, image] : enumerate(Document.Images))
+		{
+			imageKeys[i] = GetAssetKey(Document.GetString(image.Path));
+		}
+
+		std::vector<UINT64> meshKeys(Document.Meshes.size());
+		for (auto [i, mesh] : enumerate(Document.Meshes))
+		{
+			meshKeys[i] = GetAssetKey(Document.GetString(mesh.Path));
+		}
+
+		std::vector<entt::entity> entities(Document.NumEntities);
+		pScene->Registry.create(entities.begin(), entities.end());
+
+		InsertComponents<Tag>(pScene, entities, Document.Tags, [&](Tag& Tag, const StringRef& Record)
+		{
+			Tag.Name = Document.GetString(Record);
+		});
+
+		InsertComponents<Transform>(pScene, entities, Document.Transforms, [](Transform& Transform, const TransformRecord& Record)
+		{
+			Apply(Record, Transform);
+		});
+
+		InsertComponents<MeshFilter>(pScene, entities, Document.MeshFilters, [&](MeshFilter& MeshFilter, const MeshFilterRecord& Record)
+		{
+			if (Record.Mesh < meshKeys.size())
+			{
+				MeshFilter.Key = meshKeys[Record.Mesh];
+			}
+		});
+
+		InsertComponents<MeshRenderer>(pScene, entities, Document.MeshRenderers, [&](MeshRenderer& MeshRenderer, const MeshRendererRecord& Record)
+		{
+			Apply(Record, MeshRenderer.Material);
+			for (int i = 0; i < TextureTypes::NumTextureTypes; ++i)
+			{
+				if (Record.Textures[i] < imageKeys.size())
+				{
+					MeshRenderer.Material.TextureKeys[i] = imageKeys[Record.Textures[i]];
+				}
+			}
+		});
+
+		InsertComponents<Light>(pScene, entities, Document.Lights, [&](Light& Light, const LightRecord& Record)
+		{
+			Apply(Record, Light);
+			if (Record.Texture < imageKeys.size())
+			{
+				Light.TextureKey = imageKeys[Record.Texture];
+			}
+		});
+
+		// Inserting in bulk skips Scene::OnComponentAdded, connect the mesh renderers to their mesh filters here
+		for (auto [handle, meshFilter, meshRenderer] : pScene->Registry.view<MeshFilter, MeshRenderer>().each())
+		{
+			meshRenderer.pMeshFilter = &meshFilter;
+		}
+	}
+
+	void Restore(const Document& Document, Scene* pScene)
+	{
+		auto& AssetManager = AssetManager::Instance();
+
+		pScene->Clear();
+		AssetManager.GetImageCache().DestroyAll();
+		AssetManager.GetMeshCache().DestroyAll();
+		AssetManager.Mount(nullptr);
+
+		for (const auto& image : Document.Images)
+		{
+			AssetManager.AsyncLoadImage(Application::ExecutableFolderPath / Document.GetString(image.Path), image.sRGB);
+		}
+
+		for (const auto& mesh : Document.Meshes)
+		{
+			AssetManager.AsyncLoadMesh(Application::ExecutableFolderPath / Document.GetString(mesh.Path), mesh.KeepGeometryInRAM, mesh.QuantizeVertices, mesh.GenerateLODs, mesh.OptimizeMesh);
+		}
+
+		RestoreEntities(Document, pScene);
+	}
+}
+
+void BinarySceneParser::Save(const std::filesystem::path& Path, Scene* pScene)
+{
+	if (!BinaryScene::Capture(pScene).Save(Path))
+	{
+		LOG_ERROR("Failed to save {}", Path.string());
+	}
+}
+
+void BinarySceneParser::Load(const std::filesystem::path& Path, Scene* pScene)
+{
+	BinaryScene::Document document;
+	if (!document.Load(Path))
+	{
+		throw std::exception("Invalid file");
+	}
+
+	BinaryScene::Restore(document, pScene);
+}
+
+#if defined(_DEBUG)
+void BinarySceneParser::Benchmark(size_t NumEntities, Scene* pScene)
+{
+	std::mt19937 generator(0);
+	std::uniform_real_distribution<float> distribution(0.0f, 1.0f);
+
+	pScene->Clear();
+	for (size_t i = 0; i < NumEntities; ++i)
+	{
+		Entity entity = pScene->CreateEntity("Entity " + std::to_string(i));
+
+		auto& transform = entity.GetComponent<Transform>();
+		transform.Position = { distribution(generator) * 100.0f, distribution(generator) * 100.0f, distribution(generator) * 100.0f };
+
+		// Mostly renderables with the occasional light, roughly what large scenes look like
+		if (i % 16 == 0)
+		{
+			auto& light = entity.AddComponent<Light>();
+			light.Type = QuadLight;
+			light.I = { distribution(generator), distribution(generator), distribution(generator) };
+		}
+		else
+		{
+			entity.AddComponent<MeshFilter>();
+			auto& meshRenderer = entity.AddComponent<MeshRenderer>();
+			meshRenderer.Material.baseColor = { distribution(generator), distribution(generator), distribution(generator) };
+			meshRenderer.Material.roughness = distribution(generator);
+			meshRenderer.Material.metallic = distribution(generator);
+		}
+	}
+
+	const auto folder = std::filesystem::temp_directory_path();
+	const auto yamlPath = folder / "Benchmark.yaml";
+	const auto binaryPath = folder / ("Benchmark" + std::string(BinaryScene::Extension));
+
+	auto Measure = [](auto Function)
+	{
+		const auto start = std::chrono::high_resolution_clock::now();
+		Function();
+		const auto stop = std::chrono::high_resolution_clock::now();
+		return std::chrono::duration_cast<std::chrono::milliseconds>(stop - start).count();
+	};
+
+	const auto yamlSave = Measure([&] { SceneParser::Save(yamlPath, pScene); });
+	const auto binarySave = Measure([&] { Save(binaryPath, pScene); });
+	const auto yamlLoad = Measure([&] { SceneParser::Load(yamlPath, pScene); });
+	const auto binaryLoad = Measure([&] { Load(binaryPath, pScene); });
+
+	std::error_code ec;
+	LOG_INFO("{} entities, YAML: saved in {}(ms), loaded in {}(ms), {}(KiB). Binary: saved in {}(ms), loaded in {}(ms), {}(KiB)",
+		NumEntities,
+		yamlSave, yamlLoad, ToKiB(std::filesystem::file_size(yamlPath, ec)),
+		binarySave, binaryLoad, ToKiB(std::filesystem::file_size(binaryPath, ec)));
+}
+#endif
@@ -0,0 +1,196 @@
+#pragma once
+#include <filesystem>
+#include <string_view>
+
+#include "Components/Transform.h"
+#include "Components/MeshRenderer.h"
+#include "Components/Light.h"
+#include "Camera.h"
+
+struct Scene;
+class AssetStreamWriter;
+class AssetStreamReader;
+
+/*
+* Compact binary alternative to the YAML scene format. The scene is an AssetStream with one column of records per
+* component type, every column is paired with a column of entity indices. Loading creates every entity at once and
+* inserts each component type into the registry in bulk instead of walking a YAML node tree per entity.
+* Assets are referenced by index into the image and mesh tables, which hold the same paths and import options the
+* YAML format does.
+*/
+namespace BinaryScene
+{
+	inline constexpr uint32_t Version = 4; // 2 added MeshRendererRecord::emissive, 3 added LightRecord::Texture, 4 added MeshRecord::OptimizeMesh
+	inline constexpr std::string_view Extension = ".kscene";
+
+	inline constexpr uint32_t InvalidIndex = UINT32_MAX;
+
+	struct StringRef
+	{
+		uint32_t Offset;
+		uint32_t Length;
+	};
+
+	struct CameraRecord
+	{
+		DirectX::XMFLOAT3 Position;
+		DirectX::XMFLOAT3 Scale;
+		DirectX::XMFLOAT4 Orientation;
+		float FoVY;
+		float NearZ;
+		float FarZ;
+		float FocalLength;
+		float RelativeAperture;
+		float ShutterTime;
+		float SensorSensitivity;
+	};
+
+	struct ImageRecord
+	{
+		StringRef Path; // Relative to Application::ExecutableFolderPath
+		uint32_t sRGB;
+	};
+
+	struct MeshRecord
+	{
+		StringRef Path; // Relative to Application::ExecutableFolderPath
+		uint32_t KeepGeometryInRAM;
+		uint32_t QuantizeVertices;
+		uint32_t GenerateLODs;
+		uint32_t OptimizeMesh;
+	};
+
+	struct TransformRecord
+	{
+		DirectX::XMFLOAT3 Position;
+		DirectX::XMFLOAT3 Scale;
+		DirectX::XMFLOAT4 Orientation;
+	};
+
+	struct MeshFilterRecord
+	{
+		uint32_t Mesh; // Into the mesh table, InvalidIndex if there is none
+	};
+
+	struct MeshRendererRecord
+	{
+		int BSDFType;
+		DirectX::XMFLOAT3 baseColor;
+		float metallic;
+		float subsurface;
+		float specular;
+		float roughness;
+		float specularTint;
+		float anisotropic;
+		float sheen;
+		float sheenTint;
+		float clearcoat;
+		float clearcoatGloss;
+		DirectX::XMFLOAT3 T;
+		float etaA;
+		float etaB;
+		DirectX::XMFLOAT3 emissive;
+		uint32_t Textures[NumTextureTypes]; // Into the image table, InvalidIndex if there is none
+	};
+
+	struct LightRecord
+	{
+		uint32_t Type;
+		DirectX::XMFLOAT3 I;
+		float Width;
+		float Height;
+		uint32_t Texture; // Into the image table, InvalidIndex if there is none
+	};
+
+	template<typename T>
+	struct Column
+	{
+		std::vector<uint32_t> Entities; // Index of the entity every record belongs to, ascending
+		std::vector<T> Records;
+
+		void Add(uint32_t Entity, const T& Record)
+		{
+			Entities.push_back(Entity);
+			Records.push_back(Record);
+		}
+	};
+
+	// In memory form of a binary scene, also used to convert between the YAML and the binary format
+	struct Document
+	{
+		uint32_t NumEntities = 0;
+		CameraRecord Camera = {};
+
+		std::vector<ImageRecord> Images;
+		std::vector<MeshRecord> Meshes;
+
+		Column<StringRef> Tags;
+		Column<TransformRecord> Transforms;
+		Column<MeshFilterRecord> MeshFilters;
+		Column<MeshRendererRecord> MeshRenderers;
+		Column<LightRecord> Lights;
+
+		std::string Strings;
+
+		StringRef AddString(std::string_view String);
+		[[nodiscard]] std::string_view GetString(StringRef String) const;
+
+		// Returns the index of the image or mesh with the given asset cache key, adds it if it is not in the table yet
+		uint32_t AddImage(UINT64 Key, std::string_view Path, bool sRGB);
+		uint32_t AddMesh(UINT64 Key, std::string_view Path, const MeshRecord& Metadata);
+
+		// Returns the index of the image or mesh by asset cache key, InvalidIndex if it is not in the table
+		[[nodiscard]] uint32_t FindImage(UINT64 Key) const;
+		[[nodiscard]] uint32_t FindMesh(UINT64 Key) const;
+
+		void Write(AssetStreamWriter& Writer) const;
+		bool Read(const AssetStreamReader& Reader);
+
+		bool Save(const std::filesystem::path& Path) const;
+		bool Load(const std::filesystem::path& Path);
+	private:
+		std::unordered_map<UINT64, uint32_t> ImageIndices;
+		std::unordered_map<UINT64, uint32_t> MeshIndices;
+	};
+
+	// Returns the asset cache key of an asset path relative to Application::ExecutableFolderPath
+	UINT64 GetAssetKey(std::string_view Path);
+
+	// Conversions between components and records, records of materials leave the textures to the caller
+	CameraRecord MakeRecord(const Camera& Camera);
+	TransformRecord MakeRecord(const Transform& Transform);
+	MeshRendererRecord MakeRecord(const Material& Material);
+	LightRecord MakeRecord(const Light& Light);
+
+	void Apply(const CameraRecord& Record, Camera& Camera);
+	void Apply(const TransformRecord& Record, Transform& Transform);
+	void Apply(const MeshRendererRecord& Record, Material& Material);
+	void Apply(const LightRecord& Record, Light& Light);
+
+	// Captures the camera and the entities of the scene, components reference assets through the image and mesh
+	// tables of the document which must be populated first. References to assets that are not in them are dropped
+	void CaptureEntities(Scene* pScene, Document& Document);
+
+	// Captures the scene and every asset in the asset caches
+	Document Capture(Scene* pScene);
+
+	// Creates the camera and the entities of the document in an empty scene without requesting any asset
+	void RestoreEntities(const Document& Document, Scene* pScene);
+
+	// Replaces the scene with the document and requests every asset it references
+	void Restore(const Document& Document, Scene* pScene);
+}
+
+class BinarySceneParser
+{
+public:
+	static void Save(const std::filesystem::path& Path, Scene* pScene);
+
+	static void Load(const std::filesystem::path& Path, Scene* pScene);
+
+#if defined(_DEBUG)
+	// Fills the scene with NumEntities synthetic entities and logs how long saving and loading them takes
+	// with the YAML and the binary format, the scene is left with the entities loaded from the binary format
+	static void Benchmark(size_t NumEntities, Scene* pScene);
+#endif
+};
@@ -1,11 +1,15 @@
 #pragma once
 #include "Component.h"
 #include "../../SharedDefines.h"
+#include "../../Asset/Image.h"
+#include "../../Asset/AssetCache.h"
 
 enum LightType
 {
 	PointLight,
 	QuadLight,
+	EnvironmentLight, // Equirectangular HDR image around the scene, I scales its radiance
+	MeshLight, // Made by the renderers for instances with an emissive material, never a component
 };
 
 struct Light : Component
@@ -21,4 +25,8 @@ struct Light : Component
 
 	float3 I;
 	float Width, Height;
-};
\ No newline at end of file
+
+	// Image of environment lights, only the first environment light with a loaded image is rendered
+	UINT64 TextureKey = 0;
+	AssetHandle<Asset::Image> Texture;
+};
@@ -35,6 +35,7 @@ struct Material
 		{
 			TextureIndices[i] = -1;
 			TextureChannel[i] = 0;
+			TextureMinLOD[i] = 0.0f;
 
 			TextureKeys[i] = 0;
 		}
@@ -58,8 +59,11 @@ struct Material
 	float etaA = 1.000277f; // air
 	float etaB = 1.5046f; // glass
 
+	float3 emissive = { 0, 0, 0 }; // Radiance leaving both sides of every triangle, emissive instances become mesh lights
+
 	int TextureIndices[NumTextureTypes];
 	int TextureChannel[NumTextureTypes];
+	float TextureMinLOD[NumTextureTypes];
 
 	UINT64 TextureKeys[NumTextureTypes];
 	AssetHandle<Asset::Image> Textures[NumTextureTypes];
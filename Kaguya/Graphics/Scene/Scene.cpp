@@ -49,7 +49,14 @@ void Scene::Update()
 				SceneState = SCENE_STATE_UPDATED;
 			}
 
-			meshFilter.Mesh = AssetManager::Instance().GetMeshCache().Load(meshFilter.Key);
+			// Changes when the mesh finishes loading or is hot reloaded, only then does the accumulation reset
+			auto Mesh = AssetManager::Instance().GetMeshCache().Load(meshFilter.Key);
+			if (meshFilter.Mesh != Mesh)
+			{
+				meshFilter.Mesh = Mesh;
+
+				SceneState = SCENE_STATE_UPDATED;
+			}
 		}
 	}
 
@@ -75,8 +82,22 @@ void Scene::Update()
 
 				if (Texture)
 				{
+					if (meshRenderer.Material.Textures[i] != Texture)
+					{
+						SceneState = SCENE_STATE_UPDATED;
+					}
+
 					meshRenderer.Material.Textures[i] = Texture;
 					meshRenderer.Material.TextureIndices[i] = Texture->SRV.Index;
+
+					// Texture got refined by the streamer
+					float MinLOD = static_cast<float>(Texture->MostDetailedMip);
+					if (meshRenderer.Material.TextureMinLOD[i] != MinLOD)
+					{
+						meshRenderer.Material.TextureMinLOD[i] = MinLOD;
+
+						SceneState = SCENE_STATE_UPDATED;
+					}
 				}
 			}
 		}
@@ -93,6 +114,15 @@ void Scene::Update()
 
 				SceneState = SCENE_STATE_UPDATED;
 			}
+
+			// Changes when the image finishes loading, the environment map is built by then
+			auto Texture = AssetManager::Instance().GetImageCache().Load(light.TextureKey);
+			if (light.Texture != Texture)
+			{
+				light.Texture = Texture;
+
+				SceneState = SCENE_STATE_UPDATED;
+			}
 		}
 	}
 
@@ -22,7 +22,9 @@ struct Scene
 	};
 
 	static constexpr UINT64 MAX_MATERIAL_SUPPORTED = 1000;
-	static constexpr UINT64 MAX_LIGHT_SUPPORTED = 100;
+	static constexpr UINT64 MAX_LIGHT_SUPPORTED = 4096;
+	static constexpr UINT64 MAX_EMISSIVE_TRIANGLE_SUPPORTED = 262144; // Of all mesh lights
+	static constexpr UINT64 MAX_ENVIRONMENT_CDF_SUPPORTED = 1025 * 1025; // Of an environment distribution at most 1024 texels wide and high
 	static constexpr UINT64 MAX_INSTANCE_SUPPORTED = 1000;
 
 	Scene();
@@ -77,7 +79,17 @@ inline HLSL::Material GetHLSLMaterialDesc(const Material& Material)
 			Material.TextureChannel[1],
 			Material.TextureChannel[2],
 			Material.TextureChannel[3]
-		}
+		},
+		.TextureMinLOD =
+		{
+			Material.TextureMinLOD[0],
+			Material.TextureMinLOD[1],
+			Material.TextureMinLOD[2],
+			Material.TextureMinLOD[3]
+		},
+
+		.emissive = Material.emissive,
+		.LightIndex = -1
 	};
 }
 
@@ -1,13 +1,19 @@
 #include "pch.h"
 #include "SceneParser.h"
+#include "BinarySceneParser.h"
 
 #include "Scene.h"
 #include "Entity.h"
 
 #include <fstream>
 #include <yaml-cpp/yaml.h>
+#include <yaml-cpp/eventhandler.h>
 
 #include "../AssetManager.h"
+#include "../Asset/MeshStream.h"
+#include "../Asset/IndexPacking.h"
+#include "../Asset/AsyncLoader.h"
+#include "../CPU/BVH.h"
 
 namespace Version
 {
@@ -70,66 +76,80 @@ YAML::Emitter& operator<<(YAML::Emitter& Emitter, const Transform& Transform)
 	return Emitter;
 }
 
-template<>
-YAML::Emitter& operator<<(YAML::Emitter& Emitter, const MeshFilter& MeshFilter)
+static void SerializeMeshFilter(YAML::Emitter& Emitter, const std::string& MeshPath)
 {
 	Emitter << YAML::Key << "Mesh Filter";
 	Emitter << YAML::BeginMap;
 	{
-		std::string relativePath = MeshFilter.Mesh ? std::filesystem::relative(MeshFilter.Mesh->Metadata.Path, Application::ExecutableFolderPath).string() : "NULL";
-
-		Emitter << YAML::Key << "Name" << relativePath;
+		Emitter << YAML::Key << "Name" << MeshPath;
 	}
 	Emitter << YAML::EndMap;
-	return Emitter;
 }
 
 template<>
-YAML::Emitter& operator<<(YAML::Emitter& Emitter, const MeshRenderer& MeshRenderer)
+YAML::Emitter& operator<<(YAML::Emitter& Emitter, const MeshFilter& MeshFilter)
+{
+	std::string relativePath = MeshFilter.Mesh ? std::filesystem::relative(MeshFilter.Mesh->Metadata.Path, Application::ExecutableFolderPath).string() : "NULL";
+
+	SerializeMeshFilter(Emitter, relativePath);
+	return Emitter;
+}
+
+static void SerializeMeshRenderer(YAML::Emitter& Emitter, const Material& Material, const std::string (&TexturePaths)[TextureTypes::NumTextureTypes])
 {
 	Emitter << YAML::Key << "Mesh Renderer";
 	Emitter << YAML::BeginMap;
 	{
-		auto& material = MeshRenderer.Material;
 		Emitter << YAML::Key << "Material";
 		Emitter << YAML::BeginMap;
 		{
-			Emitter << YAML::Key << "BSDFType" << material.BSDFType;
-
-			Emitter << YAML::Key << "baseColor" << material.baseColor;
-			Emitter << YAML::Key << "metallic" << material.metallic;
-			Emitter << YAML::Key << "subsurface" << material.subsurface;
-			Emitter << YAML::Key << "specular" << material.specular;
-			Emitter << YAML::Key << "roughness" << material.roughness;
-			Emitter << YAML::Key << "specularTint" << material.specularTint;
-			Emitter << YAML::Key << "anisotropic" << material.anisotropic;
-			Emitter << YAML::Key << "sheen" << material.sheen;
-			Emitter << YAML::Key << "sheenTint" << material.sheenTint;
-			Emitter << YAML::Key << "clearcoat" << material.clearcoat;
-			Emitter << YAML::Key << "clearcoatGloss" << material.clearcoatGloss;
-
-			Emitter << YAML::Key << "T" << material.T;
-			Emitter << YAML::Key << "etaA" << material.etaA;
-			Emitter << YAML::Key << "etaB" << material.etaB;
+			Emitter << YAML::Key << "BSDFType" << Material.BSDFType;
+
+			Emitter << YAML::Key << "baseColor" << Material.baseColor;
+			Emitter << YAML::Key << "metallic" << Material.metallic;
+			Emitter << YAML::Key << "subsurface" << Material.subsurface;
+			Emitter << YAML::Key << "specular" << Material.specular;
+			Emitter << YAML::Key << "roughness" << Material.roughness;
+			Emitter << YAML::Key << "specularTint" << Material.specularTint;
+			Emitter << YAML::Key << "anisotropic" << Material.anisotropic;
+			Emitter << YAML::Key << "sheen" << Material.sheen;
+			Emitter << YAML::Key << "sheenTint" << Material.sheenTint;
+			Emitter << YAML::Key << "clearcoat" << Material.clearcoat;
+			Emitter << YAML::Key << "clearcoatGloss" << Material.clearcoatGloss;
+
+			Emitter << YAML::Key << "T" << Material.T;
+			Emitter << YAML::Key << "etaA" << Material.etaA;
+			Emitter << YAML::Key << "etaB" << Material.etaB;
+
+			Emitter << YAML::Key << "emissive" << Material.emissive;
 
 			const char* textureTypes[TextureTypes::NumTextureTypes] = { "Albedo", "Normal", "Roughness", "Metallic" };
 			for (int i = 0; i < TextureTypes::NumTextureTypes; ++i)
 			{
-				const auto& texture = material.Textures[i];
-
-				std::string relativePath = texture ? std::filesystem::relative(texture->Metadata.Path, Application::ExecutableFolderPath).string() : "NULL";
-
-				Emitter << YAML::Key << textureTypes[i] << relativePath;
+				Emitter << YAML::Key << textureTypes[i] << TexturePaths[i];
 			}
 		}
 		Emitter << YAML::EndMap;
 	}
 	Emitter << YAML::EndMap;
-	return Emitter;
 }
 
 template<>
-YAML::Emitter& operator<<(YAML::Emitter& Emitter, const Light& Light)
+YAML::Emitter& operator<<(YAML::Emitter& Emitter, const MeshRenderer& MeshRenderer)
+{
+	std::string texturePaths[TextureTypes::NumTextureTypes];
+	for (int i = 0; i < TextureTypes::NumTextureTypes; ++i)
+	{
+		const auto& texture = MeshRenderer.Material.Textures[i];
+
+		texturePaths[i] = texture ? std::filesystem::relative(texture->Metadata.Path, Application::ExecutableFolderPath).string() : "NULL";
+	}
+
+	SerializeMeshRenderer(Emitter, MeshRenderer.Material, texturePaths);
+	return Emitter;
+}
+
+static void SerializeLight(YAML::Emitter& Emitter, const Light& Light, const std::string& TexturePath)
 {
 	Emitter << YAML::Key << "Light";
 	Emitter << YAML::BeginMap;
@@ -138,8 +158,16 @@ YAML::Emitter& operator<<(YAML::Emitter& Emitter, const Light& Light)
 		Emitter << YAML::Key << "I" << Light.I;
 		Emitter << YAML::Key << "Width" << Light.Width;
 		Emitter << YAML::Key << "Height" << Light.Height;
+		Emitter << YAML::Key << "Texture" << TexturePath;
 	}
 	Emitter << YAML::EndMap;
+}
+
+template<>
+YAML::Emitter& operator<<(YAML::Emitter& Emitter, const Light& Light)
+{
+	const auto& texture = Light.Texture;
+	SerializeLight(Emitter, Light, texture ? std::filesystem::relative(texture->Metadata.Path, Application::ExecutableFolderPath).string() : "NULL");
 	return Emitter;
 }
 
@@ -245,6 +273,21 @@ static void SerializeCamera(YAML::Emitter& Emitter, const Camera& Camera)
 	Emitter << YAML::EndMap;
 }
 
+static void SerializeImage(YAML::Emitter& Emitter, const std::string& RelativePath, bool sRGB)
+{
+	Emitter << YAML::BeginMap;
+	{
+		Emitter << YAML::Key << "Image" << RelativePath;
+		Emitter << YAML::Key << "Metadata";
+		Emitter << YAML::BeginMap;
+		{
+			Emitter << YAML::Key << "sRGB" << sRGB;
+		}
+		Emitter << YAML::EndMap;
+	}
+	Emitter << YAML::EndMap;
+}
+
 static void SerializeImages(YAML::Emitter& Emitter)
 {
 	auto& ImageCache = AssetManager::Instance().GetImageCache();
@@ -259,22 +302,30 @@ static void SerializeImages(YAML::Emitter& Emitter)
 
 		for (auto& SortedImage : sortedImages)
 		{
-			Emitter << YAML::BeginMap;
-			{
-				Emitter << YAML::Key << "Image" << std::filesystem::relative(SortedImage.second->Metadata.Path, Application::ExecutableFolderPath).string();
-				Emitter << YAML::Key << "Metadata";
-				Emitter << YAML::BeginMap;
-				{
-					Emitter << YAML::Key << "sRGB" << SortedImage.second->Metadata.sRGB;
-				}
-				Emitter << YAML::EndMap;
-			}
-			Emitter << YAML::EndMap;
+			SerializeImage(Emitter, std::filesystem::relative(SortedImage.second->Metadata.Path, Application::ExecutableFolderPath).string(), SortedImage.second->Metadata.sRGB);
 		}
 	}
 	Emitter << YAML::EndSeq;
 }
 
+static void SerializeMesh(YAML::Emitter& Emitter, const std::string& RelativePath, bool KeepGeometryInRAM, bool QuantizeVertices, bool GenerateLODs, bool OptimizeMesh)
+{
+	Emitter << YAML::BeginMap;
+	{
+		Emitter << YAML::Key << "Mesh" << YAML::Value << RelativePath;
+		Emitter << YAML::Key << "Metadata";
+		Emitter << YAML::BeginMap;
+		{
+			Emitter << YAML::Key << "KeepGeometryInRAM" << KeepGeometryInRAM;
+			Emitter << YAML::Key << "QuantizeVertices" << QuantizeVertices;
+			Emitter << YAML::Key << "GenerateLODs" << GenerateLODs;
+			Emitter << YAML::Key << "OptimizeMesh" << OptimizeMesh;
+		}
+		Emitter << YAML::EndMap;
+	}
+	Emitter << YAML::EndMap;
+}
+
 static void SerializeMeshes(YAML::Emitter& Emitter)
 {
 	auto& MeshCache = AssetManager::Instance().GetMeshCache();
@@ -289,17 +340,8 @@ static void SerializeMeshes(YAML::Emitter& Emitter)
 
 		for (auto& SortedMeshe : sortedMeshes)
 		{
-			Emitter << YAML::BeginMap;
-			{
-				Emitter << YAML::Key << "Mesh" << YAML::Value << std::filesystem::relative(SortedMeshe.second->Metadata.Path, Application::ExecutableFolderPath).string();
-				Emitter << YAML::Key << "Metadata";
-				Emitter << YAML::BeginMap;
-				{
-					Emitter << YAML::Key << "KeepGeometryInRAM" << SortedMeshe.second->Metadata.KeepGeometryInRAM;
-				}
-				Emitter << YAML::EndMap;
-			}
-			Emitter << YAML::EndMap;
+			const auto& metadata = SortedMeshe.second->Metadata;
+			SerializeMesh(Emitter, std::filesystem::relative(metadata.Path, Application::ExecutableFolderPath).string(), metadata.KeepGeometryInRAM, metadata.QuantizeVertices, metadata.GenerateLODs, metadata.OptimizeMesh);
 		}
 	}
 	Emitter << YAML::EndSeq;
@@ -331,7 +373,7 @@ static void SerializeEntity(YAML::Emitter& Emitter, Entity Entity)
 	Emitter << YAML::EndMap;
 }
 
-void SceneParser::Save(const std::filesystem::path& Path, Scene* pScene)
+static std::string SerializeScene(const std::filesystem::path& Path, Scene* pScene)
 {
 	YAML::Emitter emitter;
 	emitter << YAML::BeginMap;
@@ -360,11 +402,128 @@ void SceneParser::Save(const std::filesystem::path& Path, Scene* pScene)
 	}
 	emitter << YAML::EndMap;
 
+	return emitter.c_str();
+}
+
+void SceneParser::Save(const std::filesystem::path& Path, Scene* pScene)
+{
+	if (Path.extension() == BinaryScene::Extension)
+	{
+		BinarySceneParser::Save(Path, pScene);
+		return;
+	}
+
 	std::ofstream fout(Path);
-	fout << emitter.c_str();
+	fout << SerializeScene(Path, pScene);
 }
 
-static void DeserializeCamera(const YAML::Node& Node, Scene* pScene)
+static std::vector<BYTE> ReadFileBytes(const std::filesystem::path& Path)
+{
+	std::ifstream fin(Path, std::ios::binary | std::ios::ate);
+	if (!fin)
+	{
+		return {};
+	}
+
+	std::vector<BYTE> bytes(static_cast<size_t>(fin.tellg()));
+	fin.seekg(0);
+	fin.read(reinterpret_cast<char*>(bytes.data()), bytes.size());
+	return fin ? bytes : std::vector<BYTE>();
+}
+
+// Cooked image, taken from the bundle the image was read from when rebaking a bundled scene
+static std::vector<BYTE> BakeImage(const Asset::Image& Image)
+{
+	if (Image.Metadata.Bundle)
+	{
+		auto data = Image.Metadata.Bundle->Find(SceneBundle::AssetType::Image, Image.Metadata.Path);
+		return { data.begin(), data.end() };
+	}
+	return ReadFileBytes(ImageStream::GetCookedPath(Image.Metadata.Path));
+}
+
+// Cooked mesh followed by its BVH, meshes in the mesh cache may have dropped their geometry after upload
+// so the cooked mesh is read back
+static std::vector<BYTE> BakeMesh(const Asset::Mesh& Mesh)
+{
+	if (Mesh.Metadata.Bundle)
+	{
+		auto data = Mesh.Metadata.Bundle->Find(SceneBundle::AssetType::Mesh, Mesh.Metadata.Path);
+		if (!data.empty())
+		{
+			return { data.begin(), data.end() };
+		}
+	}
+
+	Asset::Mesh cookedMesh;
+	cookedMesh.Metadata = Mesh.Metadata;
+	if (!MeshStream::Read(MeshStream::GetCookedPath(Mesh.Metadata.Path), Mesh.Metadata, cookedMesh))
+	{
+		return {};
+	}
+
+	CPU::BVH bvh;
+	if (cookedMesh.Meshlets.empty())
+	{
+		bvh.Build(cookedMesh);
+	}
+	else
+	{
+		bvh.BuildFromMeshlets(cookedMesh);
+	}
+
+	AssetStreamWriter writer(MeshStream::Version);
+	MeshStream::Write(writer, cookedMesh);
+	bvh.Write(writer);
+	return writer.Serialize();
+}
+
+void SceneParser::Bake(const std::filesystem::path& Path, Scene* pScene)
+{
+	const auto start = std::chrono::high_resolution_clock::now();
+
+	auto& AssetManager = AssetManager::Instance();
+
+	SceneBundleWriter writer;
+	writer.SetScene(SerializeScene(Path, pScene));
+
+	size_t numImages = 0, numMeshes = 0;
+	AssetManager.GetImageCache().Each_ThreadSafe([&](UINT64 Key, AssetHandle<Asset::Image> Resource)
+	{
+		auto data = BakeImage(*Resource);
+		if (data.empty())
+		{
+			LOG_WARN("{} is not cooked, it is not baked into the scene bundle", Resource->Metadata.Path.string());
+			return;
+		}
+		writer.AddAsset(SceneBundle::AssetType::Image, Resource->Metadata.Path, std::move(data));
+		numImages++;
+	});
+
+	AssetManager.GetMeshCache().Each_ThreadSafe([&](UINT64 Key, AssetHandle<Asset::Mesh> Resource)
+	{
+		auto data = BakeMesh(*Resource);
+		if (data.empty())
+		{
+			LOG_WARN("{} is not cooked, it is not baked into the scene bundle", Resource->Metadata.Path.string());
+			return;
+		}
+		writer.AddAsset(SceneBundle::AssetType::Mesh, Resource->Metadata.Path, std::move(data));
+		numMeshes++;
+	});
+
+	if (!writer.Write(Path))
+	{
+		LOG_ERROR("Failed to write scene bundle {}", Path.string());
+		return;
+	}
+
+	const auto stop = std::chrono::high_resolution_clock::now();
+	const auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(stop - start);
+	LOG_INFO("{} baked in {}(ms), {} images, {} meshes", Path.string(), duration.count(), numImages, numMeshes);
+}
+
+static Camera DeserializeCamera(const YAML::Node& Node)
 {
 	auto transform = Node["Transform"];
 
@@ -384,8 +543,7 @@ static void DeserializeCamera(const YAML::Node& Node, Scene* pScene)
 	camera.ShutterTime = Node["Shutter Time"].as<float>();
 	camera.SensorSensitivity = Node["Sensor Sensitivity"].as<float>();
 
-	pScene->Camera = camera;
-	pScene->PreviousCamera = camera;
+	return camera;
 }
 
 static void DeserializeImage(const YAML::Node& Node)
@@ -401,17 +559,27 @@ static void DeserializeImage(const YAML::Node& Node)
 	AssetManager.AsyncLoadImage(path, sRGB);
 }
 
+static BinaryScene::MeshRecord DeserializeMeshMetadata(const YAML::Node& Metadata)
+{
+	return
+	{
+		.KeepGeometryInRAM = Metadata["KeepGeometryInRAM"].as<bool>(),
+		// Optional, scenes saved before these import options existed don't have them
+		.QuantizeVertices = Metadata["QuantizeVertices"] ? Metadata["QuantizeVertices"].as<bool>() : false,
+		.GenerateLODs = Metadata["GenerateLODs"] ? Metadata["GenerateLODs"].as<bool>() : false,
+		.OptimizeMesh = Metadata["OptimizeMesh"] ? Metadata["OptimizeMesh"].as<bool>() : false
+	};
+}
+
 static void DeserializeMesh(const YAML::Node& Node)
 {
 	auto& AssetManager = AssetManager::Instance();
 
 	auto path = Node["Mesh"].as<std::string>();
 	path = (Application::ExecutableFolderPath / path).string();
-	auto metadata = Node["Metadata"];
-
-	bool keepGeometryInRAM = metadata["KeepGeometryInRAM"].as<bool>();
+	auto metadata = DeserializeMeshMetadata(Node["Metadata"]);
 
-	AssetManager.AsyncLoadMesh(path, keepGeometryInRAM);
+	AssetManager.AsyncLoadMesh(path, metadata.KeepGeometryInRAM, metadata.QuantizeVertices, metadata.GenerateLODs, metadata.OptimizeMesh);
 }
 
 template<IsAComponent T, typename DeserializeFunction>
@@ -473,6 +641,12 @@ static void DeserializeEntity(const YAML::Node& Node, Scene* pScene)
 		MeshRenderer.Material.etaA = material["etaA"].as<float>();
 		MeshRenderer.Material.etaB = material["etaB"].as<float>();
 
+		// Scenes saved before materials could emit do not have it
+		if (material["emissive"])
+		{
+			MeshRenderer.Material.emissive = material["emissive"].as<DirectX::XMFLOAT3>();
+		}
+
 		const char* textureTypes[TextureTypes::NumTextureTypes] = { "Albedo", "Normal", "Roughness", "Metallic" };
 		for (int i = 0; i < TextureTypes::NumTextureTypes; ++i)
 		{
@@ -492,66 +666,517 @@ static void DeserializeEntity(const YAML::Node& Node, Scene* pScene)
 		Light.I = Node["I"].as<DirectX::XMFLOAT3>();
 		Light.Width = Node["Width"].as<float>();
 		Light.Height = Node["Height"].as<float>();
+
+		// Scenes saved before environment lights do not have it
+		if (Node["Texture"])
+		{
+			auto path = Node["Texture"].as<std::string>();
+			if (path != "NULL")
+			{
+				path = (Application::ExecutableFolderPath / path).string();
+
+				Light.TextureKey = entt::hashed_string(path.data());
+			}
+		}
 	});
 }
 
-void SceneParser::Load(const std::filesystem::path& Path, Scene* pScene)
+static void ValidateScene(const YAML::Node& Data)
 {
-	auto& AssetManager = AssetManager::Instance();
+	if (!Data["Version"])
+	{
+		throw std::exception("Invalid file");
+	}
 
-	pScene->Clear();
-	AssetManager.GetImageCache().DestroyAll();
-	AssetManager.GetMeshCache().DestroyAll();
+	auto version = Data["Version"].as<std::string>();
+	if (version != Version::String)
+	{
+		throw std::exception("Invalid version");
+	}
 
+	if (!Data["Camera"])
+	{
+		throw std::exception("Invalid camera");
+	}
+}
+
+static std::string ReadScene(const std::filesystem::path& Path)
+{
 	std::ifstream fin(Path);
 	std::stringstream ss;
 	ss << fin.rdbuf();
+	return ss.str();
+}
+
+namespace
+{
+	/*
+	* Deserializes a scene while yaml-cpp is still scanning it. Every top level value is built into a node and
+	* deserialized as soon as it ends, except for the top level sequences (Images, Meshes, WorldBegin) whose elements
+	* are deserialized one at a time. Asset loads are issued as their entries are parsed so the asset I/O overlaps
+	* with parsing the rest of the scene instead of waiting for the whole node tree.
+	*/
+	class StreamingSceneParser : public YAML::EventHandler
+	{
+	public:
+		explicit StreamingSceneParser(Scene* pScene)
+			: pScene(pScene)
+		{
+
+		}
+
+		void Parse(std::istream& Stream)
+		{
+			YAML::Parser parser(Stream);
+			if (!parser.HandleNextDocument(*this) || !HasVersion)
+			{
+				throw std::exception("Invalid file");
+			}
+			if (!HasCamera)
+			{
+				throw std::exception("Invalid camera");
+			}
+		}
+
+		void OnDocumentStart(const YAML::Mark& Mark) override
+		{
+
+		}
+
+		void OnDocumentEnd() override
+		{
+
+		}
+
+		void OnNull(const YAML::Mark& Mark, YAML::anchor_t Anchor) override
+		{
+			Complete(YAML::Node(YAML::NodeType::Null));
+		}
+
+		void OnAlias(const YAML::Mark& Mark, YAML::anchor_t Anchor) override
+		{
+			// Scenes are written without anchors
+			throw std::exception("Invalid file");
+		}
+
+		void OnScalar(const YAML::Mark& Mark, const std::string& Tag, YAML::anchor_t Anchor, const std::string& Value) override
+		{
+			Complete(YAML::Node(Value));
+		}
+
+		void OnSequenceStart(const YAML::Mark& Mark, const std::string& Tag, YAML::anchor_t Anchor, YAML::EmitterStyle::value Style) override
+		{
+			Stack.push_back({ .Node = YAML::Node(YAML::NodeType::Sequence), .IsMap = false });
+		}
+
+		void OnSequenceEnd() override
+		{
+			End();
+		}
+
+		void OnMapStart(const YAML::Mark& Mark, const std::string& Tag, YAML::anchor_t Anchor, YAML::EmitterStyle::value Style) override
+		{
+			Stack.push_back({ .Node = YAML::Node(YAML::NodeType::Map), .IsMap = true });
+		}
+
+		void OnMapEnd() override
+		{
+			End();
+		}
+	private:
+		struct Frame
+		{
+			YAML::Node Node;
+			bool IsMap;
+			bool HasKey = false;
+			std::string Key;
+		};
+
+		bool IsTopLevelSequence() const
+		{
+			return Stack.size() == 2 && !Stack[1].IsMap;
+		}
+
+		void End()
+		{
+			Frame frame = std::move(Stack.back());
+			Stack.pop_back();
+
+			if (Stack.empty())
+			{
+				return;
+			}
 
-	auto data = YAML::Load(ss.str());
+			if (Stack.size() > 1 || frame.IsMap)
+			{
+				Complete(frame.Node);
+			}
+			else
+			{
+				// A top level sequence, its elements have already been deserialized
+				Stack[0].HasKey = false;
+			}
+		}
+
+		void Complete(const YAML::Node& Node)
+		{
+			if (Stack.empty())
+			{
+				throw std::exception("Invalid file");
+			}
 
-	if (!data["Version"])
+			Frame& parent = Stack.back();
+			if (Stack.size() == 1)
+			{
+				if (!parent.HasKey)
+				{
+					parent.Key = Node.Scalar();
+					parent.HasKey = true;
+				}
+				else
+				{
+					OnTopLevelValue(parent.Key, Node);
+					parent.HasKey = false;
+				}
+			}
+			else if (IsTopLevelSequence())
+			{
+				OnTopLevelElement(Stack[0].Key, Node);
+			}
+			else if (!parent.IsMap)
+			{
+				parent.Node.push_back(Node);
+			}
+			else if (!parent.HasKey)
+			{
+				parent.Key = Node.Scalar();
+				parent.HasKey = true;
+			}
+			else
+			{
+				parent.Node[parent.Key] = Node;
+				parent.HasKey = false;
+			}
+		}
+
+		void OnTopLevelValue(const std::string& Key, const YAML::Node& Node)
+		{
+			if (Key == "Version")
+			{
+				if (Node.as<std::string>() != Version::String)
+				{
+					throw std::exception("Invalid version");
+				}
+				HasVersion = true;
+				return;
+			}
+
+			if (!HasVersion)
+			{
+				throw std::exception("Invalid file");
+			}
+
+			if (Key == "Camera")
+			{
+				pScene->Camera = DeserializeCamera(Node);
+				pScene->PreviousCamera = pScene->Camera;
+				HasCamera = true;
+			}
+		}
+
+		void OnTopLevelElement(const std::string& Key, const YAML::Node& Node)
+		{
+			if (!HasVersion)
+			{
+				throw std::exception("Invalid file");
+			}
+
+			if (Key == "Images")
+			{
+				DeserializeImage(Node);
+			}
+			else if (Key == "Meshes")
+			{
+				DeserializeMesh(Node);
+			}
+			else if (Key == "WorldBegin")
+			{
+				DeserializeEntity(Node, pScene);
+			}
+		}
+
+		Scene* pScene;
+		std::vector<Frame> Stack; // The scene map followed by the nodes being built
+		bool HasVersion = false;
+		bool HasCamera = false;
+	};
+}
+
+void SceneParser::Load(const std::filesystem::path& Path, Scene* pScene)
+{
+	if (Path.extension() == BinaryScene::Extension)
 	{
-		throw std::exception("Invalid file");
+		BinarySceneParser::Load(Path, pScene);
+		return;
 	}
 
-	auto version = data["Version"].as<std::string>();
-	if (version != Version::String)
+	auto& AssetManager = AssetManager::Instance();
+
+	pScene->Clear();
+	AssetManager.GetImageCache().DestroyAll();
+	AssetManager.GetMeshCache().DestroyAll();
+
+	const auto start = std::chrono::high_resolution_clock::now();
+	const UINT64 numLoadsRequested = AssetManager.GetNumLoadsRequested();
+	const UINT64 numLoadsFinished = AssetManager.GetNumLoadsFinished();
+
+	StreamingSceneParser parser(pScene);
+	if (Path.extension() == SceneBundle::Extension)
 	{
-		throw std::exception("Invalid version");
-	}
+		auto bundle = std::make_shared<SceneBundle>();
+		if (!bundle->Open(Path))
+		{
+			throw std::exception("Invalid scene bundle");
+		}
 
-	auto camera = data["Camera"];
-	if (!camera)
+		std::istringstream stream{ std::string(bundle->GetScene()) };
+		AssetManager.Mount(std::move(bundle));
+		parser.Parse(stream);
+	}
+	else
 	{
-		throw std::exception("Invalid camera");
+		AssetManager.Mount(nullptr);
+
+		std::ifstream stream(Path);
+		parser.Parse(stream);
 	}
 
-	DeserializeCamera(camera, pScene);
+	// Loads of the scene that finished before the parser did overlapped with parsing
+	const auto stop = std::chrono::high_resolution_clock::now();
+	LOG_INFO("{} parsed in {}(ms), {} of the {} asset loads it issued finished while parsing", Path.string(),
+		std::chrono::duration_cast<std::chrono::milliseconds>(stop - start).count(),
+		AssetManager.GetNumLoadsFinished() - numLoadsFinished, AssetManager.GetNumLoadsRequested() - numLoadsRequested);
+}
+
+// Goes through a scene that is never rendered nor registered with the asset manager, components keep referencing
+// assets by key and the keys are resolved against the image and mesh lists of the source scene
+static BinaryScene::Document DeserializeDocument(const YAML::Node& Data)
+{
+	ValidateScene(Data);
+
+	Scene scene;
+	scene.Camera = DeserializeCamera(Data["Camera"]);
 
-	auto images = data["Images"];
-	if (images)
+	BinaryScene::Document document;
+	if (auto images = Data["Images"])
 	{
 		for (auto image : images)
 		{
-			DeserializeImage(image);
+			auto path = image["Image"].as<std::string>();
+			document.AddImage(BinaryScene::GetAssetKey(path), path, image["Metadata"]["sRGB"].as<bool>());
 		}
 	}
 
-	auto meshes = data["Meshes"];
-	if (meshes)
+	if (auto meshes = Data["Meshes"])
 	{
 		for (auto mesh : meshes)
 		{
-			DeserializeMesh(mesh);
+			auto path = mesh["Mesh"].as<std::string>();
+			document.AddMesh(BinaryScene::GetAssetKey(path), path, DeserializeMeshMetadata(mesh["Metadata"]));
 		}
 	}
 
-	auto world = data["WorldBegin"];
-	if (world)
+	if (auto world = Data["WorldBegin"])
 	{
 		for (auto entity : world)
 		{
-			DeserializeEntity(entity, pScene);
+			DeserializeEntity(entity, &scene);
+		}
+	}
+
+	BinaryScene::CaptureEntities(&scene, document);
+	return document;
+}
+
+static std::string SerializeDocument(const std::filesystem::path& Path, const BinaryScene::Document& Document)
+{
+	Scene scene;
+	BinaryScene::RestoreEntities(Document, &scene);
+
+	std::unordered_map<UINT64, std::string> paths;
+	auto GetPath = [&](UINT64 Key) -> std::string
+	{
+		auto iter = paths.find(Key);
+		return iter != paths.end() ? iter->second : "NULL";
+	};
+
+	YAML::Emitter emitter;
+	emitter << YAML::BeginMap;
+	{
+		emitter << YAML::Key << "Version" << YAML::Value << Version::String;
+		emitter << YAML::Key << "Scene" << YAML::Value << Path.filename().string();
+
+		SerializeCamera(emitter, scene.Camera);
+
+		emitter << YAML::Key << "Images" << YAML::Value << YAML::BeginSeq;
+		for (const auto& image : Document.Images)
+		{
+			std::string path(Document.GetString(image.Path));
+			SerializeImage(emitter, path, image.sRGB);
+			paths[BinaryScene::GetAssetKey(path)] = path;
+		}
+		emitter << YAML::EndSeq;
+
+		emitter << YAML::Key << "Meshes" << YAML::Value << YAML::BeginSeq;
+		for (const auto& mesh : Document.Meshes)
+		{
+			std::string path(Document.GetString(mesh.Path));
+			SerializeMesh(emitter, path, mesh.KeepGeometryInRAM, mesh.QuantizeVertices, mesh.GenerateLODs, mesh.OptimizeMesh);
+			paths[BinaryScene::GetAssetKey(path)] = path;
+		}
+		emitter << YAML::EndSeq;
+
+		emitter << YAML::Key << "WorldBegin" << YAML::Value << YAML::BeginSeq;
+		{
+			scene.Registry.each([&](auto Handle)
+			{
+				Entity entity(Handle, &scene);
+				if (!entity)
+				{
+					return;
+				}
+
+				emitter << YAML::BeginMap;
+				{
+					emitter << YAML::Key << "Entity" << YAML::Value << std::to_string(typeid(Entity).hash_code());
+
+					SerializeComponent<Tag>(emitter, entity);
+					SerializeComponent<Transform>(emitter, entity);
+					if (entity.HasComponent<MeshFilter>())
+					{
+						SerializeMeshFilter(emitter, GetPath(entity.GetComponent<MeshFilter>().Key));
+					}
+					if (entity.HasComponent<MeshRenderer>())
+					{
+						const auto& material = entity.GetComponent<MeshRenderer>().Material;
+
+						std::string texturePaths[TextureTypes::NumTextureTypes];
+						for (int i = 0; i < TextureTypes::NumTextureTypes; ++i)
+						{
+							texturePaths[i] = GetPath(material.TextureKeys[i]);
+						}
+						SerializeMeshRenderer(emitter, material, texturePaths);
+					}
+					if (entity.HasComponent<Light>())
+					{
+						const auto& light = entity.GetComponent<Light>();
+						SerializeLight(emitter, light, GetPath(light.TextureKey));
+					}
+				}
+				emitter << YAML::EndMap;
+			});
+		}
+		emitter << YAML::EndSeq;
+	}
+	emitter << YAML::EndMap;
+
+	return emitter.c_str();
+}
+
+void SceneParser::Convert(const std::filesystem::path& Source, const std::filesystem::path& Destination)
+{
+	const auto start = std::chrono::high_resolution_clock::now();
+
+	BinaryScene::Document document;
+	if (Source.extension() == BinaryScene::Extension)
+	{
+		if (!document.Load(Source))
+		{
+			throw std::exception("Invalid file");
 		}
 	}
-}
\ No newline at end of file
+	else
+	{
+		document = DeserializeDocument(YAML::Load(ReadScene(Source)));
+	}
+
+	if (Destination.extension() == BinaryScene::Extension)
+	{
+		if (!document.Save(Destination))
+		{
+			LOG_ERROR("Failed to save {}", Destination.string());
+			return;
+		}
+	}
+	else
+	{
+		std::ofstream fout(Destination);
+		fout << SerializeDocument(Destination, document);
+	}
+
+	const auto stop = std::chrono::high_resolution_clock::now();
+	LOG_INFO("{} converted to {} in {}(ms)", Source.string(), Destination.string(), std::chrono::duration_cast<std::chrono::milliseconds>(stop - start).count());
+}
+
+void SceneParser::MeasureIndexMemory(const std::filesystem::path& Path)
+{
+	const auto start = std::chrono::high_resolution_clock::now();
+
+	BinaryScene::Document document;
+	if (Path.extension() == BinaryScene::Extension)
+	{
+		if (!document.Load(Path))
+		{
+			throw std::exception("Invalid file");
+		}
+	}
+	else
+	{
+		document = DeserializeDocument(YAML::Load(ReadScene(Path)));
+	}
+
+	size_t numMeshes = 0, numSubmeshes = 0, num16BitSubmeshes = 0;
+	size_t unpackedSizeInBytes = 0, packedSizeInBytes = 0, unpackedLODSizeInBytes = 0, packedLODSizeInBytes = 0;
+	for (const auto& record : document.Meshes)
+	{
+		Asset::Mesh mesh;
+		mesh.Metadata =
+		{
+			.Path = Application::ExecutableFolderPath / document.GetString(record.Path),
+			.KeepGeometryInRAM = record.KeepGeometryInRAM != 0,
+			.QuantizeVertices = record.QuantizeVertices != 0,
+			.GenerateLODs = record.GenerateLODs != 0,
+			.OptimizeMesh = record.OptimizeMesh != 0
+		};
+		if (!LoadMesh(mesh.Metadata, mesh))
+		{
+			LOG_WARN("Failed to load {}, it is not measured", mesh.Metadata.Path.string());
+			continue;
+		}
+
+		// Only the submesh indices are uploaded, see AssetManager
+		for (const auto& submesh : mesh.Submeshes)
+		{
+			unpackedSizeInBytes += size_t(submesh.IndexCount) * sizeof(uint32_t);
+			num16BitSubmeshes += submesh.IndexFormat == DXGI_FORMAT_R16_UINT;
+		}
+		for (const auto& lod : mesh.LODs)
+		{
+			unpackedLODSizeInBytes += size_t(lod.IndexCount) * sizeof(uint32_t);
+		}
+		packedSizeInBytes += GetSubmeshIndexSizeInBytes(mesh);
+		packedLODSizeInBytes += mesh.CompactIndices.size() - GetSubmeshIndexSizeInBytes(mesh);
+
+		numMeshes++;
+		numSubmeshes += mesh.Submeshes.size();
+	}
+
+	const auto stop = std::chrono::high_resolution_clock::now();
+	const auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(stop - start);
+	LOG_INFO("{} measured in {}(ms), {} meshes, {} of {} submeshes use 16-bit indices", Path.string(), duration.count(), numMeshes, num16BitSubmeshes, numSubmeshes);
+	LOG_INFO("Index memory: {}(KiB), {}(KiB) with 32-bit indices", ToKiB(packedSizeInBytes), ToKiB(unpackedSizeInBytes));
+	if (unpackedLODSizeInBytes > 0)
+	{
+		LOG_INFO("LOD index memory: {}(KiB), {}(KiB) with 32-bit indices", ToKiB(packedLODSizeInBytes), ToKiB(unpackedLODSizeInBytes));
+	}
+}
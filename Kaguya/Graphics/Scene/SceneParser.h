@@ -6,7 +6,19 @@ struct Scene;
 class SceneParser
 {
 public:
+	// Saves the scene as YAML, or in the binary format if the extension is BinaryScene::Extension
 	static void Save(const std::filesystem::path& Path, Scene* pScene);
 
+	// Loads a scene saved with Save or baked with Bake
 	static void Load(const std::filesystem::path& Path, Scene* pScene);
+
+	// Writes the scene along with every cooked asset it references into a single scene bundle, see SceneBundle
+	static void Bake(const std::filesystem::path& Path, Scene* pScene);
+
+	// Converts a scene between the YAML and the binary format, the formats are picked by extension
+	static void Convert(const std::filesystem::path& Source, const std::filesystem::path& Destination);
+
+	// Loads every mesh of the scene, cooking the ones that are not cooked yet, and logs their index memory
+	// with packed indices and with 32-bit indices
+	static void MeasureIndexMemory(const std::filesystem::path& Path);
 };
\ No newline at end of file
@@ -24,6 +24,10 @@ namespace HLSL
 
 		int TextureIndices[NumTextureTypes];
 		int TextureChannel[NumTextureTypes];
+		float TextureMinLOD[NumTextureTypes];
+
+		float3 emissive;
+		int LightIndex; // Mesh light of the instance, -1 when it does not emit
 	};
 
 	struct Light
@@ -36,6 +40,18 @@ namespace HLSL
 		float3 Points[4]; // World-space points that are pre-computed on the Cpu so we don't have to compute them in shader for every ray
 
 		float3 I;
+
+		// Mesh lights, Points[0] and Points[1] hold their world space bounds and I their radiance
+		uint FirstTriangle; // Into the emissive triangles and the alias table bins that pick them
+		uint NumTriangles;
+		float Area; // World space
+		float ObjectArea; // A triangle is picked with the probability of its object space area over this
+	};
+
+	// World space triangle of a mesh light
+	struct EmissiveTriangle
+	{
+		float3 p0, p1, p2;
 	};
 
 	struct Mesh
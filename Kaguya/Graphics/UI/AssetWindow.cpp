@@ -2,6 +2,8 @@
 #include "AssetWindow.h"
 
 #include <Graphics/AssetManager.h>
+#include <Graphics/Asset/ImageDecoder.h>
+#include <Graphics/VirtualTexture.h>
 
 void AssetWindow::RenderGui()
 {
@@ -63,15 +65,21 @@ void AssetWindow::RenderGui()
 			if (ImGui::BeginPopupModal("Mesh Options", nullptr, ImGuiWindowFlags_AlwaysAutoResize))
 			{
 				static bool KeepGeometryInRAM = true;
+				static bool QuantizeVertices = false;
+				static bool GenerateLODs = false;
+				static bool OptimizeMesh = false;
 				ImGui::PushStyleVar(ImGuiStyleVar_FramePadding, ImVec2(0, 0));
 				ImGui::Checkbox("Keep Geometry In RAM", &KeepGeometryInRAM);
+				ImGui::Checkbox("Quantize Vertices", &QuantizeVertices);
+				ImGui::Checkbox("Generate LODs", &GenerateLODs);
+				ImGui::Checkbox("Optimize Mesh", &OptimizeMesh);
 				ImGui::PopStyleVar();
 
 				if (ImGui::Button("Browse", ImVec2(120, 0)))
 				{
 					OpenDialogMultiple("obj,stl,ply", "", [&](auto Path)
 					{
-						AssetManager::Instance().AsyncLoadMesh(Path, KeepGeometryInRAM);
+						AssetManager::Instance().AsyncLoadMesh(Path, KeepGeometryInRAM, QuantizeVertices, GenerateLODs, OptimizeMesh);
 					});
 
 					ImGui::CloseCurrentPopup();
@@ -88,6 +96,29 @@ void AssetWindow::RenderGui()
 			addAllMeshToHierarchy = true;
 		}
 
+#if defined(_DEBUG)
+		if (ImGui::Button("Benchmark image decoders"))
+		{
+			OpenDialog("tga,hdr", "", [&](auto Path)
+			{
+				BenchmarkImageDecoders(Path, 10);
+			});
+		}
+
+		if (ImGui::Button("Benchmark mesh locality"))
+		{
+			OpenDialog("obj,stl,ply", "", [&](auto Path)
+			{
+				BenchmarkMeshLocality(Path);
+			});
+		}
+
+		if (ImGui::Button("Validate virtual texturing"))
+		{
+			ValidateVirtualTextureSystem();
+		}
+#endif
+
 		ImGui::EndPopup();
 	}
 
@@ -2,6 +2,7 @@
 #include "HierarchyWindow.h"
 
 #include <Graphics/Scene/SceneParser.h>
+#include <Graphics/Scene/BinarySceneParser.h>
 
 void HierarchyWindow::RenderGui()
 {
@@ -69,7 +70,7 @@ void HierarchyWindow::RenderGui()
 
 		if (ImGui::MenuItem("Save"))
 		{
-			SaveDialog("yaml", "", [&](auto Path)
+			SaveDialog("yaml;kscene", "", [&](auto Path)
 			{
 				if (!Path.has_extension())
 				{
@@ -80,14 +81,53 @@ void HierarchyWindow::RenderGui()
 			});
 		}
 
+		if (ImGui::MenuItem("Bake"))
+		{
+			SaveDialog("bundle", "", [&](auto Path)
+			{
+				if (!Path.has_extension())
+				{
+					Path += ".bundle";
+				}
+
+				SceneParser::Bake(Path, pScene);
+			});
+		}
+
 		if (ImGui::MenuItem("Load"))
 		{
-			OpenDialog("yaml", "", [&](auto Path)
+			OpenDialog("yaml,bundle,kscene", "", [&](auto Path)
 			{
 				SceneParser::Load(Path, pScene);
 			});
 		}
 
+		if (ImGui::MenuItem("Convert"))
+		{
+			OpenDialog("yaml,kscene", "", [&](auto Source)
+			{
+				SaveDialog("yaml;kscene", "", [&](auto Destination)
+				{
+					SceneParser::Convert(Source, Destination);
+				});
+			});
+		}
+
+#if defined(_DEBUG)
+		if (ImGui::MenuItem("Benchmark"))
+		{
+			BinarySceneParser::Benchmark(100000, pScene);
+		}
+
+		if (ImGui::MenuItem("Measure index memory"))
+		{
+			OpenDialogMultiple("yaml,kscene", "", [&](auto Path)
+			{
+				SceneParser::MeasureIndexMemory(Path);
+			});
+		}
+#endif
+
 		ImGui::EndPopup();
 	}
 	ImGui::EndChild();
@@ -376,6 +376,8 @@ void InspectorWindow::RenderGui(float x, float y, float width, float height)
 					break;
 				}
 
+				IsEdited |= RenderFloat3Control("Emissive", &Material.emissive.x);
+
 				auto ImageBox = [&](TextureTypes TextureType, UINT64& Key, std::string_view Name)
 				{
 					auto Handle = AssetManager::Instance().GetImageCache().Load(Key);
@@ -423,11 +425,39 @@ void InspectorWindow::RenderGui(float x, float y, float width, float height)
 
 			auto pType = (int*)&Component.Type;
 
-			const char* LightTypes[] = { "Point", "Quad" };
+			const char* LightTypes[] = { "Point", "Quad", "Environment" };
 			IsEdited |= ImGui::Combo("Type", pType, LightTypes, ARRAYSIZE(LightTypes), ARRAYSIZE(LightTypes));
 			IsEdited |= RenderFloat3Control("I", &Component.I.x);
-			IsEdited |= ImGui::SliderFloat("Width", &Component.Width, 1, 50);
-			IsEdited |= ImGui::SliderFloat("Height", &Component.Height, 1, 50);
+			if (Component.Type == EnvironmentLight)
+			{
+				auto Handle = AssetManager::Instance().GetImageCache().Load(Component.TextureKey);
+
+				ImGui::Text("Image: ");
+				ImGui::SameLine();
+				ImGui::Button(Handle ? Handle->Name.data() : "NULL");
+				if (Handle && Handle->Metadata.Path.extension() != ".hdr")
+				{
+					ImGui::Text("Only .hdr images can light the scene");
+				}
+
+				if (ImGui::BeginDragDropTarget())
+				{
+					if (const ImGuiPayload* payload = ImGui::AcceptDragDropPayload("ASSET_IMAGE");
+						payload)
+					{
+						IM_ASSERT(payload->DataSize == sizeof(UINT64));
+						Component.TextureKey = (*(UINT64*)payload->Data);
+
+						IsEdited = true;
+					}
+					ImGui::EndDragDropTarget();
+				}
+			}
+			else
+			{
+				IsEdited |= ImGui::SliderFloat("Width", &Component.Width, 1, 50);
+				IsEdited |= ImGui::SliderFloat("Height", &Component.Height, 1, 50);
+			}
 
 			return IsEdited;
 		},
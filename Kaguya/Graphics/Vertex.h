@@ -10,4 +10,24 @@ struct Vertex
 	float3 Normal;
 };
 
-#endif
\ No newline at end of file
+// Must match VertexFormat_* in Vertex.hlsli
+enum class VertexFormat : uint32_t
+{
+	Full,		// Vertex
+	Compact		// CompactVertex
+};
+
+// 16 byte vertex, position is quantized to SNORM16 relative to the bounding box of its submesh
+// (the 4th component is padding so the position can be fed to the BLAS as R16G16B16A16_SNORM),
+// texture coordinate is stored as half floats and the normal is octahedral encoded as SNORM16
+struct CompactVertex
+{
+	int16_t Position[4];
+	uint16_t Texture[2];
+	int16_t Normal[2];
+};
+
+static_assert(sizeof(Vertex) == 32);
+static_assert(sizeof(CompactVertex) == 16);
+
+#endif
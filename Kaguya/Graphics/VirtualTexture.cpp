@@ -0,0 +1,494 @@
+#include "pch.h"
+#include "VirtualTexture.h"
+
+using namespace DirectX;
+
+VirtualTexturePageTable::VirtualTexturePageTable(UINT Width, UINT Height, UINT MipLevels, UINT TileSize)
+{
+	Mips.resize(MipLevels);
+	for (UINT mip = 0; mip < MipLevels; ++mip)
+	{
+		UINT width = std::max(1u, Width >> mip);
+		UINT height = std::max(1u, Height >> mip);
+
+		Mips[mip].NumTilesX = (width + TileSize - 1) / TileSize;
+		Mips[mip].NumTilesY = (height + TileSize - 1) / TileSize;
+		Mips[mip].Slots.resize(size_t(Mips[mip].NumTilesX) * Mips[mip].NumTilesY, InvalidSlot);
+	}
+}
+
+UINT VirtualTexturePageTable::GetSlot(UINT Mip, UINT X, UINT Y) const
+{
+	return Mips[Mip].Slots[size_t(Y) * Mips[Mip].NumTilesX + X];
+}
+
+void VirtualTexturePageTable::SetSlot(UINT Mip, UINT X, UINT Y, UINT Slot)
+{
+	Mips[Mip].Slots[size_t(Y) * Mips[Mip].NumTilesX + X] = Slot;
+}
+
+UINT VirtualTexturePageTable::Translate(UINT Mip, UINT X, UINT Y, UINT* pResidentMip) const
+{
+	for (UINT mip = Mip; mip < GetMipLevels(); ++mip)
+	{
+		// Tile coordinates halve every mip level, but the tile count is rounded up so clamp
+		UINT x = std::min(X >> (mip - Mip), Mips[mip].NumTilesX - 1);
+		UINT y = std::min(Y >> (mip - Mip), Mips[mip].NumTilesY - 1);
+		if (UINT slot = GetSlot(mip, x, y);
+			slot != InvalidSlot)
+		{
+			if (pResidentMip)
+			{
+				*pResidentMip = mip;
+			}
+			return slot;
+		}
+	}
+	return InvalidSlot;
+}
+
+VirtualTextureCache::VirtualTextureCache(UINT64 MemoryBudget)
+	: MemoryBudget(MemoryBudget)
+{
+
+}
+
+void VirtualTextureCache::Touch(const VirtualTextureTile& Tile)
+{
+	if (auto it = Entries.find(Tile.Key());
+		it != Entries.end())
+	{
+		LRU.splice(LRU.begin(), LRU, it->second.LRU);
+	}
+}
+
+bool VirtualTextureCache::Allocate(const VirtualTextureTile& Tile, UINT64 SizeInBytes, bool Pinned, UINT* pSlot, std::vector<VirtualTextureTile>* pEvicted)
+{
+	assert(!IsResident(Tile));
+
+	// Evict least recently used tiles, skipping pinned ones
+	auto candidate = LRU.end();
+	while (MemoryUsage + SizeInBytes > MemoryBudget && candidate != LRU.begin())
+	{
+		--candidate;
+
+		auto it = Entries.find(*candidate);
+		if (it->second.Pinned)
+		{
+			continue;
+		}
+
+		if (pEvicted)
+		{
+			pEvicted->push_back(it->second.Tile);
+		}
+		MemoryUsage -= it->second.SizeInBytes;
+		FreeSlots.push_back(it->second.Slot);
+
+		candidate = LRU.erase(candidate);
+		Entries.erase(it);
+	}
+
+	if (MemoryUsage + SizeInBytes > MemoryBudget)
+	{
+		return false;
+	}
+
+	UINT slot;
+	if (!FreeSlots.empty())
+	{
+		slot = FreeSlots.back();
+		FreeSlots.pop_back();
+	}
+	else
+	{
+		slot = NumSlots++;
+	}
+
+	LRU.push_front(Tile.Key());
+	Entries[Tile.Key()] =
+	{
+		.Tile = Tile,
+		.Slot = slot,
+		.SizeInBytes = SizeInBytes,
+		.Pinned = Pinned,
+		.LRU = LRU.begin()
+	};
+	MemoryUsage += SizeInBytes;
+
+	*pSlot = slot;
+	return true;
+}
+
+VirtualTextureSystem::VirtualTextureSystem(UINT64 MemoryBudget)
+	: Cache(MemoryBudget)
+{
+
+}
+
+UINT VirtualTextureSystem::RegisterTexture(const std::filesystem::path& Path)
+{
+	auto stream = std::make_unique<ImageStream>();
+	if (!stream->Open(ImageStream::GetCookedPath(Path)))
+	{
+		throw std::exception("Virtual textures must be cooked before they can be registered");
+	}
+
+	return RegisterTexture(std::move(stream));
+}
+
+UINT VirtualTextureSystem::RegisterTexture(std::unique_ptr<ImageStream> Stream)
+{
+	const auto& Metadata = Stream->GetMetadata();
+
+	UINT TextureId = static_cast<UINT>(Textures.size());
+	Texture& texture = Textures.emplace_back();
+	texture.PageTable = VirtualTexturePageTable(
+		static_cast<UINT>(Metadata.width),
+		static_cast<UINT>(Metadata.height),
+		static_cast<UINT>(Metadata.mipLevels),
+		TileSize);
+	texture.Stream = std::move(Stream);
+
+	// Pin the coarsest mip so every lookup resolves to something
+	const UINT CoarsestMip = texture.PageTable.GetMipLevels() - 1;
+	for (UINT y = 0; y < texture.PageTable.GetNumTilesY(CoarsestMip); ++y)
+	{
+		for (UINT x = 0; x < texture.PageTable.GetNumTilesX(CoarsestMip); ++x)
+		{
+			LoadTile({ TextureId, CoarsestMip, x, y }, true, PinnedUploads);
+		}
+	}
+
+	return TextureId;
+}
+
+void VirtualTextureSystem::ProcessFeedback(std::span<const VirtualTextureFeedback> Feedback)
+{
+	std::unordered_map<UINT64, std::pair<VirtualTextureTile, UINT>> Counts;
+
+	for (const auto& feedback : Feedback)
+	{
+		if (feedback.TextureId >= Textures.size())
+		{
+			continue;
+		}
+
+		const auto& PageTable = Textures[feedback.TextureId].PageTable;
+		const UINT Mip = std::min(feedback.Mip, PageTable.GetMipLevels() - 1);
+
+		// Wrap addressing
+		const float U = feedback.U - std::floor(feedback.U);
+		const float V = feedback.V - std::floor(feedback.V);
+		const UINT X = std::min(static_cast<UINT>(U * PageTable.GetNumTilesX(Mip)), PageTable.GetNumTilesX(Mip) - 1);
+		const UINT Y = std::min(static_cast<UINT>(V * PageTable.GetNumTilesY(Mip)), PageTable.GetNumTilesY(Mip) - 1);
+
+		// Tile of the sample at a coarser mip, clamped like in Translate since the tile count is rounded up
+		auto TileAt = [&](UINT CoarserMip) -> VirtualTextureTile
+		{
+			return
+			{
+				feedback.TextureId,
+				CoarserMip,
+				std::min(X >> (CoarserMip - Mip), PageTable.GetNumTilesX(CoarserMip) - 1),
+				std::min(Y >> (CoarserMip - Mip), PageTable.GetNumTilesY(CoarserMip) - 1)
+			};
+		};
+
+		UINT ResidentMip = Mip;
+		(void)PageTable.Translate(Mip, X, Y, &ResidentMip);
+
+		// Keep whatever currently backs this sample alive
+		Cache.Touch(TileAt(ResidentMip));
+
+		if (ResidentMip == Mip)
+		{
+			continue;
+		}
+
+		// Refine one mip level at a time, the tile right below the resident one is requested
+		const VirtualTextureTile Request = TileAt(ResidentMip - 1);
+
+		auto& [Tile, Count] = Counts[Request.Key()];
+		Tile = Request;
+		Count++;
+	}
+
+	std::vector<std::pair<VirtualTextureTile, UINT>> Sorted;
+	Sorted.reserve(Counts.size());
+	for (const auto& [Key, Value] : Counts)
+	{
+		Sorted.push_back(Value);
+	}
+
+	std::sort(Sorted.begin(), Sorted.end(), [](const auto& a, const auto& b)
+	{
+		if (a.second != b.second)
+		{
+			return a.second > b.second;
+		}
+		if (a.first.Mip != b.first.Mip)
+		{
+			return a.first.Mip > b.first.Mip;
+		}
+		return a.first.Key() < b.first.Key();
+	});
+
+	Requests.clear();
+	Requests.reserve(Sorted.size());
+	for (const auto& [Tile, Count] : Sorted)
+	{
+		Requests.push_back(Tile);
+	}
+}
+
+std::vector<VirtualTextureUpload> VirtualTextureSystem::Update(size_t MaxTiles)
+{
+	std::vector<VirtualTextureUpload> Uploads = std::move(PinnedUploads);
+	PinnedUploads.clear();
+
+	size_t NumLoaded = 0;
+	for (const auto& Tile : Requests)
+	{
+		if (NumLoaded >= MaxTiles)
+		{
+			break;
+		}
+
+		if (Cache.IsResident(Tile))
+		{
+			continue;
+		}
+
+		if (!LoadTile(Tile, false, Uploads))
+		{
+			// Budget is exhausted by pinned tiles
+			break;
+		}
+		NumLoaded++;
+	}
+
+	Requests.clear();
+	return Uploads;
+}
+
+bool VirtualTextureSystem::LoadTile(const VirtualTextureTile& Tile, bool Pinned, std::vector<VirtualTextureUpload>& Uploads)
+{
+	Texture& texture = Textures[Tile.TextureId];
+	const auto& Metadata = texture.Stream->GetMetadata();
+
+	size_t RowPitch, SlicePitch;
+	ThrowIfFailed(ComputePitch(Metadata.format, TileSize, TileSize, RowPitch, SlicePitch));
+
+	UINT Slot;
+	std::vector<VirtualTextureTile> Evicted;
+	if (!Cache.Allocate(Tile, SlicePitch, Pinned, &Slot, &Evicted))
+	{
+		return false;
+	}
+
+	for (const auto& evicted : Evicted)
+	{
+		Textures[evicted.TextureId].PageTable.SetSlot(evicted.Mip, evicted.X, evicted.Y, VirtualTexturePageTable::InvalidSlot);
+
+		// The slot may have been handed out to a pending upload, discard it
+		std::erase_if(Uploads, [&](const VirtualTextureUpload& Upload)
+		{
+			return Upload.Tile == evicted;
+		});
+	}
+
+	VirtualTextureUpload& Upload = Uploads.emplace_back();
+	Upload.Tile = Tile;
+	Upload.PhysicalSlot = Slot;
+	Upload.RowPitch = static_cast<UINT>(RowPitch);
+	Upload.Data.resize(SlicePitch);
+	texture.Stream->ReadRegion(Tile.Mip, 0, size_t(Tile.X) * TileSize, size_t(Tile.Y) * TileSize, TileSize, TileSize, Upload.Data.data(), RowPitch);
+
+	texture.PageTable.SetSlot(Tile.Mip, Tile.X, Tile.Y, Slot);
+	return true;
+}
+
+static UINT EncodeValidationTile(UINT Mip, UINT X, UINT Y)
+{
+	return (Mip << 24) | (X << 12) | Y;
+}
+
+// 1024x512 with a full mip chain, every texel holds the tile it belongs to
+static std::unique_ptr<ImageStream> CreateValidationStream()
+{
+	constexpr UINT Width = 1024, Height = 512;
+	constexpr UINT TileSize = VirtualTextureSystem::TileSize;
+
+	ScratchImage image;
+	ThrowIfFailed(image.Initialize2D(DXGI_FORMAT_R32_UINT, Width, Height, 1, 0));
+	for (size_t mip = 0; mip < image.GetMetadata().mipLevels; ++mip)
+	{
+		const DirectX::Image* pImage = image.GetImage(mip, 0, 0);
+		for (size_t y = 0; y < pImage->height; ++y)
+		{
+			auto pRow = reinterpret_cast<UINT*>(pImage->pixels + y * pImage->rowPitch);
+			for (size_t x = 0; x < pImage->width; ++x)
+			{
+				pRow[x] = EncodeValidationTile(static_cast<UINT>(mip), static_cast<UINT>(x / TileSize), static_cast<UINT>(y / TileSize));
+			}
+		}
+	}
+
+	// Streams only read cooked files, which are written with the DX10 header
+	auto blob = std::make_shared<Blob>();
+	ThrowIfFailed(SaveToDDSMemory(image.GetImages(), image.GetImageCount(), image.GetMetadata(), DDS_FLAGS_FORCE_DX10_EXT, *blob));
+
+	auto stream = std::make_unique<ImageStream>();
+	if (!stream->Open(static_cast<const BYTE*>(blob->GetBufferPointer()), blob->GetBufferSize(), blob))
+	{
+		throw std::exception("Failed to open the virtual texture validation image");
+	}
+	return stream;
+}
+
+// Every texel of the upload that lies inside the mip must encode the tile of the upload
+static bool IsValidUpload(const VirtualTextureUpload& Upload, const TexMetadata& Metadata)
+{
+	constexpr UINT TileSize = VirtualTextureSystem::TileSize;
+
+	const size_t mipWidth = std::max<size_t>(1, Metadata.width >> Upload.Tile.Mip);
+	const size_t mipHeight = std::max<size_t>(1, Metadata.height >> Upload.Tile.Mip);
+	const size_t width = std::min<size_t>(TileSize, mipWidth - size_t(Upload.Tile.X) * TileSize);
+	const size_t height = std::min<size_t>(TileSize, mipHeight - size_t(Upload.Tile.Y) * TileSize);
+
+	const UINT expected = EncodeValidationTile(Upload.Tile.Mip, Upload.Tile.X, Upload.Tile.Y);
+	for (size_t y = 0; y < height; ++y)
+	{
+		auto pRow = reinterpret_cast<const UINT*>(Upload.Data.data() + y * Upload.RowPitch);
+		for (size_t x = 0; x < width; ++x)
+		{
+			if (pRow[x] != expected)
+			{
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+bool ValidateVirtualTextureSystem()
+{
+	constexpr UINT64 TileSizeInBytes = UINT64(VirtualTextureSystem::TileSize) * VirtualTextureSystem::TileSize * sizeof(UINT);
+
+	size_t numFailed = 0;
+	const auto check = [&](bool Passed, const char* Description)
+	{
+		if (!Passed)
+		{
+			LOG_ERROR("Virtual texture validation failed: {}", Description);
+			numFailed++;
+		}
+	};
+
+	// Room for the pinned tile and 3 more
+	{
+		VirtualTextureSystem system(4 * TileSizeInBytes);
+		auto stream = CreateValidationStream();
+		const TexMetadata metadata = stream->GetMetadata();
+		const UINT id = system.RegisterTexture(std::move(stream));
+		const auto& pageTable = system.GetPageTable(id);
+		const UINT coarsestMip = pageTable.GetMipLevels() - 1;
+
+		// Samples of mip 0 in the top left and bottom right tiles
+		const VirtualTextureFeedback topLeft = { id, 0, 0.05f, 0.05f };
+		const VirtualTextureFeedback bottomRight = { id, 0, 0.95f, 0.95f };
+
+		auto uploads = system.Update(0);
+		check(uploads.size() == 1 && uploads[0].Tile.Mip == coarsestMip && IsValidUpload(uploads[0], metadata),
+			"the first update uploads the pinned coarsest mip");
+
+		UINT residentMip = 0;
+		check(pageTable.Translate(0, 7, 3, &residentMip) != VirtualTexturePageTable::InvalidSlot && residentMip == coarsestMip,
+			"tiles that were never requested fall back to the coarsest mip");
+
+		bool refinedInOrder = true;
+		for (UINT mip = coarsestMip; mip-- > 0;)
+		{
+			system.ProcessFeedback({ &topLeft, 1 });
+			const auto& requests = system.GetRequests();
+			refinedInOrder &= requests.size() == 1 && requests[0].Mip == mip;
+
+			uploads = system.Update(1);
+			refinedInOrder &= uploads.size() == 1 && IsValidUpload(uploads[0], metadata);
+			refinedInOrder &= system.GetCache().GetMemoryUsage() <= system.GetCache().GetMemoryBudget();
+		}
+		check(refinedInOrder, "feedback refines a tile one mip at a time with uploads of its texels within the budget");
+		check(pageTable.Translate(0, 0, 0, &residentMip) != VirtualTexturePageTable::InvalidSlot && residentMip == 0,
+			"the sampled tile is resident at the mip it was sampled at");
+		check(system.GetCache().GetNumResidentTiles() == 4, "coarser tiles of the chain are evicted to stay in the budget");
+		check(pageTable.GetSlot(coarsestMip - 1, 0, 0) == VirtualTexturePageTable::InvalidSlot, "evicted tiles are removed from the page table");
+		check(pageTable.GetSlot(coarsestMip, 0, 0) != VirtualTexturePageTable::InvalidSlot, "pinned tiles are never evicted");
+
+		// The top left tile keeps being sampled while the bottom right one is refined next to it
+		const VirtualTextureFeedback feedback[] = { topLeft, bottomRight };
+		for (UINT round = 0; round < coarsestMip; ++round)
+		{
+			system.ProcessFeedback(feedback);
+			system.Update(1);
+		}
+		check(pageTable.GetSlot(0, 0, 0) != VirtualTexturePageTable::InvalidSlot, "tiles that keep being sampled are not evicted");
+		check(pageTable.Translate(0, 7, 3, &residentMip) != VirtualTexturePageTable::InvalidSlot && residentMip == 0,
+			"tiles are refined next to the ones that are kept");
+	}
+
+	// Request order, the top left and top right samples share a tile down to mip 3
+	{
+		VirtualTextureSystem system;
+		const UINT id = system.RegisterTexture(CreateValidationStream());
+		system.Update(0);
+
+		const VirtualTextureFeedback topLeft = { id, 0, 0.05f, 0.05f };
+		const VirtualTextureFeedback topRight = { id, 0, 0.95f, 0.05f };
+		while (system.GetPageTable(id).GetSlot(2, 0, 0) == VirtualTexturePageTable::InvalidSlot)
+		{
+			system.ProcessFeedback({ &topLeft, 1 });
+			if (system.GetRequests().empty())
+			{
+				break;
+			}
+			system.Update(1);
+		}
+
+		// Top left requests mip 1, top right requests mip 2
+		const VirtualTextureFeedback tie[] = { topLeft, topRight };
+		system.ProcessFeedback(tie);
+		check(system.GetRequests().size() == 2 && system.GetRequests()[0].Mip == 2, "coarser mips are requested first on ties");
+
+		const VirtualTextureFeedback weighted[] = { topLeft, topLeft, topRight };
+		system.ProcessFeedback(weighted);
+		check(system.GetRequests().size() == 2 && system.GetRequests()[0].Mip == 1, "tiles that are requested more often come first");
+	}
+
+	// The pinned tile takes the whole budget
+	{
+		VirtualTextureSystem system(TileSizeInBytes);
+		const UINT id = system.RegisterTexture(CreateValidationStream());
+		system.Update(0);
+
+		// Every sample of the texture is in the single tile of the mip below the pinned one
+		std::vector<VirtualTextureFeedback> feedback;
+		for (UINT i = 0; i < 64; ++i)
+		{
+			feedback.push_back({ id, 0, static_cast<float>(i % 8) / 8.0f, static_cast<float>(i / 8) / 8.0f });
+		}
+		system.ProcessFeedback(feedback);
+		check(system.GetRequests().size() == 1, "samples that need the same tile become one request");
+
+		UINT residentMip = 0;
+		check(system.Update(1).empty(), "nothing is loaded when pinned tiles take the whole budget");
+		check(system.GetPageTable(id).Translate(0, 0, 0, &residentMip) != VirtualTexturePageTable::InvalidSlot &&
+			residentMip == system.GetPageTable(id).GetMipLevels() - 1, "pinned tiles stay resident when loads fail");
+	}
+
+	if (numFailed == 0)
+	{
+		LOG_INFO("Virtual texture validation passed");
+	}
+	return numFailed == 0;
+}
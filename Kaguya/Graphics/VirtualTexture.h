@@ -0,0 +1,163 @@
+#pragma once
+#include <list>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+#include "Asset/ImageStream.h"
+
+/*
+* Backend neutral virtual texturing core. Textures are split into fixed-size tiles that
+* are made resident on demand: the renderer writes feedback for the tiles it wanted to sample,
+* the system turns that into a request list, loads the tiles from the cooked texture cache and
+* hands them to the backend as uploads into a physical tile pool. The page table of each texture
+* maps every virtual tile to the physical slot of the finest resident tile covering it.
+*
+* The coarsest mip of every texture is pinned so the page table always has a valid fallback.
+*/
+struct VirtualTextureTile
+{
+	UINT TextureId;
+	UINT Mip;
+	UINT X;
+	UINT Y;
+
+	auto operator<=>(const VirtualTextureTile&) const = default;
+
+	// TextureId : 24, Mip : 8, X : 16, Y : 16
+	[[nodiscard]] UINT64 Key() const
+	{
+		return (UINT64(TextureId) << 40) | (UINT64(Mip) << 32) | (UINT64(X) << 16) | UINT64(Y);
+	}
+};
+
+// Written by the renderer for every sample, Mip is the desired mip, the tile is derived from UV
+struct VirtualTextureFeedback
+{
+	UINT TextureId;
+	UINT Mip;
+	float U;
+	float V;
+};
+
+// Loaded tile data that the backend needs to copy into the physical tile pool
+struct VirtualTextureUpload
+{
+	VirtualTextureTile Tile;
+	UINT PhysicalSlot;
+	UINT RowPitch;
+	std::vector<BYTE> Data;
+};
+
+class VirtualTexturePageTable
+{
+public:
+	static constexpr UINT InvalidSlot = UINT(-1);
+
+	VirtualTexturePageTable() = default;
+	VirtualTexturePageTable(UINT Width, UINT Height, UINT MipLevels, UINT TileSize);
+
+	[[nodiscard]] UINT GetMipLevels() const { return static_cast<UINT>(Mips.size()); }
+	[[nodiscard]] UINT GetNumTilesX(UINT Mip) const { return Mips[Mip].NumTilesX; }
+	[[nodiscard]] UINT GetNumTilesY(UINT Mip) const { return Mips[Mip].NumTilesY; }
+
+	// Slot of the tile itself, InvalidSlot if it is not resident
+	[[nodiscard]] UINT GetSlot(UINT Mip, UINT X, UINT Y) const;
+	void SetSlot(UINT Mip, UINT X, UINT Y, UINT Slot);
+
+	// Walks up the mip chain until a resident tile covering (Mip, X, Y) is found,
+	// this is what the page table entry resolves to when sampled
+	[[nodiscard]] UINT Translate(UINT Mip, UINT X, UINT Y, UINT* pResidentMip = nullptr) const;
+private:
+	struct MipLevel
+	{
+		UINT NumTilesX;
+		UINT NumTilesY;
+		std::vector<UINT> Slots;
+	};
+
+	std::vector<MipLevel> Mips;
+};
+
+// LRU cache of physical tile slots with a memory budget
+class VirtualTextureCache
+{
+public:
+	VirtualTextureCache() = default;
+	explicit VirtualTextureCache(UINT64 MemoryBudget);
+
+	[[nodiscard]] UINT64 GetMemoryBudget() const { return MemoryBudget; }
+	[[nodiscard]] UINT64 GetMemoryUsage() const { return MemoryUsage; }
+	[[nodiscard]] size_t GetNumResidentTiles() const { return Entries.size(); }
+
+	[[nodiscard]] bool IsResident(const VirtualTextureTile& Tile) const { return Entries.contains(Tile.Key()); }
+
+	// Marks the tile as most recently used
+	void Touch(const VirtualTextureTile& Tile);
+
+	// Allocates a slot for Tile, evicting least recently used tiles until SizeInBytes fits in
+	// the budget. Evicted tiles are appended to pEvicted. Returns false if the budget can't be met
+	// because every resident tile is pinned
+	bool Allocate(const VirtualTextureTile& Tile, UINT64 SizeInBytes, bool Pinned, UINT* pSlot, std::vector<VirtualTextureTile>* pEvicted);
+private:
+	struct Entry
+	{
+		VirtualTextureTile Tile;
+		UINT Slot;
+		UINT64 SizeInBytes;
+		bool Pinned;
+		std::list<UINT64>::iterator LRU;
+	};
+
+	UINT64 MemoryBudget = 0;
+	UINT64 MemoryUsage = 0;
+	std::unordered_map<UINT64, Entry> Entries;
+	std::list<UINT64> LRU; // Front is most recently used
+	std::vector<UINT> FreeSlots;
+	UINT NumSlots = 0;
+};
+
+class VirtualTextureSystem
+{
+public:
+	static constexpr UINT TileSize = 128;
+	static constexpr UINT64 DefaultMemoryBudget = 256_MiB;
+
+	explicit VirtualTextureSystem(UINT64 MemoryBudget = DefaultMemoryBudget);
+
+	// Registers the cooked DDS of the source image, returns the id used in feedback
+	UINT RegisterTexture(const std::filesystem::path& Path);
+	// Registers an opened stream, it can also read from memory
+	UINT RegisterTexture(std::unique_ptr<ImageStream> Stream);
+
+	[[nodiscard]] const VirtualTexturePageTable& GetPageTable(UINT TextureId) const { return Textures[TextureId].PageTable; }
+	[[nodiscard]] const VirtualTextureCache& GetCache() const { return Cache; }
+
+	// Converts feedback into a deduplicated request list, resident tiles are touched in the LRU.
+	// Requests are ordered by how often they were requested, coarser mips first on ties
+	void ProcessFeedback(std::span<const VirtualTextureFeedback> Feedback);
+
+	[[nodiscard]] const std::vector<VirtualTextureTile>& GetRequests() const { return Requests; }
+
+	// Loads up to MaxTiles requested tiles and returns them as uploads, the page tables are
+	// updated as if the uploads have already been made
+	std::vector<VirtualTextureUpload> Update(size_t MaxTiles);
+private:
+	struct Texture
+	{
+		std::unique_ptr<ImageStream> Stream;
+		VirtualTexturePageTable PageTable;
+	};
+
+	bool LoadTile(const VirtualTextureTile& Tile, bool Pinned, std::vector<VirtualTextureUpload>& Uploads);
+
+	std::vector<Texture> Textures;
+	VirtualTextureCache Cache;
+	std::vector<VirtualTextureTile> Requests;
+	std::vector<VirtualTextureUpload> PinnedUploads; // Returned by the next Update
+};
+
+// Runs a VirtualTextureSystem over a synthetic texture whose texels encode the tile they belong to and feeds it
+// synthetic feedback, checks refinement, request order, the content of the uploads, LRU eviction under a small budget and pinning.
+// Logs every failed check and returns true if all of them passed
+bool ValidateVirtualTextureSystem();
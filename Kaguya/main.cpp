@@ -18,6 +18,10 @@
 #include <Core/Application.h>
 #include <Graphics/RenderDevice.h>
 #include <Graphics/AssetManager.h>
+#include <Graphics/Asset/ImportWorker.h>
+#include <Graphics/CPU/LUTGenerator.h>
+#include <Graphics/CPU/BlueNoiseGenerator.h>
+#include <Graphics/CPU/Sampler.h>
 #include <Graphics/Renderer.h>
 #include <Graphics/UI/HierarchyWindow.h>
 #include <Graphics/UI/ViewportWindow.h>
@@ -169,6 +173,26 @@ private:
 
 int main(int argc, char* argv[])
 {
+	if (argc > 1 && argv[1] == ImportWorkerPool::CommandLineFlag)
+	{
+		return ImportWorkerPool::RunWorker(argc, argv);
+	}
+
+	if (argc > 1 && argv[1] == CPU::LUTGenerator::CommandLineFlag)
+	{
+		return CPU::LUTGenerator::Run(argc, argv);
+	}
+
+	if (argc > 1 && argv[1] == CPU::BlueNoiseGenerator::CommandLineFlag)
+	{
+		return CPU::BlueNoiseGenerator::Run(argc, argv);
+	}
+
+	if (argc > 1 && argv[1] == CPU::Sampler::CommandLineFlag)
+	{
+		return CPU::Sampler::Run(argc, argv);
+	}
+
 #if defined(_DEBUG)
 	ENABLE_LEAK_DETECTION();
 	SET_LEAK_BREAKPOINT(-1);
@@ -184,6 +208,7 @@ int main(int argc, char* argv[])
 
 	Application::Initialize(config);
 	RenderDevice::Initialize();
+	ImportWorkerPool::Initialize();
 	AssetManager::Initialize();
 
 	RenderDevice::Instance().ShaderCompiler.SetIncludeDirectory(Application::ExecutableFolderPath / L"Shaders");
@@ -207,6 +232,7 @@ int main(int argc, char* argv[])
 		delete editor;
 
 		AssetManager::Shutdown();
+		ImportWorkerPool::Shutdown();
 		RenderDevice::Shutdown();
 	});
 }
\ No newline at end of file
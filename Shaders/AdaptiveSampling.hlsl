@@ -0,0 +1,44 @@
+#include <DescriptorTable.hlsli>
+#include <AdaptiveSampling.hlsli>
+
+cbuffer Settings : register(b0, space0)
+{
+	uint MomentsIndex;
+	uint TileSamplesIndex;
+	uint MaxSamplesPerPixel; // Per frame
+	float ErrorThreshold;
+	uint Width;
+	uint Height;
+};
+
+groupshared uint TileError; // asuint of a non negative float orders like the float
+groupshared uint TileNumSamples;
+
+// One group per tile, writes the samples every pixel of the tile takes next frame to TileSamples.x
+[numthreads(AdaptiveSamplingTileSize, AdaptiveSamplingTileSize, 1)]
+void CSMain(uint3 GroupID : SV_GroupID, uint3 DTid : SV_DispatchThreadID, uint GroupIndex : SV_GroupIndex)
+{
+	if (GroupIndex == 0)
+	{
+		TileError = 0;
+		TileNumSamples = 0xFFFFFFFF;
+	}
+	GroupMemoryBarrierWithGroupSync();
+
+	if (DTid.x < Width && DTid.y < Height)
+	{
+		RWTexture2D<float4> Moments = g_RWTexture2DTable[MomentsIndex];
+		const float4 moments = Moments[DTid.xy];
+
+		InterlockedMax(TileError, asuint(RelativeError(moments)));
+		InterlockedMin(TileNumSamples, uint(moments.z));
+	}
+	GroupMemoryBarrierWithGroupSync();
+
+	if (GroupIndex == 0)
+	{
+		RWTexture2D<float4> TileSamples = g_RWTexture2DTable[TileSamplesIndex];
+		const uint numSamples = NumAdaptiveSamples(asfloat(TileError), TileNumSamples, ErrorThreshold, MaxSamplesPerPixel);
+		TileSamples[GroupID.xy] = float4(numSamples, asfloat(TileError), 0.0f, 0.0f);
+	}
+}
@@ -0,0 +1,60 @@
+#ifndef ADAPTIVE_SAMPLING_HLSLI
+#define ADAPTIVE_SAMPLING_HLSLI
+
+// Must match Graphics/CPU/PathIntegrator.h, the CPU integrator validates the same rule
+static const uint AdaptiveSamplingTileSize = 16;
+static const uint AdaptiveSamplingMinSamples = 16; // Samples before the variance of a pixel is trusted
+static const float AdaptiveSamplingMinLuminance = 0.01f; // Lower bound of the mean the error is relative to
+
+// Moments of a pixel: x = mean luminance, y = sum of squared differences from the mean, z = number of samples
+float4 AddSample(float4 Moments, float Luminance)
+{
+	Moments.z += 1.0f;
+	const float delta = Luminance - Moments.x;
+	Moments.x += delta / Moments.z;
+	Moments.y += delta * (Luminance - Moments.x);
+	return Moments;
+}
+
+// Standard error of the mean relative to the mean, infinite below 2 samples
+float RelativeError(float4 Moments)
+{
+	if (Moments.z < 2.0f)
+	{
+		return asfloat(0x7F800000);
+	}
+
+	const float variance = Moments.y / (Moments.z - 1.0f);
+	return sqrt(variance / Moments.z) / max(Moments.x, AdaptiveSamplingMinLuminance);
+}
+
+// Samples to add to a tile whose pixels have NumSamples samples and whose worst pixel has RelativeError,
+// 0 once it is below Threshold, see NumAdaptiveSamples in Graphics/CPU/PathIntegrator.h
+uint NumAdaptiveSamples(float RelativeError, uint NumSamples, float Threshold, uint MaxSamples)
+{
+	if (MaxSamples == 0)
+	{
+		return 0;
+	}
+
+	if (NumSamples < AdaptiveSamplingMinSamples)
+	{
+		return min(AdaptiveSamplingMinSamples - NumSamples, MaxSamples);
+	}
+
+	if (RelativeError <= Threshold)
+	{
+		return 0;
+	}
+
+	if (Threshold <= 0.0f)
+	{
+		return MaxSamples;
+	}
+
+	const float ratio = RelativeError / Threshold;
+	const float needed = ceil(float(NumSamples) * (ratio * ratio - 1.0f));
+	return uint(clamp(needed, 1.0f, float(MaxSamples)));
+}
+
+#endif // ADAPTIVE_SAMPLING_HLSLI
@@ -353,4 +353,54 @@ float3 SampleLi(Light light, SurfaceInteraction si, float2 Xi, out float3 pWi, o
 	return 0.xxx;
 }
 
+// Finds the point where the ray from p along wi hits the light, returns false for point lights which cannot be hit.
+// pLi is the radiance it emits towards p and pPdf the pdf of SampleLi for wi
+bool IntersectLight(Light light, float3 p, float3 wi, out float pT, out float3 pLi, out float pPdf)
+{
+	pT = 0.0f;
+	pLi = 0.xxx;
+	pPdf = 0.0f;
+	
+	if (light.Type != LightType_Quad)
+	{
+		return false;
+	}
+	
+	float3 ex = light.Points[1] - light.Points[0];
+	float3 ey = light.Points[3] - light.Points[0];
+	float3 n = cross(ex, ey);
+	
+	float denominator = dot(wi, n);
+	if (denominator == 0.0f)
+	{
+		return false;
+	}
+	
+	float t = dot(light.Points[0] - p, n) / denominator;
+	if (t <= 0.0f)
+	{
+		return false;
+	}
+	
+	// Parametric coordinates of the hit point along the edges
+	float3 d = p + t * wi - light.Points[0];
+	float u = dot(d, ex) / dot(ex, ex);
+	float v = dot(d, ey) / dot(ey, ey);
+	if (u < 0.0f || u > 1.0f || v < 0.0f || v > 1.0f)
+	{
+		return false;
+	}
+	
+	SphericalRectangle squad = SphericalRectangleInit(light.Points[0], ex, ey, p);
+	if (!(squad.SolidAngle > 0.0f))
+	{
+		return false;
+	}
+	
+	pT = t;
+	pLi = light.I;
+	pPdf = 1.0f / squad.SolidAngle;
+	return true;
+}
+
 #endif // BSDF_HLSLI
\ No newline at end of file
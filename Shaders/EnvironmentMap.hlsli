@@ -0,0 +1,84 @@
+#ifndef ENVIRONMENT_MAP_HLSLI
+#define ENVIRONMENT_MAP_HLSLI
+
+// Equirectangular environment map sampled with the piecewise constant 2D distribution built by CPU::EnvironmentMap.
+// Cdfs holds the marginal CDF of the rows (Height + 1 values) followed by the CDF of every row (Width + 1 values each).
+// u follows the azimuth around +y, v goes from +y at the top row to -y at the bottom one
+
+float2 EnvironmentDirectionToUV(float3 w)
+{
+	float phi = atan2(w.z, w.x);
+	phi = phi < 0.0f ? phi + g_2PI : phi;
+	const float theta = acos(clamp(w.y, -1.0f, 1.0f));
+	return float2(phi * g_1DIV2PI, theta * g_1DIVPI);
+}
+
+float3 EnvironmentUVToDirection(float2 uv, out float pSinTheta)
+{
+	const float theta = uv.y * g_PI;
+	const float phi = uv.x * g_2PI;
+	pSinTheta = sin(theta);
+	return float3(pSinTheta * cos(phi), cos(theta), pSinTheta * sin(phi));
+}
+
+// Inverts the CDF of N bins that starts at First, returns the continuous position in [0, 1) and the density there
+float SampleEnvironmentCdf(StructuredBuffer<float> Cdfs, uint First, uint N, float u, out float pPdf)
+{
+	// Last entry that is <= u, bins of zero width are never picked
+	uint lo = 0, hi = N;
+	while (lo + 1 < hi)
+	{
+		const uint mid = (lo + hi) / 2;
+		if (Cdfs[First + mid] <= u)
+		{
+			lo = mid;
+		}
+		else
+		{
+			hi = mid;
+		}
+	}
+
+	const float cdf0 = Cdfs[First + lo];
+	const float width = Cdfs[First + lo + 1] - cdf0;
+	const float du = width > 0.0f ? (u - cdf0) / width : 0.0f;
+
+	pPdf = width * float(N);
+	return min((float(lo) + du) / float(N), 0.99999994f);
+}
+
+// Picks a direction in proportion to the luminance arriving along it, the pdf is per solid angle and 0 on failure
+float3 SampleEnvironment(StructuredBuffer<float> Cdfs, uint Width, uint Height, float2 Xi, out float pPdf)
+{
+	float marginalPdf, conditionalPdf;
+	const float v = SampleEnvironmentCdf(Cdfs, 0, Height, Xi.y, marginalPdf);
+	const uint y = min(uint(v * float(Height)), Height - 1);
+	const float u = SampleEnvironmentCdf(Cdfs, Height + 1 + y * (Width + 1), Width, Xi.x, conditionalPdf);
+
+	// Jacobian of the equirectangular mapping
+	float sinTheta;
+	const float3 wi = EnvironmentUVToDirection(float2(u, v), sinTheta);
+	pPdf = sinTheta > 0.0f ? marginalPdf * conditionalPdf / (2.0f * g_PI * g_PI * sinTheta) : 0.0f;
+	return wi;
+}
+
+// Solid angle pdf of SampleEnvironment picking w
+float EnvironmentPdf(StructuredBuffer<float> Cdfs, uint Width, uint Height, float3 w)
+{
+	const float2 uv = EnvironmentDirectionToUV(w);
+	const float sinTheta = sin(uv.y * g_PI);
+	if (sinTheta == 0.0f)
+	{
+		return 0.0f;
+	}
+
+	const uint x = min(uint(uv.x * float(Width)), Width - 1);
+	const uint y = min(uint(uv.y * float(Height)), Height - 1);
+	const uint row = Height + 1 + y * (Width + 1);
+
+	const float marginalPdf = (Cdfs[y + 1] - Cdfs[y]) * float(Height);
+	const float conditionalPdf = (Cdfs[row + x + 1] - Cdfs[row + x]) * float(Width);
+	return marginalPdf * conditionalPdf / (2.0f * g_PI * g_PI * sinTheta);
+}
+
+#endif // ENVIRONMENT_MAP_HLSLI
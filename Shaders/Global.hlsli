@@ -3,6 +3,8 @@
 // This file defines global root signature for raytracing shaders
 
 #include <HLSLCommon.hlsli>
+#include <LightBVH.hlsli>
+#include <EnvironmentMap.hlsli>
 
 struct SystemConstants
 {
@@ -23,8 +25,25 @@ struct RenderPassData
 	uint NumSamplesPerPixel;
 	uint MaxDepth;
 	uint NumAccumulatedSamples;
+	uint Sampler; // SamplerType_* in Sampler.hlsli
 
 	uint RenderTarget;
+	int BlueNoise; // Spatiotemporal blue noise texture array, -1 when it is not loaded
+	uint Moments; // Luminance moments of every pixel, see AdaptiveSampling.hlsli
+	int TileSamples; // Samples of every tile written by AdaptiveSampling.hlsl, -1 samples every pixel uniformly
+
+	uint RussianRouletteMinDepth; // Bounces before Russian roulette, greater than MaxDepth when it is disabled
+	float RussianRouletteMinSurvival;
+
+	uint MultipleImportanceSampling; // 0 samples direct lighting from the lights only
+	uint LightSampling; // LightSampling_* in LightBVH.hlsli
+
+	float3 EnvironmentScale; // I of the environment light
+	int Environment; // Image of the environment light, -1 when there is none
+	float EnvironmentMinLOD;
+	uint EnvironmentWidth; // Of g_EnvironmentDistribution
+	uint EnvironmentHeight;
+	uint BlueNoiseChannels; // Independent sets per texel of BlueNoise, 1, 2 or 4
 };
 
 ConstantBuffer<SystemConstants> g_SystemConstants : register(b0, space0);
@@ -33,6 +52,12 @@ ConstantBuffer<RenderPassData> g_RenderPassData : register(b1, space0);
 RaytracingAccelerationStructure g_Scene : register(t0, space0);
 StructuredBuffer<Material> g_Materials : register(t1, space0);
 StructuredBuffer<Light> g_Lights : register(t2, space0);
+StructuredBuffer<AliasTableBin> g_LightAliasTable : register(t3, space0); // Picks lights in proportion to their power
+StructuredBuffer<LightBVHNode> g_LightBVH : register(t4, space0); // Picks lights by what they contribute to a point
+StructuredBuffer<uint> g_LightBitTrails : register(t5, space0); // Path from the root of g_LightBVH to every light
+StructuredBuffer<EmissiveTriangle> g_EmissiveTriangles : register(t6, space0); // Of every mesh light, see Light::FirstTriangle
+StructuredBuffer<AliasTableBin> g_EmissiveTriangleAliasTable : register(t7, space0); // Picks the triangles of a mesh light by area
+StructuredBuffer<float> g_EnvironmentDistribution : register(t8, space0); // CDFs of the environment light, see EnvironmentMap.hlsli
 
 SamplerState g_SamplerPointWrap : register(s0, space0);
 SamplerState g_SamplerPointClamp : register(s1, space0);
@@ -0,0 +1,189 @@
+#ifndef LIGHT_BVH_HLSLI
+#define LIGHT_BVH_HLSLI
+
+// Must match CPU::LightSamplingStrategy in Graphics/CPU/RaytracingScene.h
+static const uint LightSampling_Power = 0;
+static const uint LightSampling_BVH = 1;
+
+static const uint LightBVHNodeFlag_Leaf = 1 << 0;
+static const uint LightBVHNodeFlag_TwoSided = 1 << 1;
+
+static const uint LightBVHInvalidBitTrail = 0xFFFFFFFF;
+
+// Node of a light BVH built on the CPU, must match CPU::LightBVH::Node. Interior nodes are followed by their first
+// child, ChildOrLightIndex is the second child of interior nodes and the light of leaves
+struct LightBVHNode
+{
+	float3 Min;
+	float Phi; // Luminance of the power of the lights below
+	float3 Max;
+	uint ChildOrLightIndex;
+	float3 w; // Axis of the cone of normals
+	float CosTheta_o; // Spread of the normals around w
+	float CosTheta_e; // Angle past a normal light is emitted at
+	uint Flags;
+};
+
+float LightBVHSafeSqrt(float x)
+{
+	return sqrt(max(x, 0.0f));
+}
+
+// cos(a - b) and sin(a - b) with the difference clamped at 0
+float CosSubClamped(float SinThetaA, float CosThetaA, float SinThetaB, float CosThetaB)
+{
+	return CosThetaA > CosThetaB ? 1.0f : CosThetaA * CosThetaB + SinThetaA * SinThetaB;
+}
+
+float SinSubClamped(float SinThetaA, float CosThetaA, float SinThetaB, float CosThetaB)
+{
+	return CosThetaA > CosThetaB ? 0.0f : SinThetaA * CosThetaB - CosThetaA * SinThetaB;
+}
+
+// Upper bound of what the lights of the node contribute to p with normal n, see Importance in Graphics/CPU/LightBVH.cpp
+float LightBVHImportance(LightBVHNode Node, float3 p, float3 n)
+{
+	const float3 center = (Node.Min + Node.Max) * 0.5f;
+
+	// Keeps the importance finite for points inside the bounds
+	const float distance2 = dot(p - center, p - center);
+	const float d2 = max(distance2, length(Node.Max - Node.Min) * 0.5f);
+	if (d2 == 0.0f)
+	{
+		return 0.0f;
+	}
+
+	const float3 wi = normalize(p - center);
+	float cosTheta_w = dot(Node.w, wi);
+	if (Node.Flags & LightBVHNodeFlag_TwoSided)
+	{
+		cosTheta_w = abs(cosTheta_w);
+	}
+	const float sinTheta_w = LightBVHSafeSqrt(1.0f - cosTheta_w * cosTheta_w);
+
+	// Directions the bounding sphere of the node subtends from p
+	const float r2 = dot(Node.Max - center, Node.Max - center);
+	const float cosTheta_b = distance2 < r2 ? -1.0f : LightBVHSafeSqrt(1.0f - r2 / distance2);
+	const float sinTheta_b = LightBVHSafeSqrt(1.0f - cosTheta_b * cosTheta_b);
+
+	// Smallest angle between wi and an emitter normal, then shrunk by the angle of the bounds
+	const float sinTheta_o = LightBVHSafeSqrt(1.0f - Node.CosTheta_o * Node.CosTheta_o);
+	const float cosTheta_x = CosSubClamped(sinTheta_w, cosTheta_w, sinTheta_o, Node.CosTheta_o);
+	const float sinTheta_x = SinSubClamped(sinTheta_w, cosTheta_w, sinTheta_o, Node.CosTheta_o);
+	const float cosTheta_p = CosSubClamped(sinTheta_x, cosTheta_x, sinTheta_b, cosTheta_b);
+	if (cosTheta_p <= Node.CosTheta_e)
+	{
+		return 0.0f;
+	}
+
+	float importance = Node.Phi * cosTheta_p / d2;
+
+	if (any(n))
+	{
+		const float cosTheta_i = abs(dot(wi, n));
+		const float sinTheta_i = LightBVHSafeSqrt(1.0f - cosTheta_i * cosTheta_i);
+		importance *= CosSubClamped(sinTheta_i, cosTheta_i, sinTheta_b, cosTheta_b);
+	}
+
+	return max(importance, 0.0f);
+}
+
+// Walks down from the root picking children by importance and reusing u at every level, false when no light reaches p
+bool SampleLightBVH(StructuredBuffer<LightBVHNode> Nodes, float3 p, float3 n, float u, out uint LightIndex, out float Pmf)
+{
+	LightIndex = 0;
+	Pmf = 0.0f;
+
+	uint nodeIndex = 0;
+	float pmf = 1.0f;
+	LightBVHNode node = Nodes[0];
+	while (!(node.Flags & LightBVHNodeFlag_Leaf))
+	{
+		const uint child1 = node.ChildOrLightIndex;
+		const LightBVHNode node0 = Nodes[nodeIndex + 1];
+		const LightBVHNode node1 = Nodes[child1];
+		const float importance0 = LightBVHImportance(node0, p, n);
+		const float importance1 = LightBVHImportance(node1, p, n);
+		if (importance0 == 0.0f && importance1 == 0.0f)
+		{
+			return false;
+		}
+
+		const float p0 = importance0 / (importance0 + importance1);
+		if (u < p0)
+		{
+			nodeIndex = nodeIndex + 1;
+			node = node0;
+			u = min(u / p0, 0.99999994f);
+			pmf *= p0;
+		}
+		else
+		{
+			nodeIndex = child1;
+			node = node1;
+			u = min((u - p0) / (1.0f - p0), 0.99999994f);
+			pmf *= 1.0f - p0;
+		}
+	}
+
+	// A leaf is only picked through a parent that saw it contribute, except when it is the root
+	if (nodeIndex == 0 && LightBVHImportance(node, p, n) == 0.0f)
+	{
+		return false;
+	}
+
+	LightIndex = node.ChildOrLightIndex;
+	Pmf = pmf;
+	return true;
+}
+
+// Probability of SampleLightBVH picking the light, follows the bit trail of the light down to its leaf
+float LightBVHPmf(StructuredBuffer<LightBVHNode> Nodes, StructuredBuffer<uint> BitTrails, float3 p, float3 n, uint LightIndex)
+{
+	uint bitTrail = BitTrails[LightIndex];
+	if (bitTrail == LightBVHInvalidBitTrail)
+	{
+		return 0.0f;
+	}
+
+	uint nodeIndex = 0;
+	float pmf = 1.0f;
+	LightBVHNode node = Nodes[0];
+	while (!(node.Flags & LightBVHNodeFlag_Leaf))
+	{
+		const uint children[2] = { nodeIndex + 1, node.ChildOrLightIndex };
+		const float importance0 = LightBVHImportance(Nodes[children[0]], p, n);
+		const float importance1 = LightBVHImportance(Nodes[children[1]], p, n);
+		if (importance0 == 0.0f && importance1 == 0.0f)
+		{
+			return 0.0f;
+		}
+
+		const uint child = bitTrail & 1;
+		pmf *= (child ? importance1 : importance0) / (importance0 + importance1);
+		nodeIndex = children[child];
+		node = Nodes[nodeIndex];
+		bitTrail >>= 1;
+	}
+
+	if (nodeIndex == 0 && LightBVHImportance(node, p, n) == 0.0f)
+	{
+		return 0.0f;
+	}
+	return pmf;
+}
+
+// Slab test against [0, TMax], see LightBVH::IntersectBounds. min and max return the other operand for NaN, so rays in
+// the plane of a flat side leave the interval as it is
+bool LightBVHIntersectBounds(LightBVHNode Node, float3 Origin, float3 InvDirection, float TMax)
+{
+	const float3 t0 = (Node.Min - Origin) * InvDirection;
+	const float3 t1 = (Node.Max - Origin) * InvDirection;
+	const float3 tNear = min(t0, t1);
+	const float3 tFar = max(t0, t1);
+	const float tMin = max(max(tNear.x, tNear.y), max(tNear.z, 0.0f));
+	const float tMax = min(min(tFar.x, tFar.y), min(tFar.z, TMax));
+	return tMin <= tMax;
+}
+
+#endif // LIGHT_BVH_HLSLI
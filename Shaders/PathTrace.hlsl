@@ -1,26 +1,51 @@
 #include "Global.hlsli"
+#include <Sampler.hlsli>
+#include <AdaptiveSampling.hlsli>
+
+// Sample dimensions drawn for the camera and for every bounce, each bounce draws all of its dimensions so the
+// dimension of a decision only depends on the depth
+static const uint CameraDimensions = 2; // Pixel jitter
+static const uint BounceDimensions = 9; // Light selection, light sample (2), BSDF sample (2), Russian roulette, mesh light triangle, environment sample (2)
 
 // HitGroup Local Root Signature
 // ====================
 cbuffer RootConstants : register(b0, space1)
 {
 	uint MaterialIndex;
+	uint VertexFormat;
+	uint IndexStride;
 };
 
-StructuredBuffer<Vertex> VertexBuffer : register(t0, space1);
-StructuredBuffer<uint> IndexBuffer : register(t1, space1);
+// Buffers are offset to the start of the submesh
+ByteAddressBuffer VertexBuffer : register(t0, space1);
+ByteAddressBuffer IndexBuffer : register(t1, space1);
+ByteAddressBuffer QuantizationTransform : register(t2, space1);
+
+Vertex FetchVertex(uint Index)
+{
+	if (VertexFormat == VertexFormat_Compact)
+	{
+		float3x4 dequantize = float3x4(
+			asfloat(QuantizationTransform.Load4(0)),
+			asfloat(QuantizationTransform.Load4(16)),
+			asfloat(QuantizationTransform.Load4(32)));
+		return LoadCompactVertex(VertexBuffer, Index, dequantize);
+	}
+	return LoadVertex(VertexBuffer, Index);
+}
 
 SurfaceInteraction GetSurfaceInteraction(in BuiltInTriangleIntersectionAttributes attrib)
 {
 	// Fetch indices
-	unsigned int idx0 = IndexBuffer[PrimitiveIndex() * 3 + 0];
-	unsigned int idx1 = IndexBuffer[PrimitiveIndex() * 3 + 1];
-	unsigned int idx2 = IndexBuffer[PrimitiveIndex() * 3 + 2];
+	uint3 indices = LoadIndices(IndexBuffer, PrimitiveIndex(), IndexStride);
+	unsigned int idx0 = indices.x;
+	unsigned int idx1 = indices.y;
+	unsigned int idx2 = indices.z;
 	
 	// Fetch vertices
-	Vertex vtx0 = VertexBuffer[idx0];
-	Vertex vtx1 = VertexBuffer[idx1];
-	Vertex vtx2 = VertexBuffer[idx2];
+	Vertex vtx0 = FetchVertex(idx0);
+	Vertex vtx1 = FetchVertex(idx1);
+	Vertex vtx2 = FetchVertex(idx2);
 	
 	float3 p0 = vtx0.Position, p1 = vtx1.Position, p2 = vtx2.Position;
 	// Compute 2 edges of the triangle
@@ -49,7 +74,7 @@ SurfaceInteraction GetSurfaceInteraction(in BuiltInTriangleIntersectionAttribute
 	int AlbedoTexture = material.TextureIndices[AlbedoIdx];
 	if (AlbedoTexture != -1)
 	{
-		material.baseColor = g_Texture2DTable[AlbedoTexture].SampleLevel(g_SamplerAnisotropicWrap, si.uv, 0.0f).rgb;
+		material.baseColor = g_Texture2DTable[AlbedoTexture].SampleLevel(g_SamplerAnisotropicWrap, si.uv, material.TextureMinLOD[AlbedoIdx]).rgb;
 	}
 	
 	si.BSDF = InitBSDF(si.GeometryFrame.n, si.ShadingFrame, material);
@@ -65,6 +90,9 @@ struct RayPayload
 	float3 Direction;
 	uint Seed;
 	uint Depth;
+	uint SampleIndex;
+	float ScatteringPdf; // Of the BSDF sample that spawned the ray, 0 for specular samples
+	float3 ScatteringNormal; // At the origin of the ray, the light BVH pmf depends on it
 };
 
 struct ShadowRayPayload
@@ -102,7 +130,62 @@ float TraceShadowRay(RayDesc DXRRay)
 	return RayPayload.Visibility;
 }
 
-float3 EstimateDirect(SurfaceInteraction si, Light light, float2 XiLight)
+// Picks a triangle of the mesh light with u and a point on it uniformly by area with Xi, see CPU::SampleMeshLi
+float3 SampleMeshLi(Light light, SurfaceInteraction si, float u, float2 Xi, out float3 pWi, out float pPdf, out VisibilityTester pVisibilityTester)
+{
+	pWi = 0.xxx;
+	pPdf = 0.0f;
+	pVisibilityTester = (VisibilityTester) 0;
+	if (light.NumTriangles == 0)
+	{
+		return 0.xxx;
+	}
+	
+	float pmf;
+	const uint index = SampleAliasTable(g_EmissiveTriangleAliasTable, light.FirstTriangle, light.NumTriangles, u, pmf);
+	const EmissiveTriangle emissiveTriangle = g_EmissiveTriangles[light.FirstTriangle + index];
+	
+	const float3 n = cross(emissiveTriangle.p1 - emissiveTriangle.p0, emissiveTriangle.p2 - emissiveTriangle.p0);
+	const float area = 0.5f * length(n);
+	
+	// Uniform barycentrics
+	const float su = sqrt(Xi.x);
+	const float b0 = 1.0f - su;
+	const float b1 = Xi.y * su;
+	const float3 Y = b0 * emissiveTriangle.p0 + b1 * emissiveTriangle.p1 + (1.0f - b0 - b1) * emissiveTriangle.p2;
+	
+	const float3 d = Y - si.p;
+	const float d2 = dot(d, d);
+	if (area == 0.0f || d2 == 0.0f)
+	{
+		return 0.xxx;
+	}
+	
+	pWi = d / sqrt(d2);
+	const float cosTheta = abs(dot(normalize(n), pWi));
+	if (cosTheta == 0.0f)
+	{
+		return 0.xxx;
+	}
+	pPdf = pmf / area * d2 / cosTheta;
+	
+	pVisibilityTester.I0.p = si.p;
+	pVisibilityTester.I0.wo = si.wo;
+	pVisibilityTester.I0.n = si.n;
+	
+	pVisibilityTester.I1.p = Y;
+	
+	return light.I;
+}
+
+float LightSelectionPmf(float3 p, float3 n, uint LightIndex)
+{
+	return g_RenderPassData.LightSampling == LightSampling_BVH ?
+		LightBVHPmf(g_LightBVH, g_LightBitTrails, p, n, LightIndex) :
+		g_LightAliasTable[LightIndex].Pmf;
+}
+
+float3 EstimateDirect(SurfaceInteraction si, Light light, float lightSelectionPdf, float uTriangle, float2 XiLight)
 {
 	float3 Ld = float3(0.0f, 0.0f, 0.0f);
 	
@@ -111,7 +194,9 @@ float3 EstimateDirect(SurfaceInteraction si, Light light, float2 XiLight)
 	float lightPdf = 0.0f, scatteringPdf = 0.0f;
 	VisibilityTester visibilityTester;
 	
-	float3 Li = SampleLi(light, si, XiLight, wi, lightPdf, visibilityTester);
+	float3 Li = light.Type == LightType_Mesh ?
+		SampleMeshLi(light, si, uTriangle, XiLight, wi, lightPdf, visibilityTester) :
+		SampleLi(light, si, XiLight, wi, lightPdf, visibilityTester);
 	if (lightPdf > 0.0f && any(Li))
 	{
 		// Compute BSDF's value for light sample
@@ -127,47 +212,211 @@ float3 EstimateDirect(SurfaceInteraction si, Light light, float2 XiLight)
 			Ld += f * Li * visibility / lightPdf;
 		}
 	
-		if (light.Type == LightType_Quad)
+		// BSDF sampling finds the light as well, see LightEmission and SurfaceEmission
+		if (light.Type == LightType_Quad || light.Type == LightType_Mesh)
 		{
-			float weight = PowerHeuristic(1, lightPdf, 1, scatteringPdf);
+			float weight = g_RenderPassData.MultipleImportanceSampling ? PowerHeuristic(1, lightSelectionPdf * lightPdf, 1, scatteringPdf) : 1.0f;
 			Ld += f * Li * weight * visibility / lightPdf;
 		}
 	}
-	
-	// No BSDF MIS yet
 
 	return Ld;
 }
 
-float3 UniformSampleOneLight(SurfaceInteraction si, inout uint seed)
+float3 SampleOneLight(SurfaceInteraction si, float uLight, float uTriangle, float2 XiLight)
 {
 	if (g_SystemConstants.NumLights == 0)
 	{
 		return float3(0.0f, 0.0f, 0.0f);
 	}
 	
-	int numLights = g_SystemConstants.NumLights;
-
-	int lightIndex = min(RandomFloat01(seed) * numLights, numLights-1);
-	float lightPdf = 1.0f / float(numLights);
+	float lightPdf;
+	uint lightIndex;
+	if (g_RenderPassData.LightSampling == LightSampling_BVH)
+	{
+		if (!SampleLightBVH(g_LightBVH, si.p, si.n, uLight, lightIndex, lightPdf))
+		{
+			return float3(0.0f, 0.0f, 0.0f);
+		}
+	}
+	else
+	{
+		lightIndex = SampleAliasTable(g_LightAliasTable, g_SystemConstants.NumLights, uLight, lightPdf);
+	}
 
 	Light light = g_Lights[lightIndex];
 
-	float2 XiLight = float2(RandomFloat01(seed), RandomFloat01(seed));
+	return EstimateDirect(si, light, lightPdf, uTriangle, XiLight) / lightPdf;
+}
 
-	return EstimateDirect(si, light, XiLight) / lightPdf;
+float3 EnvironmentLe(float3 w)
+{
+	const float2 uv = EnvironmentDirectionToUV(w);
+	return g_RenderPassData.EnvironmentScale * g_Texture2DTable[g_RenderPassData.Environment].SampleLevel(g_SamplerPointWrap, uv, g_RenderPassData.EnvironmentMinLOD).rgb;
+}
+
+// The environment light is sampled on its own with one more shadow ray, so it is weighted against the BSDF only and
+// does not take part in light selection
+float3 SampleEnvironmentLight(SurfaceInteraction si, float2 Xi)
+{
+	float lightPdf;
+	const float3 wi = SampleEnvironment(g_EnvironmentDistribution, g_RenderPassData.EnvironmentWidth, g_RenderPassData.EnvironmentHeight, Xi, lightPdf);
+	if (lightPdf <= 0.0f)
+	{
+		return float3(0.0f, 0.0f, 0.0f);
+	}
+	
+	const float3 f = si.BSDF.f(si.wo, wi) * abs(dot(wi, si.ShadingFrame.n));
+	if (!any(f))
+	{
+		return float3(0.0f, 0.0f, 0.0f);
+	}
+	
+	RayDesc ray = { si.p, 0.0001f, wi, FLT_MAX };
+	const float visibility = TraceShadowRay(ray);
+	
+	const float weight = g_RenderPassData.MultipleImportanceSampling ? PowerHeuristic(1, lightPdf, 1, si.BSDF.Pdf(si.wo, wi)) : 1.0f;
+	return f * EnvironmentLe(wi) * weight * visibility / lightPdf;
+}
+
+// Radiance of the environment along the ray that left the scene, weighted against sampling it in SampleEnvironmentLight
+float3 EnvironmentEmission(float3 wi, float ScatteringPdf)
+{
+	if (g_RenderPassData.Environment < 0)
+	{
+		return float3(0.0f, 0.0f, 0.0f);
+	}
+	
+	// Camera rays and specular directions cannot be found by sampling the environment
+	if (ScatteringPdf == 0.0f)
+	{
+		return EnvironmentLe(wi);
+	}
+	
+	// Without MIS lights are only found by sampling them
+	if (!g_RenderPassData.MultipleImportanceSampling)
+	{
+		return float3(0.0f, 0.0f, 0.0f);
+	}
+	
+	const float lightPdf = EnvironmentPdf(g_EnvironmentDistribution, g_RenderPassData.EnvironmentWidth, g_RenderPassData.EnvironmentHeight, wi);
+	return EnvironmentLe(wi) * PowerHeuristic(1, ScatteringPdf, 1, lightPdf);
+}
+
+// Radiance the ray from p along wi receives from the closest light it passes before TMax, weighted against sampling
+// that light in SampleOneLight from p with normal n. Lights are not in the acceleration structure, only the lights whose
+// bounds the ray enters in g_LightBVH are tested. Lights without power are not in the tree and emit nothing
+float3 LightEmission(float3 p, float3 n, float3 wi, float TMax, float ScatteringPdf)
+{
+	// Without MIS lights are only found by sampling them, unless the direction came from a specular BSDF
+	if (!g_RenderPassData.MultipleImportanceSampling && ScatteringPdf > 0.0f)
+	{
+		return float3(0.0f, 0.0f, 0.0f);
+	}
+	
+	float3 Le = float3(0.0f, 0.0f, 0.0f);
+	float closest = TMax;
+	float lightPdf = 0.0f;
+	uint lightIndex = 0;
+	
+	// Bit trails are 32 bit so no leaf is deeper than 32, at most one node is pushed per level
+	const float3 invDirection = rcp(wi);
+	uint stack[32];
+	uint stackSize = 0;
+	uint nodeIndex = 0;
+	while (true)
+	{
+		const LightBVHNode node = g_LightBVH[nodeIndex];
+		if (LightBVHIntersectBounds(node, p, invDirection, closest))
+		{
+			if (!(node.Flags & LightBVHNodeFlag_Leaf))
+			{
+				stack[stackSize++] = node.ChildOrLightIndex;
+				nodeIndex = nodeIndex + 1;
+				continue;
+			}
+			
+			// An empty tree is a single leaf without power, see Renderer
+			const uint i = node.ChildOrLightIndex;
+			float t, pdf;
+			float3 Li;
+			if (i < g_SystemConstants.NumLights && IntersectLight(g_Lights[i], p, wi, t, Li, pdf) && t < closest)
+			{
+				closest = t;
+				Le = Li;
+				lightPdf = pdf;
+				lightIndex = i;
+			}
+		}
+		
+		if (stackSize == 0)
+		{
+			break;
+		}
+		nodeIndex = stack[--stackSize];
+	}
+	
+	// Specular directions cannot be found by sampling the light
+	if (ScatteringPdf == 0.0f || !any(Le))
+	{
+		return Le;
+	}
+	
+	lightPdf *= LightSelectionPmf(p, n, lightIndex);
+	return Le * PowerHeuristic(1, ScatteringPdf, 1, lightPdf);
+}
+
+// Radiance of the emissive surface the ray hit, weighted against sampling its mesh light in SampleOneLight from the
+// origin of the ray with normal n. Emissive instances that are not mesh lights are only found by BSDF sampling
+float3 SurfaceEmission(float3 n, float ScatteringPdf)
+{
+	const Material material = g_Materials[MaterialIndex];
+	if (material.LightIndex < 0 || ScatteringPdf == 0.0f)
+	{
+		return material.emissive;
+	}
+	
+	// Without MIS lights are only found by sampling them
+	if (!g_RenderPassData.MultipleImportanceSampling)
+	{
+		return float3(0.0f, 0.0f, 0.0f);
+	}
+	
+	// The triangle was picked with the probability of its object space area, which does not depend on the order of
+	// the triangles in the acceleration structure
+	const uint3 indices = LoadIndices(IndexBuffer, PrimitiveIndex(), IndexStride);
+	const float3 p0 = FetchVertex(indices.x).Position;
+	const float3 e0 = FetchVertex(indices.y).Position - p0;
+	const float3 e1 = FetchVertex(indices.z).Position - p0;
+	const float3 worldNormal = cross(mul((float3x3) ObjectToWorld3x4(), e0), mul((float3x3) ObjectToWorld3x4(), e1));
+	const float objectArea = 0.5f * length(cross(e0, e1));
+	const float area = 0.5f * length(worldNormal);
+	
+	const Light light = g_Lights[material.LightIndex];
+	const float3 d = WorldRayDirection() * RayTCurrent();
+	const float d2 = dot(d, d);
+	const float cosTheta = abs(dot(normalize(worldNormal), normalize(d)));
+	if (area == 0.0f || cosTheta == 0.0f)
+	{
+		return float3(0.0f, 0.0f, 0.0f);
+	}
+	
+	const float triangleMeshPdf = objectArea / light.ObjectArea / area * d2 / cosTheta;
+	const float lightPdf = LightSelectionPmf(WorldRayOrigin(), n, material.LightIndex) * triangleMeshPdf;
+	return material.emissive * PowerHeuristic(1, ScatteringPdf, 1, lightPdf);
 }
 
 void TerminateRay(inout RayPayload rayPayload)
 {
-	rayPayload.Depth = g_RenderPassData.MaxDepth;
+	rayPayload.Depth = g_RenderPassData.MaxDepth + 1;
 }
 
-float3 Li(RayDesc DXRRay, inout uint Seed)
+float3 Li(RayDesc DXRRay, inout uint Seed, uint SampleIndex)
 {
-	RayPayload RayPayload = { float3(0.0f, 0.0f, 0.0f), float3(1.0f, 1.0f, 1.0f), DXRRay.Origin, DXRRay.Direction, Seed, 0 };
+	RayPayload RayPayload = { float3(0.0f, 0.0f, 0.0f), float3(1.0f, 1.0f, 1.0f), DXRRay.Origin, DXRRay.Direction, Seed, 0, SampleIndex, 0.0f, float3(0.0f, 0.0f, 0.0f) };
 	
-	while (RayPayload.Depth < g_RenderPassData.MaxDepth)
+	// The ray leaving the last bounce is traced as well, it only gathers the lights it passes
+	while (RayPayload.Depth <= g_RenderPassData.MaxDepth)
 	{
 		// Trace the ray
 		const uint RayFlags = RAY_FLAG_NONE;
@@ -191,6 +440,7 @@ float3 Li(RayDesc DXRRay, inout uint Seed)
 		RayPayload.Depth++;
 	}
 
+	Seed = RayPayload.Seed;
 	return RayPayload.L;
 }
 
@@ -200,45 +450,54 @@ void RayGeneration()
 	const uint2 launchIndex = DispatchRaysIndex().xy;
 	const uint2 launchDimensions = DispatchRaysDimensions().xy;
 	uint seed = uint(launchIndex.x * uint(1973) + launchIndex.y * uint(9277) + uint(g_SystemConstants.TotalFrameCount) * uint(26699)) | uint(1);
-	
-	float3 L = float3(0.0f, 0.0f, 0.0f);
-	for (int sample = 0; sample < g_RenderPassData.NumSamplesPerPixel; ++sample)
+
+	RWTexture2D<float4> RenderTarget = g_RWTexture2DTable[g_RenderPassData.RenderTarget];
+	RWTexture2D<float4> Moments = g_RWTexture2DTable[g_RenderPassData.Moments];
+
+	// Pixels keep their own sample count, adaptive sampling gives every tile a different number of samples per frame
+	const bool accumulate = g_RenderPassData.NumAccumulatedSamples > 0;
+	float3 mean = accumulate ? RenderTarget[launchIndex].rgb : float3(0.0f, 0.0f, 0.0f);
+	float4 moments = accumulate ? Moments[launchIndex] : float4(0.0f, 0.0f, 0.0f, 0.0f);
+
+	uint numSamples = g_RenderPassData.NumSamplesPerPixel;
+	if (g_RenderPassData.TileSamples >= 0 && accumulate)
 	{
+		RWTexture2D<float4> TileSamples = g_RWTexture2DTable[g_RenderPassData.TileSamples];
+		numSamples = uint(TileSamples[launchIndex / AdaptiveSamplingTileSize].x);
+	}
+
+	if (numSamples == 0)
+	{
+		return;
+	}
+
+	const uint firstSampleIndex = uint(moments.z);
+	for (uint sample = 0; sample < numSamples; ++sample)
+	{
+		const uint sampleIndex = firstSampleIndex + sample;
+		Sampler samples = InitSampler(g_RenderPassData.Sampler, launchIndex, sampleIndex, 0, seed, g_RenderPassData.BlueNoise, g_RenderPassData.BlueNoiseChannels);
+
 		// Calculate subpixel camera jitter for anti aliasing
-		const float2 jitter = float2(RandomFloat01(seed), RandomFloat01(seed)) - 0.5f;
+		const float2 jitter = samples.Get2D() - 0.5f;
+		seed = samples.Seed;
 		const float2 pixel = (float2(launchIndex) + jitter) / float2(launchDimensions);
 
 		const float2 ndc = float2(2, -2) * pixel + float2(-1, 1);
 
 		// Initialize ray
 		RayDesc ray = g_SystemConstants.Camera.GenerateCameraRay(ndc, seed);
-	
-		L += Li(ray, seed);
-	}
-	L /= float(g_RenderPassData.NumSamplesPerPixel);
-	
-	// Replace NaN components with zero. See explanation in Ray Tracing: The Rest of Your Life.
-	if (L.r != L.r)
-	{
-		L.r = 0.0;
-	}
-	if (L.g != L.g)
-	{
-		L.g = 0.0;
-	}
-	if (L.b != L.b)
-	{
-		L.b = 0.0;
-	}
 
-	RWTexture2D<float4> RenderTarget = g_RWTexture2DTable[g_RenderPassData.RenderTarget];
-	
-	if (g_RenderPassData.NumAccumulatedSamples > 0)
-	{
-		L = lerp(RenderTarget[launchIndex].rgb, L, 1.0f / float(g_RenderPassData.NumAccumulatedSamples));
+		float3 L = Li(ray, seed, sampleIndex);
+
+		// Replace NaN components with zero. See explanation in Ray Tracing: The Rest of Your Life.
+		L = isnan(L) ? 0.0f : L;
+
+		moments = AddSample(moments, RGBToCIELuminance(L));
+		mean += (L - mean) / moments.z;
 	}
-	
-	RenderTarget[launchIndex] = float4(L, 1);
+
+	RenderTarget[launchIndex] = float4(mean, 1);
+	Moments[launchIndex] = moments;
 }
 
 [shader("miss")]
@@ -246,6 +505,15 @@ void Miss(inout RayPayload rayPayload : SV_RayPayload)
 {
 	//float t = 0.5f * (WorldRayDirection().y + 1.0f);
 	//rayPayload.L += rayPayload.beta * lerp(float3(1.0, 1.0, 1.0), float3(0.5, 0.7, 1.0), t);
+	
+	// Lights are not visible to camera rays
+	if (rayPayload.Depth > 0)
+	{
+		rayPayload.L += rayPayload.beta * LightEmission(WorldRayOrigin(), rayPayload.ScatteringNormal, WorldRayDirection(), RayTCurrent(), rayPayload.ScatteringPdf);
+	}
+	
+	// The environment is visible to every ray
+	rayPayload.L += rayPayload.beta * EnvironmentEmission(WorldRayDirection(), rayPayload.ScatteringPdf);
 	TerminateRay(rayPayload);
 }
 
@@ -259,19 +527,48 @@ void ShadowMiss(inout ShadowRayPayload rayPayload : SV_RayPayload)
 [shader("closesthit")]
 void ClosestHit(inout RayPayload rayPayload : SV_RayPayload, in BuiltInTriangleIntersectionAttributes attrib)
 {
+	// Lights the ray passed before the surface, lights are not visible to camera rays
+	if (rayPayload.Depth > 0)
+	{
+		rayPayload.L += rayPayload.beta * LightEmission(WorldRayOrigin(), rayPayload.ScatteringNormal, WorldRayDirection(), RayTCurrent(), rayPayload.ScatteringPdf);
+	}
+	
+	// Emissive surfaces are visible to every ray
+	rayPayload.L += rayPayload.beta * SurfaceEmission(rayPayload.ScatteringNormal, rayPayload.ScatteringPdf);
+	
+	if (rayPayload.Depth == g_RenderPassData.MaxDepth)
+	{
+		TerminateRay(rayPayload);
+		return;
+	}
+	
 	SurfaceInteraction si = GetSurfaceInteraction(attrib);
 	
+	Sampler samples = InitSampler(g_RenderPassData.Sampler, DispatchRaysIndex().xy, rayPayload.SampleIndex, CameraDimensions + rayPayload.Depth * BounceDimensions, rayPayload.Seed, g_RenderPassData.BlueNoise, g_RenderPassData.BlueNoiseChannels);
+	const float uLight = samples.Get1D();
+	const float2 XiLight = samples.Get2D();
+	const float2 XiBSDF = samples.Get2D();
+	const float uRR = samples.Get1D();
+	const float uTriangle = samples.Get1D();
+	const float2 XiEnvironment = samples.Get2D();
+	rayPayload.Seed = samples.Seed;
+	
 	// Sample illumination from lights to find path contribution.
 	// (But skip this for perfectly specular BSDFs.)
 	if (si.BSDF.IsNonSpecular())
 	{
-		rayPayload.L += rayPayload.beta * UniformSampleOneLight(si, rayPayload.Seed);
+		rayPayload.L += rayPayload.beta * SampleOneLight(si, uLight, uTriangle, XiLight);
+		
+		if (g_RenderPassData.Environment >= 0)
+		{
+			rayPayload.L += rayPayload.beta * SampleEnvironmentLight(si, XiEnvironment);
+		}
 	}
 	
 	// Sample BSDF to get new path direction
 	float3 wo = -WorldRayDirection();
 	BSDFSample bsdfSample = (BSDFSample) 0;
-	bool success = si.BSDF.Samplef(wo, float2(RandomFloat01(rayPayload.Seed), RandomFloat01(rayPayload.Seed)), bsdfSample);
+	bool success = si.BSDF.Samplef(wo, XiBSDF, bsdfSample);
 	if (!success)
 	{
 		// Used to debug
@@ -285,17 +582,26 @@ void ClosestHit(inout RayPayload rayPayload : SV_RayPayload, in BuiltInTriangleI
 	// Spawn new ray
 	rayPayload.Position = si.p;
 	rayPayload.Direction = bsdfSample.wi;
+	rayPayload.ScatteringPdf = (bsdfSample.flags & BxDFFlags::Specular) ? 0.0f : bsdfSample.pdf;
+	rayPayload.ScatteringNormal = si.n;
 	
-	const float rrThreshold = 1.0f;
-	float3 rr = rayPayload.beta;
-	float rrMaxComponentValue = max(rr.x, max(rr.y, rr.z));
-	if (rrMaxComponentValue < rrThreshold && rayPayload.Depth > 1)
+	// Russian roulette, once the path has RussianRouletteMinDepth bounces it survives with a probability that follows
+	// its throughput, clamped below so the weights of the survivors stay bounded
+	const float rrMaxComponentValue = max(rayPayload.beta.x, max(rayPayload.beta.y, rayPayload.beta.z));
+	if (rrMaxComponentValue <= 0.0f)
+	{
+		TerminateRay(rayPayload);
+	}
+	else if (rayPayload.Depth + 1 >= g_RenderPassData.RussianRouletteMinDepth)
 	{
-		float q = max(0.0f, 1.0f - rrMaxComponentValue);
-		if (RandomFloat01(rayPayload.Seed) < q)
+		const float survival = max(rrMaxComponentValue, g_RenderPassData.RussianRouletteMinSurvival);
+		if (survival < 1.0f)
 		{
-			TerminateRay(rayPayload);
+			if (uRR >= survival)
+			{
+				TerminateRay(rayPayload);
+			}
+			rayPayload.beta /= survival;
 		}
-		rayPayload.beta /= 1.0f - q;
 	}
 }
\ No newline at end of file
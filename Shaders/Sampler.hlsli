@@ -0,0 +1,153 @@
+#ifndef SAMPLER_HLSLI
+#define SAMPLER_HLSLI
+
+#include <DescriptorTable.hlsli>
+#include <Random.hlsli>
+#include <SobolMatrices.hlsli>
+
+static const float g_GoldenRatioConjugate = 0.618033989f;
+
+// Must match CPU::SamplerType in Graphics/CPU/Sampler.h
+static const uint SamplerType_Independent = 0;
+static const uint SamplerType_BlueNoise = 1;
+static const uint SamplerType_Sobol = 2;
+
+uint Hash(uint Value)
+{
+	return WangHash(Value);
+}
+
+// 24 bits fit in a float exactly, the result is in [0, 1)
+float ToFloat01(uint Value)
+{
+	return float(Value >> 8) * 5.96046448e-8f;
+}
+
+uint SobolSample(uint Index, uint Dimension)
+{
+	uint value = 0;
+	for (uint i = Dimension * SobolMatrixSize; Index; Index >>= 1, ++i)
+	{
+		if (Index & 1)
+		{
+			value ^= SobolMatrices[i];
+		}
+	}
+	return value;
+}
+
+// Hash based nested uniform (Owen) scrambling of the bits of Value, Laine and Karras 2011 / Burley 2020
+uint OwenScramble(uint Value, uint Seed)
+{
+	Value = reversebits(Value);
+	Value += Seed;
+	Value ^= Value * 0x6c50b47cu;
+	Value ^= Value * 0xb82f1e52u;
+	Value ^= Value * 0xc7afe638u;
+	Value ^= Value * 0x8d22f6e6u;
+	return reversebits(Value);
+}
+
+// Every Get1D/Get2D call consumes the next dimension(s) of the pixel sample, see Graphics/CPU/Sampler.h for the C++
+// counterpart the sequences are validated against.
+// - Independent: white noise
+// - BlueNoise: spatiotemporal blue noise texture array (see Graphics/CPU/BlueNoiseGenerator.h) with 1, 2 or 4 independent
+//   8-bit channels per texel. Sample i of a pixel reads slice i % depth, so consecutive samples step through the sequence the
+//   set was optimized for
+// - Sobol: padded Owen scrambled Sobol, pixels are decorrelated by a Cranley-Patterson rotation read from the first
+//   blue noise slice so the remaining error is distributed as blue noise, hashed when the texture is not loaded
+// BlueNoise falls back to white noise when the texture is not loaded (BlueNoise is -1)
+struct Sampler
+{
+	float Get1D()
+	{
+		uint dimension = Dimension++;
+		if (Type == SamplerType_Sobol)
+		{
+			return Sobol(0, dimension);
+		}
+		if (Type == SamplerType_BlueNoise && BlueNoise >= 0)
+		{
+			return LoadBlueNoise(dimension, SampleIndex);
+		}
+		return RandomFloat01(Seed);
+	}
+
+	float2 Get2D()
+	{
+		if (Type == SamplerType_Sobol)
+		{
+			// Both values come from the same index, the first two Sobol dimensions form a (0, 2)-sequence
+			uint dimension = Dimension;
+			Dimension += 2;
+			return float2(Sobol(0, dimension), Sobol(1, dimension));
+		}
+
+		float x = Get1D();
+		float y = Get1D();
+		return float2(x, y);
+	}
+
+	float Sobol(uint sobolDimension, uint dimension)
+	{
+		// The index is shuffled per draw so draws are not correlated with each other
+		uint seed = Hash(dimension);
+		uint index = OwenScramble(SampleIndex, seed);
+		float value = ToFloat01(OwenScramble(SobolSample(index, sobolDimension), Hash(seed + sobolDimension + 1)));
+
+		float rotated = value + Rotation(dimension + sobolDimension);
+		return rotated >= 1.0f ? rotated - 1.0f : rotated;
+	}
+
+	float Rotation(uint dimension)
+	{
+		if (BlueNoise >= 0)
+		{
+			return LoadBlueNoise(dimension, 0);
+		}
+		return ToFloat01(Hash(Pixel.x + Hash(Pixel.y + Hash(dimension))));
+	}
+
+	float LoadBlueNoise(uint dimension, uint sampleIndex)
+	{
+		Texture2DArray texture = g_Texture2DArrayTable[BlueNoise];
+		uint width, height, depth;
+		texture.GetDimensions(width, height, depth);
+
+		// Every BlueNoiseChannels dimensions share a texel, later groups read the tile at a hashed offset to decorrelate them
+		uint hash = Hash(dimension / BlueNoiseChannels + 1);
+		uint2 texel = (Pixel + uint2(hash, hash >> 16)) % uint2(width, height);
+
+		float value = texture.Load(int4(texel, sampleIndex % depth, 0))[dimension % BlueNoiseChannels];
+
+		// 8-bit levels are stored as rank * 256 / N, map them to the center of their interval in [0, 1)
+		value = (round(value * 255.0f) + 0.5f) / 256.0f;
+
+		// Once every slice has been used, rotate the values by the golden ratio (Cranley-Patterson rotation), the
+		// sequence of a pixel keeps producing new values and stays uniformly distributed
+		return frac(value + g_GoldenRatioConjugate * float(sampleIndex / depth));
+	}
+
+	uint Type; // SamplerType_*
+	uint2 Pixel;
+	uint SampleIndex;
+	uint Dimension;
+	uint Seed; // State of the white noise sampler
+	int BlueNoise; // Index into g_Texture2DArrayTable
+	uint BlueNoiseChannels; // 1, 2 or 4
+};
+
+Sampler InitSampler(uint Type, uint2 Pixel, uint SampleIndex, uint Dimension, uint Seed, int BlueNoise, uint BlueNoiseChannels)
+{
+	Sampler samples;
+	samples.Type = Type;
+	samples.Pixel = Pixel;
+	samples.SampleIndex = SampleIndex;
+	samples.Dimension = Dimension;
+	samples.Seed = Seed;
+	samples.BlueNoise = BlueNoise;
+	samples.BlueNoiseChannels = BlueNoiseChannels;
+	return samples;
+}
+
+#endif // SAMPLER_HLSLI
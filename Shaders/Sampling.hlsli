@@ -75,4 +75,31 @@ float PowerHeuristic(int nf, float fPdf, int ng, float gPdf)
 	return (f * f) / (f * f + g * g);
 }
 
+// Bin of an alias table built on the CPU, must match CPU::AliasTable::Bin
+struct AliasTableBin
+{
+	float q; // Probability of keeping the bin instead of taking its alias
+	uint Alias;
+	float Pmf; // Of the element of the bin
+};
+
+// Samples the table that starts at First in O(1), the fraction of u left after picking a bin decides between the bin
+// and its alias. Aliases and the index returned are relative to First
+uint SampleAliasTable(StructuredBuffer<AliasTableBin> Table, uint First, uint NumBins, float u, out float pPmf)
+{
+	float scaled = u * float(NumBins);
+	uint bin = min(uint(scaled), NumBins - 1);
+	float up = min(scaled - float(bin), 0.99999994f);
+
+	AliasTableBin b = Table[First + bin];
+	uint index = up < b.q ? bin : b.Alias;
+	pPmf = Table[First + index].Pmf;
+	return index;
+}
+
+uint SampleAliasTable(StructuredBuffer<AliasTableBin> Table, uint NumBins, float u, out float pPmf)
+{
+	return SampleAliasTable(Table, 0, NumBins, u, pPmf);
+}
+
 #endif // SAMPLING_HLSLI
\ No newline at end of file
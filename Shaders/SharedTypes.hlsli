@@ -37,11 +37,17 @@ struct Material
 	
 	int TextureIndices[NumTextureTypes];
 	int TextureChannel[NumTextureTypes];
+	float TextureMinLOD[NumTextureTypes]; // Most detailed mip that is resident, textures are streamed in coarsest mip first
+
+	float3 emissive; // Radiance leaving both sides of every triangle
+	int LightIndex; // Mesh light of the instance, -1 when it does not emit
 };
 
 // ==================== Light ====================
 #define LightType_Point (0)
 #define LightType_Quad (1)
+#define LightType_Environment (2) // Never in g_Lights, sampled from g_EnvironmentDistribution
+#define LightType_Mesh (3)
 
 struct Light
 {
@@ -53,6 +59,18 @@ struct Light
 	float3 Points[4]; // World-space points that are pre-computed on the Cpu so we don't have to compute them in shader for every ray
 
 	float3 I;
+
+	// Mesh lights, Points[0] and Points[1] hold their world space bounds and I their radiance
+	uint FirstTriangle; // Into g_EmissiveTriangles and g_EmissiveTriangleAliasTable
+	uint NumTriangles;
+	float Area; // World space
+	float ObjectArea; // A triangle is picked with the probability of its object space area over this
+};
+
+// World space triangle of a mesh light
+struct EmissiveTriangle
+{
+	float3 p0, p1, p2;
 };
 
 // ==================== Mesh ====================
@@ -8,6 +8,68 @@ struct Vertex
 	float3 Normal;
 };
 
+// Must match VertexFormat in Vertex.h
+#define VertexFormat_Full (0)
+#define VertexFormat_Compact (1)
+
+// Takes the lower 16 bits
+float DecodeSnorm16(uint Value)
+{
+	return max(float(int(Value << 16) >> 16) / 32767.0f, -1.0f);
+}
+
+float3 DecodeOctahedral(float2 e)
+{
+	float3 n = float3(e.x, e.y, 1.0f - abs(e.x) - abs(e.y));
+	float t = saturate(-n.z);
+	n.xy += (n.xy >= 0.0f) ? -t : t;
+	return normalize(n);
+}
+
+// See Vertex in Vertex.h
+Vertex LoadVertex(ByteAddressBuffer Buffer, uint Index)
+{
+	uint address = Index * 32;
+	uint4 a = Buffer.Load4(address);
+	uint4 b = Buffer.Load4(address + 16);
+
+	Vertex vertex;
+	vertex.Position = asfloat(a.xyz);
+	vertex.TextureCoordinate = asfloat(uint2(a.w, b.x));
+	vertex.Normal = asfloat(b.yzw);
+	return vertex;
+}
+
+// See CompactVertex in Vertex.h, Dequantize takes the SNORM16 position back into object space
+Vertex LoadCompactVertex(ByteAddressBuffer Buffer, uint Index, float3x4 Dequantize)
+{
+	uint4 data = Buffer.Load4(Index * 16);
+
+	Vertex vertex;
+	vertex.Position = mul(Dequantize, float4(DecodeSnorm16(data.x), DecodeSnorm16(data.x >> 16), DecodeSnorm16(data.y), 1.0f));
+	vertex.TextureCoordinate = f16tof32(uint2(data.z, data.z >> 16));
+	vertex.Normal = DecodeOctahedral(float2(DecodeSnorm16(data.w), DecodeSnorm16(data.w >> 16)));
+	return vertex;
+}
+
+// Loads the 3 indices of a triangle, Stride is 2 for 16-bit indices and 4 for 32-bit indices.
+// The buffer has to start on a 4 byte boundary
+uint3 LoadIndices(ByteAddressBuffer Buffer, uint PrimitiveIndex, uint Stride)
+{
+	uint address = PrimitiveIndex * 3 * Stride;
+	if (Stride == 2)
+	{
+		// 6 bytes per triangle, read the 8 aligned bytes that contain them
+		uint2 data = Buffer.Load2(address & ~3);
+		if (address & 2)
+		{
+			return uint3(data.x >> 16, data.y & 0xffff, data.y >> 16);
+		}
+		return uint3(data.x & 0xffff, data.x >> 16, data.y & 0xffff);
+	}
+	return Buffer.Load3(address);
+}
+
 float BarycentricInterpolation(float v0, float v1, float v2, float3 barycentric)
 {
 	return v0 * barycentric.x + v1 * barycentric.y + v2 * barycentric.z;